@@ -154,6 +154,40 @@ Java_com_example_ipmedth_1nfi_bridge_NativeReconstructionEngine_nativeMapModel(
     );
 }
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ipmedth_1nfi_bridge_NativeReconstructionEngine_nativeSetFeatureCacheBudget(
+        JNIEnv* /* env */,
+        jobject /* thiz */,
+        jlong max_num_bytes
+) {
+    if (engine == nullptr) {
+        LOG(MM_ERROR) << "ReconstructionEngine not initialized. Call create() first.";
+        return;
+    }
+    if (max_num_bytes < 0) {
+        LOG(MM_ERROR) << "Feature cache budget must not be negative.";
+        return;
+    }
+
+    engine->setFeatureCacheBudget(static_cast<std::size_t>(max_num_bytes));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_ipmedth_1nfi_bridge_NativeReconstructionEngine_nativeTrimMemory(
+        JNIEnv* /* env */,
+        jobject /* thiz */,
+        jint level
+) {
+    if (engine == nullptr) {
+        LOG(MM_WARNING) << "ReconstructionEngine not initialized, nothing to trim.";
+        return;
+    }
+
+    engine->trimMemory(static_cast<int>(level));
+}
+
 std::string jstringToString(JNIEnv* env, jstring jstr) {
     if (jstr == nullptr) throw std::runtime_error("Could not convert jstring to std::string");
     const char* chars = env->GetStringUTFChars(jstr, nullptr);
@@ -5,6 +5,7 @@
 #include "../scene/database.h"
 #include "../util/file.h"
 #include "../util/misc.h"
+#include "../util/task_scheduler.h"
 #include "../util/timer.h"
 
 #include <numeric>
@@ -67,127 +68,50 @@ struct ImageData {
   FeatureDescriptors descriptors;
 };
 
-class ImageResizerThread : public Thread {
- public:
-  ImageResizerThread(int max_image_size,
-                     JobQueue<ImageData>* input_queue,
-                     JobQueue<ImageData>* output_queue)
-      : max_image_size_(max_image_size),
-        input_queue_(input_queue),
-        output_queue_(output_queue) {}
-
- private:
-  void Run() override {
-    while (true) {
-      if (IsStopped()) {
-        break;
-      }
-
-      auto input_job = input_queue_->Pop();
-      if (input_job.IsValid()) {
-        auto& image_data = input_job.Data();
-
-        if (image_data.status == ImageReader::Status::SUCCESS) {
-          if (static_cast<int>(image_data.bitmap.Width()) > max_image_size_ ||
-              static_cast<int>(image_data.bitmap.Height()) > max_image_size_) {
-            // Fit the down-sampled version exactly into the max dimensions.
-            const double scale =
-                static_cast<double>(max_image_size_) /
-                std::max(image_data.bitmap.Width(), image_data.bitmap.Height());
-            const int new_width =
-                static_cast<int>(image_data.bitmap.Width() * scale);
-            const int new_height =
-                static_cast<int>(image_data.bitmap.Height() * scale);
-
-            image_data.bitmap.Rescale(new_width, new_height);
-          }
-        }
-
-        output_queue_->Push(std::move(image_data));
-      } else {
-        break;
-      }
-    }
+void ResizeImage(const int max_image_size, ImageData* image_data) {
+  if (image_data->status != ImageReader::Status::SUCCESS) {
+    return;
   }
 
-  const int max_image_size_;
-
-  JobQueue<ImageData>* input_queue_;
-  JobQueue<ImageData>* output_queue_;
-};
-
-class SiftFeatureExtractorThread : public Thread {
- public:
-     SiftFeatureExtractorThread(const SiftExtractionOptions& sift_options,
-         const std::shared_ptr<Bitmap>& camera_mask,
-         JobQueue<ImageData>* input_queue,
-         JobQueue<ImageData>* output_queue)
-         : sift_options_(sift_options),
-         camera_mask_(camera_mask),
-         input_queue_(input_queue),
-         output_queue_(output_queue
-     ) {
-         THROW_CHECK(sift_options_.Check());
-     }
-
- private:
-  void Run() override {
-
-    std::unique_ptr<FeatureExtractor> extractor =
-        CreateSiftFeatureExtractor(sift_options_);
-    if (extractor == nullptr) {
-      LOG(MM_ERROR) << "Failed to create feature extractor.";
-      SignalInvalidSetup();
-      return;
-    }
-
-    SignalValidSetup();
+  if (static_cast<int>(image_data->bitmap.Width()) > max_image_size ||
+      static_cast<int>(image_data->bitmap.Height()) > max_image_size) {
+    // Fit the down-sampled version exactly into the max dimensions.
+    const double scale =
+        static_cast<double>(max_image_size) /
+        std::max(image_data->bitmap.Width(), image_data->bitmap.Height());
+    const int new_width = static_cast<int>(image_data->bitmap.Width() * scale);
+    const int new_height =
+        static_cast<int>(image_data->bitmap.Height() * scale);
+
+    image_data->bitmap.Rescale(new_width, new_height);
+  }
+}
 
-    while (true) {
-      if (IsStopped()) {
-        break;
+void ExtractFeatures(FeatureExtractor* extractor,
+                     const Bitmap* camera_mask,
+                     ImageData* image_data) {
+  if (image_data->status == ImageReader::Status::SUCCESS) {
+    if (extractor->Extract(image_data->bitmap,
+                           &image_data->keypoints,
+                           &image_data->descriptors)) {
+      ScaleKeypoints(
+          image_data->bitmap, image_data->camera, &image_data->keypoints);
+      if (camera_mask) {
+        MaskKeypoints(
+            *camera_mask, &image_data->keypoints, &image_data->descriptors);
       }
-
-      auto input_job = input_queue_->Pop();
-      if (input_job.IsValid()) {
-        auto& image_data = input_job.Data();
-
-        if (image_data.status == ImageReader::Status::SUCCESS) {
-          if (extractor->Extract(image_data.bitmap,
-                                 &image_data.keypoints,
-                                 &image_data.descriptors)) {
-            ScaleKeypoints(
-                image_data.bitmap, image_data.camera, &image_data.keypoints);
-            if (camera_mask_) {
-              MaskKeypoints(*camera_mask_,
-                            &image_data.keypoints,
-                            &image_data.descriptors);
-            }
-            if (image_data.mask.Data()) {
-              MaskKeypoints(image_data.mask,
-                            &image_data.keypoints,
-                            &image_data.descriptors);
-            }
-          } else {
-            image_data.status = ImageReader::Status::FAILURE;
-          }
-        }
-
-        image_data.bitmap.Deallocate();
-
-        output_queue_->Push(std::move(image_data));
-      } else {
-        break;
+      if (image_data->mask.Data()) {
+        MaskKeypoints(image_data->mask,
+                      &image_data->keypoints,
+                      &image_data->descriptors);
       }
+    } else {
+      image_data->status = ImageReader::Status::FAILURE;
     }
   }
 
-  const SiftExtractionOptions sift_options_;
-  std::shared_ptr<Bitmap> camera_mask_;
-
-  JobQueue<ImageData>* input_queue_;
-  JobQueue<ImageData>* output_queue_;
-};
+  image_data->bitmap.Deallocate();
+}
 
 class FeatureWriterThread : public Thread {
  public:
@@ -250,6 +174,16 @@ class FeatureWriterThread : public Thread {
                 image_data.pose_prior.position.x(),
                 image_data.pose_prior.position.y(),
                 image_data.pose_prior.position.z());
+          }
+          if (image_data.pose_prior.IsGravityValid()) {
+            LOG(MM_INFO) << StringPrintf(
+                "  Gravity:         X=%.3f, Y=%.3f, Z=%.3f",
+                image_data.pose_prior.gravity.x(),
+                image_data.pose_prior.gravity.y(),
+                image_data.pose_prior.gravity.z());
+          }
+          if (image_data.pose_prior.IsValid() ||
+              image_data.pose_prior.IsGravityValid()) {
             database_->WritePosePrior(image_data.image.ImageId(),
                                       image_data.pose_prior);
           }
@@ -292,16 +226,15 @@ class FeatureExtractorController : public Thread {
     THROW_CHECK(reader_options_.Check());
     THROW_CHECK(sift_options_.Check());
 
-    std::shared_ptr<Bitmap> camera_mask;
     if (!reader_options_.camera_mask_path.empty()) {
       if (ExistsFile(reader_options_.camera_mask_path)) {
-        camera_mask = std::make_shared<Bitmap>();
-        if (!camera_mask->Read(reader_options_.camera_mask_path,
-                               /*as_rgb*/ false)) {
+        camera_mask_ = std::make_shared<Bitmap>();
+        if (!camera_mask_->Read(reader_options_.camera_mask_path,
+                                /*as_rgb*/ false)) {
           LOG(MM_ERROR) << "Failed to read invalid mask file at: "
                      << reader_options_.camera_mask_path
                      << ". No mask is going to be used.";
-          camera_mask.reset();
+          camera_mask_.reset();
         }
       } else {
         LOG(MM_ERROR) << "Mask at " << reader_options_.camera_mask_path
@@ -312,65 +245,36 @@ class FeatureExtractorController : public Thread {
     const int num_threads = GetEffectiveNumThreads(sift_options_.num_threads);
     THROW_CHECK_GT(num_threads, 0);
 
-    // Make sure that we only have limited number of objects in the queue to
+    // Make sure that we only have a limited number of images in flight to
     // avoid excess in memory usage since images and features take lots of
-    // memory.
+    // memory. Every image is resized and extracted by one task of the shared
+    // task scheduler, which uses at most one extractor per running task.
+    max_num_pending_images_ = static_cast<size_t>(num_threads);
     const int kQueueSize = 1;
-    resizer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
-    extractor_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
     writer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
 
-    if (sift_options_.max_image_size > 0) {
-      for (int i = 0; i < num_threads; ++i) {
-        resizers_.emplace_back(
-            std::make_unique<ImageResizerThread>(sift_options_.max_image_size,
-                                                 resizer_queue_.get(),
-                                                 extractor_queue_.get()));
-      }
+    if (sift_options_.num_threads == -1 &&
+        sift_options_.max_image_size ==
+            SiftExtractionOptions().max_image_size &&
+        sift_options_.first_octave == SiftExtractionOptions().first_octave) {
+      LOG(MM_WARNING)
+          << "Your current options use the maximum number of "
+             "threads on the machine to extract features. Extracting SIFT "
+             "features on the CPU can consume a lot of RAM per thread for "
+             "large images. Consider reducing the maximum image size and/or "
+             "the first octave or manually limit the number of extraction "
+             "threads. Ignore this warning, if your machine has sufficient "
+             "memory for the current settings.";
     }
 
-    // GPU
-    if (!sift_options_.domain_size_pooling &&
-        !sift_options_.estimate_affine_shape && sift_options_.use_gpu) {
-      std::vector<int> gpu_indices = CSVToVector<int>(sift_options_.gpu_index);
-      THROW_CHECK_GT(gpu_indices.size(), 0);
-
-      auto sift_gpu_options = sift_options_;
-      for (const auto& gpu_index : gpu_indices) {
-        sift_gpu_options.gpu_index = std::to_string(gpu_index);
-        extractors_.emplace_back(
-            std::make_unique<SiftFeatureExtractorThread>(sift_gpu_options,
-                                                         camera_mask,
-                                                         extractor_queue_.get(),
-                                                         writer_queue_.get()));
-      }
-    } else { // NO GPU
-      if (sift_options_.num_threads == -1 &&
-          sift_options_.max_image_size ==
-              SiftExtractionOptions().max_image_size &&
-          sift_options_.first_octave == SiftExtractionOptions().first_octave
-          ) {
-        LOG(MM_WARNING)
-            << "Your current options use the maximum number of "
-               "threads on the machine to extract features. Extracting SIFT "
-               "features on the CPU can consume a lot of RAM per thread for "
-               "large images. Consider reducing the maximum image size and/or "
-               "the first octave or manually limit the number of extraction "
-               "threads. Ignore this warning, if your machine has sufficient "
-               "memory for the current settings.";
-      }
-
-      auto custom_sift_options = sift_options_;
-      custom_sift_options.use_gpu = false;
-      LOG(MM_DEBUG) << "Using " << num_threads << " threads, to start feature extraction process";
-      for (int i = 0; i < num_threads; ++i) {
-        extractors_.emplace_back(
-            std::make_unique<SiftFeatureExtractorThread>(custom_sift_options,
-                                                         camera_mask,
-                                                         extractor_queue_.get(),
-                                                         writer_queue_.get()));
-      }
-    }
+    auto custom_sift_options = sift_options_;
+    custom_sift_options.use_gpu = false;
+    LOG(MM_DEBUG) << "Using " << num_threads
+                  << " threads, to start feature extraction process";
+    extractors_ = std::make_unique<TaskResourcePool<FeatureExtractor>>(
+        [custom_sift_options]() {
+          return CreateSiftFeatureExtractor(custom_sift_options);
+        });
 
     writer_ = std::make_unique<FeatureWriterThread>(
         image_reader_.NumImages(), &database_, writer_queue_.get());
@@ -382,31 +286,29 @@ class FeatureExtractorController : public Thread {
     Timer run_timer;
     run_timer.Start();
 
-    for (auto& resizer : resizers_) {
-      resizer->Start();
-    }
-
-    for (auto& extractor : extractors_) {
-      extractor->Start();
+    // Create one extractor upfront to validate the options.
+    std::unique_ptr<FeatureExtractor> extractor = extractors_->Acquire();
+    if (extractor == nullptr) {
+      LOG(MM_ERROR) << "Failed to create feature extractor.";
+      return;
     }
+    extractors_->Release(std::move(extractor));
 
     writer_->Start();
 
-    for (auto& extractor : extractors_) {
-      if (!extractor->CheckValidSetup()) {
-        return;
-      }
-    }
+    // SIFT extraction is the most expensive stage of the whole pipeline and
+    // holds full resolution images, so prefer the performance cores.
+    TaskHints hints;
+    hints.core_type = TaskHints::CoreType::PERFORMANCE;
+    TaskGroup group(hints);
 
     while (image_reader_.NextIndex() < image_reader_.NumImages()) {
       if (IsStopped()) {
-        resizer_queue_->Stop();
-        extractor_queue_->Stop();
-        resizer_queue_->Clear();
-        extractor_queue_->Clear();
         break;
       }
 
+      group.Wait(max_num_pending_images_ - 1);
+
       ImageData image_data;
       image_data.status = image_reader_.Next(&image_data.rig,
                                              &image_data.camera,
@@ -419,24 +321,19 @@ class FeatureExtractorController : public Thread {
         image_data.bitmap.Deallocate();
       }
 
-      if (sift_options_.max_image_size > 0) {
-        THROW_CHECK(resizer_queue_->Push(std::move(image_data)));
-      } else {
-        THROW_CHECK(extractor_queue_->Push(std::move(image_data)));
-      }
-    }
-
-    resizer_queue_->Wait();
-    resizer_queue_->Stop();
-    for (auto& resizer : resizers_) {
-      resizer->Wait();
+      group.Run([this, image_data = std::move(image_data)]() mutable {
+        if (sift_options_.max_image_size > 0) {
+          ResizeImage(sift_options_.max_image_size, &image_data);
+        }
+        std::unique_ptr<FeatureExtractor> extractor = extractors_->Acquire();
+        THROW_CHECK_NOTNULL(extractor.get());
+        ExtractFeatures(extractor.get(), camera_mask_.get(), &image_data);
+        extractors_->Release(std::move(extractor));
+        THROW_CHECK(writer_queue_->Push(std::move(image_data)));
+      });
     }
 
-    extractor_queue_->Wait();
-    extractor_queue_->Stop();
-    for (auto& extractor : extractors_) {
-      extractor->Wait();
-    }
+    group.Wait();
 
     writer_queue_->Wait();
     writer_queue_->Stop();
@@ -451,12 +348,11 @@ class FeatureExtractorController : public Thread {
   Database database_;
   ImageReader image_reader_;
 
-  std::vector<std::unique_ptr<Thread>> resizers_;
-  std::vector<std::unique_ptr<Thread>> extractors_;
+  std::shared_ptr<Bitmap> camera_mask_;
+  size_t max_num_pending_images_;
+  std::unique_ptr<TaskResourcePool<FeatureExtractor>> extractors_;
   std::unique_ptr<Thread> writer_;
 
-  std::unique_ptr<JobQueue<ImageData>> resizer_queue_;
-  std::unique_ptr<JobQueue<ImageData>> extractor_queue_;
   std::unique_ptr<JobQueue<ImageData>> writer_queue_;
 };
 
@@ -519,7 +415,7 @@ class FeatureImporterController : public Thread {
 
         if (image.ImageId() == kInvalidImageId) {
           image.SetImageId(database.WriteImage(image));
-          if (pose_prior.IsValid()) {
+          if (pose_prior.IsValid() || pose_prior.IsGravityValid()) {
             database.WritePosePrior(image.ImageId(), pose_prior);
           }
           Frame frame;
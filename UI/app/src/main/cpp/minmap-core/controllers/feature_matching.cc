@@ -76,10 +76,11 @@ std::unique_ptr<Thread> CreateExhaustiveFeatureMatcher(
     const ExhaustiveMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
-    const std::string& database_path) {
+    const std::string& database_path,
+    std::shared_ptr<CacheMemoryBudget> memory_budget) {
   auto database = std::make_shared<Database>(database_path);
-  auto cache =
-      std::make_shared<FeatureMatcherCache>(options.CacheSize(), database);
+  auto cache = std::make_shared<FeatureMatcherCache>(
+      options.CacheSize(), database, std::move(memory_budget));
   return std::make_unique<FeatureMatcherThread>(
       matching_options, geometry_options, database, cache, [options, cache]() {
         return std::make_unique<ExhaustivePairGenerator>(options, cache);
@@ -132,10 +133,11 @@ std::unique_ptr<Thread> CreateTransitiveFeatureMatcher(
     const TransitiveMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
-    const std::string& database_path) {
+    const std::string& database_path,
+    std::shared_ptr<CacheMemoryBudget> memory_budget) {
   auto database = std::make_shared<Database>(database_path);
-  auto cache =
-      std::make_shared<FeatureMatcherCache>(options.CacheSize(), database);
+  auto cache = std::make_shared<FeatureMatcherCache>(
+      options.CacheSize(), database, std::move(memory_budget));
   return std::make_unique<FeatureMatcherThread>(
       matching_options, geometry_options, database, cache, [options, cache]() {
         return std::make_unique<TransitivePairGenerator>(options, cache);
@@ -146,10 +148,11 @@ std::unique_ptr<Thread> CreateImagePairsFeatureMatcher(
     const ImagePairsMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
-    const std::string& database_path) {
+    const std::string& database_path,
+    std::shared_ptr<CacheMemoryBudget> memory_budget) {
   auto database = std::make_shared<Database>(database_path);
-  auto cache =
-      std::make_shared<FeatureMatcherCache>(options.CacheSize(), database);
+  auto cache = std::make_shared<FeatureMatcherCache>(
+      options.CacheSize(), database, std::move(memory_budget));
   return std::make_unique<FeatureMatcherThread>(
       matching_options, geometry_options, database, cache, [options, cache]() {
         return std::make_unique<ImportedPairGenerator>(options, cache);
@@ -276,7 +279,9 @@ class FeaturePairsFeatureMatcher : public Thread {
                                     camera2,
                                     FeatureKeypointsToPointsVector(*keypoints2),
                                     matches,
-                                    geometry_options_);
+                                    geometry_options_,
+                                    cache_->GetGravity(image1.ImageId()),
+                                    cache_->GetGravity(image2.ImageId()));
 
         database_->WriteTwoViewGeometry(
             image1.ImageId(), image2.ImageId(), two_view_geometry);
@@ -10,6 +10,11 @@
 
 namespace colmap {
 
+// The matchers that cache features optionally take the memory budget for the
+// cached keypoints, descriptors, and descriptor indices. Its limit can be
+// changed while matching runs. By default, each matcher creates its own budget
+// with a limit of `FeatureMatcherCache::kDefaultMaxNumBytes`.
+
 // Exhaustively match images by processing each block in the exhaustive match
 // matrix in one batch:
 //
@@ -37,7 +42,8 @@ std::unique_ptr<Thread> CreateExhaustiveFeatureMatcher(
     const ExhaustiveMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
-    const std::string& database_path);
+    const std::string& database_path,
+    std::shared_ptr<CacheMemoryBudget> memory_budget = nullptr);
 
 // Match each image against its nearest neighbors using a vocabulary tree.
 //std::unique_ptr<Thread> CreateVocabTreeFeatureMatcher(
@@ -86,7 +92,8 @@ std::unique_ptr<Thread> CreateTransitiveFeatureMatcher(
     const TransitiveMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
-    const std::string& database_path);
+    const std::string& database_path,
+    std::shared_ptr<CacheMemoryBudget> memory_budget = nullptr);
 
 // Match images manually specified in a list of image pairs.
 //
@@ -101,7 +108,8 @@ std::unique_ptr<Thread> CreateImagePairsFeatureMatcher(
     const ImagePairsMatchingOptions& options,
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
-    const std::string& database_path);
+    const std::string& database_path,
+    std::shared_ptr<CacheMemoryBudget> memory_budget = nullptr);
 
 // Import feature matches from a text file.
 //
@@ -3,6 +3,7 @@
 #include "../estimators/two_view_geometry.h"
 #include "../feature/utils.h"
 #include "../util/misc.h"
+#include "../util/threading.h"
 
 #include <fstream>
 #include <numeric>
@@ -10,153 +11,6 @@
 
 namespace colmap {
 
-FeatureMatcherWorker::FeatureMatcherWorker(
-    const SiftMatchingOptions& matching_options,
-    const TwoViewGeometryOptions& geometry_options,
-    const std::shared_ptr<FeatureMatcherCache>& cache,
-    JobQueue<Input>* input_queue,
-    JobQueue<Output>* output_queue)
-    : matching_options_(matching_options),
-      geometry_options_(geometry_options),
-      cache_(cache),
-      input_queue_(input_queue),
-      output_queue_(output_queue) {
-  THROW_CHECK(matching_options_.Check());
-}
-
-void FeatureMatcherWorker::SetMaxNumMatches(int max_num_matches) {
-  matching_options_.max_num_matches = max_num_matches;
-}
-
-void FeatureMatcherWorker::Run() {
-  matching_options_.cpu_descriptor_index_cache =
-      &cache_->GetFeatureDescriptorIndexCache();
-  THROW_CHECK_NOTNULL(matching_options_.cpu_descriptor_index_cache);
-
-  // Minimize the amount of allocated GPU memory by computing the maximum number
-  // of descriptors for any image over the whole database.
-  matching_options_.max_num_matches = std::min<int>(
-      matching_options_.max_num_matches, cache_->MaxNumKeypoints());
-
-  std::unique_ptr<FeatureMatcher> matcher =
-      CreateSiftFeatureMatcher(matching_options_);
-  if (matcher == nullptr) {
-    LOG(MM_ERROR) << "Failed to create feature matcher.";
-    SignalInvalidSetup();
-    return;
-  }
-
-  SignalValidSetup();
-
-  while (true) {
-    if (IsStopped()) {
-      break;
-    }
-
-    auto input_job = input_queue_->Pop();
-    if (input_job.IsValid()) {
-      auto& data = input_job.Data();
-
-      if (!cache_->ExistsDescriptors(data.image_id1) ||
-          !cache_->ExistsDescriptors(data.image_id2)) {
-        THROW_CHECK(output_queue_->Push(std::move(data)));
-        continue;
-      }
-
-      if (matching_options_.guided_matching) {
-        matcher->MatchGuided(geometry_options_.ransac_options.max_error,
-                             {
-                                 data.image_id1,
-                                 cache_->GetDescriptors(data.image_id1),
-                                 cache_->GetKeypoints(data.image_id1),
-                             },
-                             {
-                                 data.image_id2,
-                                 cache_->GetDescriptors(data.image_id2),
-                                 cache_->GetKeypoints(data.image_id2),
-                             },
-                             &data.two_view_geometry);
-      } else {
-        matcher->Match(
-            {
-                data.image_id1,
-                cache_->GetDescriptors(data.image_id1),
-            },
-            {
-                data.image_id2,
-                cache_->GetDescriptors(data.image_id2),
-            },
-            &data.matches);
-      }
-
-      THROW_CHECK(output_queue_->Push(std::move(data)));
-    }
-  }
-}
-
-namespace {
-
-class VerifierWorker : public Thread {
- public:
-  typedef FeatureMatcherData Input;
-  typedef FeatureMatcherData Output;
-
-  VerifierWorker(const TwoViewGeometryOptions& options,
-                 std::shared_ptr<FeatureMatcherCache> cache,
-                 JobQueue<Input>* input_queue,
-                 JobQueue<Output>* output_queue)
-      : options_(options),
-        cache_(std::move(cache)),
-        input_queue_(input_queue),
-        output_queue_(output_queue) {
-    THROW_CHECK(options_.Check());
-  }
-
- protected:
-  void Run() override {
-    while (true) {
-      if (IsStopped()) {
-        break;
-      }
-
-      auto input_job = input_queue_->Pop();
-      if (input_job.IsValid()) {
-        auto& data = input_job.Data();
-
-        if (data.matches.size() <
-            static_cast<size_t>(options_.min_num_inliers)) {
-          THROW_CHECK(output_queue_->Push(std::move(data)));
-          continue;
-        }
-
-        const auto& camera1 =
-            cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
-        const auto& camera2 =
-            cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
-        const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
-        const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
-        const std::vector<Eigen::Vector2d> points1 =
-            FeatureKeypointsToPointsVector(*keypoints1);
-        const std::vector<Eigen::Vector2d> points2 =
-            FeatureKeypointsToPointsVector(*keypoints2);
-
-        data.two_view_geometry = EstimateTwoViewGeometry(
-            camera1, points1, camera2, points2, data.matches, options_);
-
-        THROW_CHECK(output_queue_->Push(std::move(data)));
-      }
-    }
-  }
-
- private:
-  const TwoViewGeometryOptions options_;
-  std::shared_ptr<FeatureMatcherCache> cache_;
-  JobQueue<Input>* input_queue_;
-  JobQueue<Output>* output_queue_;
-};
-
-}  // namespace
-
 FeatureMatcherController::FeatureMatcherController(
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
@@ -170,160 +24,134 @@ FeatureMatcherController::FeatureMatcherController(
 
   const int num_threads = GetEffectiveNumThreads(matching_options_.num_threads);
   THROW_CHECK_GT(num_threads, 0);
+  max_num_pending_pairs_ = 2 * static_cast<size_t>(num_threads);
+}
 
-  std::vector<int> gpu_indices = CSVToVector<int>(matching_options_.gpu_index);
-  THROW_CHECK_GT(gpu_indices.size(), 0);
-
-#if defined(COLMAP_CUDA_ENABLED)
-  if (matching_options_.use_gpu && gpu_indices.size() == 1 &&
-      gpu_indices[0] == -1) {
-    const int num_cuda_devices = GetNumCudaDevices();
-    THROW_CHECK_GT(num_cuda_devices, 0);
-    gpu_indices.resize(num_cuda_devices);
-    std::iota(gpu_indices.begin(), gpu_indices.end(), 0);
-  }
-#endif  // COLMAP_CUDA_ENABLED
-
-  if (matching_options_.use_gpu) {
-    auto matching_options_copy = matching_options_;
-    // The first matching is always without guided matching.
-    matching_options_copy.guided_matching = false;
-    matchers_.reserve(gpu_indices.size());
-    for (const auto& gpu_index : gpu_indices) {
-      matching_options_copy.gpu_index = std::to_string(gpu_index);
-      matchers_.emplace_back(
-          std::make_unique<FeatureMatcherWorker>(matching_options_copy,
-                                                 geometry_options_,
-                                                 cache_,
-                                                 &matcher_queue_,
-                                                 &verifier_queue_));
-    }
-  } else {
-    auto matching_options_copy = matching_options_;
-    // The first matching is always without guided matching.
-    matching_options_copy.guided_matching = false;
-    matchers_.reserve(num_threads);
-    for (int i = 0; i < num_threads; ++i) {
-      matchers_.emplace_back(
-          std::make_unique<FeatureMatcherWorker>(matching_options_copy,
-                                                 geometry_options_,
-                                                 cache_,
-                                                 &matcher_queue_,
-                                                 &verifier_queue_));
-    }
-  }
+bool FeatureMatcherController::Setup() {
+  // Minimize the amount of allocated memory by computing the maximum number
+  // of descriptors for any image over the whole database.
+  const int max_num_features = THROW_CHECK_NOTNULL(cache_)->MaxNumKeypoints();
+  matching_options_.max_num_matches =
+      std::min(matching_options_.max_num_matches, max_num_features);
+  matching_options_.cpu_descriptor_index_cache =
+      &cache_->GetFeatureDescriptorIndexCache();
 
-  verifiers_.reserve(num_threads);
+  // The first matching is always without guided matching.
+  SiftMatchingOptions matcher_options = matching_options_;
+  matcher_options.guided_matching = false;
+  matchers_ = std::make_unique<TaskResourcePool<FeatureMatcher>>(
+      [matcher_options]() { return CreateSiftFeatureMatcher(matcher_options); });
   if (matching_options_.guided_matching) {
-    // Redirect the verification output to final round of guided matching.
-    for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(std::make_unique<VerifierWorker>(
-          geometry_options_, cache_, &verifier_queue_, &guided_matcher_queue_));
-    }
+    const SiftMatchingOptions guided_matcher_options = matching_options_;
+    guided_matchers_ = std::make_unique<TaskResourcePool<FeatureMatcher>>(
+        [guided_matcher_options]() {
+          return CreateSiftFeatureMatcher(guided_matcher_options);
+        });
+  }
 
-    if (matching_options_.use_gpu) {
-      auto matching_options_copy = matching_options_;
-      guided_matchers_.reserve(gpu_indices.size());
-      for (const auto& gpu_index : gpu_indices) {
-        matching_options_copy.gpu_index = std::to_string(gpu_index);
-        guided_matchers_.emplace_back(
-            std::make_unique<FeatureMatcherWorker>(matching_options_copy,
-                                                   geometry_options_,
-                                                   cache_,
-                                                   &guided_matcher_queue_,
-                                                   &output_queue_));
-      }
-    } else {
-      guided_matchers_.reserve(num_threads);
-      for (int i = 0; i < num_threads; ++i) {
-        guided_matchers_.emplace_back(
-            std::make_unique<FeatureMatcherWorker>(matching_options_,
-                                                   geometry_options_,
-                                                   cache_,
-                                                   &guided_matcher_queue_,
-                                                   &output_queue_));
-      }
+  // Create one matcher of every kind upfront to validate the options.
+  for (auto* matchers : {matchers_.get(), guided_matchers_.get()}) {
+    if (matchers == nullptr) {
+      continue;
     }
-  } else {
-    for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(std::make_unique<VerifierWorker>(
-          geometry_options_, cache_, &verifier_queue_, &output_queue_));
+    std::unique_ptr<FeatureMatcher> matcher = matchers->Acquire();
+    if (matcher == nullptr) {
+      LOG(MM_ERROR) << "Failed to create feature matcher.";
+      return false;
     }
-  }
-}
-
-FeatureMatcherController::~FeatureMatcherController() {
-  matcher_queue_.Wait();
-  verifier_queue_.Wait();
-  guided_matcher_queue_.Wait();
-  output_queue_.Wait();
-
-  for (auto& matcher : matchers_) {
-    matcher->Stop();
-  }
-
-  for (auto& verifier : verifiers_) {
-    verifier->Stop();
-  }
-
-  for (auto& guided_matcher : guided_matchers_) {
-    guided_matcher->Stop();
-  }
-
-  matcher_queue_.Stop();
-  verifier_queue_.Stop();
-  guided_matcher_queue_.Stop();
-  output_queue_.Stop();
-
-  for (auto& matcher : matchers_) {
-    matcher->Wait();
+    matchers->Release(std::move(matcher));
   }
 
-  for (auto& verifier : verifiers_) {
-    verifier->Wait();
-  }
+  is_setup_ = true;
 
-  for (auto& guided_matcher : guided_matchers_) {
-    guided_matcher->Wait();
-  }
+  return true;
 }
 
-bool FeatureMatcherController::Setup() {
-  // Minimize the amount of allocated GPU memory by computing the maximum number
-  // of descriptors for any image over the whole database.
-  const int max_num_features = THROW_CHECK_NOTNULL(cache_)->MaxNumKeypoints();
-  matching_options_.max_num_matches =
-      std::min(matching_options_.max_num_matches, max_num_features);
-
-  for (auto& matcher : matchers_) {
-    matcher->SetMaxNumMatches(matching_options_.max_num_matches);
-    matcher->Start();
+void FeatureMatcherController::MatchImagePair(const bool exists_matches,
+                                              FeatureMatcherData* data) {
+  const bool exists_descriptors = cache_->ExistsDescriptors(data->image_id1) &&
+                                  cache_->ExistsDescriptors(data->image_id2);
+
+  if (!exists_matches) {
+    if (!exists_descriptors) {
+      return;
+    }
+    std::unique_ptr<FeatureMatcher> matcher = matchers_->Acquire();
+    THROW_CHECK_NOTNULL(matcher.get());
+    matcher->Match(
+        {
+            data->image_id1,
+            cache_->GetDescriptors(data->image_id1),
+        },
+        {
+            data->image_id2,
+            cache_->GetDescriptors(data->image_id2),
+        },
+        &data->matches);
+    matchers_->Release(std::move(matcher));
+  }
+
+  if (data->matches.size() <
+      static_cast<size_t>(geometry_options_.min_num_inliers)) {
+    return;
   }
 
-  for (auto& verifier : verifiers_) {
-    verifier->Start();
+  const auto& camera1 =
+      cache_->GetCamera(cache_->GetImage(data->image_id1).CameraId());
+  const auto& camera2 =
+      cache_->GetCamera(cache_->GetImage(data->image_id2).CameraId());
+  const auto keypoints1 = cache_->GetKeypoints(data->image_id1);
+  const auto keypoints2 = cache_->GetKeypoints(data->image_id2);
+  const std::vector<Eigen::Vector2d> points1 =
+      FeatureKeypointsToPointsVector(*keypoints1);
+  const std::vector<Eigen::Vector2d> points2 =
+      FeatureKeypointsToPointsVector(*keypoints2);
+
+  data->two_view_geometry =
+      EstimateTwoViewGeometry(camera1,
+                              points1,
+                              camera2,
+                              points2,
+                              data->matches,
+                              geometry_options_,
+                              cache_->GetGravity(data->image_id1),
+                              cache_->GetGravity(data->image_id2));
+
+  if (guided_matchers_ == nullptr || !exists_descriptors) {
+    return;
   }
 
-  for (auto& guided_matcher : guided_matchers_) {
-    guided_matcher->SetMaxNumMatches(matching_options_.max_num_matches);
-    guided_matcher->Start();
-  }
+  std::unique_ptr<FeatureMatcher> guided_matcher = guided_matchers_->Acquire();
+  THROW_CHECK_NOTNULL(guided_matcher.get());
+  guided_matcher->MatchGuided(geometry_options_.ransac_options.max_error,
+                              {
+                                  data->image_id1,
+                                  cache_->GetDescriptors(data->image_id1),
+                                  keypoints1,
+                              },
+                              {
+                                  data->image_id2,
+                                  cache_->GetDescriptors(data->image_id2),
+                                  keypoints2,
+                              },
+                              &data->two_view_geometry);
+  guided_matchers_->Release(std::move(guided_matcher));
+}
 
-  for (auto& matcher : matchers_) {
-    if (!matcher->CheckValidSetup()) {
-      return false;
-    }
+void FeatureMatcherController::WriteOutput(FeatureMatcherData& output) {
+  if (output.matches.size() <
+      static_cast<size_t>(geometry_options_.min_num_inliers)) {
+    output.matches = {};
   }
 
-  for (auto& guided_matcher : guided_matchers_) {
-    if (!guided_matcher->CheckValidSetup()) {
-      return false;
-    }
+  if (output.two_view_geometry.inlier_matches.size() <
+      static_cast<size_t>(geometry_options_.min_num_inliers)) {
+    output.two_view_geometry = TwoViewGeometry();
   }
 
-  is_setup_ = true;
-
-  return true;
+  cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
+  cache_->WriteTwoViewGeometry(
+      output.image_id1, output.image_id2, output.two_view_geometry);
 }
 
 void FeatureMatcherController::Match(
@@ -342,7 +170,23 @@ void FeatureMatcherController::Match(
   std::unordered_set<image_pair_t> image_pair_ids;
   image_pair_ids.reserve(image_pairs.size());
 
-  size_t num_outputs = 0;
+  // Results are written by the calling thread, which owns the database
+  // transaction, whenever it waits for the number of pending pairs to drop.
+  std::mutex outputs_mutex;
+  std::vector<FeatureMatcherData> outputs;
+  std::vector<FeatureMatcherData> finished_outputs;
+  const auto write_finished_outputs = [&]() {
+    {
+      std::lock_guard<std::mutex> lock(outputs_mutex);
+      finished_outputs.swap(outputs);
+    }
+    for (auto& output : finished_outputs) {
+      WriteOutput(output);
+    }
+    finished_outputs.clear();
+  };
+
+  TaskGroup group;
   for (const auto& image_pair : image_pairs) {
     // Avoid self-matches.
     if (image_pair.first == image_pair.second) {
@@ -367,12 +211,10 @@ void FeatureMatcherController::Match(
       continue;
     }
 
-    num_outputs += 1;
-
     // If only one of the matches or inlier matches exist, we recompute them
     // from scratch and delete the existing results. This must be done before
-    // pushing the jobs to the queue, otherwise database constraints might fail
-    // when writing an existing result into the database.
+    // submitting the task, otherwise database constraints might fail when
+    // writing an existing result into the database.
 
     if (exists_inlier_matches) {
       cache_->DeleteInlierMatches(image_pair.first, image_pair.second);
@@ -385,37 +227,25 @@ void FeatureMatcherController::Match(
     if (exists_matches) {
       data.matches = cache_->GetMatches(image_pair.first, image_pair.second);
       cache_->DeleteMatches(image_pair.first, image_pair.second);
-      THROW_CHECK(verifier_queue_.Push(std::move(data)));
-    } else {
-      THROW_CHECK(matcher_queue_.Push(std::move(data)));
     }
+
+    group.Wait(max_num_pending_pairs_);
+    write_finished_outputs();
+
+    group.Run([this, exists_matches, &outputs_mutex, &outputs,
+               data = std::move(data)]() mutable {
+      MatchImagePair(exists_matches, &data);
+      std::lock_guard<std::mutex> lock(outputs_mutex);
+      outputs.push_back(std::move(data));
+    });
   }
 
   //////////////////////////////////////////////////////////////////////////////
   // Write results to database
   //////////////////////////////////////////////////////////////////////////////
 
-  for (size_t i = 0; i < num_outputs; ++i) {
-    auto output_job = output_queue_.Pop();
-    THROW_CHECK(output_job.IsValid());
-    auto& output = output_job.Data();
-
-    if (output.matches.size() <
-        static_cast<size_t>(geometry_options_.min_num_inliers)) {
-      output.matches = {};
-    }
-
-    if (output.two_view_geometry.inlier_matches.size() <
-        static_cast<size_t>(geometry_options_.min_num_inliers)) {
-      output.two_view_geometry = TwoViewGeometry();
-    }
-
-    cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
-    cache_->WriteTwoViewGeometry(
-        output.image_id1, output.image_id2, output.two_view_geometry);
-  }
-
-  THROW_CHECK_EQ(output_queue_.Size(), 0);
+  group.Wait();
+  write_finished_outputs();
 }
 
 }  // namespace colmap
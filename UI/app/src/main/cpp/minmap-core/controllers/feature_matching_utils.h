@@ -4,7 +4,7 @@
 #include "../feature/matcher.h"
 #include "../feature/sift.h"
 #include "../scene/database.h"
-#include "../util/threading.h"
+#include "../util/task_scheduler.h"
 
 #include <array>
 #include <memory>
@@ -20,36 +20,13 @@ struct FeatureMatcherData {
   TwoViewGeometry two_view_geometry;
 };
 
-class FeatureMatcherWorker : public Thread {
- public:
-  typedef FeatureMatcherData Input;
-  typedef FeatureMatcherData Output;
-
-  FeatureMatcherWorker(const SiftMatchingOptions& matching_options,
-                       const TwoViewGeometryOptions& geometry_options,
-                       const std::shared_ptr<FeatureMatcherCache>& cache,
-                       JobQueue<Input>* input_queue,
-                       JobQueue<Output>* output_queue);
-
-  void SetMaxNumMatches(int max_num_matches);
-
- private:
-  void Run() override;
-
-  SiftMatchingOptions matching_options_;
-  TwoViewGeometryOptions geometry_options_;
-  std::shared_ptr<FeatureMatcherCache> cache_;
-  JobQueue<Input>* input_queue_;
-  JobQueue<Output>* output_queue_;
-
-  //std::unique_ptr<OpenGLContextManager> opengl_context_;
-};
-
-// Multi-threaded and multi-GPU SIFT feature matcher, which writes the computed
-// results to the database and skips already matched image pairs. To improve
-// performance of the matching by taking advantage of caching and database
-// transactions, pass multiple images to the `Match` function. Note that the
-// database should be in an active transaction while calling `Match`.
+// Multi-threaded SIFT feature matcher, which writes the computed results to
+// the database and skips already matched image pairs. Every image pair is
+// matched, verified, and optionally guided matched by one task of the shared
+// task scheduler, while the results are written by the calling thread. To
+// improve performance of the matching by taking advantage of caching and
+// database transactions, pass multiple images to the `Match` function. Note
+// that the database should be in an active transaction while calling `Match`.
 class FeatureMatcherController {
  public:
   FeatureMatcherController(
@@ -57,8 +34,6 @@ class FeatureMatcherController {
       const TwoViewGeometryOptions& two_view_geometry_options,
       std::shared_ptr<FeatureMatcherCache> cache);
 
-  ~FeatureMatcherController();
-
   // Setup the matchers and return if successful.
   bool Setup();
 
@@ -66,21 +41,22 @@ class FeatureMatcherController {
   void Match(const std::vector<std::pair<image_t, image_t>>& image_pairs);
 
  private:
+  // Match, verify, and optionally guided match one image pair.
+  void MatchImagePair(bool exists_matches, FeatureMatcherData* data);
+  void WriteOutput(FeatureMatcherData& output);
+
   SiftMatchingOptions matching_options_;
   TwoViewGeometryOptions geometry_options_;
   std::shared_ptr<FeatureMatcherCache> cache_;
 
   bool is_setup_;
 
-  std::vector<std::unique_ptr<FeatureMatcherWorker>> matchers_;
-  std::vector<std::unique_ptr<FeatureMatcherWorker>> guided_matchers_;
-  std::vector<std::unique_ptr<Thread>> verifiers_;
-  std::unique_ptr<ThreadPool> thread_pool_;
+  // The maximum number of image pairs in flight, which bounds the memory of
+  // finished results that are not yet written.
+  size_t max_num_pending_pairs_;
 
-  JobQueue<FeatureMatcherData> matcher_queue_;
-  JobQueue<FeatureMatcherData> verifier_queue_;
-  JobQueue<FeatureMatcherData> guided_matcher_queue_;
-  JobQueue<FeatureMatcherData> output_queue_;
+  std::unique_ptr<TaskResourcePool<FeatureMatcher>> matchers_;
+  std::unique_ptr<TaskResourcePool<FeatureMatcher>> guided_matchers_;
 };
 
 }  // namespace colmap
@@ -4,6 +4,8 @@
 #include "../util/file.h"
 #include "../util/misc.h"
 
+#include <sstream>
+
 namespace colmap {
 
 bool ImageReaderOptions::Check() const {
@@ -43,6 +45,23 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
     }
   }
 
+  if (!options_.gravity_path.empty()) {
+    for (const std::string& line : ReadTextFileLines(options_.gravity_path)) {
+      if (line[0] == '#') {
+        continue;
+      }
+      std::istringstream line_stream(line);
+      std::string image_name;
+      Eigen::Vector3d gravity;
+      line_stream >> image_name >> gravity.x() >> gravity.y() >> gravity.z();
+      if (line_stream.fail() || !gravity.allFinite() || gravity.isZero()) {
+        LOG(MM_WARNING) << "Invalid gravity direction: " << line;
+        continue;
+      }
+      gravities_[image_name] = gravity.normalized();
+    }
+  }
+
   if (static_cast<camera_t>(options_.existing_camera_id) != kInvalidCameraId) {
     THROW_CHECK(database->ExistsCamera(options_.existing_camera_id));
     prev_camera_ = database->ReadCamera(options_.existing_camera_id);
@@ -287,6 +306,15 @@ ImageReader::Status ImageReader::Next(Rig* rig,
       pose_prior->position = position_prior;
       pose_prior->coordinate_system = PosePrior::CoordinateSystem::WGS84;
     }
+
+    //////////////////////////////////////////////////////////////////////////////
+    // Set the gravity direction.
+    //////////////////////////////////////////////////////////////////////////////
+
+    const auto gravity_it = gravities_.find(image->Name());
+    if (gravity_it != gravities_.end()) {
+      pose_prior->gravity = gravity_it->second;
+    }
   }
 
   *camera = prev_camera_;
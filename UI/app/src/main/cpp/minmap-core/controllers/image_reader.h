@@ -29,6 +29,16 @@ struct ImageReaderOptions {
   // intensity value 0 in grayscale).
   std::string camera_mask_path;
 
+  // Optional path to a text file with the direction of gravity of the images,
+  // e.g. from the accelerometer of a phone, with one line per image:
+  //
+  //    IMAGE_NAME GX GY GZ
+  //
+  // The image name is relative to image_path and (GX, GY, GZ) is the
+  // direction of gravity in the camera frame (x right, y down, z forward).
+  // Lines starting with # are ignored.
+  std::string gravity_path;
+
   // Optional list of images to read. The list must contain the relative path
   // of the images with respect to the image_path.
   std::vector<std::string> image_names;
@@ -100,6 +110,8 @@ class ImageReader {
   // Names of image sub-folders.
   std::string prev_image_folder_;
   std::unordered_set<std::string> image_folders_;
+  // Gravity directions by image name.
+  std::unordered_map<std::string, Eigen::Vector3d> gravities_;
 };
 
 }  // namespace colmap
@@ -22,6 +22,30 @@ void IterativeGlobalRefinement(const IncrementalPipelineOptions& options,
   mapper.FilterFrames(mapper_options);
 }
 
+void BeginBackgroundGlobalRefinement(
+    const IncrementalPipelineOptions& options,
+    const IncrementalMapper::Options& mapper_options,
+    IncrementalMapper& mapper) {
+  LOG(MM_INFO) << "Retriangulation and Global bundle adjustment in background";
+  mapper.BeginBackgroundGlobalRefinement(mapper_options,
+                                         options.GlobalBundleAdjustment(),
+                                         options.Triangulation());
+}
+
+void EndBackgroundGlobalRefinement(
+    const IncrementalPipelineOptions& options,
+    const IncrementalMapper::Options& mapper_options,
+    IncrementalMapper& mapper) {
+  if (!mapper.HasBackgroundGlobalRefinement()) {
+    return;
+  }
+  LOG(MM_INFO) << "Merging background global bundle adjustment";
+  if (mapper.EndBackgroundGlobalRefinement(mapper_options,
+                                           options.Triangulation())) {
+    mapper.FilterFrames(mapper_options);
+  }
+}
+
 void ExtractColors(const std::string& image_path,
                    const image_t image_id,
                    Reconstruction& reconstruction) {
@@ -234,12 +258,21 @@ bool IncrementalPipeline::LoadDatabase() {
     }
   }
 
-  Database database(database_path_);
   Timer timer;
   timer.Start();
   const size_t min_num_matches = static_cast<size_t>(options_->min_num_matches);
-  database_cache_ = DatabaseCache::Create(
-      database, min_num_matches, options_->ignore_watermarks, image_names);
+  if (options_->database_cache_path.empty()) {
+    Database database(database_path_);
+    database_cache_ = DatabaseCache::Create(
+        database, min_num_matches, options_->ignore_watermarks, image_names);
+  } else {
+    database_cache_ =
+        DatabaseCache::CreateWithSnapshot(database_path_,
+                                          options_->database_cache_path,
+                                          min_num_matches,
+                                          options_->ignore_watermarks,
+                                          image_names);
+  }
   timer.PrintMinutes();
 
   if (database_cache_->NumImages() == 0) {
@@ -392,20 +425,44 @@ IncrementalPipeline::Status IncrementalPipeline::ReconstructSubModel(
       break;
     }
 
-    image_t next_image_id;
-    for (size_t reg_trial = 0; reg_trial < next_images.size(); ++reg_trial) {
-      next_image_id = next_images[reg_trial];
-
-      LOG(MM_INFO) << StringPrintf("Registering image #%d (num_reg_frames=%d)",
-                                next_image_id,
-                                reconstruction->NumRegFrames());
-      LOG(MM_INFO) << StringPrintf(
-          "=> Image sees %d / %d points",
-          mapper.ObservationManager().NumVisiblePoints3D(next_image_id),
-          mapper.ObservationManager().NumObservations(next_image_id));
+    const size_t num_parallel_images =
+        static_cast<size_t>(mapper_options.reg_num_parallel_images);
 
-      reg_next_success =
-          mapper.RegisterNextImage(mapper_options, next_image_id);
+    image_t next_image_id;
+    for (size_t reg_trial = 0; reg_trial < next_images.size();
+         reg_trial += num_parallel_images) {
+      if (num_parallel_images == 1) {
+        next_image_id = next_images[reg_trial];
+
+        LOG(MM_INFO) << StringPrintf(
+            "Registering image #%d (num_reg_frames=%d)",
+            next_image_id,
+            reconstruction->NumRegFrames());
+        LOG(MM_INFO) << StringPrintf(
+            "=> Image sees %d / %d points",
+            mapper.ObservationManager().NumVisiblePoints3D(next_image_id),
+            mapper.ObservationManager().NumObservations(next_image_id));
+
+        reg_next_success =
+            mapper.RegisterNextImage(mapper_options, next_image_id);
+      } else {
+        const std::vector<image_t> image_ids(
+            next_images.begin() + reg_trial,
+            next_images.begin() +
+                std::min(reg_trial + num_parallel_images, next_images.size()));
+
+        LOG(MM_INFO) << StringPrintf(
+            "Registering best of %d images (num_reg_frames=%d)",
+            image_ids.size(),
+            reconstruction->NumRegFrames());
+
+        next_image_id = mapper.RegisterBestNextImage(mapper_options, image_ids);
+        reg_next_success = next_image_id != kInvalidImageId;
+        if (reg_next_success) {
+          LOG(MM_INFO) << StringPrintf("=> Registered image #%d",
+                                       next_image_id);
+        }
+      }
 
       if (reg_next_success) {
         break;
@@ -435,8 +492,20 @@ IncrementalPipeline::Status IncrementalPipeline::ReconstructSubModel(
                                       options_->Triangulation(),
                                       next_image_id);
 
-      if (CheckRunGlobalRefinement(
-              *reconstruction, ba_prev_num_reg_frames, ba_prev_num_points)) {
+      if (options_->ba_global_background) {
+        if (mapper.IsBackgroundGlobalRefinementDone()) {
+          EndBackgroundGlobalRefinement(*options_, mapper_options, mapper);
+        }
+        if (!mapper.HasBackgroundGlobalRefinement() &&
+            CheckRunGlobalRefinement(
+                *reconstruction, ba_prev_num_reg_frames, ba_prev_num_points)) {
+          BeginBackgroundGlobalRefinement(*options_, mapper_options, mapper);
+          ba_prev_num_points = reconstruction->NumPoints3D();
+          ba_prev_num_reg_frames = reconstruction->NumRegFrames();
+        }
+      } else if (CheckRunGlobalRefinement(*reconstruction,
+                                          ba_prev_num_reg_frames,
+                                          ba_prev_num_points)) {
         IterativeGlobalRefinement(*options_, mapper_options, mapper);
         ba_prev_num_points = reconstruction->NumPoints3D();
         ba_prev_num_reg_frames = reconstruction->NumRegFrames();
@@ -468,6 +537,7 @@ IncrementalPipeline::Status IncrementalPipeline::ReconstructSubModel(
     // bundle adjustment and try again to register one image. If this fails
     // once, then exit the incremental mapping.
     if (!reg_next_success && prev_reg_next_success) {
+      EndBackgroundGlobalRefinement(*options_, mapper_options, mapper);
       IterativeGlobalRefinement(*options_, mapper_options, mapper);
     }
   } while (reg_next_success || prev_reg_next_success);
@@ -476,6 +546,8 @@ IncrementalPipeline::Status IncrementalPipeline::ReconstructSubModel(
     return Status::INTERRUPTED;
   }
 
+  EndBackgroundGlobalRefinement(*options_, mapper_options, mapper);
+
   // Only run final global BA, if last incremental BA was not global.
   if (reconstruction->NumRegFrames() > 0 &&
       reconstruction->NumRegFrames() != ba_prev_num_reg_frames &&
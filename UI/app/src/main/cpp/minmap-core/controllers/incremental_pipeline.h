@@ -90,6 +90,14 @@ struct IncrementalPipelineOptions {
   int ba_global_max_refinements = 5;
   double ba_global_max_refinement_change = 0.0005;
 
+  // Whether to run the periodic global bundle adjustments on a snapshot of
+  // the reconstruction in the background, while the next images are
+  // registered and locally refined. The result is merged into the
+  // reconstruction once the adjustment finished, and the next global bundle
+  // adjustment only starts after that. The final global bundle adjustment of
+  // each model always runs in the foreground.
+  bool ba_global_background = false;
+
   // Whether to use Ceres' CUDA sparse linear algebra library, if available.
   bool ba_use_gpu = false;
   std::string ba_gpu_index = "-1";
@@ -110,6 +118,11 @@ struct IncrementalPipelineOptions {
   std::string snapshot_path = "";
   int snapshot_frames_freq = 0;
 
+  // Path to a binary snapshot of the loaded database cache. If specified, the
+  // cache is restored from the snapshot when it matches the current state of
+  // the database, and otherwise loaded from the database and written to it.
+  std::string database_cache_path = "";
+
   // Optional list of image names to reconstruct. If no images are specified,
   // all images will be reconstructed by default.
   std::vector<std::string> image_names;
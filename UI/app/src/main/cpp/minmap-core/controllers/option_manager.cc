@@ -161,6 +161,8 @@ void OptionManager::AddExtractionOptions() {
                               &image_reader->default_focal_length_factor);
   Register("ImageReader.camera_mask_path",
                               &image_reader->camera_mask_path);
+  Register("ImageReader.gravity_path",
+                              &image_reader->gravity_path);
 
   Register("SiftExtraction.num_threads",
                               &sift_extraction->num_threads);
@@ -237,6 +239,14 @@ void OptionManager::AddMatchingOptions() {
   Register(
       "TwoViewGeometry.min_inlier_ratio",
       &two_view_geometry->ransac_options.min_inlier_ratio);
+  Register("TwoViewGeometry.progressive_sampling",
+                              &two_view_geometry->progressive_sampling);
+  Register("TwoViewGeometry.minimal_solver_backend",
+                              &two_view_geometry->minimal_solver_backend);
+  Register("TwoViewGeometry.use_gravity",
+                              &two_view_geometry->use_gravity);
+  Register("TwoViewGeometry.use_sprt",
+                              &two_view_geometry->ransac_options.use_sprt);
 }
 
 void OptionManager::AddExhaustiveMatchingOptions() {
@@ -336,6 +346,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_global_max_refinements);
   Register("Mapper.ba_global_max_refinement_change",
                               &mapper->ba_global_max_refinement_change);
+  Register("Mapper.ba_global_background",
+                              &mapper->ba_global_background);
   Register("Mapper.ba_local_max_refinements",
                               &mapper->ba_local_max_refinements);
   Register("Mapper.ba_local_max_refinement_change",
@@ -345,6 +357,7 @@ void OptionManager::AddMapperOptions() {
   Register(
       "Mapper.ba_min_num_residuals_for_cpu_multi_threading",
       &mapper->ba_min_num_residuals_for_cpu_multi_threading);
+  Register("Mapper.database_cache_path", &mapper->database_cache_path);
   Register("Mapper.snapshot_path", &mapper->snapshot_path);
   Register("Mapper.snapshot_frames_freq",
                               &mapper->snapshot_frames_freq);
@@ -368,12 +381,18 @@ void OptionManager::AddMapperOptions() {
                               &mapper->mapper.abs_pose_min_num_inliers);
   Register("Mapper.abs_pose_min_inlier_ratio",
                               &mapper->mapper.abs_pose_min_inlier_ratio);
+  Register("Mapper.abs_pose_progressive_sampling",
+                              &mapper->mapper.abs_pose_progressive_sampling);
+  Register("Mapper.abs_pose_use_gravity",
+                              &mapper->mapper.abs_pose_use_gravity);
   Register("Mapper.filter_max_reproj_error",
                               &mapper->mapper.filter_max_reproj_error);
   Register("Mapper.filter_min_tri_angle",
                               &mapper->mapper.filter_min_tri_angle);
   Register("Mapper.max_reg_trials",
                               &mapper->mapper.max_reg_trials);
+  Register("Mapper.reg_num_parallel_images",
+                              &mapper->mapper.reg_num_parallel_images);
   Register("Mapper.local_ba_min_tri_angle",
                               &mapper->mapper.local_ba_min_tri_angle);
 
@@ -400,6 +419,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->triangulation.min_angle);
   Register("Mapper.tri_ignore_two_view_tracks",
                               &mapper->triangulation.ignore_two_view_tracks);
+  Register("Mapper.tri_num_threads",
+                              &mapper->triangulation.num_threads);
 }
 
 void OptionManager::Reset() {
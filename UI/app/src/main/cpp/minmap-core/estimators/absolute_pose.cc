@@ -13,6 +13,7 @@
 
 #include <PoseLib/solvers/p4pf.h>
 #include <PoseLib/solvers/p3p.h>
+#include <PoseLib/solvers/up2p.h>
 
 #include <PoseLib/alignment.h>
 
@@ -50,6 +51,44 @@ void P3PEstimator::Residuals(const std::vector<X_t>& points2D,
       points2D, points3D, cam_from_world, img_from_cam_func_, residuals);
 }
 
+UprightP2PEstimator::UprightP2PEstimator(
+    ImgFromCamFunc img_from_cam_func,
+    const Eigen::Vector3d& gravity_in_cam,
+    const Eigen::Vector3d& gravity_in_world)
+    : img_from_cam_func_(std::move(img_from_cam_func)),
+      gravity_in_cam_(gravity_in_cam),
+      gravity_in_world_(gravity_in_world) {}
+
+void UprightP2PEstimator::Estimate(const std::vector<X_t>& points2D,
+                                   const std::vector<Y_t>& points3D,
+                                   std::vector<M_t>* cams_from_world) const {
+  THROW_CHECK_EQ(points2D.size(), 2);
+  THROW_CHECK_EQ(points3D.size(), 2);
+  THROW_CHECK_NOTNULL(cams_from_world);
+
+  std::vector<Eigen::Vector3d> rays(2);
+  for (int i = 0; i < 2; ++i) {
+    rays[i] = points2D[i].camera_ray;
+  }
+
+  std::vector<poselib::CameraPose> poses;
+  const int num_poses = poselib::up2p(
+      rays, points3D, gravity_in_cam_, gravity_in_world_, &poses);
+
+  cams_from_world->resize(num_poses);
+  for (int i = 0; i < num_poses; ++i) {
+    (*cams_from_world)[i] = poses[i].Rt();
+  }
+}
+
+void UprightP2PEstimator::Residuals(const std::vector<X_t>& points2D,
+                                    const std::vector<Y_t>& points3D,
+                                    const M_t& cam_from_world,
+                                    std::vector<double>* residuals) const {
+  ComputeSquaredReprojectionError(
+      points2D, points3D, cam_from_world, img_from_cam_func_, residuals);
+}
+
 void P4PFEstimator::Estimate(const std::vector<X_t>& points2D,
                              const std::vector<Y_t>& points3D,
                              std::vector<M_t>* models) {
@@ -70,6 +70,58 @@ class P3PEstimator {
   const ImgFromCamFunc img_from_cam_func_;
 };
 
+// Minimal solver for the 4-DOF pose from two 2D-3D correspondences, given the
+// direction of gravity in the camera and in the world frame, e.g. from the
+// accelerometer of a phone. Only the rotation about gravity and the
+// translation are estimated, which needs one correspondence less than P3P.
+//
+//    Z. Kukelova, M. Bujnak, T. Pajdla, Closed-form solutions to minimal
+//    absolute pose problems with known vertical direction, ACCV 2010.
+class UprightP2PEstimator {
+ public:
+  // The 2D image feature observations.
+  typedef Point2DWithRay X_t;
+  // The observed 3D features in the world frame.
+  typedef Eigen::Vector3d Y_t;
+  // The transformation from the world to the camera frame.
+  typedef Eigen::Matrix3x4d M_t;
+
+  // The minimum number of samples needed to estimate a model.
+  static const int kMinNumSamples = 2;
+
+  UprightP2PEstimator(ImgFromCamFunc img_from_cam_func,
+                      const Eigen::Vector3d& gravity_in_cam,
+                      const Eigen::Vector3d& gravity_in_world);
+
+  // Estimate up to two solutions from a set of two 2D-3D point
+  // correspondences.
+  //
+  // @param points2D   Normalized 2D image points as 2x2 matrix.
+  // @param points3D   3D world points as 2x3 matrix.
+  //
+  // @return           Poses as a vector of 3x4 matrices.
+  void Estimate(const std::vector<X_t>& points2D,
+                const std::vector<Y_t>& points3D,
+                std::vector<M_t>* cams_from_world) const;
+
+  // Calculate the squared reprojection error given a set of 2D-3D point
+  // correspondences and a projection matrix.
+  //
+  // @param points2D        Normalized 2D image points as Nx2 matrix.
+  // @param points3D        3D world points as Nx3 matrix.
+  // @param cam_from_world  3x4 projection matrix.
+  // @param residuals       Output vector of residuals.
+  void Residuals(const std::vector<X_t>& points2D,
+                 const std::vector<Y_t>& points3D,
+                 const M_t& cam_from_world,
+                 std::vector<double>* residuals) const;
+
+ private:
+  const ImgFromCamFunc img_from_cam_func_;
+  const Eigen::Vector3d gravity_in_cam_;
+  const Eigen::Vector3d gravity_in_world_;
+};
+
 // Minimal solver for 6-DOF pose and focal length.
 class P4PFEstimator {
  public:
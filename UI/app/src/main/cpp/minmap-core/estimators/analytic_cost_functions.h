@@ -0,0 +1,437 @@
+#pragma once
+
+#include "../geometry/rigid3.h"
+#include "../sensor/models.h"
+
+#include <PoseLib/alignment.h>
+
+#include <Eigen/Core>
+#include <ceres/ceres.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace colmap {
+
+// Projection of normalized camera coordinates (u, v) = (x / z, y / z) to image
+// coordinates with closed-form derivatives. Specialized for the camera models
+// used in practice, for which the hand-derived Jacobians are several times
+// faster to evaluate than dual numbers. The Jacobians are row-major.
+    template <typename CameraModel>
+    struct AnalyticCameraModel {
+        static constexpr bool kSupported = false;
+    };
+
+    template <>
+    struct AnalyticCameraModel<SimplePinholeCameraModel> {
+        static constexpr bool kSupported = true;
+
+        static void ImgFromNormalizedCam(const double* params,
+                                         const double u,
+                                         const double v,
+                                         double* xy,
+                                         double* J_uv,
+                                         double* J_params) {
+            const double f = params[0];
+            xy[0] = f * u + params[1];
+            xy[1] = f * v + params[2];
+            if (J_uv) {
+                J_uv[0] = f;
+                J_uv[1] = 0;
+                J_uv[2] = 0;
+                J_uv[3] = f;
+            }
+            if (J_params) {
+                J_params[0] = u;
+                J_params[1] = 1;
+                J_params[2] = 0;
+                J_params[3] = v;
+                J_params[4] = 0;
+                J_params[5] = 1;
+            }
+        }
+    };
+
+    template <>
+    struct AnalyticCameraModel<PinholeCameraModel> {
+        static constexpr bool kSupported = true;
+
+        static void ImgFromNormalizedCam(const double* params,
+                                         const double u,
+                                         const double v,
+                                         double* xy,
+                                         double* J_uv,
+                                         double* J_params) {
+            const double f1 = params[0];
+            const double f2 = params[1];
+            xy[0] = f1 * u + params[2];
+            xy[1] = f2 * v + params[3];
+            if (J_uv) {
+                J_uv[0] = f1;
+                J_uv[1] = 0;
+                J_uv[2] = 0;
+                J_uv[3] = f2;
+            }
+            if (J_params) {
+                J_params[0] = u;
+                J_params[1] = 0;
+                J_params[2] = 1;
+                J_params[3] = 0;
+                J_params[4] = 0;
+                J_params[5] = v;
+                J_params[6] = 0;
+                J_params[7] = 1;
+            }
+        }
+    };
+
+    template <>
+    struct AnalyticCameraModel<SimpleRadialCameraModel> {
+        static constexpr bool kSupported = true;
+
+        static void ImgFromNormalizedCam(const double* params,
+                                         const double u,
+                                         const double v,
+                                         double* xy,
+                                         double* J_uv,
+                                         double* J_params) {
+            const double f = params[0];
+            const double k = params[3];
+
+            const double r2 = u * u + v * v;
+            const double radial = k * r2;
+            const double distorted_u = u * (1 + radial);
+            const double distorted_v = v * (1 + radial);
+            xy[0] = f * distorted_u + params[1];
+            xy[1] = f * distorted_v + params[2];
+
+            if (J_uv) {
+                const double two_k = 2 * k;
+                J_uv[0] = f * (1 + radial + two_k * u * u);
+                J_uv[1] = f * two_k * u * v;
+                J_uv[2] = J_uv[1];
+                J_uv[3] = f * (1 + radial + two_k * v * v);
+            }
+            if (J_params) {
+                J_params[0] = distorted_u;
+                J_params[1] = 1;
+                J_params[2] = 0;
+                J_params[3] = f * u * r2;
+                J_params[4] = distorted_v;
+                J_params[5] = 0;
+                J_params[6] = 1;
+                J_params[7] = f * v * r2;
+            }
+        }
+    };
+
+    template <>
+    struct AnalyticCameraModel<RadialCameraModel> {
+        static constexpr bool kSupported = true;
+
+        static void ImgFromNormalizedCam(const double* params,
+                                         const double u,
+                                         const double v,
+                                         double* xy,
+                                         double* J_uv,
+                                         double* J_params) {
+            const double f = params[0];
+            const double k1 = params[3];
+            const double k2 = params[4];
+
+            const double r2 = u * u + v * v;
+            const double radial = k1 * r2 + k2 * r2 * r2;
+            const double distorted_u = u * (1 + radial);
+            const double distorted_v = v * (1 + radial);
+            xy[0] = f * distorted_u + params[1];
+            xy[1] = f * distorted_v + params[2];
+
+            if (J_uv) {
+                // Derivative of the radial term w.r.t. r2, times two.
+                const double g = 2 * k1 + 4 * k2 * r2;
+                J_uv[0] = f * (1 + radial + g * u * u);
+                J_uv[1] = f * g * u * v;
+                J_uv[2] = J_uv[1];
+                J_uv[3] = f * (1 + radial + g * v * v);
+            }
+            if (J_params) {
+                J_params[0] = distorted_u;
+                J_params[1] = 1;
+                J_params[2] = 0;
+                J_params[3] = f * u * r2;
+                J_params[4] = f * u * r2 * r2;
+                J_params[5] = distorted_v;
+                J_params[6] = 0;
+                J_params[7] = 1;
+                J_params[8] = f * v * r2;
+                J_params[9] = f * v * r2 * r2;
+            }
+        }
+    };
+
+    template <>
+    struct AnalyticCameraModel<OpenCVCameraModel> {
+        static constexpr bool kSupported = true;
+
+        static void ImgFromNormalizedCam(const double* params,
+                                         const double u,
+                                         const double v,
+                                         double* xy,
+                                         double* J_uv,
+                                         double* J_params) {
+            const double f1 = params[0];
+            const double f2 = params[1];
+            const double k1 = params[4];
+            const double k2 = params[5];
+            const double p1 = params[6];
+            const double p2 = params[7];
+
+            const double u2 = u * u;
+            const double uv = u * v;
+            const double v2 = v * v;
+            const double r2 = u2 + v2;
+            const double radial = k1 * r2 + k2 * r2 * r2;
+            const double distorted_u =
+                    u + u * radial + 2 * p1 * uv + p2 * (r2 + 2 * u2);
+            const double distorted_v =
+                    v + v * radial + 2 * p2 * uv + p1 * (r2 + 2 * v2);
+            xy[0] = f1 * distorted_u + params[2];
+            xy[1] = f2 * distorted_v + params[3];
+
+            if (J_uv) {
+                // Derivative of the radial term w.r.t. r2, times two.
+                const double g = 2 * k1 + 4 * k2 * r2;
+                const double cross = g * uv + 2 * p1 * u + 2 * p2 * v;
+                J_uv[0] = f1 * (1 + radial + g * u2 + 2 * p1 * v + 6 * p2 * u);
+                J_uv[1] = f1 * cross;
+                J_uv[2] = f2 * cross;
+                J_uv[3] = f2 * (1 + radial + g * v2 + 2 * p2 * u + 6 * p1 * v);
+            }
+            if (J_params) {
+                J_params[0] = distorted_u;
+                J_params[1] = 0;
+                J_params[2] = 1;
+                J_params[3] = 0;
+                J_params[4] = f1 * u * r2;
+                J_params[5] = f1 * u * r2 * r2;
+                J_params[6] = f1 * 2 * uv;
+                J_params[7] = f1 * (r2 + 2 * u2);
+                J_params[8] = 0;
+                J_params[9] = distorted_v;
+                J_params[10] = 0;
+                J_params[11] = 1;
+                J_params[12] = f2 * v * r2;
+                J_params[13] = f2 * v * r2 * r2;
+                J_params[14] = f2 * (r2 + 2 * v2);
+                J_params[15] = f2 * 2 * uv;
+            }
+        }
+    };
+
+// Reprojection error and its Jacobians w.r.t. the camera rotation (Eigen
+// quaternion coefficients x, y, z, w), translation, point, and camera
+// parameters, each of which may be null. The rotation is applied with the
+// same formula as Eigen's quaternion-vector product, such that the Jacobians
+// match the AutoDiff cost functors also for the ambient quaternion
+// parameters. Points behind the camera have zero residuals and Jacobians.
+    template <typename CameraModel>
+    inline void EvaluateAnalyticReprojError(const double* cam_from_world_rotation,
+                                            const double* cam_from_world_translation,
+                                            const double* point3D,
+                                            const double* camera_params,
+                                            const double observed_x,
+                                            const double observed_y,
+                                            double* residuals,
+                                            double* J_rotation,
+                                            double* J_translation,
+                                            double* J_point3D,
+                                            double* J_camera_params) {
+        constexpr int kNumParams = CameraModel::num_params;
+
+        const Eigen::Map<const Eigen::Vector3d> q_vec(cam_from_world_rotation);
+        const double q_w = cam_from_world_rotation[3];
+        const Eigen::Map<const Eigen::Vector3d> point(point3D);
+
+        // p = X + w * uv + q_vec x uv with uv = 2 * (q_vec x X).
+        const Eigen::Vector3d uv = 2 * q_vec.cross(point);
+        const Eigen::Vector3d point3D_in_cam =
+                point + q_w * uv + q_vec.cross(uv) +
+                Eigen::Map<const Eigen::Vector3d>(cam_from_world_translation);
+
+        if (point3D_in_cam.z() < std::numeric_limits<double>::epsilon()) {
+            residuals[0] = 0;
+            residuals[1] = 0;
+            if (J_rotation) {
+                std::fill(J_rotation, J_rotation + 2 * 4, 0.0);
+            }
+            if (J_translation) {
+                std::fill(J_translation, J_translation + 2 * 3, 0.0);
+            }
+            if (J_point3D) {
+                std::fill(J_point3D, J_point3D + 2 * 3, 0.0);
+            }
+            if (J_camera_params) {
+                std::fill(J_camera_params, J_camera_params + 2 * kNumParams, 0.0);
+            }
+            return;
+        }
+
+        const double inv_z = 1 / point3D_in_cam.z();
+        const double u = point3D_in_cam.x() * inv_z;
+        const double v = point3D_in_cam.y() * inv_z;
+
+        const bool has_point_jacobians = J_rotation || J_translation || J_point3D;
+        Eigen::Matrix<double, 2, 2, Eigen::RowMajor> J_uv;
+        AnalyticCameraModel<CameraModel>::ImgFromNormalizedCam(
+                camera_params,
+                u,
+                v,
+                residuals,
+                has_point_jacobians ? J_uv.data() : nullptr,
+                J_camera_params);
+        residuals[0] -= observed_x;
+        residuals[1] -= observed_y;
+
+        if (!has_point_jacobians) {
+            return;
+        }
+
+        // Jacobian of the image point w.r.t. the point in camera coordinates.
+        Eigen::Matrix<double, 2, 3> J_uv_cam;
+        J_uv_cam << inv_z, 0, -u * inv_z, 0, inv_z, -v * inv_z;
+        const Eigen::Matrix<double, 2, 3> J_cam = J_uv * J_uv_cam;
+
+        using RowMajorMatrix2x3 = Eigen::Matrix<double, 2, 3, Eigen::RowMajor>;
+        using RowMajorMatrix2x4 = Eigen::Matrix<double, 2, 4, Eigen::RowMajor>;
+
+        if (J_translation) {
+            Eigen::Map<RowMajorMatrix2x3>(J_translation).noalias() = J_cam;
+        }
+
+        Eigen::Matrix3d q_vec_cross;
+        q_vec_cross << 0, -q_vec.z(), q_vec.y(), q_vec.z(), 0, -q_vec.x(),
+                -q_vec.y(), q_vec.x(), 0;
+
+        if (J_point3D) {
+            const Eigen::Matrix3d d_point = Eigen::Matrix3d::Identity() +
+                                            2 * q_w * q_vec_cross +
+                                            2 * q_vec_cross * q_vec_cross;
+            Eigen::Map<RowMajorMatrix2x3>(J_point3D).noalias() = J_cam * d_point;
+        }
+
+        if (J_rotation) {
+            Eigen::Matrix3d point_cross;
+            point_cross << 0, -point.z(), point.y(), point.z(), 0, -point.x(),
+                    -point.y(), point.x(), 0;
+            Eigen::Matrix<double, 3, 4> d_rotation;
+            d_rotation.leftCols<3>() =
+                    -2 * q_w * point_cross +
+                    2 * (q_vec.dot(point) * Eigen::Matrix3d::Identity() +
+                         q_vec * point.transpose() - 2 * point * q_vec.transpose());
+            d_rotation.col(3) = uv;
+            Eigen::Map<RowMajorMatrix2x4>(J_rotation).noalias() = J_cam * d_rotation;
+        }
+    }
+
+// Analytic-derivative equivalent of ReprojErrorCostFunctor.
+    template <typename CameraModel>
+    class AnalyticReprojErrorCostFunction
+            : public ceres::SizedCostFunction<2, 4, 3, 3, CameraModel::num_params> {
+    public:
+        explicit AnalyticReprojErrorCostFunction(const Eigen::Vector2d& point2D)
+                : observed_x_(point2D(0)), observed_y_(point2D(1)) {}
+
+        bool Evaluate(double const* const* parameters,
+                      double* residuals,
+                      double** jacobians) const override {
+            EvaluateAnalyticReprojError<CameraModel>(
+                    parameters[0],
+                    parameters[1],
+                    parameters[2],
+                    parameters[3],
+                    observed_x_,
+                    observed_y_,
+                    residuals,
+                    jacobians ? jacobians[0] : nullptr,
+                    jacobians ? jacobians[1] : nullptr,
+                    jacobians ? jacobians[2] : nullptr,
+                    jacobians ? jacobians[3] : nullptr);
+            return true;
+        }
+
+    private:
+        const double observed_x_;
+        const double observed_y_;
+    };
+
+// Analytic-derivative equivalent of ReprojErrorConstantPoseCostFunctor.
+    template <typename CameraModel>
+    class AnalyticReprojErrorConstantPoseCostFunction
+            : public ceres::SizedCostFunction<2, 3, CameraModel::num_params> {
+    public:
+        AnalyticReprojErrorConstantPoseCostFunction(const Eigen::Vector2d& point2D,
+                                                    const Rigid3d& cam_from_world)
+                : observed_x_(point2D(0)),
+                  observed_y_(point2D(1)),
+                  cam_from_world_(cam_from_world) {}
+
+        bool Evaluate(double const* const* parameters,
+                      double* residuals,
+                      double** jacobians) const override {
+            EvaluateAnalyticReprojError<CameraModel>(
+                    cam_from_world_.rotation.coeffs().data(),
+                    cam_from_world_.translation.data(),
+                    parameters[0],
+                    parameters[1],
+                    observed_x_,
+                    observed_y_,
+                    residuals,
+                    nullptr,
+                    nullptr,
+                    jacobians ? jacobians[0] : nullptr,
+                    jacobians ? jacobians[1] : nullptr);
+            return true;
+        }
+
+    private:
+        const double observed_x_;
+        const double observed_y_;
+        const Rigid3d cam_from_world_;
+    };
+
+// Analytic-derivative equivalent of ReprojErrorConstantPoint3DCostFunctor.
+    template <typename CameraModel>
+    class AnalyticReprojErrorConstantPoint3DCostFunction
+            : public ceres::SizedCostFunction<2, 4, 3, CameraModel::num_params> {
+    public:
+        AnalyticReprojErrorConstantPoint3DCostFunction(
+                const Eigen::Vector2d& point2D, const Eigen::Vector3d& point3D)
+                : observed_x_(point2D(0)),
+                  observed_y_(point2D(1)),
+                  point3D_(point3D) {}
+
+        bool Evaluate(double const* const* parameters,
+                      double* residuals,
+                      double** jacobians) const override {
+            EvaluateAnalyticReprojError<CameraModel>(
+                    parameters[0],
+                    parameters[1],
+                    point3D_.data(),
+                    parameters[2],
+                    observed_x_,
+                    observed_y_,
+                    residuals,
+                    jacobians ? jacobians[0] : nullptr,
+                    jacobians ? jacobians[1] : nullptr,
+                    nullptr,
+                    jacobians ? jacobians[2] : nullptr);
+            return true;
+        }
+
+    private:
+        const double observed_x_;
+        const double observed_y_;
+        const Eigen::Vector3d point3D_;
+    };
+
+}  // namespace colmap
@@ -268,10 +268,11 @@ namespace colmap {
 #endif  // CERES_VERSION_MAJOR
         } else {
             custom_solver_options.num_threads =
-                    GetEffectiveNumThreads(custom_solver_options.num_threads);
+                    GetEffectiveNumSolverThreads(custom_solver_options.num_threads);
 #if CERES_VERSION_MAJOR < 2
             custom_solver_options.num_linear_solver_threads =
-                    GetEffectiveNumThreads(custom_solver_options.num_linear_solver_threads);
+                    GetEffectiveNumSolverThreads(
+                            custom_solver_options.num_linear_solver_threads);
 #endif  // CERES_VERSION_MAJOR
         }
 
@@ -282,6 +283,7 @@ namespace colmap {
 
     bool BundleAdjustmentOptions::Check() const {
         CHECK_OPTION_GE(loss_function_scale, 0);
+        CHECK_OPTION_GE(max_num_frames_local_solver, 0);
         CHECK_OPTION_LT(max_num_images_direct_dense_cpu_solver,
                         max_num_images_direct_sparse_cpu_solver);
         CHECK_OPTION_LT(max_num_images_direct_dense_gpu_solver,
@@ -291,6 +293,28 @@ namespace colmap {
 
     namespace {
 
+        // Ceres context shared by all bundle adjustments, such that the solver
+        // threads are started once instead of for every problem.
+        ceres::Context* GetSharedSolverContext() {
+            static std::unique_ptr<ceres::Context> context(ceres::Context::Create());
+            return context.get();
+        }
+
+        // Create the reprojection error cost function of the camera model, with
+        // analytic derivatives unless they are disabled in the options.
+        template <template <typename> class CostFunctor, typename... Args>
+        ceres::CostFunction* CreateReprojErrorCostFunction(
+                const BundleAdjustmentOptions& options,
+                const CameraModelId camera_model_id,
+                Args&&... args) {
+            if (options.use_analytic_jacobians) {
+                return CreateCameraCostFunction<CostFunctor>(
+                        camera_model_id, std::forward<Args>(args)...);
+            }
+            return CreateAutoDiffCameraCostFunction<CostFunctor>(
+                    camera_model_id, std::forward<Args>(args)...);
+        }
+
         void ParameterizeCameras(const BundleAdjustmentOptions& options,
                                  const BundleAdjustmentConfig& config,
                                  const std::set<camera_t>& camera_ids,
@@ -597,6 +621,7 @@ namespace colmap {
                               options_.CreateLossFunction())) {
                 ceres::Problem::Options problem_options;
                 problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+                problem_options.context = GetSharedSolverContext();
                 problem_ = std::make_shared<ceres::Problem>(problem_options);
 
                 // Set up problem
@@ -698,15 +723,15 @@ namespace colmap {
 
                     if (constant_cam_from_world) {
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<ReprojErrorConstantPoseCostFunctor>(
-                                        camera.model_id, point2D.xy, cam_from_world),
+                                CreateReprojErrorCostFunction<ReprojErrorConstantPoseCostFunctor>(
+                                        options_, camera.model_id, point2D.xy, cam_from_world),
                                 loss_function_.get(),
                                 point3D.xyz.data(),
                                 camera.params.data());
                     } else {
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<ReprojErrorCostFunctor>(camera.model_id,
-                                                                                 point2D.xy),
+                                CreateReprojErrorCostFunction<ReprojErrorCostFunctor>(
+                                        options_, camera.model_id, point2D.xy),
                                 loss_function_.get(),
                                 cam_from_world.rotation.coeffs().data(),
                                 cam_from_world.translation.data(),
@@ -755,15 +780,15 @@ namespace colmap {
                     // rare enough that we do not have a specialized cost function for it.
                     if (constant_sensor_from_rig && constant_rig_from_world) {
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<ReprojErrorConstantPoseCostFunctor>(
-                                        camera.model_id, point2D.xy, cam_from_rig * rig_from_world),
+                                CreateReprojErrorCostFunction<ReprojErrorConstantPoseCostFunctor>(
+                                        options_, camera.model_id, point2D.xy, cam_from_rig * rig_from_world),
                                 loss_function_.get(),
                                 point3D.xyz.data(),
                                 camera.params.data());
                     } else if (!constant_rig_from_world && constant_sensor_from_rig) {
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<RigReprojErrorConstantRigCostFunctor>(
-                                        camera.model_id, point2D.xy, cam_from_rig),
+                                CreateReprojErrorCostFunction<RigReprojErrorConstantRigCostFunctor>(
+                                        options_, camera.model_id, point2D.xy, cam_from_rig),
                                 loss_function_.get(),
                                 rig_from_world.rotation.coeffs().data(),
                                 rig_from_world.translation.data(),
@@ -771,8 +796,8 @@ namespace colmap {
                                 camera.params.data());
                     } else {
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<RigReprojErrorCostFunctor>(camera.model_id,
-                                                                                    point2D.xy),
+                                CreateReprojErrorCostFunction<RigReprojErrorCostFunctor>(
+                                        options_, camera.model_id, point2D.xy),
                                 loss_function_.get(),
                                 cam_from_rig.rotation.coeffs().data(),
                                 cam_from_rig.translation.data(),
@@ -818,8 +843,8 @@ namespace colmap {
                         Rigid3d& cam_from_world = image.FramePtr()->RigFromWorld();
 
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<ReprojErrorConstantPoseCostFunctor>(
-                                        camera.model_id, point2D.xy, cam_from_world),
+                                CreateReprojErrorCostFunction<ReprojErrorConstantPoseCostFunctor>(
+                                        options_, camera.model_id, point2D.xy, cam_from_world),
                                 loss_function_.get(),
                                 point3D.xyz.data(),
                                 camera.params.data());
@@ -829,8 +854,8 @@ namespace colmap {
                         Rigid3d& rig_from_world = image.FramePtr()->RigFromWorld();
 
                         problem_->AddResidualBlock(
-                                CreateCameraCostFunction<ReprojErrorConstantPoseCostFunctor>(
-                                        camera.model_id, point2D.xy, cam_from_rig * rig_from_world),
+                                CreateReprojErrorCostFunction<ReprojErrorConstantPoseCostFunctor>(
+                                        options_, camera.model_id, point2D.xy, cam_from_rig * rig_from_world),
                                 loss_function_.get(),
                                 point3D.xyz.data(),
                                 camera.params.data());
@@ -137,6 +137,11 @@ namespace colmap {
         // Whether to print a final summary.
         bool print_summary = true;
 
+        // Whether to evaluate the reprojection errors with the analytic
+        // derivatives of the camera models, where available, instead of
+        // automatic differentiation.
+        bool use_analytic_jacobians = true;
+
         // Whether to use Ceres' CUDA linear algebra library, if available.
         bool use_gpu = false;
         std::string gpu_index = "-1";
@@ -159,6 +164,11 @@ namespace colmap {
         int max_num_images_direct_dense_gpu_solver = 200;
         int max_num_images_direct_sparse_gpu_solver = 4000;
 
+        // Maximum number of variable frames up to which CreateLocalBundleAdjuster
+        // solves problems with its dense Schur complement solver instead of
+        // Ceres. Set to 0 to always use Ceres.
+        int max_num_frames_local_solver = 32;
+
         // Ceres-Solver options.
         ceres::Solver::Options solver_options;
 
@@ -0,0 +1,205 @@
+// Benchmark of the global bundle adjustment on a synthetic scene for an
+// increasing number of Ceres solver threads, with analytic and with AutoDiff
+// derivatives of the reprojection errors. The cameras move along a line
+// and look at a wall of points, such that every point is observed by a
+// sliding window of images, similar to a walk-through capture. Build with
+// MINMAP_BUILD_BENCHMARKS=ON and run, e.g., through adb on the target device:
+//
+//    minmap_bundle_adjustment_benchmark [num_images] [num_points]
+//                                       [max_num_threads]
+//
+
+#include "bundle_adjustment.h"
+
+#include "../util/string.h"
+#include "../util/timer.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace colmap {
+namespace {
+
+constexpr double kImageSize = 1000;
+constexpr double kFocalLength = 1000;
+constexpr double kImageSpacing = 0.25;
+constexpr double kMinDepth = 8;
+constexpr double kMaxDepth = 12;
+
+Reconstruction CreateSyntheticReconstruction(const int num_images,
+                                             const int num_points) {
+  std::mt19937 rng(42);
+  std::normal_distribution<double> noise(0, 1);
+
+  Reconstruction reconstruction;
+
+  Camera camera = Camera::CreateFromModelName(
+      1, "SIMPLE_RADIAL", kFocalLength, kImageSize, kImageSize);
+  reconstruction.AddCamera(camera);
+
+  Rig rig;
+  rig.SetRigId(1);
+  rig.AddRefSensor(camera.SensorId());
+  reconstruction.AddRig(rig);
+
+  // Noise-free points on a wall in front of the camera trajectory.
+  const double trajectory_length = (num_images - 1) * kImageSpacing;
+  std::uniform_real_distribution<double> x_distribution(-2,
+                                                        trajectory_length + 2);
+  std::uniform_real_distribution<double> y_distribution(-3, 3);
+  std::uniform_real_distribution<double> z_distribution(kMinDepth, kMaxDepth);
+  std::vector<Eigen::Vector3d> points3D(num_points);
+  for (auto& point3D : points3D) {
+    point3D = Eigen::Vector3d(
+        x_distribution(rng), y_distribution(rng), z_distribution(rng));
+  }
+
+  std::vector<std::vector<std::pair<point3D_t, Eigen::Vector2d>>>
+      observations(num_images);
+  for (int i = 0; i < num_images; ++i) {
+    const image_t image_id = i + 1;
+    const Rigid3d cam_from_world(
+        Eigen::Quaterniond::Identity(),
+        Eigen::Vector3d(-i * kImageSpacing, 0, 0));
+
+    Image image;
+    image.SetImageId(image_id);
+    image.SetCameraId(camera.camera_id);
+    image.SetName(StringPrintf("image%06d", i));
+
+    std::vector<Eigen::Vector2d> points2D;
+    for (int j = 0; j < num_points; ++j) {
+      const std::optional<Eigen::Vector2d> point2D =
+          camera.ImgFromCam(cam_from_world * points3D[j]);
+      if (!point2D || point2D->x() < 0 || point2D->y() < 0 ||
+          point2D->x() >= kImageSize || point2D->y() >= kImageSize) {
+        continue;
+      }
+      observations[i].emplace_back(
+          j, *point2D + 0.5 * Eigen::Vector2d(noise(rng), noise(rng)));
+      points2D.push_back(observations[i].back().second);
+    }
+    image.SetPoints2D(points2D);
+
+    Frame frame;
+    frame.SetFrameId(image_id);
+    frame.SetRigId(rig.RigId());
+    frame.AddDataId(image.DataId());
+    frame.SetRigFromWorld(cam_from_world);
+    reconstruction.AddFrame(frame);
+
+    image.SetFrameId(image_id);
+    reconstruction.AddImage(image);
+    reconstruction.RegisterFrame(image_id);
+  }
+
+  // Perturbed points, such that the solver has something to do.
+  std::vector<point3D_t> point3D_ids(num_points, kInvalidPoint3DId);
+  for (int i = 0; i < num_images; ++i) {
+    const image_t image_id = i + 1;
+    for (size_t point2D_idx = 0; point2D_idx < observations[i].size();
+         ++point2D_idx) {
+      const int j = observations[i][point2D_idx].first;
+      if (point3D_ids[j] == kInvalidPoint3DId) {
+        point3D_ids[j] = reconstruction.AddPoint3D(
+            points3D[j] + 0.05 * Eigen::Vector3d(noise(rng),
+                                                 noise(rng),
+                                                 noise(rng)),
+            Track());
+      }
+      reconstruction.AddObservation(point3D_ids[j],
+                                    TrackElement(image_id, point2D_idx));
+    }
+  }
+
+  // Drop points that are not observed at least twice.
+  for (const point3D_t point3D_id : point3D_ids) {
+    if (point3D_id != kInvalidPoint3DId &&
+        reconstruction.Point3D(point3D_id).track.Length() < 2) {
+      reconstruction.DeletePoint3D(point3D_id);
+    }
+  }
+
+  return reconstruction;
+}
+
+ceres::Solver::Summary RunBundleAdjustment(Reconstruction reconstruction,
+                                           const int num_threads,
+                                           const bool use_analytic_jacobians) {
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  options.use_analytic_jacobians = use_analytic_jacobians;
+  options.solver_options.num_threads = num_threads;
+  options.solver_options.max_num_iterations = 10;
+  // Run all iterations, such that every thread count does the same work.
+  options.solver_options.gradient_tolerance = 0;
+  options.min_num_residuals_for_cpu_multi_threading = 0;
+
+  BundleAdjustmentConfig config;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    config.AddImage(image_id);
+  }
+  config.FixGauge(BundleAdjustmentGauge::TWO_CAMS_FROM_WORLD);
+
+  std::unique_ptr<BundleAdjuster> bundle_adjuster = CreateDefaultBundleAdjuster(
+      std::move(options), std::move(config), reconstruction);
+  return bundle_adjuster->Solve();
+}
+
+}  // namespace
+}  // namespace colmap
+
+int main(int argc, char** argv) {
+  using namespace colmap;
+
+  const int num_images = argc > 1 ? std::stoi(argv[1]) : 200;
+  const int num_points = argc > 2 ? std::stoi(argv[2]) : 20000;
+  const int max_num_threads =
+      argc > 3 ? std::stoi(argv[3])
+               : std::max<int>(1, std::thread::hardware_concurrency());
+
+  Timer timer;
+  timer.Start();
+  const Reconstruction reconstruction =
+      CreateSyntheticReconstruction(num_images, num_points);
+  std::cout << StringPrintf(
+                   "num_images=%d num_points=%d num_observations=%d "
+                   "hardware_concurrency=%u setup=%.2fs",
+                   num_images,
+                   static_cast<int>(reconstruction.NumPoints3D()),
+                   static_cast<int>(reconstruction.ComputeNumObservations()),
+                   std::thread::hardware_concurrency(),
+                   timer.ElapsedSeconds())
+            << std::endl;
+  std::cout << "jacobians  threads  threads_used  total [s]  jacobian [s]  "
+               "linear_solver [s]  speedup  final_cost"
+            << std::endl;
+
+  // The speedups are relative to single-threaded AutoDiff.
+  double single_thread_time = 0;
+  for (const bool use_analytic_jacobians : {false, true}) {
+    for (int num_threads = 1; num_threads <= max_num_threads;
+         num_threads *= 2) {
+      const ceres::Solver::Summary summary = RunBundleAdjustment(
+          reconstruction, num_threads, use_analytic_jacobians);
+      if (num_threads == 1 && !use_analytic_jacobians) {
+        single_thread_time = summary.total_time_in_seconds;
+      }
+      std::cout << StringPrintf(
+                       "%9s %8d %13d %10.3f %13.3f %18.3f %8.2f  %.6e",
+                       use_analytic_jacobians ? "analytic" : "autodiff",
+                       num_threads,
+                       summary.num_threads_used,
+                       summary.total_time_in_seconds,
+                       summary.jacobian_evaluation_time_in_seconds,
+                       summary.linear_solver_time_in_seconds,
+                       single_thread_time / summary.total_time_in_seconds,
+                       summary.final_cost)
+                << std::endl;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../estimators/analytic_cost_functions.h"
 #include "../geometry/rigid3.h"
 #include "../sensor/models.h"
 #include "../util/logging.h"
@@ -11,6 +12,8 @@
 #include <ceres/conditioned_cost_function.h>
 #include <ceres/rotation.h>
 
+#include <type_traits>
+
 namespace colmap {
 
     template <typename T>
@@ -513,10 +516,65 @@ namespace colmap {
         const CostFunctor cost_;
     };
 
+// Cost function with analytic derivatives that is equivalent to the given
+// AutoDiff cost functor, or void if there is none.
+    template <typename CostFunctor>
+    struct AnalyticCostFunction {
+        using Type = void;
+    };
+
+    template <typename CameraModel>
+    struct AnalyticCostFunction<ReprojErrorCostFunctor<CameraModel>> {
+        using Type = std::conditional_t<AnalyticCameraModel<CameraModel>::kSupported,
+                AnalyticReprojErrorCostFunction<CameraModel>,
+                void>;
+    };
+
+    template <typename CameraModel>
+    struct AnalyticCostFunction<ReprojErrorConstantPoseCostFunctor<CameraModel>> {
+        using Type = std::conditional_t<
+                AnalyticCameraModel<CameraModel>::kSupported,
+                AnalyticReprojErrorConstantPoseCostFunction<CameraModel>,
+                void>;
+    };
+
+    template <typename CameraModel>
+    struct AnalyticCostFunction<
+            ReprojErrorConstantPoint3DCostFunctor<CameraModel>> {
+        using Type = std::conditional_t<
+                AnalyticCameraModel<CameraModel>::kSupported,
+                AnalyticReprojErrorConstantPoint3DCostFunction<CameraModel>,
+                void>;
+    };
+
+// Create the cost function of the given camera model, with analytic
+// derivatives if available and AutoDiff otherwise.
     template <template <typename> class CostFunctor, typename... Args>
     ceres::CostFunction* CreateCameraCostFunction(
             const CameraModelId camera_model_id, Args&&... args) {
         switch (camera_model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                          \
+  case CameraModel::model_id: {                                                 \
+    using AnalyticType =                                                        \
+        typename AnalyticCostFunction<CostFunctor<CameraModel>>::Type;          \
+    if constexpr (!std::is_void_v<AnalyticType>) {                              \
+      return new AnalyticType(std::forward<Args>(args)...);                     \
+    } else {                                                                    \
+      return CostFunctor<CameraModel>::Create(std::forward<Args>(args)...);     \
+    }                                                                           \
+  }
+
+            CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+        }
+    }
+
+// Same as CreateCameraCostFunction but always with AutoDiff derivatives.
+    template <template <typename> class CostFunctor, typename... Args>
+    ceres::CostFunction* CreateAutoDiffCameraCostFunction(
+            const CameraModelId camera_model_id, Args&&... args) {
+        switch (camera_model_id) {
 #define CAMERA_MODEL_CASE(CameraModel)                                    \
   case CameraModel::model_id:                                             \
     return CostFunctor<CameraModel>::Create(std::forward<Args>(args)...); \
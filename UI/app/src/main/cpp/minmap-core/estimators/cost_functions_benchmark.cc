@@ -0,0 +1,256 @@
+// Checks the analytic reprojection error cost functions against their AutoDiff
+// equivalents and compares their evaluation time. The residuals and Jacobians
+// of both are evaluated for random poses, points, and camera parameters, and
+// the benchmark fails if they do not agree. Build with
+// MINMAP_BUILD_BENCHMARKS=ON and run, e.g., through adb on the target device:
+//
+//    minmap_cost_functions_benchmark [num_evaluations]
+//
+
+#include "cost_functions.h"
+
+#include "../scene/camera.h"
+#include "../util/string.h"
+#include "../util/timer.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace colmap {
+namespace {
+
+constexpr double kMaxRelativeError = 1e-9;
+constexpr int kNumCheckedEvaluations = 1000;
+
+struct Parameters {
+  Eigen::Quaterniond cam_from_world_rotation;
+  Eigen::Vector3d cam_from_world_translation;
+  Eigen::Vector3d point3D;
+  std::vector<double> camera_params;
+  Eigen::Vector2d point2D;
+};
+
+// Random camera parameters with realistic distortion, such that the distorted
+// projections stay within the domain where the models are monotonic.
+std::vector<double> RandomCameraParams(const CameraModelId model_id,
+                                       std::mt19937& rng) {
+  std::uniform_real_distribution<double> focal_length(500, 1500);
+  std::uniform_real_distribution<double> principal_point(400, 600);
+  std::uniform_real_distribution<double> distortion(-0.1, 0.1);
+  std::uniform_real_distribution<double> tangential(-0.01, 0.01);
+  const Camera camera =
+      Camera::CreateFromModelId(1, model_id, focal_length(rng), 1000, 1000);
+  std::vector<double> params = camera.params;
+  for (const size_t idx : camera.FocalLengthIdxs()) {
+    params[idx] = focal_length(rng);
+  }
+  for (const size_t idx : camera.PrincipalPointIdxs()) {
+    params[idx] = principal_point(rng);
+  }
+  for (const size_t idx : camera.ExtraParamsIdxs()) {
+    params[idx] = distortion(rng);
+  }
+  if (model_id == OpenCVCameraModel::model_id) {
+    params[6] = tangential(rng);
+    params[7] = tangential(rng);
+  }
+  return params;
+}
+
+Parameters RandomParameters(const CameraModelId model_id, std::mt19937& rng) {
+  std::normal_distribution<double> normal(0, 1);
+  std::uniform_real_distribution<double> depth(2, 10);
+  Parameters parameters;
+  parameters.cam_from_world_rotation =
+      Eigen::Quaterniond(
+          1, 0.2 * normal(rng), 0.2 * normal(rng), 0.2 * normal(rng))
+          .normalized();
+  parameters.cam_from_world_translation =
+      Eigen::Vector3d(normal(rng), normal(rng), normal(rng));
+  // Place the point in front of the camera within a field of view of roughly
+  // 90 degrees.
+  const Eigen::Vector3d point3D_in_cam(
+      0.4 * normal(rng), 0.4 * normal(rng), 1);
+  parameters.point3D =
+      parameters.cam_from_world_rotation.inverse() *
+      (depth(rng) * point3D_in_cam - parameters.cam_from_world_translation);
+  parameters.camera_params = RandomCameraParams(model_id, rng);
+  parameters.point2D = Eigen::Vector2d(1000 * std::abs(normal(rng)),
+                                       1000 * std::abs(normal(rng)));
+  return parameters;
+}
+
+// Evaluate the residuals and all Jacobians of the cost function, which are
+// concatenated into one vector.
+void Evaluate(const ceres::CostFunction& cost_function,
+              const std::vector<double*>& parameter_blocks,
+              std::vector<double>* values) {
+  const std::vector<int32_t>& block_sizes =
+      cost_function.parameter_block_sizes();
+  const int num_residuals = cost_function.num_residuals();
+  int num_values = num_residuals;
+  for (const int32_t block_size : block_sizes) {
+    num_values += num_residuals * block_size;
+  }
+  values->resize(num_values);
+  constexpr size_t kMaxNumParameterBlocks = 4;
+  THROW_CHECK_LE(block_sizes.size(), kMaxNumParameterBlocks);
+  double* jacobians[kMaxNumParameterBlocks];
+  double* jacobian = values->data() + num_residuals;
+  for (size_t i = 0; i < block_sizes.size(); ++i) {
+    jacobians[i] = jacobian;
+    jacobian += num_residuals * block_sizes[i];
+  }
+  THROW_CHECK(cost_function.Evaluate(
+      parameter_blocks.data(), values->data(), jacobians));
+}
+
+double MaxRelativeError(const std::vector<double>& values,
+                        const std::vector<double>& ref_values) {
+  THROW_CHECK_EQ(values.size(), ref_values.size());
+  double max_error = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    const double error = std::abs(values[i] - ref_values[i]) /
+                         std::max(1.0, std::abs(ref_values[i]));
+    max_error = std::max(max_error, error);
+  }
+  return max_error;
+}
+
+// Microseconds per evaluation of the residuals and all Jacobians.
+double TimeEvaluations(const ceres::CostFunction& cost_function,
+                       const std::vector<double*>& parameter_blocks,
+                       const int num_evaluations) {
+  std::vector<double> values;
+  double checksum = 0;
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < num_evaluations; ++i) {
+    Evaluate(cost_function, parameter_blocks, &values);
+    checksum += values[0];
+  }
+  const double elapsed_seconds = timer.ElapsedSeconds();
+  // Keep the compiler from removing the evaluations.
+  if (checksum == std::numeric_limits<double>::max()) {
+    std::cout << checksum << std::endl;
+  }
+  return 1e6 * elapsed_seconds / num_evaluations;
+}
+
+struct CostFunctionPair {
+  std::string name;
+  std::unique_ptr<ceres::CostFunction> analytic;
+  std::unique_ptr<ceres::CostFunction> autodiff;
+  std::vector<double*> parameter_blocks;
+};
+
+std::vector<CostFunctionPair> CreateCostFunctionPairs(
+    const CameraModelId model_id, Parameters& parameters) {
+  double* rotation = parameters.cam_from_world_rotation.coeffs().data();
+  double* translation = parameters.cam_from_world_translation.data();
+  double* point3D = parameters.point3D.data();
+  double* camera_params = parameters.camera_params.data();
+  const Rigid3d cam_from_world(parameters.cam_from_world_rotation,
+                               parameters.cam_from_world_translation);
+
+  std::vector<CostFunctionPair> pairs(3);
+  pairs[0].name = "ReprojError";
+  pairs[0].analytic.reset(CreateCameraCostFunction<ReprojErrorCostFunctor>(
+      model_id, parameters.point2D));
+  pairs[0].autodiff.reset(
+      CreateAutoDiffCameraCostFunction<ReprojErrorCostFunctor>(
+          model_id, parameters.point2D));
+  pairs[0].parameter_blocks = {rotation, translation, point3D, camera_params};
+
+  pairs[1].name = "ReprojErrorConstantPose";
+  pairs[1].analytic.reset(
+      CreateCameraCostFunction<ReprojErrorConstantPoseCostFunctor>(
+          model_id, parameters.point2D, cam_from_world));
+  pairs[1].autodiff.reset(
+      CreateAutoDiffCameraCostFunction<ReprojErrorConstantPoseCostFunctor>(
+          model_id, parameters.point2D, cam_from_world));
+  pairs[1].parameter_blocks = {point3D, camera_params};
+
+  pairs[2].name = "ReprojErrorConstantPoint3D";
+  pairs[2].analytic.reset(
+      CreateCameraCostFunction<ReprojErrorConstantPoint3DCostFunctor>(
+          model_id, parameters.point2D, parameters.point3D));
+  pairs[2].autodiff.reset(
+      CreateAutoDiffCameraCostFunction<ReprojErrorConstantPoint3DCostFunctor>(
+          model_id, parameters.point2D, parameters.point3D));
+  pairs[2].parameter_blocks = {rotation, translation, camera_params};
+
+  return pairs;
+}
+
+}  // namespace
+}  // namespace colmap
+
+int main(int argc, char** argv) {
+  using namespace colmap;
+
+  const int num_evaluations = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+  const std::vector<CameraModelId> model_ids = {
+      SimplePinholeCameraModel::model_id,
+      PinholeCameraModel::model_id,
+      SimpleRadialCameraModel::model_id,
+      RadialCameraModel::model_id,
+      OpenCVCameraModel::model_id,
+  };
+
+  std::mt19937 rng(42);
+  bool success = true;
+
+  std::cout << "model          cost function                max rel error  "
+               "analytic [us]  autodiff [us]  speedup"
+            << std::endl;
+  for (const CameraModelId model_id : model_ids) {
+    // Check the equivalence for many random inputs.
+    std::vector<double> max_errors;
+    std::vector<double> values;
+    std::vector<double> ref_values;
+    for (int i = 0; i < kNumCheckedEvaluations; ++i) {
+      Parameters parameters = RandomParameters(model_id, rng);
+      const std::vector<CostFunctionPair> pairs =
+          CreateCostFunctionPairs(model_id, parameters);
+      max_errors.resize(pairs.size(), 0);
+      for (size_t j = 0; j < pairs.size(); ++j) {
+        Evaluate(*pairs[j].analytic, pairs[j].parameter_blocks, &values);
+        Evaluate(*pairs[j].autodiff, pairs[j].parameter_blocks, &ref_values);
+        max_errors[j] =
+            std::max(max_errors[j], MaxRelativeError(values, ref_values));
+      }
+    }
+
+    Parameters parameters = RandomParameters(model_id, rng);
+    const std::vector<CostFunctionPair> pairs =
+        CreateCostFunctionPairs(model_id, parameters);
+    for (size_t j = 0; j < pairs.size(); ++j) {
+      const double analytic_time = TimeEvaluations(
+          *pairs[j].analytic, pairs[j].parameter_blocks, num_evaluations);
+      const double autodiff_time = TimeEvaluations(
+          *pairs[j].autodiff, pairs[j].parameter_blocks, num_evaluations);
+      std::cout << StringPrintf("%-14s %-28s %13.2e %14.3f %14.3f %8.2f",
+                                CameraModelIdToName(model_id).c_str(),
+                                pairs[j].name.c_str(),
+                                max_errors[j],
+                                analytic_time,
+                                autodiff_time,
+                                autodiff_time / analytic_time)
+                << std::endl;
+      if (max_errors[j] > kMaxRelativeError) {
+        std::cerr << "ERROR: Analytic and AutoDiff derivatives differ for "
+                  << CameraModelIdToName(model_id) << " " << pairs[j].name
+                  << std::endl;
+        success = false;
+      }
+    }
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,6 @@
 #include "essential_matrix.h"
 #include "../estimators/utils.h"
+#include "../geometry/essential_matrix.h"
 #include "../math/math.h"
 #include "../math/polynomial.h"
 #include "../util/logging.h"
@@ -8,18 +9,31 @@
 #include <Eigen/LU>
 #include <Eigen/SVD>
 
+#include <PoseLib/solvers/relpose_5pt.h>
+#include <PoseLib/solvers/relpose_upright_3pt.h>
+
 namespace colmap {
 
+EssentialMatrixFivePointEstimator::EssentialMatrixFivePointEstimator(
+    const MinimalSolverBackend backend)
+    : backend_(backend == MinimalSolverBackend::DEFAULT ? kDefaultBackend
+                                                         : backend) {}
+
 void EssentialMatrixFivePointEstimator::Estimate(
     const std::vector<X_t>& cam_rays1,
     const std::vector<Y_t>& cam_rays2,
-    std::vector<M_t>* models) {
+    std::vector<M_t>* models) const {
   THROW_CHECK_EQ(cam_rays1.size(), cam_rays2.size());
   THROW_CHECK_GE(cam_rays1.size(), 5);
   THROW_CHECK(models != nullptr);
 
   models->clear();
 
+  if (backend_ == MinimalSolverBackend::POSELIB && cam_rays1.size() == 5) {
+    poselib::relpose_5pt(cam_rays1, cam_rays2, models);
+    return;
+  }
+
   // Setup system of equations: [cam_rays2(i,:), 1]' * E * [cam_rays1(i,:), 1]'.
 
   Eigen::Matrix<double, Eigen::Dynamic, 9> Q(cam_rays1.size(), 9);
@@ -122,6 +136,89 @@ void EssentialMatrixFivePointEstimator::Residuals(
   ComputeSquaredSampsonError(cam_rays1, cam_rays2, E, residuals);
 }
 
+void EssentialMatrixFivePointEstimator::Pack(
+    const std::vector<X_t>& cam_rays1,
+    const std::vector<Y_t>& cam_rays2,
+    const std::vector<size_t>& order,
+    Packed_t* packed) {
+  PackCorrespondences(cam_rays1, cam_rays2, order, packed);
+}
+
+void EssentialMatrixFivePointEstimator::Residuals(const Packed_t& packed,
+                                                  const M_t& E,
+                                                  const size_t begin,
+                                                  const size_t end,
+                                                  float* residuals) {
+  ComputeSquaredSampsonError(packed, E, begin, end, residuals);
+}
+
+EssentialMatrixUprightThreePointEstimator::
+    EssentialMatrixUprightThreePointEstimator(const Eigen::Vector3d& gravity1,
+                                              const Eigen::Vector3d& gravity2)
+    : upright1_from_cam1_(
+          Eigen::Quaterniond::FromTwoVectors(gravity1, Eigen::Vector3d::UnitY())
+              .toRotationMatrix()),
+      upright2_from_cam2_(
+          Eigen::Quaterniond::FromTwoVectors(gravity2, Eigen::Vector3d::UnitY())
+              .toRotationMatrix()) {}
+
+void EssentialMatrixUprightThreePointEstimator::Estimate(
+    const std::vector<X_t>& cam_rays1,
+    const std::vector<Y_t>& cam_rays2,
+    std::vector<M_t>* models) const {
+  THROW_CHECK_EQ(cam_rays1.size(), 3);
+  THROW_CHECK_EQ(cam_rays2.size(), 3);
+  THROW_CHECK(models != nullptr);
+
+  models->clear();
+
+  std::vector<Eigen::Vector3d> upright_rays1(3);
+  std::vector<Eigen::Vector3d> upright_rays2(3);
+  for (int i = 0; i < 3; ++i) {
+    upright_rays1[i] = upright1_from_cam1_ * cam_rays1[i];
+    upright_rays2[i] = upright2_from_cam2_ * cam_rays2[i];
+  }
+
+  poselib::CameraPoseVector poses;
+  poselib::relpose_upright_3pt(upright_rays1, upright_rays2, &poses);
+
+  models->reserve(poses.size());
+  for (const poselib::CameraPose& pose : poses) {
+    // Transform the relative pose between the upright frames back into the
+    // camera frames.
+    const Eigen::Matrix3d cam2_from_cam1_rotation =
+        upright2_from_cam2_.transpose() * pose.R() * upright1_from_cam1_;
+    models->push_back(EssentialMatrixFromPose(
+        Rigid3d(Eigen::Quaterniond(cam2_from_cam1_rotation),
+                upright2_from_cam2_.transpose() * pose.t)));
+  }
+}
+
+void EssentialMatrixUprightThreePointEstimator::Residuals(
+    const std::vector<X_t>& cam_rays1,
+    const std::vector<Y_t>& cam_rays2,
+    const M_t& E,
+    std::vector<double>* residuals) {
+  ComputeSquaredSampsonError(cam_rays1, cam_rays2, E, residuals);
+}
+
+void EssentialMatrixUprightThreePointEstimator::Pack(
+    const std::vector<X_t>& cam_rays1,
+    const std::vector<Y_t>& cam_rays2,
+    const std::vector<size_t>& order,
+    Packed_t* packed) {
+  PackCorrespondences(cam_rays1, cam_rays2, order, packed);
+}
+
+void EssentialMatrixUprightThreePointEstimator::Residuals(
+    const Packed_t& packed,
+    const M_t& E,
+    const size_t begin,
+    const size_t end,
+    float* residuals) {
+  ComputeSquaredSampsonError(packed, E, begin, end, residuals);
+}
+
 void EssentialMatrixEightPointEstimator::Estimate(
     const std::vector<X_t>& cam_rays1,
     const std::vector<Y_t>& cam_rays2,
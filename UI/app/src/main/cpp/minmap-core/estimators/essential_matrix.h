@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../estimators/minimal_solver.h"
+#include "../estimators/utils.h"
 #include "../util/types.h"
 
 #include <vector>
@@ -25,18 +27,26 @@ class EssentialMatrixFivePointEstimator {
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 5;
 
+  // The backend of DEFAULT, see minimal_solvers_benchmark.cc.
+  static constexpr MinimalSolverBackend kDefaultBackend =
+      MinimalSolverBackend::POSELIB;
+
+  explicit EssentialMatrixFivePointEstimator(
+      MinimalSolverBackend backend = MinimalSolverBackend::DEFAULT);
+
   // Estimate up to 10 possible essential matrix solutions from a set of
   // corresponding camera rays.
   //
-  //  The number of corresponding rays must be at least 5.
+  //  The number of corresponding rays must be at least 5. Only samples of
+  //  exactly 5 rays are solved by the PoseLib backend.
   //
   // @param cam_rays1  First set of corresponding rays.
   // @param cam_rays2  Second set of corresponding rays.
   //
   // @return           Up to 10 solutions as a vector of 3x3 essential matrices.
-  static void Estimate(const std::vector<X_t>& cam_rays1,
-                       const std::vector<Y_t>& cam_rays2,
-                       std::vector<M_t>* models);
+  void Estimate(const std::vector<X_t>& cam_rays1,
+                const std::vector<Y_t>& cam_rays2,
+                std::vector<M_t>* models) const;
 
   // Calculate the residuals of a set of corresponding rays and a given
   // essential matrix.
@@ -51,6 +61,92 @@ class EssentialMatrixFivePointEstimator {
                         const std::vector<Y_t>& cam_rays2,
                         const M_t& E,
                         std::vector<double>* residuals);
+
+  // The rays in the layout of the vectorized residual kernel.
+  typedef PackedCorrespondences Packed_t;
+
+  // Pack the corresponding rays in the given order of their indices.
+  static void Pack(const std::vector<X_t>& cam_rays1,
+                   const std::vector<Y_t>& cam_rays2,
+                   const std::vector<size_t>& order,
+                   Packed_t* packed);
+
+  // Calculate the residuals of the packed rays in the range
+  // [begin, end) as `Residuals` above, but in single precision.
+  static void Residuals(const Packed_t& packed,
+                        const M_t& E,
+                        size_t begin,
+                        size_t end,
+                        float* residuals);
+
+ private:
+  MinimalSolverBackend backend_;
+};
+
+// Essential matrix estimator from corresponding normalized camera ray pairs
+// with known gravity directions in both cameras, which leave only the rotation
+// about the gravity axis and the translation unknown.
+//
+// This algorithm solves the upright 3-Point problem based on the following
+// paper:
+//
+//    C. Sweeney, J. Flynn, M. Turk, Solving for Relative Pose with a
+//    Partially Known Rotation is a Quadratic Eigenvalue Problem, 3DV 2014.
+class EssentialMatrixUprightThreePointEstimator {
+ public:
+  typedef Eigen::Vector3d X_t;
+  typedef Eigen::Vector3d Y_t;
+  typedef Eigen::Matrix3d M_t;
+
+  // The minimum number of samples needed to estimate a model.
+  static const int kMinNumSamples = 3;
+
+  // @param gravity1  Unit direction of gravity in the first camera frame.
+  // @param gravity2  Unit direction of gravity in the second camera frame.
+  EssentialMatrixUprightThreePointEstimator(const Eigen::Vector3d& gravity1,
+                                            const Eigen::Vector3d& gravity2);
+
+  // Estimate up to 8 possible essential matrix solutions from a set of
+  // corresponding camera rays.
+  //
+  //  The number of corresponding rays must be exactly 3.
+  //
+  // @param cam_rays1  First set of corresponding rays.
+  // @param cam_rays2  Second set of corresponding rays.
+  //
+  // @return           Up to 8 solutions as a vector of 3x3 essential matrices.
+  void Estimate(const std::vector<X_t>& cam_rays1,
+                const std::vector<Y_t>& cam_rays2,
+                std::vector<M_t>* models) const;
+
+  // Calculate the residuals of a set of corresponding rays and a given
+  // essential matrix as the squared Sampson error.
+  static void Residuals(const std::vector<X_t>& cam_rays1,
+                        const std::vector<Y_t>& cam_rays2,
+                        const M_t& E,
+                        std::vector<double>* residuals);
+
+  // The rays in the layout of the vectorized residual kernel.
+  typedef PackedCorrespondences Packed_t;
+
+  // Pack the corresponding rays in the given order of their indices.
+  static void Pack(const std::vector<X_t>& cam_rays1,
+                   const std::vector<Y_t>& cam_rays2,
+                   const std::vector<size_t>& order,
+                   Packed_t* packed);
+
+  // Calculate the residuals of the packed rays in the range
+  // [begin, end) as `Residuals` above, but in single precision.
+  static void Residuals(const Packed_t& packed,
+                        const M_t& E,
+                        size_t begin,
+                        size_t end,
+                        float* residuals);
+
+ private:
+  // Rotations of the camera frames, such that gravity points along +Y.
+  Eigen::Matrix3d upright1_from_cam1_;
+  Eigen::Matrix3d upright2_from_cam2_;
 };
 
 // Essential matrix estimator from corresponding normalized camera ray pairs.
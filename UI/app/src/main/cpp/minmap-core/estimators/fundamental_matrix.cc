@@ -9,22 +9,39 @@
 #include <vector>
 
 #include <PoseLib/alignment.h>
+#include <PoseLib/solvers/relpose_7pt.h>
 #include <Eigen/Geometry>
 #include <Eigen/LU>
 #include <Eigen/SVD>
 
 namespace colmap {
 
+FundamentalMatrixSevenPointEstimator::FundamentalMatrixSevenPointEstimator(
+    const MinimalSolverBackend backend)
+    : backend_(backend == MinimalSolverBackend::DEFAULT ? kDefaultBackend
+                                                         : backend) {}
+
 void FundamentalMatrixSevenPointEstimator::Estimate(
     const std::vector<X_t>& points1,
     const std::vector<Y_t>& points2,
-    std::vector<M_t>* models) {
+    std::vector<M_t>* models) const {
   THROW_CHECK_EQ(points1.size(), 7);
   THROW_CHECK_EQ(points2.size(), 7);
   THROW_CHECK(models != nullptr);
 
   models->clear();
 
+  if (backend_ == MinimalSolverBackend::POSELIB) {
+    std::vector<Eigen::Vector3d> x1(7);
+    std::vector<Eigen::Vector3d> x2(7);
+    for (size_t i = 0; i < 7; ++i) {
+      x1[i] = points1[i].homogeneous();
+      x2[i] = points2[i].homogeneous();
+    }
+    poselib::relpose_7pt(x1, x2, models);
+    return;
+  }
+
   // Setup system of equations: [points2(i,:), 1]' * F * [points1(i,:), 1]'.
   Eigen::Matrix<double, 9, 7> A;
   for (size_t i = 0; i < 7; ++i) {
@@ -92,6 +109,22 @@ void FundamentalMatrixSevenPointEstimator::Residuals(
   ComputeSquaredSampsonError(points1, points2, F, residuals);
 }
 
+void FundamentalMatrixSevenPointEstimator::Pack(
+    const std::vector<X_t>& points1,
+    const std::vector<Y_t>& points2,
+    const std::vector<size_t>& order,
+    Packed_t* packed) {
+  PackCorrespondences(points1, points2, order, packed);
+}
+
+void FundamentalMatrixSevenPointEstimator::Residuals(const Packed_t& packed,
+                                                     const M_t& F,
+                                                     const size_t begin,
+                                                     const size_t end,
+                                                     float* residuals) {
+  ComputeSquaredSampsonError(packed, F, begin, end, residuals);
+}
+
 void FundamentalMatrixEightPointEstimator::Estimate(
     const std::vector<X_t>& points1,
     const std::vector<Y_t>& points2,
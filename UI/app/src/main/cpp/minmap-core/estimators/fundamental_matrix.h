@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../estimators/homography_matrix.h"
+#include "../estimators/minimal_solver.h"
+#include "../estimators/utils.h"
 #include "../util/types.h"
 
 #include <vector>
@@ -27,6 +29,13 @@ class FundamentalMatrixSevenPointEstimator {
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 7;
 
+  // The backend of DEFAULT, see minimal_solvers_benchmark.cc.
+  static constexpr MinimalSolverBackend kDefaultBackend =
+      MinimalSolverBackend::NATIVE;
+
+  explicit FundamentalMatrixSevenPointEstimator(
+      MinimalSolverBackend backend = MinimalSolverBackend::DEFAULT);
+
   // Estimate either 1 or 3 possible fundamental matrix solutions from a set of
   // corresponding points.
   //
@@ -36,9 +45,9 @@ class FundamentalMatrixSevenPointEstimator {
   // @param points2  Second set of corresponding points
   //
   // @return         Up to 4 solutions as a vector of 3x3 fundamental matrices.
-  static void Estimate(const std::vector<X_t>& points1,
-                       const std::vector<Y_t>& points2,
-                       std::vector<M_t>* models);
+  void Estimate(const std::vector<X_t>& points1,
+                const std::vector<Y_t>& points2,
+                std::vector<M_t>* models) const;
 
   // Calculate the residuals of a set of corresponding points and a given
   // fundamental matrix.
@@ -53,6 +62,26 @@ class FundamentalMatrixSevenPointEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& F,
                         std::vector<double>* residuals);
+
+  // The points in the layout of the vectorized residual kernel.
+  typedef PackedCorrespondences Packed_t;
+
+  // Pack the corresponding points in the given order of their indices.
+  static void Pack(const std::vector<X_t>& points1,
+                   const std::vector<Y_t>& points2,
+                   const std::vector<size_t>& order,
+                   Packed_t* packed);
+
+  // Calculate the residuals of the packed points in the range
+  // [begin, end) as `Residuals` above, but in single precision.
+  static void Residuals(const Packed_t& packed,
+                        const M_t& F,
+                        size_t begin,
+                        size_t end,
+                        float* residuals);
+
+ private:
+  MinimalSolverBackend backend_;
 };
 
 // Fundamental matrix estimator from corresponding point pairs.
@@ -1,8 +1,10 @@
 #include "homography_matrix.h"
 
+#include "../math/simd.h"
 #include "../util/logging.h"
 
 #include <PoseLib/alignment.h>
+#include <PoseLib/solvers/homography_4pt.h>
 
 #include <Eigen/Geometry>
 #include <Eigen/LU>
@@ -10,9 +12,14 @@
 
 namespace colmap {
 
+HomographyMatrixEstimator::HomographyMatrixEstimator(
+    const MinimalSolverBackend backend)
+    : backend_(backend == MinimalSolverBackend::DEFAULT ? kDefaultBackend
+                                                         : backend) {}
+
 void HomographyMatrixEstimator::Estimate(const std::vector<X_t>& points1,
                                          const std::vector<Y_t>& points2,
-                                         std::vector<M_t>* models) {
+                                         std::vector<M_t>* models) const {
   THROW_CHECK_EQ(points1.size(), points2.size());
   THROW_CHECK_GE(points1.size(), 4);
   THROW_CHECK(models != nullptr);
@@ -21,6 +28,20 @@ void HomographyMatrixEstimator::Estimate(const std::vector<X_t>& points1,
 
   const size_t num_points = points1.size();
 
+  if (backend_ == MinimalSolverBackend::POSELIB && num_points == 4) {
+    std::vector<Eigen::Vector3d> x1(4);
+    std::vector<Eigen::Vector3d> x2(4);
+    for (size_t i = 0; i < 4; ++i) {
+      x1[i] = points1[i].homogeneous();
+      x2[i] = points2[i].homogeneous();
+    }
+    Eigen::Matrix3d H;
+    if (poselib::homography_4pt(x1, x2, &H, /*check_cheirality=*/true) > 0) {
+      models->push_back(H);
+    }
+    return;
+  }
+
   // Setup constraint matrix.
   Eigen::Matrix<double, Eigen::Dynamic, 9> A(2 * num_points, 9);
   for (size_t i = 0; i < num_points; ++i) {
@@ -102,4 +123,59 @@ void HomographyMatrixEstimator::Residuals(const std::vector<X_t>& points1,
   }
 }
 
+void HomographyMatrixEstimator::Pack(const std::vector<X_t>& points1,
+                                     const std::vector<Y_t>& points2,
+                                     const std::vector<size_t>& order,
+                                     Packed_t* packed) {
+  PackCorrespondences(points1, points2, order, packed);
+}
+
+namespace {
+
+// Squared transformation error for float and Float4, where H is in row-major
+// order.
+template <typename T>
+inline T SquaredTransformationError(
+    const T H[9], const T& s_0, const T& s_1, const T& d_0, const T& d_1) {
+  const T pd_0 = H[0] * s_0 + H[1] * s_1 + H[2];
+  const T pd_1 = H[3] * s_0 + H[4] * s_1 + H[5];
+  const T pd_2 = H[6] * s_0 + H[7] * s_1 + H[8];
+  const T inv_pd_2 = Reciprocal(pd_2);
+  const T dd_0 = d_0 - pd_0 * inv_pd_2;
+  const T dd_1 = d_1 - pd_1 * inv_pd_2;
+  return dd_0 * dd_0 + dd_1 * dd_1;
+}
+
+}  // namespace
+
+void HomographyMatrixEstimator::Residuals(const Packed_t& packed,
+                                          const M_t& H,
+                                          const size_t begin,
+                                          const size_t end,
+                                          float* residuals) {
+  THROW_CHECK_LE(begin, end);
+  THROW_CHECK_LE(end, packed.Size());
+
+  float H_float[9];
+  Float4 H_float4[9];
+  for (int i = 0; i < 9; ++i) {
+    H_float[i] = static_cast<float>(H(i / 3, i % 3));
+    H_float4[i] = Float4::Broadcast(H_float[i]);
+  }
+
+  size_t i = begin;
+  for (; i + Float4::kSize <= end; i += Float4::kSize) {
+    SquaredTransformationError(H_float4,
+                               Float4::Load(&packed.x1[i]),
+                               Float4::Load(&packed.y1[i]),
+                               Float4::Load(&packed.x2[i]),
+                               Float4::Load(&packed.y2[i]))
+        .Store(residuals + i - begin);
+  }
+  for (; i < end; ++i) {
+    residuals[i - begin] = SquaredTransformationError(
+        H_float, packed.x1[i], packed.y1[i], packed.x2[i], packed.y2[i]);
+  }
+}
+
 }  // namespace colmap
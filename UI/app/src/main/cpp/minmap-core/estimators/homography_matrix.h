@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../estimators/minimal_solver.h"
+#include "../estimators/utils.h"
 #include "../util/types.h"
 
 #include <vector>
@@ -21,17 +23,25 @@ class HomographyMatrixEstimator {
   // The minimum number of samples needed to estimate a model.
   static const int kMinNumSamples = 4;
 
+  // The backend of DEFAULT, see minimal_solvers_benchmark.cc.
+  static constexpr MinimalSolverBackend kDefaultBackend =
+      MinimalSolverBackend::NATIVE;
+
+  explicit HomographyMatrixEstimator(
+      MinimalSolverBackend backend = MinimalSolverBackend::DEFAULT);
+
   // Estimate the projective transformation (homography).
   //
-  // The number of corresponding points must be at least 4.
+  // The number of corresponding points must be at least 4. Only samples of
+  // exactly 4 points are solved by the PoseLib backend.
   //
   // @param points1    First set of corresponding points.
   // @param points2    Second set of corresponding points.
   //
   // @return         3x3 homogeneous transformation matrix.
-  static void Estimate(const std::vector<X_t>& points1,
-                       const std::vector<Y_t>& points2,
-                       std::vector<M_t>* models);
+  void Estimate(const std::vector<X_t>& points1,
+                const std::vector<Y_t>& points2,
+                std::vector<M_t>* models) const;
 
   // Calculate the transformation error for each corresponding point pair.
   //
@@ -46,6 +56,26 @@ class HomographyMatrixEstimator {
                         const std::vector<Y_t>& points2,
                         const M_t& H,
                         std::vector<double>* residuals);
+
+  // The points in the layout of the vectorized residual kernel.
+  typedef PackedCorrespondences Packed_t;
+
+  // Pack the corresponding points in the given order of their indices.
+  static void Pack(const std::vector<X_t>& points1,
+                   const std::vector<Y_t>& points2,
+                   const std::vector<size_t>& order,
+                   Packed_t* packed);
+
+  // Calculate the residuals of the packed points in the range
+  // [begin, end) as `Residuals` above, but in single precision.
+  static void Residuals(const Packed_t& packed,
+                        const M_t& H,
+                        size_t begin,
+                        size_t end,
+                        float* residuals);
+
+ private:
+  MinimalSolverBackend backend_;
 };
 
 }  // namespace colmap
@@ -0,0 +1,1281 @@
+#include "local_bundle_adjustment.h"
+
+#include "analytic_cost_functions.h"
+#include "../util/logging.h"
+#include "../util/timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Geometry>
+
+namespace colmap {
+namespace {
+
+constexpr int kPoseSize = 6;
+// The largest number of parameters of the camera models with analytic
+// derivatives, i.e., OpenCV.
+constexpr int kMaxNumCameraParams = 8;
+constexpr int kMaxBlockSize = std::max(kPoseSize, kMaxNumCameraParams);
+
+using Matrix23d = Eigen::Matrix<double, 2, 3>;
+using Matrix26d = Eigen::Matrix<double, 2, kPoseSize>;
+using CameraJacobian = Eigen::Matrix<double, 2, kMaxNumCameraParams>;
+using RowMajorCameraJacobian =
+    Eigen::Matrix<double, 2, kMaxNumCameraParams, Eigen::RowMajor>;
+using BlockMatrix = Eigen::Matrix<double,
+                                  Eigen::Dynamic,
+                                  3,
+                                  Eigen::ColMajor,
+                                  kMaxBlockSize,
+                                  3>;
+
+// Reprojection error of the observation and, if the Jacobians are not null,
+// its derivatives w.r.t. the pose update, the point, and all camera
+// parameters. The pose update is [rotation, translation] with the rotation
+// update left-multiplied to the rotation, such that the derivatives follow
+// directly from the rotated point. Points behind the camera have zero
+// residuals and Jacobians, as in the cost functors.
+template <typename CameraModel>
+void EvaluateReprojError(const Eigen::Matrix3d& cam_from_world_rotation,
+                         const Eigen::Vector3d& cam_from_world_translation,
+                         const double* camera_params,
+                         const Eigen::Vector3d& point3D,
+                         const Eigen::Vector2d& point2D,
+                         Eigen::Vector2d* residual,
+                         Matrix26d* J_pose,
+                         Matrix23d* J_point,
+                         RowMajorCameraJacobian* J_camera) {
+  const Eigen::Vector3d rotated_point3D = cam_from_world_rotation * point3D;
+  const Eigen::Vector3d point3D_in_cam =
+      rotated_point3D + cam_from_world_translation;
+  if (point3D_in_cam.z() < std::numeric_limits<double>::epsilon()) {
+    residual->setZero();
+    if (J_pose) {
+      J_pose->setZero();
+      J_point->setZero();
+      J_camera->setZero();
+    }
+    return;
+  }
+
+  const double inv_z = 1 / point3D_in_cam.z();
+  const double u = point3D_in_cam.x() * inv_z;
+  const double v = point3D_in_cam.y() * inv_z;
+
+  Eigen::Matrix<double, 2, 2, Eigen::RowMajor> J_uv;
+  Eigen::Matrix<double, 2, CameraModel::num_params, Eigen::RowMajor> J_params;
+  AnalyticCameraModel<CameraModel>::ImgFromNormalizedCam(
+      camera_params,
+      u,
+      v,
+      residual->data(),
+      J_pose ? J_uv.data() : nullptr,
+      J_pose ? J_params.data() : nullptr);
+  *residual -= point2D;
+
+  if (!J_pose) {
+    return;
+  }
+
+  J_camera->template leftCols<CameraModel::num_params>() = J_params;
+
+  Matrix23d J_uv_cam;
+  J_uv_cam << inv_z, 0, -u * inv_z, 0, inv_z, -v * inv_z;
+  const Matrix23d J_cam = J_uv * J_uv_cam;
+  J_pose->leftCols<3>().noalias() =
+      -J_cam * CrossProductMatrix(rotated_point3D);
+  J_pose->rightCols<3>() = J_cam;
+  J_point->noalias() = J_cam * cam_from_world_rotation;
+}
+
+using EvaluateReprojErrorFn = void (*)(const Eigen::Matrix3d&,
+                                       const Eigen::Vector3d&,
+                                       const double*,
+                                       const Eigen::Vector3d&,
+                                       const Eigen::Vector2d&,
+                                       Eigen::Vector2d*,
+                                       Matrix26d*,
+                                       Matrix23d*,
+                                       RowMajorCameraJacobian*);
+
+// Returns null if the camera model has no analytic derivatives.
+EvaluateReprojErrorFn GetEvaluateReprojErrorFn(const CameraModelId model_id) {
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                               \
+  case CameraModel::model_id:                                        \
+    if constexpr (AnalyticCameraModel<CameraModel>::kSupported &&    \
+                  CameraModel::num_params <= kMaxNumCameraParams) {  \
+      return &EvaluateReprojError<CameraModel>;                      \
+    } else {                                                         \
+      return nullptr;                                                \
+    }
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+  return nullptr;
+}
+
+// Scaling of the residuals and Jacobians that turns the robustified least
+// squares problem into a plain one, see ceres/internal/corrector.h.
+class RobustCorrector {
+ public:
+  RobustCorrector(const double sq_norm, const double rho[3]) {
+    sqrt_rho1_ = std::sqrt(rho[1]);
+    if (sq_norm == 0 || rho[2] <= 0) {
+      residual_scaling_ = sqrt_rho1_;
+      alpha_sq_norm_ = 0;
+      return;
+    }
+    const double alpha = 1 - std::sqrt(1 + 2 * sq_norm * rho[2] / rho[1]);
+    residual_scaling_ = sqrt_rho1_ / (1 - alpha);
+    alpha_sq_norm_ = alpha / sq_norm;
+  }
+
+  // Must be called before the residual is corrected.
+  template <typename Derived>
+  void CorrectJacobian(const Eigen::Vector2d& residual,
+                       Eigen::MatrixBase<Derived>& jacobian) const {
+    if (alpha_sq_norm_ == 0) {
+      jacobian *= sqrt_rho1_;
+    } else {
+      jacobian = sqrt_rho1_ * (jacobian - alpha_sq_norm_ * residual *
+                                             (residual.transpose() * jacobian));
+    }
+  }
+
+  void CorrectResidual(Eigen::Vector2d* residual) const {
+    *residual *= residual_scaling_;
+  }
+
+ private:
+  double sqrt_rho1_;
+  double residual_scaling_;
+  double alpha_sq_norm_;
+};
+
+}  // namespace
+
+// The parameter blocks and residuals of a local bundle adjustment and the
+// Levenberg-Marquardt solver of the problem. The problem is updated in place
+// for the config of the next local bundle adjustment: the residuals of points
+// whose observations in the problem did not change are kept, such that only
+// the residuals of new, changed, and removed points are added and removed.
+class LocalBundleAdjustmentProblem {
+ public:
+  // Update the problem to the config. Returns false if the problem is not
+  // supported, in which case the problem is cleared.
+  bool Update(const BundleAdjustmentOptions& options,
+              const BundleAdjustmentConfig& config,
+              Reconstruction& reconstruction);
+
+  void Clear();
+
+  ceres::Solver::Summary Solve(const BundleAdjustmentOptions& options,
+                               const ceres::LossFunction& loss_function);
+
+ private:
+  struct PoseBlock {
+    image_t image_id = kInvalidImageId;
+    Rigid3d cam_from_world;
+    Eigen::Matrix3d rotation_matrix;
+    // The pose in the reconstruction, null if the pose is constant.
+    Rigid3d* rig_from_world = nullptr;
+    // Offset in the reduced camera system, -1 if the pose is constant.
+    int offset = -1;
+    // The update in which the pose was last part of the problem.
+    size_t generation = 0;
+  };
+
+  struct CameraBlock {
+    Camera* camera = nullptr;
+    std::vector<double> params;
+    EvaluateReprojErrorFn evaluate = nullptr;
+    std::vector<int> variable_param_idxs;
+    // Offset in the reduced camera system, -1 if the camera is constant.
+    int offset = -1;
+    size_t generation = 0;
+  };
+
+  struct Observation {
+    image_t image_id = kInvalidImageId;
+    point2D_t point2D_idx = kInvalidPoint2DIdx;
+    int pose_idx = -1;
+    int camera_idx = -1;
+    Eigen::Vector2d point2D;
+
+    // The robustified residual and Jacobians of the last linearization.
+    Eigen::Vector2d residual;
+    Matrix26d J_pose;
+    CameraJacobian J_camera;
+    Matrix23d J_point;
+  };
+
+  struct PointBlock {
+    point3D_t point3D_id = kInvalidPoint3DId;
+    // The point in the reconstruction, null if the point is constant.
+    Point3D* point3D = nullptr;
+    // The observations of the point in the problem, in the order of its track.
+    std::vector<Observation> observations;
+    size_t generation = 0;
+  };
+
+  // Parameter update of a step, in the order of the blocks.
+  struct Step {
+    Eigen::VectorXd cameras;
+    std::vector<Eigen::Vector3d> points;
+  };
+
+  static bool IsSupported(const BundleAdjustmentOptions& options,
+                          const BundleAdjustmentConfig& config,
+                          const Reconstruction& reconstruction);
+
+  // Add the block to the current update of the problem or update its values
+  // from the reconstruction, if it was part of a previous update. Returns the
+  // index of the block, or -1 if the camera model is not supported.
+  int UpdatePose(Image& image, bool constant);
+  int UpdateCamera(Camera& camera,
+                   bool constant,
+                   const BundleAdjustmentOptions& options);
+  bool UpdatePoint(point3D_t point3D_id,
+                   const BundleAdjustmentOptions& options,
+                   const BundleAdjustmentConfig& config,
+                   Reconstruction& reconstruction);
+
+  // Remove the blocks that are not part of the current update and assign the
+  // offsets of the variable blocks in the reduced camera system.
+  void RemoveUnusedBlocks();
+  void AssignOffsets();
+
+  void FixGaugeWithThreePoints();
+
+  double EvaluateCost(const std::vector<PoseBlock>& poses,
+                      const std::vector<CameraBlock>& cameras,
+                      const std::vector<Eigen::Vector3d>& point_xyz,
+                      const ceres::LossFunction& loss_function) const;
+
+  // Evaluate the robustified residuals and Jacobians at the current
+  // parameters and build the normal equations of the reduced camera system.
+  // Returns the cost.
+  double Linearize(const ceres::LossFunction& loss_function);
+
+  // Compute the Levenberg-Marquardt step for the given damping by eliminating
+  // the points. Returns false if the reduced camera system is not positive
+  // definite.
+  bool ComputeStep(const ceres::Solver::Options& solver_options,
+                   double mu,
+                   Step* step);
+
+  // Predicted decrease of the cost of the linearized problem for the step.
+  double ModelCostChange(const Step& step) const;
+
+  void ApplyStep(const Step& step);
+  void WriteParameters();
+
+  size_t generation_ = 0;
+
+  std::vector<PoseBlock> poses_;
+  std::vector<int> free_pose_idxs_;
+  std::unordered_map<image_t, int> image_to_pose_idx_;
+  std::vector<CameraBlock> cameras_;
+  std::unordered_map<camera_t, int> camera_to_camera_idx_;
+  std::vector<PointBlock> points_;
+  std::vector<Eigen::Vector3d> point_xyz_;
+  std::unordered_map<point3D_t, int> point3D_to_point_idx_;
+  int num_camera_params_ = 0;
+  size_t num_residual_blocks_ = 0;
+
+  // Candidate parameters of the current step.
+  std::vector<PoseBlock> candidate_poses_;
+  std::vector<CameraBlock> candidate_cameras_;
+  std::vector<Eigen::Vector3d> candidate_point_xyz_;
+
+  // Normal equations of the last linearization.
+  Eigen::MatrixXd U_;
+  Eigen::VectorXd g_cameras_;
+  std::vector<Eigen::Matrix3d> V_;
+  std::vector<Eigen::Vector3d> g_points_;
+  double gradient_max_norm_ = 0;
+
+  // Jacobi scaling of the parameters, as in Ceres, which keeps the reduced
+  // camera system well conditioned for parameters of different magnitudes,
+  // e.g., focal lengths and rotations.
+  Eigen::VectorXd camera_scale_;
+  std::vector<Eigen::Vector3d> point_scale_;
+
+  // Reusable storage of the point elimination.
+  Eigen::MatrixXd S_;
+  Eigen::VectorXd rhs_;
+  std::vector<Eigen::Matrix3d> V_inv_;
+};
+
+bool LocalBundleAdjustmentProblem::IsSupported(
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentConfig& config,
+    const Reconstruction& reconstruction) {
+  if (config.FixedGauge() == BundleAdjustmentGauge::TWO_CAMS_FROM_WORLD) {
+    return false;
+  }
+
+  size_t num_variable_frames = 0;
+  for (const image_t image_id : config.Images()) {
+    const Image& image = reconstruction.Image(image_id);
+    if (!image.HasTrivialFrame() ||
+        GetEvaluateReprojErrorFn(image.CameraPtr()->model_id) == nullptr) {
+      return false;
+    }
+    if (options.refine_rig_from_world &&
+        !config.HasConstantRigFromWorldPose(image.FrameId())) {
+      ++num_variable_frames;
+    }
+  }
+  return num_variable_frames <=
+         static_cast<size_t>(options.max_num_frames_local_solver);
+}
+
+bool LocalBundleAdjustmentProblem::Update(
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentConfig& config,
+    Reconstruction& reconstruction) {
+  // Check the support before normalizing any poses of the reconstruction.
+  if (!IsSupported(options, config, reconstruction)) {
+    Clear();
+    return false;
+  }
+
+  generation_ += 1;
+
+  const bool constant_cameras = !options.refine_focal_length &&
+                                !options.refine_principal_point &&
+                                !options.refine_extra_params;
+  for (const image_t image_id : config.Images()) {
+    Image& image = reconstruction.Image(image_id);
+    if (image.NumPoints3D() == 0) {
+      continue;
+    }
+    UpdatePose(image,
+               !options.refine_rig_from_world ||
+                   config.HasConstantRigFromWorldPose(image.FrameId()));
+    Camera& camera = *image.CameraPtr();
+    UpdateCamera(
+        camera,
+        constant_cameras || config.HasConstantCamIntrinsics(camera.camera_id),
+        options);
+  }
+
+  // The observations of the adjusted images and the observations of the
+  // configured points in other images, as in the default bundle adjuster.
+  for (const image_t image_id : config.Images()) {
+    for (const Point2D& point2D : reconstruction.Image(image_id).Points2D()) {
+      if (point2D.HasPoint3D() &&
+          !UpdatePoint(point2D.point3D_id, options, config, reconstruction)) {
+        Clear();
+        return false;
+      }
+    }
+  }
+  for (const auto* point3D_ids :
+       {&config.VariablePoints(), &config.ConstantPoints()}) {
+    for (const point3D_t point3D_id : *point3D_ids) {
+      if (!UpdatePoint(point3D_id, options, config, reconstruction)) {
+        Clear();
+        return false;
+      }
+    }
+  }
+
+  RemoveUnusedBlocks();
+  AssignOffsets();
+
+  switch (config.FixedGauge()) {
+    case BundleAdjustmentGauge::UNSPECIFIED:
+      break;
+    case BundleAdjustmentGauge::THREE_POINTS:
+      FixGaugeWithThreePoints();
+      break;
+    default:
+      LOG(MM_FATAL) << "Unsupported BundleAdjustmentGauge";
+  }
+
+  return true;
+}
+
+void LocalBundleAdjustmentProblem::Clear() {
+  poses_.clear();
+  free_pose_idxs_.clear();
+  image_to_pose_idx_.clear();
+  cameras_.clear();
+  camera_to_camera_idx_.clear();
+  points_.clear();
+  point_xyz_.clear();
+  point3D_to_point_idx_.clear();
+  num_camera_params_ = 0;
+  num_residual_blocks_ = 0;
+}
+
+int LocalBundleAdjustmentProblem::UpdatePose(Image& image,
+                                             const bool constant) {
+  const auto [it, inserted] = image_to_pose_idx_.emplace(image.ImageId(), -1);
+  if (inserted) {
+    if (free_pose_idxs_.empty()) {
+      it->second = static_cast<int>(poses_.size());
+      poses_.emplace_back();
+    } else {
+      it->second = free_pose_idxs_.back();
+      free_pose_idxs_.pop_back();
+    }
+  }
+
+  PoseBlock& pose = poses_[it->second];
+  if (pose.generation == generation_) {
+    return it->second;
+  }
+  pose.generation = generation_;
+  pose.image_id = image.ImageId();
+  pose.rig_from_world = nullptr;
+
+  Rigid3d& rig_from_world = image.FramePtr()->RigFromWorld();
+  if (image.HasTrivialFrame()) {
+    // The cost functions assume unit quaternions.
+    rig_from_world.rotation.normalize();
+    pose.cam_from_world = rig_from_world;
+    if (!constant) {
+      pose.rig_from_world = &rig_from_world;
+    }
+  } else {
+    // The images of non-trivial frames are only supported as constant
+    // observations of the adjusted points, as in the default bundle adjuster.
+    THROW_CHECK(constant);
+    pose.cam_from_world = image.CamFromWorld();
+  }
+  pose.rotation_matrix = pose.cam_from_world.rotation.toRotationMatrix();
+
+  return it->second;
+}
+
+int LocalBundleAdjustmentProblem::UpdateCamera(
+    Camera& camera,
+    const bool constant,
+    const BundleAdjustmentOptions& options) {
+  const auto [it, inserted] = camera_to_camera_idx_.emplace(
+      camera.camera_id, static_cast<int>(cameras_.size()));
+  if (inserted) {
+    cameras_.emplace_back();
+  }
+
+  CameraBlock& camera_block = cameras_[it->second];
+  if (camera_block.generation == generation_) {
+    return it->second;
+  }
+  camera_block.evaluate = GetEvaluateReprojErrorFn(camera.model_id);
+  if (camera_block.evaluate == nullptr) {
+    return -1;
+  }
+  camera_block.generation = generation_;
+  camera_block.camera = &camera;
+  camera_block.params = camera.params;
+
+  camera_block.variable_param_idxs.clear();
+  if (!constant) {
+    const auto add_param_idxs = [&camera_block](const span<const size_t> idxs) {
+      camera_block.variable_param_idxs.insert(
+          camera_block.variable_param_idxs.end(), idxs.begin(), idxs.end());
+    };
+    if (options.refine_focal_length) {
+      add_param_idxs(camera.FocalLengthIdxs());
+    }
+    if (options.refine_principal_point) {
+      add_param_idxs(camera.PrincipalPointIdxs());
+    }
+    if (options.refine_extra_params) {
+      add_param_idxs(camera.ExtraParamsIdxs());
+    }
+    std::sort(camera_block.variable_param_idxs.begin(),
+              camera_block.variable_param_idxs.end());
+  }
+
+  return it->second;
+}
+
+bool LocalBundleAdjustmentProblem::UpdatePoint(
+    const point3D_t point3D_id,
+    const BundleAdjustmentOptions& options,
+    const BundleAdjustmentConfig& config,
+    Reconstruction& reconstruction) {
+  const auto [it, inserted] = point3D_to_point_idx_.emplace(
+      point3D_id, static_cast<int>(points_.size()));
+  if (inserted) {
+    points_.emplace_back();
+    points_.back().point3D_id = point3D_id;
+    point_xyz_.emplace_back();
+  }
+
+  PointBlock& point = points_[it->second];
+  if (point.generation == generation_) {
+    return true;
+  }
+  point.generation = generation_;
+
+  Point3D& point3D = reconstruction.Point3D(point3D_id);
+  THROW_CHECK_GT(point3D.track.Length(), 1);
+
+  // All observations of the configured points are in the problem, otherwise
+  // only the observations in the adjusted images.
+  const bool has_all_observations = config.HasVariablePoint(point3D_id) ||
+                                    config.HasConstantPoint(point3D_id);
+  const auto is_in_problem = [&](const TrackElement& track_el) {
+    return has_all_observations || config.HasImage(track_el.image_id);
+  };
+
+  // Keep the residuals, if the observations in the problem did not change.
+  size_t num_unchanged_observations = 0;
+  for (const TrackElement& track_el : point3D.track.Elements()) {
+    if (!is_in_problem(track_el)) {
+      continue;
+    }
+    if (num_unchanged_observations == point.observations.size()) {
+      num_unchanged_observations = 0;
+      break;
+    }
+    const Observation& observation =
+        point.observations[num_unchanged_observations];
+    if (observation.image_id != track_el.image_id ||
+        observation.point2D_idx != track_el.point2D_idx) {
+      num_unchanged_observations = 0;
+      break;
+    }
+    num_unchanged_observations += 1;
+  }
+
+  if (num_unchanged_observations != point.observations.size() ||
+      point.observations.empty()) {
+    point.observations.clear();
+    for (const TrackElement& track_el : point3D.track.Elements()) {
+      if (is_in_problem(track_el)) {
+        Observation& observation = point.observations.emplace_back();
+        observation.image_id = track_el.image_id;
+        observation.point2D_idx = track_el.point2D_idx;
+        observation.point2D = reconstruction.Image(track_el.image_id)
+                                  .Point2D(track_el.point2D_idx)
+                                  .xy;
+      }
+    }
+  }
+
+  // The poses and cameras of the adjusted images are already part of the
+  // update. The other images are constant observations and do not optimize
+  // the intrinsics of their cameras.
+  for (Observation& observation : point.observations) {
+    if (observation.pose_idx != -1 &&
+        poses_[observation.pose_idx].generation == generation_ &&
+        cameras_[observation.camera_idx].generation == generation_) {
+      continue;
+    }
+    Image& image = reconstruction.Image(observation.image_id);
+    observation.pose_idx = UpdatePose(image, /*constant=*/true);
+    observation.camera_idx =
+        UpdateCamera(*image.CameraPtr(), /*constant=*/true, options);
+    if (observation.camera_idx == -1) {
+      return false;
+    }
+  }
+
+  point_xyz_[it->second] = point3D.xyz;
+  // Points with observations outside of the problem are constant.
+  if (point3D.track.Length() <= point.observations.size() &&
+      !config.HasConstantPoint(point3D_id)) {
+    point.point3D = &point3D;
+  } else {
+    point.point3D = nullptr;
+  }
+
+  return true;
+}
+
+void LocalBundleAdjustmentProblem::RemoveUnusedBlocks() {
+  for (size_t pose_idx = 0; pose_idx < poses_.size(); ++pose_idx) {
+    PoseBlock& pose = poses_[pose_idx];
+    if (pose.generation != generation_ && pose.image_id != kInvalidImageId) {
+      image_to_pose_idx_.erase(pose.image_id);
+      pose.image_id = kInvalidImageId;
+      pose.rig_from_world = nullptr;
+      free_pose_idxs_.push_back(static_cast<int>(pose_idx));
+    }
+  }
+
+  for (CameraBlock& camera : cameras_) {
+    if (camera.generation != generation_) {
+      camera.camera = nullptr;
+      camera.variable_param_idxs.clear();
+    }
+  }
+
+  size_t point_idx = 0;
+  while (point_idx < points_.size()) {
+    if (points_[point_idx].generation == generation_) {
+      ++point_idx;
+      continue;
+    }
+    point3D_to_point_idx_.erase(points_[point_idx].point3D_id);
+    if (point_idx + 1 != points_.size()) {
+      points_[point_idx] = std::move(points_.back());
+      point_xyz_[point_idx] = point_xyz_.back();
+      point3D_to_point_idx_[points_[point_idx].point3D_id] =
+          static_cast<int>(point_idx);
+    }
+    points_.pop_back();
+    point_xyz_.pop_back();
+  }
+
+  num_residual_blocks_ = 0;
+  for (const PointBlock& point : points_) {
+    num_residual_blocks_ += point.observations.size();
+  }
+}
+
+void LocalBundleAdjustmentProblem::AssignOffsets() {
+  num_camera_params_ = 0;
+  for (PoseBlock& pose : poses_) {
+    pose.offset = -1;
+    if (pose.generation == generation_ && pose.rig_from_world != nullptr) {
+      pose.offset = num_camera_params_;
+      num_camera_params_ += kPoseSize;
+    }
+  }
+  for (CameraBlock& camera : cameras_) {
+    camera.offset = -1;
+    if (camera.generation == generation_ &&
+        !camera.variable_param_idxs.empty()) {
+      camera.offset = num_camera_params_;
+      num_camera_params_ += static_cast<int>(camera.variable_param_idxs.size());
+    }
+  }
+}
+
+void LocalBundleAdjustmentProblem::FixGaugeWithThreePoints() {
+  int num_fixed_points = 0;
+  Eigen::Matrix3d fixed_points = Eigen::Matrix3d::Zero();
+  const auto maybe_add_fixed_point = [&](const Eigen::Vector3d& xyz) {
+    fixed_points.col(num_fixed_points) = xyz;
+    if (fixed_points.colPivHouseholderQr().rank() > num_fixed_points) {
+      ++num_fixed_points;
+      return true;
+    }
+    fixed_points.col(num_fixed_points).setZero();
+    return false;
+  };
+
+  // First check if there are enough constant points in the problem.
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    if (points_[point_idx].point3D == nullptr &&
+        maybe_add_fixed_point(point_xyz_[point_idx]) &&
+        num_fixed_points >= 3) {
+      return;
+    }
+  }
+
+  // Otherwise, fix sufficient variable points.
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    PointBlock& point = points_[point_idx];
+    if (point.point3D != nullptr &&
+        maybe_add_fixed_point(point_xyz_[point_idx])) {
+      point.point3D = nullptr;
+      if (num_fixed_points >= 3) {
+        return;
+      }
+    }
+  }
+
+  LOG(MM_WARNING)
+      << "Failed to fix Gauge due to insufficient number of fixed points: "
+      << num_fixed_points;
+}
+
+double LocalBundleAdjustmentProblem::EvaluateCost(
+    const std::vector<PoseBlock>& poses,
+    const std::vector<CameraBlock>& cameras,
+    const std::vector<Eigen::Vector3d>& point_xyz,
+    const ceres::LossFunction& loss_function) const {
+  double cost = 0;
+  Eigen::Vector2d residual;
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    for (const Observation& observation : points_[point_idx].observations) {
+      const PoseBlock& pose = poses[observation.pose_idx];
+      const CameraBlock& camera = cameras[observation.camera_idx];
+      camera.evaluate(pose.rotation_matrix,
+                      pose.cam_from_world.translation,
+                      camera.params.data(),
+                      point_xyz[point_idx],
+                      observation.point2D,
+                      &residual,
+                      nullptr,
+                      nullptr,
+                      nullptr);
+      double rho[3];
+      loss_function.Evaluate(residual.squaredNorm(), rho);
+      cost += rho[0];
+    }
+  }
+  return 0.5 * cost;
+}
+
+double LocalBundleAdjustmentProblem::Linearize(
+    const ceres::LossFunction& loss_function) {
+  U_.setZero(num_camera_params_, num_camera_params_);
+  g_cameras_.setZero(num_camera_params_);
+  V_.assign(points_.size(), Eigen::Matrix3d::Zero());
+  g_points_.assign(points_.size(), Eigen::Vector3d::Zero());
+
+  double cost = 0;
+  RowMajorCameraJacobian J_camera;
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    PointBlock& point = points_[point_idx];
+    for (Observation& observation : point.observations) {
+      const PoseBlock& pose = poses_[observation.pose_idx];
+      const CameraBlock& camera = cameras_[observation.camera_idx];
+      camera.evaluate(pose.rotation_matrix,
+                      pose.cam_from_world.translation,
+                      camera.params.data(),
+                      point_xyz_[point_idx],
+                      observation.point2D,
+                      &observation.residual,
+                      &observation.J_pose,
+                      &observation.J_point,
+                      &J_camera);
+
+      // Select the refined camera parameters.
+      const int num_variable_params =
+          static_cast<int>(camera.variable_param_idxs.size());
+      for (int i = 0; i < num_variable_params; ++i) {
+        observation.J_camera.col(i) =
+            J_camera.col(camera.variable_param_idxs[i]);
+      }
+
+      const double sq_norm = observation.residual.squaredNorm();
+      double rho[3];
+      loss_function.Evaluate(sq_norm, rho);
+      cost += rho[0];
+
+      const RobustCorrector corrector(sq_norm, rho);
+      corrector.CorrectJacobian(observation.residual, observation.J_pose);
+      auto J_variable_camera =
+          observation.J_camera.leftCols(num_variable_params);
+      corrector.CorrectJacobian(observation.residual, J_variable_camera);
+      corrector.CorrectJacobian(observation.residual, observation.J_point);
+      corrector.CorrectResidual(&observation.residual);
+
+      if (pose.offset != -1) {
+        U_.block<kPoseSize, kPoseSize>(pose.offset, pose.offset).noalias() +=
+            observation.J_pose.transpose() * observation.J_pose;
+        g_cameras_.segment<kPoseSize>(pose.offset).noalias() -=
+            observation.J_pose.transpose() * observation.residual;
+      }
+      if (camera.offset != -1) {
+        U_.block(camera.offset,
+                 camera.offset,
+                 num_variable_params,
+                 num_variable_params)
+            .noalias() += J_variable_camera.transpose() * J_variable_camera;
+        g_cameras_.segment(camera.offset, num_variable_params).noalias() -=
+            J_variable_camera.transpose() * observation.residual;
+      }
+      if (pose.offset != -1 && camera.offset != -1) {
+        U_.block(pose.offset, camera.offset, kPoseSize, num_variable_params)
+            .noalias() += observation.J_pose.transpose() * J_variable_camera;
+        U_.block(camera.offset, pose.offset, num_variable_params, kPoseSize) =
+            U_.block(pose.offset, camera.offset, kPoseSize, num_variable_params)
+                .transpose();
+      }
+      if (point.point3D != nullptr) {
+        V_[point_idx].noalias() +=
+            observation.J_point.transpose() * observation.J_point;
+        g_points_[point_idx].noalias() -=
+            observation.J_point.transpose() * observation.residual;
+      }
+    }
+  }
+
+  gradient_max_norm_ = g_cameras_.size() > 0 ? g_cameras_.cwiseAbs().maxCoeff()
+                                             : 0;
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    if (points_[point_idx].point3D != nullptr) {
+      gradient_max_norm_ = std::max(gradient_max_norm_,
+                                    g_points_[point_idx].cwiseAbs().maxCoeff());
+    }
+  }
+
+  const auto jacobi_scale = [](const auto& diagonal) {
+    return (1 + diagonal.array().sqrt()).inverse().matrix();
+  };
+  camera_scale_ = jacobi_scale(U_.diagonal());
+  point_scale_.resize(points_.size());
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    point_scale_[point_idx] = jacobi_scale(V_[point_idx].diagonal());
+  }
+
+  return 0.5 * cost;
+}
+
+bool LocalBundleAdjustmentProblem::ComputeStep(
+    const ceres::Solver::Options& solver_options,
+    const double mu,
+    Step* step) {
+  const double min_diagonal = solver_options.min_lm_diagonal;
+  const double max_diagonal = solver_options.max_lm_diagonal;
+  const auto damp = [&](auto& matrix) {
+    for (Eigen::Index i = 0; i < matrix.rows(); ++i) {
+      matrix(i, i) += mu * std::clamp(matrix(i, i), min_diagonal, max_diagonal);
+    }
+  };
+
+  // The system is solved for the Jacobi scaled parameters.
+  S_.noalias() =
+      camera_scale_.asDiagonal() * U_ * camera_scale_.asDiagonal();
+  damp(S_);
+  rhs_ = camera_scale_.cwiseProduct(g_cameras_);
+
+  // Per point, the blocks W = J_cameras^T J_point of the camera parameters
+  // observing the point. Observations of the same camera share a block.
+  struct WBlock {
+    int offset;
+    int size;
+    BlockMatrix W;
+  };
+  std::vector<WBlock> W_blocks;
+  const auto add_W_block = [&W_blocks](const int offset,
+                                       const int size,
+                                       const auto& W) {
+    for (WBlock& W_block : W_blocks) {
+      if (W_block.offset == offset) {
+        W_block.W.noalias() += W;
+        return;
+      }
+    }
+    W_blocks.push_back({offset, size, W});
+  };
+
+  V_inv_.resize(points_.size());
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    const PointBlock& point = points_[point_idx];
+    if (point.point3D == nullptr) {
+      continue;
+    }
+
+    const Eigen::DiagonalMatrix<double, 3> point_scale(point_scale_[point_idx]);
+    Eigen::Matrix3d V = point_scale * V_[point_idx] * point_scale;
+    damp(V);
+    bool invertible = false;
+    V.computeInverseWithCheck(V_inv_[point_idx], invertible);
+    if (!invertible) {
+      return false;
+    }
+    const Eigen::Matrix3d& V_inv = V_inv_[point_idx];
+
+    W_blocks.clear();
+    for (const Observation& observation : point.observations) {
+      const PoseBlock& pose = poses_[observation.pose_idx];
+      const CameraBlock& camera = cameras_[observation.camera_idx];
+      if (pose.offset != -1) {
+        add_W_block(pose.offset,
+                    kPoseSize,
+                    observation.J_pose.transpose() * observation.J_point);
+      }
+      if (camera.offset != -1) {
+        const int num_variable_params =
+            static_cast<int>(camera.variable_param_idxs.size());
+        add_W_block(camera.offset,
+                    num_variable_params,
+                    observation.J_camera.leftCols(num_variable_params)
+                            .transpose() *
+                        observation.J_point);
+      }
+    }
+
+    // S -= W V^-1 W^T and rhs -= W V^-1 g_point.
+    for (WBlock& W_block : W_blocks) {
+      W_block.W = camera_scale_.segment(W_block.offset, W_block.size)
+                      .asDiagonal() *
+                  W_block.W * point_scale;
+    }
+    const Eigen::Vector3d V_inv_g =
+        V_inv * point_scale_[point_idx].cwiseProduct(g_points_[point_idx]);
+    for (const WBlock& W_block1 : W_blocks) {
+      const BlockMatrix W_V_inv = W_block1.W * V_inv;
+      rhs_.segment(W_block1.offset, W_block1.size).noalias() -=
+          W_block1.W * V_inv_g;
+      for (const WBlock& W_block2 : W_blocks) {
+        S_.block(W_block1.offset, W_block2.offset, W_block1.size, W_block2.size)
+            .noalias() -= W_V_inv * W_block2.W.transpose();
+      }
+    }
+  }
+
+  step->cameras.resize(num_camera_params_);
+  if (num_camera_params_ > 0) {
+    const Eigen::LLT<Eigen::MatrixXd> llt(S_);
+    if (llt.info() != Eigen::Success) {
+      return false;
+    }
+    step->cameras = camera_scale_.cwiseProduct(llt.solve(rhs_));
+  }
+
+  // Back-substitute the point updates.
+  step->points.resize(points_.size());
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    const PointBlock& point = points_[point_idx];
+    if (point.point3D == nullptr) {
+      step->points[point_idx].setZero();
+      continue;
+    }
+    Eigen::Vector3d rhs = g_points_[point_idx];
+    for (const Observation& observation : point.observations) {
+      const PoseBlock& pose = poses_[observation.pose_idx];
+      const CameraBlock& camera = cameras_[observation.camera_idx];
+      if (pose.offset != -1) {
+        rhs.noalias() -= observation.J_point.transpose() *
+                         (observation.J_pose *
+                          step->cameras.segment<kPoseSize>(pose.offset));
+      }
+      if (camera.offset != -1) {
+        const int num_variable_params =
+            static_cast<int>(camera.variable_param_idxs.size());
+        rhs.noalias() -=
+            observation.J_point.transpose() *
+            (observation.J_camera.leftCols(num_variable_params) *
+             step->cameras.segment(camera.offset, num_variable_params));
+      }
+    }
+    step->points[point_idx] = point_scale_[point_idx].cwiseProduct(
+        V_inv_[point_idx] * point_scale_[point_idx].cwiseProduct(rhs));
+  }
+
+  return step->cameras.allFinite();
+}
+
+double LocalBundleAdjustmentProblem::ModelCostChange(const Step& step) const {
+  double model_cost_change = 0;
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    const PointBlock& point = points_[point_idx];
+    for (const Observation& observation : point.observations) {
+      const PoseBlock& pose = poses_[observation.pose_idx];
+      const CameraBlock& camera = cameras_[observation.camera_idx];
+      Eigen::Vector2d J_step = Eigen::Vector2d::Zero();
+      if (pose.offset != -1) {
+        J_step.noalias() +=
+            observation.J_pose * step.cameras.segment<kPoseSize>(pose.offset);
+      }
+      if (camera.offset != -1) {
+        const int num_variable_params =
+            static_cast<int>(camera.variable_param_idxs.size());
+        J_step.noalias() +=
+            observation.J_camera.leftCols(num_variable_params) *
+            step.cameras.segment(camera.offset, num_variable_params);
+      }
+      if (point.point3D != nullptr) {
+        J_step.noalias() += observation.J_point * step.points[point_idx];
+      }
+      model_cost_change -= J_step.dot(observation.residual + 0.5 * J_step);
+    }
+  }
+  return model_cost_change;
+}
+
+void LocalBundleAdjustmentProblem::ApplyStep(const Step& step) {
+  candidate_poses_ = poses_;
+  candidate_cameras_ = cameras_;
+  candidate_point_xyz_ = point_xyz_;
+
+  for (PoseBlock& pose : candidate_poses_) {
+    if (pose.offset == -1) {
+      continue;
+    }
+    const Eigen::Vector3d rotation_step =
+        step.cameras.segment<3>(pose.offset);
+    const double angle = rotation_step.norm();
+    if (angle > 0) {
+      pose.cam_from_world.rotation =
+          (Eigen::Quaterniond(Eigen::AngleAxisd(angle, rotation_step / angle)) *
+           pose.cam_from_world.rotation)
+              .normalized();
+    }
+    pose.cam_from_world.translation += step.cameras.segment<3>(pose.offset + 3);
+    pose.rotation_matrix = pose.cam_from_world.rotation.toRotationMatrix();
+  }
+
+  for (CameraBlock& camera : candidate_cameras_) {
+    if (camera.offset == -1) {
+      continue;
+    }
+    for (size_t i = 0; i < camera.variable_param_idxs.size(); ++i) {
+      camera.params[camera.variable_param_idxs[i]] +=
+          step.cameras(camera.offset + i);
+    }
+  }
+
+  for (size_t point_idx = 0; point_idx < candidate_point_xyz_.size();
+       ++point_idx) {
+    candidate_point_xyz_[point_idx] += step.points[point_idx];
+  }
+}
+
+void LocalBundleAdjustmentProblem::WriteParameters() {
+  for (const PoseBlock& pose : poses_) {
+    if (pose.offset != -1) {
+      *pose.rig_from_world = pose.cam_from_world;
+    }
+  }
+  for (const CameraBlock& camera : cameras_) {
+    if (camera.offset != -1) {
+      camera.camera->params = camera.params;
+    }
+  }
+  for (size_t point_idx = 0; point_idx < points_.size(); ++point_idx) {
+    if (points_[point_idx].point3D != nullptr) {
+      points_[point_idx].point3D->xyz = point_xyz_[point_idx];
+    }
+  }
+}
+
+ceres::Solver::Summary LocalBundleAdjustmentProblem::Solve(
+    const BundleAdjustmentOptions& options,
+    const ceres::LossFunction& loss_function) {
+  ceres::Solver::Summary summary;
+  if (num_residual_blocks_ == 0) {
+    return summary;
+  }
+
+  Timer timer;
+  timer.Start();
+
+  const ceres::Solver::Options& solver_options = options.solver_options;
+  summary.minimizer_type = ceres::TRUST_REGION;
+  summary.trust_region_strategy_type = ceres::LEVENBERG_MARQUARDT;
+  summary.linear_solver_type_given = ceres::DENSE_SCHUR;
+  summary.linear_solver_type_used = ceres::DENSE_SCHUR;
+  summary.num_threads_given = solver_options.num_threads;
+  summary.num_threads_used = 1;
+  summary.num_residual_blocks = static_cast<int>(num_residual_blocks_);
+  summary.num_residuals = static_cast<int>(2 * num_residual_blocks_);
+  summary.num_residual_blocks_reduced = summary.num_residual_blocks;
+  summary.num_residuals_reduced = summary.num_residuals;
+  summary.num_successful_steps = 0;
+  summary.num_unsuccessful_steps = 0;
+  summary.num_parameter_blocks_reduced = 0;
+  summary.num_effective_parameters_reduced = num_camera_params_;
+  for (const PoseBlock& pose : poses_) {
+    summary.num_parameter_blocks_reduced += pose.offset != -1 ? 2 : 0;
+  }
+  for (const CameraBlock& camera : cameras_) {
+    summary.num_parameter_blocks_reduced += camera.offset != -1 ? 1 : 0;
+  }
+  for (const PointBlock& point : points_) {
+    if (point.point3D != nullptr) {
+      summary.num_parameter_blocks_reduced += 1;
+      summary.num_effective_parameters_reduced += 3;
+    }
+  }
+
+  double radius = solver_options.initial_trust_region_radius;
+  double decrease_factor = 2;
+  int num_consecutive_invalid_steps = 0;
+
+  Timer jacobian_timer;
+  jacobian_timer.Start();
+  double cost = Linearize(loss_function);
+  summary.jacobian_evaluation_time_in_seconds +=
+      jacobian_timer.ElapsedSeconds();
+  summary.initial_cost = cost;
+
+  const auto add_iteration = [&](const int iteration,
+                                 const double cost_change,
+                                 const double step_norm,
+                                 const double relative_decrease,
+                                 const bool step_is_valid,
+                                 const bool step_is_successful) {
+    ceres::IterationSummary iteration_summary;
+    iteration_summary.iteration = iteration;
+    iteration_summary.cost = cost;
+    iteration_summary.cost_change = cost_change;
+    iteration_summary.gradient_max_norm = gradient_max_norm_;
+    iteration_summary.step_norm = step_norm;
+    iteration_summary.relative_decrease = relative_decrease;
+    iteration_summary.trust_region_radius = radius;
+    iteration_summary.step_is_valid = step_is_valid;
+    iteration_summary.step_is_successful = step_is_successful;
+    iteration_summary.cumulative_time_in_seconds = timer.ElapsedSeconds();
+    summary.iterations.push_back(iteration_summary);
+  };
+  add_iteration(0, 0, 0, 0, true, true);
+
+  summary.termination_type = ceres::NO_CONVERGENCE;
+  summary.message = "Maximum number of iterations reached.";
+  if (gradient_max_norm_ <= solver_options.gradient_tolerance) {
+    summary.termination_type = ceres::CONVERGENCE;
+    summary.message = "Gradient tolerance reached.";
+  }
+
+  Step step;
+  for (int iteration = 1;
+       summary.termination_type == ceres::NO_CONVERGENCE &&
+       iteration <= solver_options.max_num_iterations;
+       ++iteration) {
+    Timer linear_solver_timer;
+    linear_solver_timer.Start();
+    const bool step_is_valid = ComputeStep(solver_options, 1 / radius, &step);
+    summary.linear_solver_time_in_seconds +=
+        linear_solver_timer.ElapsedSeconds();
+
+    const double model_cost_change = step_is_valid ? ModelCostChange(step) : 0;
+    if (!step_is_valid || !(model_cost_change > 0)) {
+      add_iteration(iteration, 0, 0, 0, false, false);
+      summary.num_unsuccessful_steps += 1;
+      if (++num_consecutive_invalid_steps >
+          solver_options.max_num_consecutive_invalid_steps) {
+        summary.termination_type = ceres::FAILURE;
+        summary.message = "Too many consecutive invalid steps.";
+        break;
+      }
+      radius /= decrease_factor;
+      decrease_factor *= 2;
+      continue;
+    }
+    num_consecutive_invalid_steps = 0;
+
+    double step_norm_sq = step.cameras.squaredNorm();
+    for (const Eigen::Vector3d& point_step : step.points) {
+      step_norm_sq += point_step.squaredNorm();
+    }
+    const double step_norm = std::sqrt(step_norm_sq);
+
+    ApplyStep(step);
+    Timer residual_timer;
+    residual_timer.Start();
+    const double candidate_cost =
+        EvaluateCost(candidate_poses_,
+                     candidate_cameras_,
+                     candidate_point_xyz_,
+                     loss_function);
+    summary.residual_evaluation_time_in_seconds +=
+        residual_timer.ElapsedSeconds();
+
+    const double cost_change = cost - candidate_cost;
+    const double relative_decrease = cost_change / model_cost_change;
+    if (relative_decrease > solver_options.min_relative_decrease) {
+      std::swap(poses_, candidate_poses_);
+      std::swap(cameras_, candidate_cameras_);
+      std::swap(point_xyz_, candidate_point_xyz_);
+      summary.num_successful_steps += 1;
+
+      radius = std::min(solver_options.max_trust_region_radius,
+                        radius / std::max(1.0 / 3.0,
+                                          1.0 - std::pow(2 * relative_decrease -
+                                                             1,
+                                                         3)));
+      decrease_factor = 2;
+
+      jacobian_timer.Restart();
+      cost = Linearize(loss_function);
+      summary.jacobian_evaluation_time_in_seconds +=
+          jacobian_timer.ElapsedSeconds();
+      add_iteration(
+          iteration, cost_change, step_norm, relative_decrease, true, true);
+
+      if (gradient_max_norm_ <= solver_options.gradient_tolerance) {
+        summary.termination_type = ceres::CONVERGENCE;
+        summary.message = "Gradient tolerance reached.";
+      } else if (std::abs(cost_change) <=
+                 solver_options.function_tolerance * cost) {
+        summary.termination_type = ceres::CONVERGENCE;
+        summary.message = "Function tolerance reached.";
+      }
+    } else {
+      add_iteration(
+          iteration, cost_change, step_norm, relative_decrease, true, false);
+      summary.num_unsuccessful_steps += 1;
+      radius /= decrease_factor;
+      decrease_factor *= 2;
+      if (radius < solver_options.min_trust_region_radius) {
+        summary.termination_type = ceres::CONVERGENCE;
+        summary.message = "Minimum trust region radius reached.";
+      }
+    }
+  }
+
+  WriteParameters();
+
+  summary.final_cost = cost;
+  summary.minimizer_time_in_seconds = timer.ElapsedSeconds();
+  summary.total_time_in_seconds = timer.ElapsedSeconds();
+
+  if (options.print_summary) {
+    PrintSolverSummary(summary, "Local bundle adjustment report");
+  }
+
+  return summary;
+}
+
+namespace {
+
+class LocalBundleAdjuster : public BundleAdjuster {
+ public:
+  LocalBundleAdjuster(BundleAdjustmentOptions options,
+                      BundleAdjustmentConfig config,
+                      std::shared_ptr<LocalBundleAdjustmentProblem> problem)
+      : BundleAdjuster(std::move(options), std::move(config)),
+        loss_function_(options_.CreateLossFunction()),
+        local_problem_(std::move(problem)) {}
+
+  ceres::Solver::Summary Solve() override {
+    return local_problem_->Solve(options_, *loss_function_);
+  }
+
+  std::shared_ptr<ceres::Problem>& Problem() override { return problem_; }
+
+ private:
+  std::shared_ptr<ceres::Problem> problem_;
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+  std::shared_ptr<LocalBundleAdjustmentProblem> local_problem_;
+};
+
+}  // namespace
+
+std::unique_ptr<BundleAdjuster>
+LocalBundleAdjustmentContext::CreateBundleAdjuster(
+    BundleAdjustmentOptions options,
+    BundleAdjustmentConfig config,
+    Reconstruction& reconstruction) {
+  if (options.max_num_frames_local_solver > 0) {
+    if (problem_ == nullptr) {
+      problem_ = std::make_shared<LocalBundleAdjustmentProblem>();
+    }
+    if (problem_->Update(options, config, reconstruction)) {
+      return std::make_unique<LocalBundleAdjuster>(
+          std::move(options), std::move(config), problem_);
+    }
+  } else {
+    Clear();
+  }
+  return CreateDefaultBundleAdjuster(
+      std::move(options), std::move(config), reconstruction);
+}
+
+void LocalBundleAdjustmentContext::Clear() {
+  if (problem_ != nullptr) {
+    problem_->Clear();
+  }
+}
+
+std::unique_ptr<BundleAdjuster> CreateLocalBundleAdjuster(
+    BundleAdjustmentOptions options,
+    BundleAdjustmentConfig config,
+    Reconstruction& reconstruction) {
+  return LocalBundleAdjustmentContext().CreateBundleAdjuster(
+      std::move(options), std::move(config), reconstruction);
+}
+
+}  // namespace colmap
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bundle_adjustment.h"
+
+#include <memory>
+
+namespace colmap {
+
+class LocalBundleAdjustmentProblem;
+
+// Create a bundle adjuster for the small problems of the local bundle
+// adjustment in the incremental mapper. Instead of building a generic Ceres
+// problem, the adjuster solves the problem with Levenberg-Marquardt on the
+// dense reduced camera system: the points are eliminated with their 3x3
+// blocks through the Schur complement, the poses are fixed-size blocks with 6
+// parameters, and the refined intrinsics are one block per camera. The
+// reprojection errors and their Jacobians are evaluated with the analytic
+// derivatives of the camera models.
+//
+// Falls back to the default Ceres bundle adjuster if the problem is not
+// supported, i.e., if one of the adjusted images is not the reference sensor
+// of its rig, if one of the camera models has no analytic derivatives, if
+// the gauge is fixed with two cameras, or if there are more variable frames
+// than BundleAdjustmentOptions::max_num_frames_local_solver. The adjuster has
+// no Ceres problem, i.e., Problem() returns null.
+std::unique_ptr<BundleAdjuster> CreateLocalBundleAdjuster(
+    BundleAdjustmentOptions options,
+    BundleAdjustmentConfig config,
+    Reconstruction& reconstruction);
+
+// Keeps the problem of the last local bundle adjustment, such that the next
+// one only adds and removes the residuals that changed. This is the case for
+// the repeated refinements of the same image, where only the observations of
+// merged, completed, and filtered tracks change, and for consecutive images
+// with overlapping local bundles.
+//
+// The values of the parameters are always read from the reconstruction, so
+// the reconstruction may change arbitrarily between bundle adjustments. The
+// context must be cleared if the reconstruction is replaced.
+class LocalBundleAdjustmentContext {
+ public:
+  // Create a bundle adjuster as CreateLocalBundleAdjuster. The adjuster
+  // shares the problem of the context, so it must be solved before the next
+  // adjuster is created.
+  std::unique_ptr<BundleAdjuster> CreateBundleAdjuster(
+      BundleAdjustmentOptions options,
+      BundleAdjustmentConfig config,
+      Reconstruction& reconstruction);
+
+  void Clear();
+
+ private:
+  std::shared_ptr<LocalBundleAdjustmentProblem> problem_;
+};
+
+}  // namespace colmap
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace colmap {
+
+// Implementation of the minimal solver of an estimator. The PoseLib solvers
+// only apply to minimal samples, such that the estimators fall back to their
+// native least-squares solvers for more correspondences, e.g., in the local
+// optimization of LO-RANSAC.
+enum class MinimalSolverBackend {
+  // The backend of each estimator as chosen by the speed and accuracy
+  // measured with minimal_solvers_benchmark.cc.
+  DEFAULT = 0,
+  // The solvers implemented in minmap-core.
+  NATIVE = 1,
+  // The solvers of the vendored PoseLib.
+  POSELIB = 2,
+};
+
+constexpr std::string_view MinimalSolverBackendToString(
+    const MinimalSolverBackend v) {
+  switch (v) {
+    case MinimalSolverBackend::DEFAULT:
+      return "DEFAULT";
+    case MinimalSolverBackend::NATIVE:
+      return "NATIVE";
+    case MinimalSolverBackend::POSELIB:
+      return "POSELIB";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+inline MinimalSolverBackend MinimalSolverBackendFromString(
+    const std::string_view s) {
+  if (s == "DEFAULT") return MinimalSolverBackend::DEFAULT;
+  if (s == "NATIVE") return MinimalSolverBackend::NATIVE;
+  if (s == "POSELIB") return MinimalSolverBackend::POSELIB;
+  throw std::runtime_error("Invalid MinimalSolverBackend: " + std::string(s));
+}
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const MinimalSolverBackend v) {
+  return os << MinimalSolverBackendToString(v);
+}
+
+inline std::istream& operator>>(std::istream& is, MinimalSolverBackend& v) {
+  std::string s;
+  if (is >> s) {
+    v = MinimalSolverBackendFromString(s);
+  }
+  return is;
+}
+
+}  // namespace colmap
@@ -0,0 +1,338 @@
+// Compares the native and the PoseLib backends of the minimal solvers in speed
+// and accuracy. Every backend solves the same random noise-free minimal
+// problems, and a problem counts as solved if one of the returned models
+// matches the ground truth. The benchmark recommends the fastest backend that
+// solves as many problems as the best backend and fails if the compiled
+// default backend of a solver is less accurate than that. Build with
+// MINMAP_BUILD_BENCHMARKS=ON and run, e.g., through adb on the target device:
+//
+//    minmap_minimal_solvers_benchmark [num_problems] [num_repetitions]
+//
+
+#include "essential_matrix.h"
+#include "fundamental_matrix.h"
+#include "homography_matrix.h"
+
+#include "../util/string.h"
+#include "../util/timer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+namespace colmap {
+namespace {
+
+// Maximum distance of a solved model to the ground truth, after both are
+// normalized to unit Frobenius norm.
+constexpr double kMaxModelError = 1e-6;
+// Fraction of problems that a backend may solve less than the best backend
+// to still be considered equally accurate. RANSAC needs at most this fraction
+// more trials with a backend that is worse by this fraction.
+constexpr double kMaxSolvedRateLoss = 0.01;
+
+template <typename Estimator>
+struct Problem {
+  std::vector<typename Estimator::X_t> X;
+  std::vector<typename Estimator::Y_t> Y;
+  typename Estimator::M_t model;
+};
+
+struct RelativePose {
+  Eigen::Matrix3d R;
+  Eigen::Vector3d t;
+};
+
+RelativePose RandomRelativePose(std::mt19937& rng) {
+  std::normal_distribution<double> normal(0, 1);
+  RelativePose pose;
+  pose.R = Eigen::Quaterniond(
+               1, 0.2 * normal(rng), 0.2 * normal(rng), 0.2 * normal(rng))
+               .normalized()
+               .toRotationMatrix();
+  pose.t = Eigen::Vector3d(normal(rng), 0.2 * normal(rng), 0.2 * normal(rng))
+               .normalized();
+  return pose;
+}
+
+Eigen::Matrix3d RandomCalibration(std::mt19937& rng) {
+  std::uniform_real_distribution<double> focal_length(500, 1500);
+  std::uniform_real_distribution<double> principal_point(400, 600);
+  Eigen::Matrix3d K = Eigen::Matrix3d::Identity();
+  K(0, 0) = K(1, 1) = focal_length(rng);
+  K(0, 2) = principal_point(rng);
+  K(1, 2) = principal_point(rng);
+  return K;
+}
+
+// Random points, which project into both images of cameras with a field of
+// view of roughly 90 degrees. If a plane (n, d) is given, the points lie on
+// the plane n' X + d = 0 in the first camera. Returns false if the pose or the
+// plane leaves too few points in view.
+bool RandomPoints(const RelativePose& pose,
+                  const size_t num_points,
+                  const Eigen::Vector4d* plane,
+                  std::mt19937& rng,
+                  std::vector<Eigen::Vector3d>* points1,
+                  std::vector<Eigen::Vector3d>* points2) {
+  std::uniform_real_distribution<double> coordinate(-0.5, 0.5);
+  std::uniform_real_distribution<double> depth(2, 10);
+  points1->clear();
+  points2->clear();
+  const size_t kMaxNumTrials = 100 * num_points;
+  for (size_t i = 0; i < kMaxNumTrials && points1->size() < num_points; ++i) {
+    const Eigen::Vector3d ray1(coordinate(rng), coordinate(rng), 1);
+    double depth1 = depth(rng);
+    if (plane != nullptr) {
+      depth1 = -plane->w() / plane->head<3>().dot(ray1);
+      if (depth1 <= 0) {
+        continue;
+      }
+    }
+    const Eigen::Vector3d point1 = depth1 * ray1;
+    const Eigen::Vector3d point2 = pose.R * point1 + pose.t;
+    if (point2.z() > 0.1 && std::abs(point2.x() / point2.z()) < 0.5 &&
+        std::abs(point2.y() / point2.z()) < 0.5) {
+      points1->push_back(point1);
+      points2->push_back(point2);
+    }
+  }
+  return points1->size() == num_points;
+}
+
+Eigen::Matrix3d CrossProductMatrix(const Eigen::Vector3d& vector) {
+  Eigen::Matrix3d matrix;
+  matrix << 0, -vector(2), vector(1), vector(2), 0, -vector(0), -vector(1),
+      vector(0), 0;
+  return matrix;
+}
+
+Problem<EssentialMatrixFivePointEstimator> RandomEssentialMatrixProblem(
+    std::mt19937& rng) {
+  RelativePose pose;
+  std::vector<Eigen::Vector3d> points1;
+  std::vector<Eigen::Vector3d> points2;
+  do {
+    pose = RandomRelativePose(rng);
+  } while (!RandomPoints(pose,
+                         EssentialMatrixFivePointEstimator::kMinNumSamples,
+                         nullptr,
+                         rng,
+                         &points1,
+                         &points2));
+  Problem<EssentialMatrixFivePointEstimator> problem;
+  for (size_t i = 0; i < points1.size(); ++i) {
+    problem.X.push_back(points1[i].normalized());
+    problem.Y.push_back(points2[i].normalized());
+  }
+  problem.model = CrossProductMatrix(pose.t) * pose.R;
+  return problem;
+}
+
+// The points are in pixels, as the fundamental matrix and the homography are
+// estimated from the uncalibrated image points in the two-view geometry.
+Problem<FundamentalMatrixSevenPointEstimator> RandomFundamentalMatrixProblem(
+    std::mt19937& rng) {
+  RelativePose pose;
+  std::vector<Eigen::Vector3d> points1;
+  std::vector<Eigen::Vector3d> points2;
+  do {
+    pose = RandomRelativePose(rng);
+  } while (!RandomPoints(pose,
+                         FundamentalMatrixSevenPointEstimator::kMinNumSamples,
+                         nullptr,
+                         rng,
+                         &points1,
+                         &points2));
+  const Eigen::Matrix3d K1 = RandomCalibration(rng);
+  const Eigen::Matrix3d K2 = RandomCalibration(rng);
+  Problem<FundamentalMatrixSevenPointEstimator> problem;
+  for (size_t i = 0; i < points1.size(); ++i) {
+    problem.X.push_back((K1 * points1[i]).hnormalized());
+    problem.Y.push_back((K2 * points2[i]).hnormalized());
+  }
+  problem.model = K2.inverse().transpose() * CrossProductMatrix(pose.t) *
+                  pose.R * K1.inverse();
+  return problem;
+}
+
+Problem<HomographyMatrixEstimator> RandomHomographyMatrixProblem(
+    std::mt19937& rng) {
+  std::normal_distribution<double> normal(0, 1);
+  std::uniform_real_distribution<double> distance(2, 10);
+  RelativePose pose;
+  Eigen::Vector4d plane;
+  std::vector<Eigen::Vector3d> points1;
+  std::vector<Eigen::Vector3d> points2;
+  do {
+    pose = RandomRelativePose(rng);
+    plane.head<3>() =
+        Eigen::Vector3d(0.3 * normal(rng), 0.3 * normal(rng), -1).normalized();
+    plane.w() = distance(rng);
+  } while (!RandomPoints(pose,
+                         HomographyMatrixEstimator::kMinNumSamples,
+                         &plane,
+                         rng,
+                         &points1,
+                         &points2));
+  const Eigen::Matrix3d K1 = RandomCalibration(rng);
+  const Eigen::Matrix3d K2 = RandomCalibration(rng);
+  Problem<HomographyMatrixEstimator> problem;
+  for (size_t i = 0; i < points1.size(); ++i) {
+    problem.X.push_back((K1 * points1[i]).hnormalized());
+    problem.Y.push_back((K2 * points2[i]).hnormalized());
+  }
+  problem.model =
+      K2 * (pose.R - pose.t * plane.head<3>().transpose() / plane.w()) *
+      K1.inverse();
+  return problem;
+}
+
+double ModelError(const Eigen::Matrix3d& model,
+                  const Eigen::Matrix3d& ref_model) {
+  const Eigen::Matrix3d normalized_model = model.normalized();
+  const Eigen::Matrix3d normalized_ref_model = ref_model.normalized();
+  return std::min((normalized_model - normalized_ref_model).norm(),
+                  (normalized_model + normalized_ref_model).norm());
+}
+
+struct Result {
+  double solved_rate = 0;
+  double median_error = 0;
+  double time = 0;
+};
+
+template <typename Estimator>
+Result EvaluateBackend(const std::vector<Problem<Estimator>>& problems,
+                       const MinimalSolverBackend backend,
+                       const int num_repetitions) {
+  const Estimator estimator(backend);
+  std::vector<typename Estimator::M_t> models;
+
+  Result result;
+  std::vector<double> errors;
+  errors.reserve(problems.size());
+  size_t num_solved = 0;
+  for (const auto& problem : problems) {
+    estimator.Estimate(problem.X, problem.Y, &models);
+    double min_error = std::numeric_limits<double>::max();
+    for (const auto& model : models) {
+      min_error = std::min(min_error, ModelError(model, problem.model));
+    }
+    errors.push_back(min_error);
+    if (min_error <= kMaxModelError) {
+      num_solved += 1;
+    }
+  }
+  result.solved_rate = static_cast<double>(num_solved) / problems.size();
+  std::nth_element(
+      errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+  result.median_error = errors[errors.size() / 2];
+
+  size_t checksum = 0;
+  Timer timer;
+  timer.Start();
+  for (int i = 0; i < num_repetitions; ++i) {
+    for (const auto& problem : problems) {
+      estimator.Estimate(problem.X, problem.Y, &models);
+      checksum += models.size();
+    }
+  }
+  result.time =
+      timer.ElapsedMicroSeconds() / (num_repetitions * problems.size());
+  // Keep the compiler from removing the estimations.
+  if (checksum == 0) {
+    std::cout << checksum << std::endl;
+  }
+
+  return result;
+}
+
+// Benchmark both backends of the estimator and check its default backend.
+template <typename Estimator, typename ProblemGenerator>
+bool BenchmarkSolver(const std::string& name,
+                     ProblemGenerator generate_problem,
+                     const int num_problems,
+                     const int num_repetitions,
+                     std::mt19937& rng) {
+  std::vector<Problem<Estimator>> problems;
+  problems.reserve(num_problems);
+  for (int i = 0; i < num_problems; ++i) {
+    problems.push_back(generate_problem(rng));
+  }
+
+  const std::vector<MinimalSolverBackend> backends = {
+      MinimalSolverBackend::NATIVE, MinimalSolverBackend::POSELIB};
+  std::vector<Result> results;
+  double max_solved_rate = 0;
+  for (const MinimalSolverBackend backend : backends) {
+    results.push_back(
+        EvaluateBackend<Estimator>(problems, backend, num_repetitions));
+    max_solved_rate = std::max(max_solved_rate, results.back().solved_rate);
+  }
+
+  // The fastest of the equally accurate backends.
+  size_t best_idx = backends.size();
+  for (size_t i = 0; i < backends.size(); ++i) {
+    if (results[i].solved_rate >= max_solved_rate - kMaxSolvedRateLoss &&
+        (best_idx == backends.size() ||
+         results[i].time < results[best_idx].time)) {
+      best_idx = i;
+    }
+  }
+
+  bool success = true;
+  for (size_t i = 0; i < backends.size(); ++i) {
+    const bool is_default = backends[i] == Estimator::kDefaultBackend;
+    std::cout << StringPrintf(
+                     "%-6s %-8s %7.2f%% %14.2e %10.3f %-11s",
+                     name.c_str(),
+                     MinimalSolverBackendToString(backends[i]).data(),
+                     100 * results[i].solved_rate,
+                     results[i].median_error,
+                     results[i].time,
+                     i == best_idx ? (is_default ? "yes, default" : "yes")
+                                   : (is_default ? "default" : ""))
+              << std::endl;
+    if (is_default &&
+        results[i].solved_rate < max_solved_rate - kMaxSolvedRateLoss) {
+      std::cerr << "ERROR: The default backend of " << name
+                << " is less accurate than "
+                << MinimalSolverBackendToString(backends[best_idx])
+                << std::endl;
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+}  // namespace
+}  // namespace colmap
+
+int main(int argc, char** argv) {
+  using namespace colmap;
+
+  const int num_problems = argc > 1 ? std::stoi(argv[1]) : 10000;
+  const int num_repetitions = argc > 2 ? std::stoi(argv[2]) : 10;
+
+  std::mt19937 rng(42);
+  bool success = true;
+
+  std::cout << "solver backend    solved   median error  time [us]  best"
+            << std::endl;
+  success &= BenchmarkSolver<EssentialMatrixFivePointEstimator>(
+      "E5", RandomEssentialMatrixProblem, num_problems, num_repetitions, rng);
+  success &= BenchmarkSolver<FundamentalMatrixSevenPointEstimator>(
+      "F7", RandomFundamentalMatrixProblem, num_problems, num_repetitions, rng);
+  success &= BenchmarkSolver<HomographyMatrixEstimator>(
+      "H4", RandomHomographyMatrixProblem, num_problems, num_repetitions, rng);
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -8,10 +8,48 @@
 #include "../geometry/essential_matrix.h"
 #include "../geometry/pose.h"
 #include "../geometry/triangulation.h"
+#include "../optim/progressive_sampler.h"
 #include "../sensor/models.h"
 #include "../util/logging.h"
 
 namespace colmap {
+namespace {
+
+// LO-RANSAC with the given minimal solver for the hypotheses and EPnP for the
+// local optimization.
+template <typename Estimator>
+bool EstimateAbsolutePoseLORANSAC(
+    const AbsolutePoseEstimationOptions& options,
+    const Estimator& estimator,
+    const EPNPEstimator& local_estimator,
+    const std::vector<Point2DWithRay>& points2D_with_rays,
+    const std::vector<Eigen::Vector3d>& points3D,
+    Rigid3d* cam_from_world,
+    size_t* num_inliers,
+    std::vector<char>* inlier_mask) {
+  auto report =
+      options.progressive_sampling
+          ? LORANSAC<Estimator,
+                     EPNPEstimator,
+                     InlierSupportMeasurer,
+                     ProgressiveSampler>(
+                options.ransac_options, estimator, local_estimator)
+                .Estimate(points2D_with_rays, points3D)
+          : LORANSAC<Estimator, EPNPEstimator>(
+                options.ransac_options, estimator, local_estimator)
+                .Estimate(points2D_with_rays, points3D);
+  if (!report.success) {
+    return false;
+  }
+  *cam_from_world =
+      Rigid3d(Eigen::Quaterniond(report.model.template leftCols<3>()),
+              report.model.col(3));
+  *num_inliers = report.support.num_inliers;
+  *inlier_mask = std::move(report.inlier_mask);
+  return true;
+}
+
+}  // namespace
 
 bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
                           const std::vector<Eigen::Vector2d>& points2D,
@@ -36,8 +74,13 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
     for (size_t i = 0; i < points2D.size(); ++i) {
       points2D_centered[i] = points2D[i] - principal_point;
     }
-    RANSAC<P4PFEstimator> ransac(options.ransac_options);
-    auto report = ransac.Estimate(points2D_centered, points3D);
+    auto report =
+        options.progressive_sampling
+            ? RANSAC<P4PFEstimator, InlierSupportMeasurer, ProgressiveSampler>(
+                  options.ransac_options)
+                  .Estimate(points2D_centered, points3D)
+            : RANSAC<P4PFEstimator>(options.ransac_options)
+                  .Estimate(points2D_centered, points3D);
     if (report.success) {
       *cam_from_world =
           Rigid3d(Eigen::Quaterniond(report.model.cam_from_world.leftCols<3>()),
@@ -50,14 +93,18 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
       return true;
     }
   } else {
+    std::vector<Eigen::Vector2d> cam_points(points2D.size());
+    std::vector<char> valid_mask(points2D.size());
+    camera->CamFromImgBatch(
+        span<const Eigen::Vector2d>(points2D.data(), points2D.size()),
+        span<Eigen::Vector2d>(cam_points.data(), cam_points.size()),
+        span<char>(valid_mask.data(), valid_mask.size()));
     std::vector<P3PEstimator::X_t> points2D_with_rays(points2D.size());
     for (size_t i = 0; i < points2D.size(); ++i) {
       points2D_with_rays[i].image_point = points2D[i];
-      if (const std::optional<Eigen::Vector2d> cam_point =
-              camera->CamFromImg(points2D[i]);
-          cam_point) {
+      if (valid_mask[i]) {
         points2D_with_rays[i].camera_ray =
-            cam_point->homogeneous().normalized();
+            cam_points[i].homogeneous().normalized();
       } else {
         points2D_with_rays[i].camera_ray.setZero();
       }
@@ -65,18 +112,29 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
 
     ImgFromCamFunc img_from_cam_func =
         std::bind(&Camera::ImgFromCam, camera, std::placeholders::_1);
-    LORANSAC<P3PEstimator, EPNPEstimator> ransac(
-        options.ransac_options,
-        P3PEstimator(img_from_cam_func),
-        EPNPEstimator(img_from_cam_func));
-    auto report = ransac.Estimate(points2D_with_rays, points3D);
-    if (report.success) {
-      *cam_from_world = Rigid3d(Eigen::Quaterniond(report.model.leftCols<3>()),
-                                report.model.col(3));
-      *num_inliers = report.support.num_inliers;
-      *inlier_mask = std::move(report.inlier_mask);
-      return true;
+    const EPNPEstimator local_estimator(img_from_cam_func);
+    if (options.gravity_in_cam.allFinite() &&
+        options.gravity_in_world.allFinite()) {
+      return EstimateAbsolutePoseLORANSAC(
+          options,
+          UprightP2PEstimator(img_from_cam_func,
+                              options.gravity_in_cam,
+                              options.gravity_in_world),
+          local_estimator,
+          points2D_with_rays,
+          points3D,
+          cam_from_world,
+          num_inliers,
+          inlier_mask);
     }
+    return EstimateAbsolutePoseLORANSAC(options,
+                                        P3PEstimator(img_from_cam_func),
+                                        local_estimator,
+                                        points2D_with_rays,
+                                        points3D,
+                                        cam_from_world,
+                                        num_inliers,
+                                        inlier_mask);
   }
 
   return false;
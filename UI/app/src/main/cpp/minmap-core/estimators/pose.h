@@ -8,6 +8,7 @@
 #include "../util/threading.h"
 #include "../util/types.h"
 
+#include <limits>
 #include <vector>
 
 #include <PoseLib/alignment.h>
@@ -20,6 +21,19 @@ struct AbsolutePoseEstimationOptions {
   // Whether to estimate the focal length.
   bool estimate_focal_length = false;
 
+  // Whether to draw the RANSAC samples progressively from the first 2D-3D
+  // correspondences (PROSAC) instead of uniformly at random. The
+  // correspondences must then be sorted by decreasing quality.
+  bool progressive_sampling = false;
+
+  // Direction of gravity in the camera and in the world frame. If both are
+  // known and the focal length is not estimated, the pose is estimated with
+  // the upright 2-point solver instead of P3P.
+  Eigen::Vector3d gravity_in_cam =
+      Eigen::Vector3d::Constant(std::numeric_limits<double>::quiet_NaN());
+  Eigen::Vector3d gravity_in_world =
+      Eigen::Vector3d::Constant(std::numeric_limits<double>::quiet_NaN());
+
   // Options used for P3P RANSAC.
   RANSACOptions ransac_options;
 
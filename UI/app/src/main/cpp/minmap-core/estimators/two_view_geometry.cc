@@ -10,14 +10,61 @@
 #include "../geometry/triangulation.h"
 #include "../math/random.h"
 #include "../optim/loransac.h"
+#include "../optim/progressive_sampler.h"
 #include "../optim/ransac.h"
 #include "../scene/camera.h"
 
+#include <algorithm>
 #include <unordered_set>
 
 namespace colmap {
 namespace {
 
+// Normalized camera rays of the image points, transformed in one batch. The
+// rays of points that cannot be transformed to the camera frame are zero.
+std::vector<Eigen::Vector3d> CamRaysFromImg(
+    const Camera& camera, const std::vector<Eigen::Vector2d>& img_points) {
+  const size_t num_points = img_points.size();
+  std::vector<Eigen::Vector2d> cam_points(num_points);
+  std::vector<char> valid_mask(num_points);
+  camera.CamFromImgBatch(
+      span<const Eigen::Vector2d>(img_points.data(), num_points),
+      span<Eigen::Vector2d>(cam_points.data(), num_points),
+      span<char>(valid_mask.data(), num_points));
+  std::vector<Eigen::Vector3d> cam_rays(num_points);
+  for (size_t i = 0; i < num_points; ++i) {
+    if (valid_mask[i]) {
+      cam_rays[i] = cam_points[i].homogeneous().normalized();
+    } else {
+      cam_rays[i].setZero();
+    }
+  }
+  return cam_rays;
+}
+
+// Normalized camera rays of the matched points of one image. The rays are
+// gathered from the precomputed rays of all points, if given, or otherwise
+// transformed in one batch.
+std::vector<Eigen::Vector3d> MatchedCamRays(
+    const Camera& camera,
+    const std::vector<Eigen::Vector2d>& points,
+    const std::vector<Eigen::Vector3d>* cam_rays,
+    const FeatureMatches& matches,
+    point2D_t FeatureMatch::*point2D_idx) {
+  if (cam_rays == nullptr) {
+    std::vector<Eigen::Vector2d> matched_points(matches.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+      matched_points[i] = points[matches[i].*point2D_idx];
+    }
+    return CamRaysFromImg(camera, matched_points);
+  }
+  std::vector<Eigen::Vector3d> matched_cam_rays(matches.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    matched_cam_rays[i] = (*cam_rays)[matches[i].*point2D_idx];
+  }
+  return matched_cam_rays;
+}
+
 FeatureMatches ExtractInlierMatches(const FeatureMatches& matches,
                                     const size_t num_inliers,
                                     const std::vector<char>& inlier_mask) {
@@ -55,6 +102,108 @@ FeatureMatches ExtractOutlierMatches(const FeatureMatches& matches,
   return outlier_matches;
 }
 
+// Whether to sample the matches progressively, which requires the distance
+// ratios of the matcher.
+bool UseProgressiveSampling(const TwoViewGeometryOptions& options,
+                            const FeatureMatches& matches) {
+  return options.progressive_sampling &&
+         std::any_of(matches.begin(),
+                     matches.end(),
+                     [](const FeatureMatch& match) {
+                       return match.distance_ratio < 1;
+                     });
+}
+
+// The matches sorted by decreasing distinctiveness, as expected by the
+// progressive sampler, or unchanged for uniform sampling.
+FeatureMatches OrderMatchesForSampling(const FeatureMatches& matches,
+                                       const bool progressive_sampling) {
+  FeatureMatches ordered_matches = matches;
+  if (progressive_sampling) {
+    std::stable_sort(
+        ordered_matches.begin(),
+        ordered_matches.end(),
+        [](const FeatureMatch& match1, const FeatureMatch& match2) {
+          return match1.distance_ratio < match2.distance_ratio;
+        });
+  }
+  return ordered_matches;
+}
+
+// Robustly estimate a model with LO-RANSAC, either with progressive or with
+// uniform sampling.
+template <typename Estimator, typename LocalEstimator>
+typename RANSAC<Estimator>::Report EstimateLORANSAC(
+    const RANSACOptions& options,
+    const bool progressive_sampling,
+    Estimator estimator,
+    LocalEstimator local_estimator,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  if (progressive_sampling) {
+    LORANSAC<Estimator,
+             LocalEstimator,
+             InlierSupportMeasurer,
+             ProgressiveSampler>
+        ransac(options, std::move(estimator), std::move(local_estimator));
+    return ransac.Estimate(X, Y);
+  }
+  LORANSAC<Estimator, LocalEstimator> ransac(
+      options, std::move(estimator), std::move(local_estimator));
+  return ransac.Estimate(X, Y);
+}
+
+// Same as above, but with the given backend of the minimal solver.
+template <typename Estimator, typename LocalEstimator>
+typename RANSAC<Estimator>::Report EstimateLORANSAC(
+    const RANSACOptions& options,
+    const bool progressive_sampling,
+    const MinimalSolverBackend backend,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  return EstimateLORANSAC<Estimator, LocalEstimator>(options,
+                                                     progressive_sampling,
+                                                     Estimator(backend),
+                                                     LocalEstimator(),
+                                                     X,
+                                                     Y);
+}
+
+// Robustly estimate the essential matrix with LO-RANSAC. If the gravity
+// directions of both cameras are given, the hypotheses are sampled with the
+// upright 3-point solver and only the local optimization uses the 5-point
+// estimator.
+typename RANSAC<EssentialMatrixFivePointEstimator>::Report
+EstimateEssentialMatrixLORANSAC(const RANSACOptions& options,
+                                const bool progressive_sampling,
+                                const MinimalSolverBackend backend,
+                                const Eigen::Vector3d* gravity1,
+                                const Eigen::Vector3d* gravity2,
+                                const std::vector<Eigen::Vector3d>& cam_rays1,
+                                const std::vector<Eigen::Vector3d>& cam_rays2) {
+  if (gravity1 == nullptr || gravity2 == nullptr) {
+    return EstimateLORANSAC<EssentialMatrixFivePointEstimator,
+                            EssentialMatrixFivePointEstimator>(
+        options, progressive_sampling, backend, cam_rays1, cam_rays2);
+  }
+
+  auto upright_report =
+      EstimateLORANSAC(options,
+                       progressive_sampling,
+                       EssentialMatrixUprightThreePointEstimator(*gravity1,
+                                                                 *gravity2),
+                       EssentialMatrixFivePointEstimator(backend),
+                       cam_rays1,
+                       cam_rays2);
+  typename RANSAC<EssentialMatrixFivePointEstimator>::Report report;
+  report.success = upright_report.success;
+  report.num_trials = upright_report.num_trials;
+  report.support = upright_report.support;
+  report.inlier_mask = std::move(upright_report.inlier_mask);
+  report.model = upright_report.model;
+  return report;
+}
+
 inline bool IsImagePointInBoundingBox(const Eigen::Vector2d& point,
                                       const double minx,
                                       const double maxx,
@@ -69,8 +218,12 @@ TwoViewGeometry EstimateCalibratedHomography(
     const std::vector<Eigen::Vector2d>& points1,
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
-    const FeatureMatches& matches,
+    const FeatureMatches& input_matches,
     const TwoViewGeometryOptions& options) {
+  const bool progressive_sampling =
+      UseProgressiveSampling(options, input_matches);
+  const FeatureMatches matches =
+      OrderMatchesForSampling(input_matches, progressive_sampling);
   TwoViewGeometry geometry;
 
   const size_t min_num_inliers = static_cast<size_t>(options.min_num_inliers);
@@ -89,10 +242,13 @@ TwoViewGeometry EstimateCalibratedHomography(
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
   const auto H_report =
-      H_ransac.Estimate(matched_img_points1, matched_img_points2);
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options.ransac_options,
+          progressive_sampling,
+          options.minimal_solver_backend,
+          matched_img_points1,
+          matched_img_points2);
   geometry.H = H_report.model;
 
   if (!H_report.success || H_report.support.num_inliers < min_num_inliers) {
@@ -126,8 +282,12 @@ TwoViewGeometry EstimateUncalibratedTwoViewGeometry(
     const std::vector<Eigen::Vector2d>& points1,
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
-    const FeatureMatches& matches,
+    const FeatureMatches& input_matches,
     const TwoViewGeometryOptions& options) {
+  const bool progressive_sampling =
+      UseProgressiveSampling(options, input_matches);
+  const FeatureMatches matches =
+      OrderMatchesForSampling(input_matches, progressive_sampling);
   TwoViewGeometry geometry;
 
   const size_t min_num_inliers = static_cast<size_t>(options.min_num_inliers);
@@ -146,19 +306,25 @@ TwoViewGeometry EstimateUncalibratedTwoViewGeometry(
 
   // Estimate epipolar model.
 
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
   const auto F_report =
-      F_ransac.Estimate(matched_img_points1, matched_img_points2);
+      EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                       FundamentalMatrixEightPointEstimator>(
+          options.ransac_options,
+          progressive_sampling,
+          options.minimal_solver_backend,
+          matched_img_points1,
+          matched_img_points2);
   geometry.F = F_report.model;
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
   const auto H_report =
-      H_ransac.Estimate(matched_img_points1, matched_img_points2);
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options.ransac_options,
+          progressive_sampling,
+          options.minimal_solver_backend,
+          matched_img_points1,
+          matched_img_points2);
   geometry.H = H_report.model;
 
   if ((!F_report.success && !H_report.success) ||
@@ -212,7 +378,9 @@ TwoViewGeometry EstimateMultipleTwoViewGeometries(
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
     const FeatureMatches& matches,
-    const TwoViewGeometryOptions& options) {
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1,
+    const Eigen::Vector3d* gravity2) {
   FeatureMatches remaining_matches = matches;
   TwoViewGeometry multi_geometry;
   std::vector<TwoViewGeometry> geometries;
@@ -220,8 +388,14 @@ TwoViewGeometry EstimateMultipleTwoViewGeometries(
   // Set to false to prevent recursive calls to this function.
   options_copy.multiple_models = false;
   while (true) {
-    TwoViewGeometry geometry = EstimateTwoViewGeometry(
-        camera1, points1, camera2, points2, remaining_matches, options_copy);
+    TwoViewGeometry geometry = EstimateTwoViewGeometry(camera1,
+                                                       points1,
+                                                       camera2,
+                                                       points2,
+                                                       remaining_matches,
+                                                       options_copy,
+                                                       gravity1,
+                                                       gravity2);
     if (geometry.config == TwoViewGeometry::ConfigurationType::DEGENERATE) {
       break;
     }
@@ -281,27 +455,46 @@ TwoViewGeometry EstimateTwoViewGeometry(
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
     const FeatureMatches& matches,
-    const TwoViewGeometryOptions& options) {
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1,
+    const Eigen::Vector3d* gravity2) {
   if (options.multiple_models) {
-    return EstimateMultipleTwoViewGeometries(
-        camera1, points1, camera2, points2, matches, options);
+    return EstimateMultipleTwoViewGeometries(camera1,
+                                             points1,
+                                             camera2,
+                                             points2,
+                                             matches,
+                                             options,
+                                             gravity1,
+                                             gravity2);
   } else if (options.force_H_use) {
     return EstimateCalibratedHomography(
         camera1, points1, camera2, points2, matches, options);
   } else if (camera1.has_prior_focal_length && camera2.has_prior_focal_length) {
-    return EstimateCalibratedTwoViewGeometry(
-        camera1, points1, camera2, points2, matches, options);
+    return EstimateCalibratedTwoViewGeometry(camera1,
+                                             points1,
+                                             camera2,
+                                             points2,
+                                             matches,
+                                             options,
+                                             gravity1,
+                                             gravity2);
   } else {
     return EstimateUncalibratedTwoViewGeometry(
         camera1, points1, camera2, points2, matches, options);
   }
 }
 
-bool EstimateTwoViewGeometryPose(const Camera& camera1,
-                                 const std::vector<Eigen::Vector2d>& points1,
-                                 const Camera& camera2,
-                                 const std::vector<Eigen::Vector2d>& points2,
-                                 TwoViewGeometry* geometry) {
+namespace {
+
+bool EstimateTwoViewGeometryPoseImpl(
+    const Camera& camera1,
+    const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector3d>* cam_rays1,
+    const Camera& camera2,
+    const std::vector<Eigen::Vector2d>& points2,
+    const std::vector<Eigen::Vector3d>* cam_rays2,
+    TwoViewGeometry* geometry) {
   // We need a valid epopolar geometry to estimate the relative pose.
   if (geometry->config != TwoViewGeometry::ConfigurationType::CALIBRATED &&
       geometry->config != TwoViewGeometry::ConfigurationType::UNCALIBRATED &&
@@ -318,25 +511,18 @@ bool EstimateTwoViewGeometryPose(const Camera& camera1,
     return false;
   }
 
-  std::vector<Eigen::Vector3d> inlier_cam_rays1(num_inlier_matches);
-  std::vector<Eigen::Vector3d> inlier_cam_rays2(num_inlier_matches);
-  for (size_t i = 0; i < num_inlier_matches; ++i) {
-    const FeatureMatch& match = geometry->inlier_matches[i];
-    if (const std::optional<Eigen::Vector2d> cam_point1 =
-            camera1.CamFromImg(points1[match.point2D_idx1]);
-        cam_point1) {
-      inlier_cam_rays1[i] = cam_point1->homogeneous().normalized();
-    } else {
-      inlier_cam_rays1[i].setZero();
-    }
-    if (const std::optional<Eigen::Vector2d> cam_point2 =
-            camera2.CamFromImg(points2[match.point2D_idx2]);
-        cam_point2) {
-      inlier_cam_rays2[i] = cam_point2->homogeneous().normalized();
-    } else {
-      inlier_cam_rays2[i].setZero();
-    }
-  }
+  const std::vector<Eigen::Vector3d> inlier_cam_rays1 =
+      MatchedCamRays(camera1,
+                     points1,
+                     cam_rays1,
+                     geometry->inlier_matches,
+                     &FeatureMatch::point2D_idx1);
+  const std::vector<Eigen::Vector3d> inlier_cam_rays2 =
+      MatchedCamRays(camera2,
+                     points2,
+                     cam_rays2,
+                     geometry->inlier_matches,
+                     &FeatureMatch::point2D_idx2);
 
   std::vector<Eigen::Vector3d> points3D;
 
@@ -408,15 +594,24 @@ bool EstimateTwoViewGeometryPose(const Camera& camera1,
   return true;
 }
 
-TwoViewGeometry EstimateCalibratedTwoViewGeometry(
+TwoViewGeometry EstimateCalibratedTwoViewGeometryImpl(
     const Camera& camera1,
     const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector3d>* cam_rays1,
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
-    const FeatureMatches& matches,
-    const TwoViewGeometryOptions& options) {
+    const std::vector<Eigen::Vector3d>* cam_rays2,
+    const FeatureMatches& input_matches,
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1,
+    const Eigen::Vector3d* gravity2) {
   THROW_CHECK(options.Check());
 
+  const bool progressive_sampling =
+      UseProgressiveSampling(options, input_matches);
+  const FeatureMatches matches =
+      OrderMatchesForSampling(input_matches, progressive_sampling);
+
   TwoViewGeometry geometry;
 
   const size_t min_num_inliers = static_cast<size_t>(options.min_num_inliers);
@@ -428,28 +623,24 @@ TwoViewGeometry EstimateCalibratedTwoViewGeometry(
   // Extract corresponding points.
   std::vector<Eigen::Vector2d> matched_img_points1(matches.size());
   std::vector<Eigen::Vector2d> matched_img_points2(matches.size());
-  std::vector<Eigen::Vector3d> matched_cam_rays1(matches.size());
-  std::vector<Eigen::Vector3d> matched_cam_rays2(matches.size());
   for (size_t i = 0; i < matches.size(); ++i) {
-    const point2D_t idx1 = matches[i].point2D_idx1;
-    const point2D_t idx2 = matches[i].point2D_idx2;
-    matched_img_points1[i] = points1[idx1];
-    matched_img_points2[i] = points2[idx2];
-    if (const std::optional<Eigen::Vector2d> cam_point1 =
-            camera1.CamFromImg(points1[idx1]);
-        cam_point1) {
-      matched_cam_rays1[i] = cam_point1->homogeneous().normalized();
-    } else {
-      matched_cam_rays1[i].setZero();
-    }
-    if (const std::optional<Eigen::Vector2d> cam_point2 =
-            camera2.CamFromImg(points2[idx2]);
-        cam_point2) {
-      matched_cam_rays2[i] = cam_point2->homogeneous().normalized();
-    } else {
-      matched_cam_rays2[i].setZero();
-    }
+    matched_img_points1[i] = points1[matches[i].point2D_idx1];
+    matched_img_points2[i] = points2[matches[i].point2D_idx2];
   }
+  const std::vector<Eigen::Vector3d> matched_cam_rays1 =
+      cam_rays1 == nullptr ? CamRaysFromImg(camera1, matched_img_points1)
+                           : MatchedCamRays(camera1,
+                                            points1,
+                                            cam_rays1,
+                                            matches,
+                                            &FeatureMatch::point2D_idx1);
+  const std::vector<Eigen::Vector3d> matched_cam_rays2 =
+      cam_rays2 == nullptr ? CamRaysFromImg(camera2, matched_img_points2)
+                           : MatchedCamRays(camera2,
+                                            points2,
+                                            cam_rays2,
+                                            matches,
+                                            &FeatureMatch::point2D_idx2);
 
   // Estimate epipolar models.
 
@@ -459,24 +650,35 @@ TwoViewGeometry EstimateCalibratedTwoViewGeometry(
        camera2.CamFromImgThreshold(options.ransac_options.max_error)) /
       2;
 
-  LORANSAC<EssentialMatrixFivePointEstimator, EssentialMatrixFivePointEstimator>
-      E_ransac(E_ransac_options);
-  const auto E_report = E_ransac.Estimate(matched_cam_rays1, matched_cam_rays2);
+  const auto E_report = EstimateEssentialMatrixLORANSAC(
+      E_ransac_options,
+      progressive_sampling,
+      options.minimal_solver_backend,
+      options.use_gravity ? gravity1 : nullptr,
+      options.use_gravity ? gravity2 : nullptr,
+      matched_cam_rays1,
+      matched_cam_rays2);
   geometry.E = E_report.model;
 
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
   const auto F_report =
-      F_ransac.Estimate(matched_img_points1, matched_img_points2);
+      EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                       FundamentalMatrixEightPointEstimator>(
+          options.ransac_options,
+          progressive_sampling,
+          options.minimal_solver_backend,
+          matched_img_points1,
+          matched_img_points2);
   geometry.F = F_report.model;
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
   const auto H_report =
-      H_ransac.Estimate(matched_img_points1, matched_img_points2);
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options.ransac_options,
+          progressive_sampling,
+          options.minimal_solver_backend,
+          matched_img_points1,
+          matched_img_points2);
   geometry.H = H_report.model;
 
   if ((!E_report.success && !F_report.success && !H_report.success) ||
@@ -565,14 +767,84 @@ TwoViewGeometry EstimateCalibratedTwoViewGeometry(
     }
 
     if (options.compute_relative_pose) {
-      EstimateTwoViewGeometryPose(
-          camera1, points1, camera2, points2, &geometry);
+      EstimateTwoViewGeometryPoseImpl(
+          camera1, points1, cam_rays1, camera2, points2, cam_rays2, &geometry);
     }
   }
 
   return geometry;
 }
 
+}  // namespace
+
+bool EstimateTwoViewGeometryPose(const Camera& camera1,
+                                 const std::vector<Eigen::Vector2d>& points1,
+                                 const Camera& camera2,
+                                 const std::vector<Eigen::Vector2d>& points2,
+                                 TwoViewGeometry* geometry) {
+  return EstimateTwoViewGeometryPoseImpl(
+      camera1, points1, nullptr, camera2, points2, nullptr, geometry);
+}
+
+bool EstimateTwoViewGeometryPose(const Camera& camera1,
+                                 const std::vector<Eigen::Vector2d>& points1,
+                                 const std::vector<Eigen::Vector3d>& cam_rays1,
+                                 const Camera& camera2,
+                                 const std::vector<Eigen::Vector2d>& points2,
+                                 const std::vector<Eigen::Vector3d>& cam_rays2,
+                                 TwoViewGeometry* geometry) {
+  THROW_CHECK_EQ(points1.size(), cam_rays1.size());
+  THROW_CHECK_EQ(points2.size(), cam_rays2.size());
+  return EstimateTwoViewGeometryPoseImpl(
+      camera1, points1, &cam_rays1, camera2, points2, &cam_rays2, geometry);
+}
+
+TwoViewGeometry EstimateCalibratedTwoViewGeometry(
+    const Camera& camera1,
+    const std::vector<Eigen::Vector2d>& points1,
+    const Camera& camera2,
+    const std::vector<Eigen::Vector2d>& points2,
+    const FeatureMatches& matches,
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1,
+    const Eigen::Vector3d* gravity2) {
+  return EstimateCalibratedTwoViewGeometryImpl(camera1,
+                                               points1,
+                                               nullptr,
+                                               camera2,
+                                               points2,
+                                               nullptr,
+                                               matches,
+                                               options,
+                                               gravity1,
+                                               gravity2);
+}
+
+TwoViewGeometry EstimateCalibratedTwoViewGeometry(
+    const Camera& camera1,
+    const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector3d>& cam_rays1,
+    const Camera& camera2,
+    const std::vector<Eigen::Vector2d>& points2,
+    const std::vector<Eigen::Vector3d>& cam_rays2,
+    const FeatureMatches& matches,
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1,
+    const Eigen::Vector3d* gravity2) {
+  THROW_CHECK_EQ(points1.size(), cam_rays1.size());
+  THROW_CHECK_EQ(points2.size(), cam_rays2.size());
+  return EstimateCalibratedTwoViewGeometryImpl(camera1,
+                                               points1,
+                                               &cam_rays1,
+                                               camera2,
+                                               points2,
+                                               &cam_rays2,
+                                               matches,
+                                               options,
+                                               gravity1,
+                                               gravity2);
+}
+
 bool DetectWatermark(const Camera& camera1,
                      const std::vector<Eigen::Vector2d>& points1,
                      const Camera& camera2,
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../estimators/minimal_solver.h"
 #include "../feature/types.h"
 #include "../geometry/rigid3.h"
 #include "../optim/ransac.h"
@@ -65,6 +66,21 @@ struct TwoViewGeometryOptions {
   // field will be initialized.
   bool multiple_models = false;
 
+  // Whether to draw the RANSAC samples progressively from the most distinctive
+  // matches (PROSAC), as ranked by the distance ratio of the matcher, instead
+  // of uniformly at random. Matches without distance ratios, e.g. read from
+  // the database, are always sampled uniformly at random.
+  bool progressive_sampling = true;
+
+  // Backend of the minimal solvers in RANSAC, see MinimalSolverBackend.
+  MinimalSolverBackend minimal_solver_backend = MinimalSolverBackend::DEFAULT;
+
+  // Whether to hypothesize the essential matrix of calibrated image pairs
+  // with the upright 3-point solver, if the gravity directions of both images
+  // are given. The local optimization still estimates all rotational degrees
+  // of freedom, such that noisy gravity only affects the sampling.
+  bool use_gravity = true;
+
   // TwoViewGeometryOptions used to robustly estimate the geometry.
   RANSACOptions ransac_options;
 
@@ -74,6 +90,7 @@ struct TwoViewGeometryOptions {
     ransac_options.min_num_trials = 100;
     ransac_options.max_num_trials = 10000;
     ransac_options.min_inlier_ratio = 0.25;
+    ransac_options.use_sprt = true;
   }
 
   bool Check() const;
@@ -88,13 +105,17 @@ struct TwoViewGeometryOptions {
 // @param points2         Feature points in second image.
 // @param matches         Feature matches between first and second image.
 // @param options         Two-view geometry estimation options.
+// @param gravity1        Optional unit gravity direction in the first camera.
+// @param gravity2        Optional unit gravity direction in the second camera.
 TwoViewGeometry EstimateTwoViewGeometry(
     const Camera& camera1,
     const std::vector<Eigen::Vector2d>& points1,
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
     const FeatureMatches& matches,
-    const TwoViewGeometryOptions& options);
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1 = nullptr,
+    const Eigen::Vector3d* gravity2 = nullptr);
 
 // Estimate relative pose for two-view geometry.
 //
@@ -110,6 +131,16 @@ bool EstimateTwoViewGeometryPose(const Camera& camera1,
                                  const std::vector<Eigen::Vector2d>& points2,
                                  TwoViewGeometry* geometry);
 
+// Same as above, but with the normalized camera rays of all feature points
+// given, e.g. from the `DatabaseCache`, instead of transforming the points.
+bool EstimateTwoViewGeometryPose(const Camera& camera1,
+                                 const std::vector<Eigen::Vector2d>& points1,
+                                 const std::vector<Eigen::Vector3d>& cam_rays1,
+                                 const Camera& camera2,
+                                 const std::vector<Eigen::Vector2d>& points2,
+                                 const std::vector<Eigen::Vector3d>& cam_rays2,
+                                 TwoViewGeometry* geometry);
+
 // Estimate two-view geometry from calibrated image pair.
 //
 // @param camera1         Camera of first image.
@@ -118,13 +149,31 @@ bool EstimateTwoViewGeometryPose(const Camera& camera1,
 // @param points2         Feature points in second image.
 // @param matches         Feature matches between first and second image.
 // @param options         Two-view geometry estimation options.
+// @param gravity1        Optional unit gravity direction in the first camera.
+// @param gravity2        Optional unit gravity direction in the second camera.
+TwoViewGeometry EstimateCalibratedTwoViewGeometry(
+    const Camera& camera1,
+    const std::vector<Eigen::Vector2d>& points1,
+    const Camera& camera2,
+    const std::vector<Eigen::Vector2d>& points2,
+    const FeatureMatches& matches,
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1 = nullptr,
+    const Eigen::Vector3d* gravity2 = nullptr);
+
+// Same as above, but with the normalized camera rays of all feature points
+// given, e.g. from the `DatabaseCache`, instead of transforming the points.
 TwoViewGeometry EstimateCalibratedTwoViewGeometry(
     const Camera& camera1,
     const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector3d>& cam_rays1,
     const Camera& camera2,
     const std::vector<Eigen::Vector2d>& points2,
+    const std::vector<Eigen::Vector3d>& cam_rays2,
     const FeatureMatches& matches,
-    const TwoViewGeometryOptions& options);
+    const TwoViewGeometryOptions& options,
+    const Eigen::Vector3d* gravity1 = nullptr,
+    const Eigen::Vector3d* gravity2 = nullptr);
 
 // Detect if inlier matches are caused by a watermark.
 // A watermark causes a pure translation in the border are of the image.
@@ -1,5 +1,6 @@
 #include "utils.h"
 
+#include "../math/simd.h"
 #include "../util/logging.h"
 
 #include <PoseLib/alignment.h>
@@ -85,4 +86,123 @@ void ComputeSquaredSampsonError(const std::vector<Eigen::Vector3d>& ray1,
   }
 }
 
+void PackCorrespondences(const std::vector<Eigen::Vector2d>& points1,
+                         const std::vector<Eigen::Vector2d>& points2,
+                         const std::vector<size_t>& order,
+                         PackedCorrespondences* packed) {
+  THROW_CHECK_EQ(points1.size(), points2.size());
+  const size_t num_points = order.size();
+  packed->x1.resize(num_points);
+  packed->y1.resize(num_points);
+  packed->z1.clear();
+  packed->x2.resize(num_points);
+  packed->y2.resize(num_points);
+  packed->z2.clear();
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Vector2d& point1 = points1[order[i]];
+    const Eigen::Vector2d& point2 = points2[order[i]];
+    packed->x1[i] = static_cast<float>(point1.x());
+    packed->y1[i] = static_cast<float>(point1.y());
+    packed->x2[i] = static_cast<float>(point2.x());
+    packed->y2[i] = static_cast<float>(point2.y());
+  }
+}
+
+void PackCorrespondences(const std::vector<Eigen::Vector3d>& rays1,
+                         const std::vector<Eigen::Vector3d>& rays2,
+                         const std::vector<size_t>& order,
+                         PackedCorrespondences* packed) {
+  THROW_CHECK_EQ(rays1.size(), rays2.size());
+  const size_t num_rays = order.size();
+  packed->x1.resize(num_rays);
+  packed->y1.resize(num_rays);
+  packed->z1.resize(num_rays);
+  packed->x2.resize(num_rays);
+  packed->y2.resize(num_rays);
+  packed->z2.resize(num_rays);
+  for (size_t i = 0; i < num_rays; ++i) {
+    const Eigen::Vector3d& ray1 = rays1[order[i]];
+    const Eigen::Vector3d& ray2 = rays2[order[i]];
+    packed->x1[i] = static_cast<float>(ray1.x());
+    packed->y1[i] = static_cast<float>(ray1.y());
+    packed->z1[i] = static_cast<float>(ray1.z());
+    packed->x2[i] = static_cast<float>(ray2.x());
+    packed->y2[i] = static_cast<float>(ray2.y());
+    packed->z2[i] = static_cast<float>(ray2.z());
+  }
+}
+
+namespace {
+
+// Squared Sampson error for float and Float4, where E is in row-major order.
+template <typename T>
+inline T SquaredSampsonError(const T E[9],
+                             const T& x1,
+                             const T& y1,
+                             const T& z1,
+                             const T& x2,
+                             const T& y2,
+                             const T& z2) {
+  const T line1_x = E[0] * x1 + E[1] * y1 + E[2] * z1;
+  const T line1_y = E[3] * x1 + E[4] * y1 + E[5] * z1;
+  const T line1_z = E[6] * x1 + E[7] * y1 + E[8] * z1;
+  const T line2_x = x2 * E[0] + y2 * E[3] + z2 * E[6];
+  const T line2_y = x2 * E[1] + y2 * E[4] + z2 * E[7];
+  const T num = x2 * line1_x + y2 * line1_y + z2 * line1_z;
+  return num * num / (line2_x * line2_x + line2_y * line2_y +
+                      line1_x * line1_x + line1_y * line1_y);
+}
+
+template <bool kIsRay>
+void ComputeSquaredSampsonErrorImpl(const PackedCorrespondences& packed,
+                                    const Eigen::Matrix3d& E,
+                                    const size_t begin,
+                                    const size_t end,
+                                    float* residuals) {
+  float E_float[9];
+  Float4 E_float4[9];
+  for (int i = 0; i < 9; ++i) {
+    E_float[i] = static_cast<float>(E(i / 3, i % 3));
+    E_float4[i] = Float4::Broadcast(E_float[i]);
+  }
+
+  const Float4 one = Float4::Broadcast(1);
+  size_t i = begin;
+  for (; i + Float4::kSize <= end; i += Float4::kSize) {
+    SquaredSampsonError(E_float4,
+                        Float4::Load(&packed.x1[i]),
+                        Float4::Load(&packed.y1[i]),
+                        kIsRay ? Float4::Load(&packed.z1[i]) : one,
+                        Float4::Load(&packed.x2[i]),
+                        Float4::Load(&packed.y2[i]),
+                        kIsRay ? Float4::Load(&packed.z2[i]) : one)
+        .Store(residuals + i - begin);
+  }
+  for (; i < end; ++i) {
+    residuals[i - begin] = SquaredSampsonError(E_float,
+                                               packed.x1[i],
+                                               packed.y1[i],
+                                               kIsRay ? packed.z1[i] : 1.0f,
+                                               packed.x2[i],
+                                               packed.y2[i],
+                                               kIsRay ? packed.z2[i] : 1.0f);
+  }
+}
+
+}  // namespace
+
+void ComputeSquaredSampsonError(const PackedCorrespondences& packed,
+                                const Eigen::Matrix3d& E,
+                                const size_t begin,
+                                const size_t end,
+                                float* residuals) {
+  THROW_CHECK_LE(begin, end);
+  THROW_CHECK_LE(end, packed.Size());
+  if (packed.z1.empty()) {
+    ComputeSquaredSampsonErrorImpl<false>(packed, E, begin, end, residuals);
+  } else {
+    ComputeSquaredSampsonErrorImpl<true>(packed, E, begin, end, residuals);
+  }
+}
+
 }  // namespace colmap
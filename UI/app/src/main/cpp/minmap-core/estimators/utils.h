@@ -46,4 +46,44 @@ void ComputeSquaredSampsonError(const std::vector<Eigen::Vector3d>& rays1,
                                 const Eigen::Matrix3d& E,
                                 std::vector<double>* residuals);
 
+// Corresponding points or rays in structure-of-arrays layout and single
+// precision for the vectorized residual kernels, which RANSAC packs once per
+// estimation instead of evaluating the residuals point by point. The z
+// coordinates are empty for points.
+struct PackedCorrespondences {
+  std::vector<float> x1;
+  std::vector<float> y1;
+  std::vector<float> z1;
+  std::vector<float> x2;
+  std::vector<float> y2;
+  std::vector<float> z2;
+
+  inline size_t Size() const { return x1.size(); }
+};
+
+// Pack the corresponding points or rays in the given order of their indices.
+void PackCorrespondences(const std::vector<Eigen::Vector2d>& points1,
+                         const std::vector<Eigen::Vector2d>& points2,
+                         const std::vector<size_t>& order,
+                         PackedCorrespondences* packed);
+void PackCorrespondences(const std::vector<Eigen::Vector3d>& rays1,
+                         const std::vector<Eigen::Vector3d>& rays2,
+                         const std::vector<size_t>& order,
+                         PackedCorrespondences* packed);
+
+// Calculate the squared Sampson error of the packed correspondences in the
+// range [begin, end) in single precision. In contrast to the double precision
+// variant, degenerate correspondences have an infinite or NaN residual, which
+// is never an inlier.
+//
+// @param packed      Packed corresponding points or rays.
+// @param E           3x3 fundamental or essential matrix.
+// @param begin, end  Range of the correspondences.
+// @param residuals   Output array of `end - begin` residuals.
+void ComputeSquaredSampsonError(const PackedCorrespondences& packed,
+                                const Eigen::Matrix3d& E,
+                                size_t begin,
+                                size_t end,
+                                float* residuals);
+
 }  // namespace colmap
@@ -18,6 +18,7 @@ class FaissFeatureDescriptorIndex : public FeatureDescriptorIndex {
   void Build(const FeatureDescriptorsFloat& index_descriptors) override {
     if (index_descriptors.rows() == 0) {
       index_ = nullptr;
+      num_bytes_ = 0;
       return;
     }
     // OpenMP disabled for Android
@@ -36,10 +37,16 @@ class FaissFeatureDescriptorIndex : public FeatureDescriptorIndex {
         index_impl->cp.min_points_per_centroid = 1;
         index_->train(index_descriptors.rows(), index_descriptors.data());
         index_->add(index_descriptors.rows(), index_descriptors.data());
+        // Inverted lists store an id next to each code.
+        num_bytes_ =
+            index_->ntotal * (index_impl->code_size + sizeof(faiss::idx_t)) +
+            coarse_quantizer_->ntotal * coarse_quantizer_->code_size;
       } else {
-        index_ = std::make_unique<faiss::IndexFlatL2>(
+        auto index_impl = std::make_unique<faiss::IndexFlatL2>(
             /*d=*/index_descriptors.cols());
-        index_->add(index_descriptors.rows(), index_descriptors.data());
+        index_impl->add(index_descriptors.rows(), index_descriptors.data());
+        num_bytes_ = index_impl->ntotal * index_impl->code_size;
+        index_ = std::move(index_impl);
       }
     }
   }
@@ -82,10 +89,13 @@ class FaissFeatureDescriptorIndex : public FeatureDescriptorIndex {
     indices = indices_long.cast<int>();
   }
 
+  size_t NumBytes() const override { return num_bytes_; }
+
  private:
   const int num_threads_;
   std::unique_ptr<faiss::Index> index_;
   std::unique_ptr<faiss::IndexFlatL2> coarse_quantizer_;
+  size_t num_bytes_ = 0;
 };
 
 }  // namespace
@@ -25,6 +25,9 @@ class FeatureDescriptorIndex {
                       const FeatureDescriptorsFloat& query_descriptors,
                       Eigen::RowMajorMatrixXi& indices,
                       Eigen::RowMajorMatrixXf& l2_dists) const = 0;
+
+  // The approximate size of the built index in memory.
+  virtual size_t NumBytes() const = 0;
 };
 
 }  // namespace colmap
@@ -3,39 +3,57 @@
 namespace colmap {
 
 FeatureMatcherCache::FeatureMatcherCache(
-    const size_t cache_size, const std::shared_ptr<Database>& database)
+    const size_t cache_size,
+    const std::shared_ptr<Database>& database,
+    std::shared_ptr<CacheMemoryBudget> memory_budget)
     : cache_size_(cache_size),
       database_(THROW_CHECK_NOTNULL(database)),
-      descriptor_index_cache_(cache_size_, [this](const image_t image_id) {
-        auto descriptors = GetDescriptors(image_id);
-        auto index = FeatureDescriptorIndex::Create();
-        index->Build(descriptors->cast<float>());
-        return index;
-      }) {
+      memory_budget_(memory_budget ? std::move(memory_budget)
+                                   : std::make_shared<CacheMemoryBudget>(
+                                         kDefaultMaxNumBytes)),
+      descriptor_index_cache_(
+          memory_budget_,
+          [this](const image_t image_id) {
+            auto descriptors = GetDescriptors(image_id);
+            auto index = FeatureDescriptorIndex::Create();
+            index->Build(descriptors->cast<float>());
+            return index;
+          },
+          [](const FeatureDescriptorIndex& index) {
+            return index.NumBytes();
+          }) {
   keypoints_cache_ =
-      std::make_unique<ThreadSafeLRUCache<image_t, FeatureKeypoints>>(
-          cache_size_, [this](const image_t image_id) {
+      std::make_unique<ShardedLRUCache<image_t, FeatureKeypoints>>(
+          memory_budget_,
+          [this](const image_t image_id) {
             std::lock_guard<std::mutex> lock(database_mutex_);
             return std::make_shared<FeatureKeypoints>(
                 database_->ReadKeypoints(image_id));
+          },
+          [](const FeatureKeypoints& keypoints) {
+            return keypoints.size() * sizeof(FeatureKeypoint);
           });
 
   descriptors_cache_ =
-      std::make_unique<ThreadSafeLRUCache<image_t, FeatureDescriptors>>(
-          cache_size_, [this](const image_t image_id) {
+      std::make_unique<ShardedLRUCache<image_t, FeatureDescriptors>>(
+          memory_budget_,
+          [this](const image_t image_id) {
             std::lock_guard<std::mutex> lock(database_mutex_);
             return std::make_shared<FeatureDescriptors>(
                 database_->ReadDescriptors(image_id));
+          },
+          [](const FeatureDescriptors& descriptors) {
+            return descriptors.size() * sizeof(FeatureDescriptors::Scalar);
           });
 
-  keypoints_exists_cache_ = std::make_unique<ThreadSafeLRUCache<image_t, bool>>(
+  keypoints_exists_cache_ = std::make_unique<ShardedLRUCache<image_t, bool>>(
       cache_size_, [this](const image_t image_id) {
         std::lock_guard<std::mutex> lock(database_mutex_);
         return std::make_shared<bool>(database_->ExistsKeypoints(image_id));
       });
 
   descriptors_exists_cache_ =
-      std::make_unique<ThreadSafeLRUCache<image_t, bool>>(
+      std::make_unique<ShardedLRUCache<image_t, bool>>(
           cache_size_, [this](const image_t image_id) {
             std::lock_guard<std::mutex> lock(database_mutex_);
             return std::make_shared<bool>(
@@ -64,6 +82,20 @@ const Image& FeatureMatcherCache::GetImage(const image_t image_id) {
   return images_cache_->at(image_id);
 }
 
+const PosePrior& FeatureMatcherCache::GetPosePrior(const image_t image_id) {
+  MaybeLoadPosePriors();
+  return pose_priors_cache_->at(image_id);
+}
+
+const Eigen::Vector3d* FeatureMatcherCache::GetGravity(const image_t image_id) {
+  MaybeLoadPosePriors();
+  const auto it = pose_priors_cache_->find(image_id);
+  if (it == pose_priors_cache_->end() || !it->second.IsGravityValid()) {
+    return nullptr;
+  }
+  return &it->second.gravity;
+}
+
 std::shared_ptr<FeatureKeypoints> FeatureMatcherCache::GetKeypoints(
     const image_t image_id) {
   return keypoints_cache_->Get(image_id);
@@ -110,11 +142,20 @@ std::vector<image_t> FeatureMatcherCache::GetImageIds() {
   return image_ids;
 }
 
-ThreadSafeLRUCache<image_t, FeatureDescriptorIndex>&
+ShardedLRUCache<image_t, FeatureDescriptorIndex>&
 FeatureMatcherCache::GetFeatureDescriptorIndexCache() {
   return descriptor_index_cache_;
 }
 
+CacheMemoryBudget& FeatureMatcherCache::GetMemoryBudget() {
+  return *memory_budget_;
+}
+
+bool FeatureMatcherCache::ExistsPosePrior(const image_t image_id) {
+  MaybeLoadPosePriors();
+  return pose_priors_cache_->count(image_id) > 0;
+}
+
 bool FeatureMatcherCache::ExistsKeypoints(const image_t image_id) {
   return *keypoints_exists_cache_->Get(image_id);
 }
@@ -41,10 +41,16 @@ class FeatureMatcher {
 };
 
 // Cache for feature matching to minimize database access during matching.
+// The keypoints, descriptors, and descriptor indices share one memory budget,
+// which is created with the default limit unless given.
 class FeatureMatcherCache {
  public:
-  FeatureMatcherCache(size_t cache_size,
-                      const std::shared_ptr<Database>& database);
+  static constexpr size_t kDefaultMaxNumBytes = 256 * 1024 * 1024;
+
+  FeatureMatcherCache(
+      size_t cache_size,
+      const std::shared_ptr<Database>& database,
+      std::shared_ptr<CacheMemoryBudget> memory_budget = nullptr);
 
   // Executes a function that accesses the database. This function is thread
   // safe and ensures that only one function can access the database at a time.
@@ -53,14 +59,19 @@ class FeatureMatcherCache {
   const Camera& GetCamera(camera_t camera_id);
   const Frame& GetFrame(frame_t frame_id);
   const Image& GetImage(image_t image_id);
+  const PosePrior& GetPosePrior(image_t image_id);
+  // The gravity direction of the image's pose prior or null if it is unknown.
+  const Eigen::Vector3d* GetGravity(image_t image_id);
   std::shared_ptr<FeatureKeypoints> GetKeypoints(image_t image_id);
   std::shared_ptr<FeatureDescriptors> GetDescriptors(image_t image_id);
   FeatureMatches GetMatches(image_t image_id1, image_t image_id2);
   std::vector<frame_t> GetFrameIds();
   std::vector<image_t> GetImageIds();
-  ThreadSafeLRUCache<image_t, FeatureDescriptorIndex>&
+  ShardedLRUCache<image_t, FeatureDescriptorIndex>&
   GetFeatureDescriptorIndexCache();
+  CacheMemoryBudget& GetMemoryBudget();
 
+  bool ExistsPosePrior(image_t image_id);
   bool ExistsKeypoints(image_t image_id);
   bool ExistsDescriptors(image_t image_id);
 
@@ -87,18 +98,18 @@ class FeatureMatcherCache {
 
   const size_t cache_size_;
   const std::shared_ptr<Database> database_;
+  const std::shared_ptr<CacheMemoryBudget> memory_budget_;
   std::mutex database_mutex_;
   std::unique_ptr<std::unordered_map<camera_t, Camera>> cameras_cache_;
   std::unique_ptr<std::unordered_map<frame_t, Frame>> frames_cache_;
   std::unique_ptr<std::unordered_map<image_t, Image>> images_cache_;
   std::unique_ptr<std::unordered_map<image_t, PosePrior>> pose_priors_cache_;
-  std::unique_ptr<ThreadSafeLRUCache<image_t, FeatureKeypoints>>
-      keypoints_cache_;
-  std::unique_ptr<ThreadSafeLRUCache<image_t, FeatureDescriptors>>
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureKeypoints>> keypoints_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureDescriptors>>
       descriptors_cache_;
-  std::unique_ptr<ThreadSafeLRUCache<image_t, bool>> keypoints_exists_cache_;
-  std::unique_ptr<ThreadSafeLRUCache<image_t, bool>> descriptors_exists_cache_;
-  ThreadSafeLRUCache<image_t, FeatureDescriptorIndex> descriptor_index_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, bool>> keypoints_exists_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, bool>> descriptors_exists_cache_;
+  ShardedLRUCache<image_t, FeatureDescriptorIndex> descriptor_index_cache_;
 };
 
 }  // namespace colmap
@@ -500,12 +500,14 @@ size_t FindBestMatchesOneWayBruteForce(
     const Eigen::RowMajorMatrixXf& dot_products,
     const float max_ratio,
     const float max_distance,
-    std::vector<int>* matches) {
+    std::vector<int>* matches,
+    std::vector<float>* distance_ratios) {
   constexpr float kInvSqDescriptorNorm =
       static_cast<float>(1. / kSqSiftDescriptorNorm);
 
   size_t num_matches = 0;
   matches->resize(dot_products.rows(), -1);
+  distance_ratios->resize(dot_products.rows(), 1.0f);
 
   for (Eigen::Index i1 = 0; i1 < dot_products.rows(); ++i1) {
     int best_d2_idx = -1;
@@ -547,6 +549,7 @@ size_t FindBestMatchesOneWayBruteForce(
 
     ++num_matches;
     (*matches)[i1] = best_d2_idx;
+    (*distance_ratios)[i1] = best_dist_normed / second_best_dist_normed;
   }
 
   return num_matches;
@@ -560,13 +563,23 @@ void FindBestMatchesBruteForce(const Eigen::RowMajorMatrixXf& dot_products,
   matches->clear();
 
   std::vector<int> matches_1to2;
-  const size_t num_matches_1to2 = FindBestMatchesOneWayBruteForce(
-      dot_products, max_ratio, max_distance, &matches_1to2);
+  std::vector<float> distance_ratios_1to2;
+  const size_t num_matches_1to2 =
+      FindBestMatchesOneWayBruteForce(dot_products,
+                                      max_ratio,
+                                      max_distance,
+                                      &matches_1to2,
+                                      &distance_ratios_1to2);
 
   if (cross_check) {
     std::vector<int> matches_2to1;
-    const size_t num_matches_2to1 = FindBestMatchesOneWayBruteForce(
-        dot_products.transpose(), max_ratio, max_distance, &matches_2to1);
+    std::vector<float> distance_ratios_2to1;
+    const size_t num_matches_2to1 =
+        FindBestMatchesOneWayBruteForce(dot_products.transpose(),
+                                        max_ratio,
+                                        max_distance,
+                                        &matches_2to1,
+                                        &distance_ratios_2to1);
     matches->reserve(std::min(num_matches_1to2, num_matches_2to1));
     for (size_t i1 = 0; i1 < matches_1to2.size(); ++i1) {
       if (matches_1to2[i1] != -1 && matches_2to1[matches_1to2[i1]] != -1 &&
@@ -574,6 +587,9 @@ void FindBestMatchesBruteForce(const Eigen::RowMajorMatrixXf& dot_products,
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches_1to2[i1];
+        match.distance_ratio =
+            std::max(distance_ratios_1to2[i1],
+                     distance_ratios_2to1[matches_1to2[i1]]);
         matches->push_back(match);
       }
     }
@@ -584,6 +600,7 @@ void FindBestMatchesBruteForce(const Eigen::RowMajorMatrixXf& dot_products,
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches_1to2[i1];
+        match.distance_ratio = distance_ratios_1to2[i1];
         matches->push_back(match);
       }
     }
@@ -594,11 +611,13 @@ size_t FindBestMatchesOneWayIndex(const Eigen::RowMajorMatrixXi& indices,
                                   const Eigen::RowMajorMatrixXf& l2_dists,
                                   const float max_ratio,
                                   const float max_distance,
-                                  std::vector<int>* matches) {
+                                  std::vector<int>* matches,
+                                  std::vector<float>* distance_ratios) {
   const float max_l2_dist = kSqSiftDescriptorNorm * max_distance * max_distance;
 
   size_t num_matches = 0;
   matches->resize(indices.rows(), -1);
+  distance_ratios->resize(indices.rows(), 1.0f);
 
   for (int d1_idx = 0; d1_idx < indices.rows(); ++d1_idx) {
     int best_d2_idx = -1;
@@ -628,12 +647,15 @@ size_t FindBestMatchesOneWayIndex(const Eigen::RowMajorMatrixXi& indices,
 
     // Check if match passes ratio test. Keep this comparison >= in order to
     // ensure that the case of best == second_best is detected.
-    if (std::sqrt(best_l2_dist) >= max_ratio * std::sqrt(second_best_l2_dist)) {
+    const float best_dist = std::sqrt(best_l2_dist);
+    const float second_best_dist = std::sqrt(second_best_l2_dist);
+    if (best_dist >= max_ratio * second_best_dist) {
       continue;
     }
 
     ++num_matches;
     (*matches)[d1_idx] = best_d2_idx;
+    (*distance_ratios)[d1_idx] = best_dist / second_best_dist;
   }
 
   return num_matches;
@@ -650,13 +672,25 @@ void FindBestMatchesIndex(const Eigen::RowMajorMatrixXi& indices_1to2,
   matches->clear();
 
   std::vector<int> matches_1to2;
-  const size_t num_matches_1to2 = FindBestMatchesOneWayIndex(
-      indices_1to2, l2_dists_1to2, max_ratio, max_distance, &matches_1to2);
+  std::vector<float> distance_ratios_1to2;
+  const size_t num_matches_1to2 =
+      FindBestMatchesOneWayIndex(indices_1to2,
+                                 l2_dists_1to2,
+                                 max_ratio,
+                                 max_distance,
+                                 &matches_1to2,
+                                 &distance_ratios_1to2);
 
   if (cross_check && indices_2to1.rows()) {
     std::vector<int> matches_2to1;
-    const size_t num_matches_2to1 = FindBestMatchesOneWayIndex(
-        indices_2to1, l2_dists_2to1, max_ratio, max_distance, &matches_2to1);
+    std::vector<float> distance_ratios_2to1;
+    const size_t num_matches_2to1 =
+        FindBestMatchesOneWayIndex(indices_2to1,
+                                   l2_dists_2to1,
+                                   max_ratio,
+                                   max_distance,
+                                   &matches_2to1,
+                                   &distance_ratios_2to1);
     matches->reserve(std::min(num_matches_1to2, num_matches_2to1));
     for (size_t i1 = 0; i1 < matches_1to2.size(); ++i1) {
       if (matches_1to2[i1] != -1 && matches_2to1[matches_1to2[i1]] != -1 &&
@@ -664,6 +698,9 @@ void FindBestMatchesIndex(const Eigen::RowMajorMatrixXi& indices_1to2,
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches_1to2[i1];
+        match.distance_ratio =
+            std::max(distance_ratios_1to2[i1],
+                     distance_ratios_2to1[matches_1to2[i1]]);
         matches->push_back(match);
       }
     }
@@ -674,6 +711,7 @@ void FindBestMatchesIndex(const Eigen::RowMajorMatrixXi& indices_1to2,
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches_1to2[i1];
+        match.distance_ratio = distance_ratios_1to2[i1];
         matches->push_back(match);
       }
     }
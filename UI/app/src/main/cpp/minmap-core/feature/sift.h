@@ -122,7 +122,7 @@ struct SiftMatchingOptions {
   bool cpu_brute_force_matcher = false;
 
   // Cache for reusing descriptor index for feature matching.
-  ThreadSafeLRUCache<image_t, FeatureDescriptorIndex>*
+  ShardedLRUCache<image_t, FeatureDescriptorIndex>*
       cpu_descriptor_index_cache = nullptr;
 
   bool Check() const;
@@ -64,6 +64,11 @@ struct FeatureMatch {
 
   // Feature index in second image.
   point2D_t point2D_idx2 = kInvalidPoint2DIdx;
+
+  // Ratio of the best to the second best descriptor distance in the ratio
+  // test, i.e. smaller ratios are more distinctive matches. Matches without
+  // known ratio, e.g. read from the database, have a ratio of 1.
+  float distance_ratio = 1.0f;
 };
 
 typedef std::vector<FeatureMatch> FeatureMatches;
@@ -8,7 +8,8 @@ std::ostream& operator<<(std::ostream& stream, const PosePrior& prior) {
   stream << "PosePrior(position=[" << prior.position.format(kVecFmt)
          << "], position_covariance=["
          << prior.position_covariance.format(kVecFmt) << "], coordinate_system="
-         << PosePrior::CoordinateSystemToString(prior.coordinate_system) << ")";
+         << PosePrior::CoordinateSystemToString(prior.coordinate_system)
+         << ", gravity=[" << prior.gravity.format(kVecFmt) << "])";
   return stream;
 }
 
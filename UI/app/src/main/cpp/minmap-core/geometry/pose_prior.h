@@ -38,6 +38,11 @@ struct PosePrior {
     Eigen::Matrix3d position_covariance =
         Eigen::Matrix3d::Constant(std::numeric_limits<double>::quiet_NaN());
     CoordinateSystem coordinate_system = CoordinateSystem::UNDEFINED;
+    // Unit direction of gravity in the camera frame, i.e. pointing down, e.g.
+    // from the accelerometer of a phone. A prior may have only a gravity
+    // direction and no position.
+    Eigen::Vector3d gravity =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::quiet_NaN());
 
     PosePrior() = default;
     explicit PosePrior(const Eigen::Vector3d& position) : position(position) {}
@@ -56,6 +61,7 @@ struct PosePrior {
     inline bool IsCovarianceValid() const {
     return position_covariance.allFinite();
     }
+    inline bool IsGravityValid() const { return gravity.allFinite(); }
 
     inline bool operator==(const PosePrior& other) const;
     inline bool operator!=(const PosePrior& other) const;
@@ -66,7 +72,9 @@ std::ostream& operator<<(std::ostream& stream, const PosePrior& prior);
 bool PosePrior::operator==(const PosePrior& other) const {
   return coordinate_system == other.coordinate_system &&
          position == other.position &&
-         position_covariance == other.position_covariance;
+         position_covariance == other.position_covariance &&
+         (gravity == other.gravity ||
+          (!IsGravityValid() && !other.IsGravityValid()));
 }
 
 bool PosePrior::operator!=(const PosePrior& other) const {
@@ -0,0 +1,117 @@
+#pragma once
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MINMAP_SIMD_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MINMAP_SIMD_SSE2
+#endif
+
+namespace colmap {
+
+// Four single precision values in one SIMD register, with NEON on arm64, SSE2
+// on x86 and a scalar fallback otherwise. Only the arithmetic needed by the
+// vectorized residual kernels is provided.
+struct Float4 {
+  static constexpr int kSize = 4;
+
+#if defined(MINMAP_SIMD_NEON)
+  float32x4_t v;
+#elif defined(MINMAP_SIMD_SSE2)
+  __m128 v;
+#else
+  float v[kSize];
+#endif
+
+  // Load or store four values, which need not be aligned.
+  inline static Float4 Load(const float* values);
+  inline void Store(float* values) const;
+
+  // Set all four values to the same value.
+  inline static Float4 Broadcast(float value);
+};
+
+inline Float4 operator+(const Float4& a, const Float4& b);
+inline Float4 operator-(const Float4& a, const Float4& b);
+inline Float4 operator*(const Float4& a, const Float4& b);
+inline Float4 operator/(const Float4& a, const Float4& b);
+
+// 1 / a, which is also defined for float, such that kernels can be written
+// generically for float and Float4.
+inline Float4 Reciprocal(const Float4& a);
+inline float Reciprocal(float a);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(MINMAP_SIMD_NEON)
+
+Float4 Float4::Load(const float* values) { return {vld1q_f32(values)}; }
+void Float4::Store(float* values) const { vst1q_f32(values, v); }
+Float4 Float4::Broadcast(const float value) { return {vdupq_n_f32(value)}; }
+
+Float4 operator+(const Float4& a, const Float4& b) {
+  return {vaddq_f32(a.v, b.v)};
+}
+Float4 operator-(const Float4& a, const Float4& b) {
+  return {vsubq_f32(a.v, b.v)};
+}
+Float4 operator*(const Float4& a, const Float4& b) {
+  return {vmulq_f32(a.v, b.v)};
+}
+Float4 operator/(const Float4& a, const Float4& b) {
+  return {vdivq_f32(a.v, b.v)};
+}
+
+#elif defined(MINMAP_SIMD_SSE2)
+
+Float4 Float4::Load(const float* values) { return {_mm_loadu_ps(values)}; }
+void Float4::Store(float* values) const { _mm_storeu_ps(values, v); }
+Float4 Float4::Broadcast(const float value) { return {_mm_set1_ps(value)}; }
+
+Float4 operator+(const Float4& a, const Float4& b) {
+  return {_mm_add_ps(a.v, b.v)};
+}
+Float4 operator-(const Float4& a, const Float4& b) {
+  return {_mm_sub_ps(a.v, b.v)};
+}
+Float4 operator*(const Float4& a, const Float4& b) {
+  return {_mm_mul_ps(a.v, b.v)};
+}
+Float4 operator/(const Float4& a, const Float4& b) {
+  return {_mm_div_ps(a.v, b.v)};
+}
+
+#else
+
+Float4 Float4::Load(const float* values) {
+  return {{values[0], values[1], values[2], values[3]}};
+}
+void Float4::Store(float* values) const {
+  for (int i = 0; i < kSize; ++i) {
+    values[i] = v[i];
+  }
+}
+Float4 Float4::Broadcast(const float value) {
+  return {{value, value, value, value}};
+}
+
+#define MINMAP_FLOAT4_OPERATOR(op)                                \
+  Float4 operator op(const Float4& a, const Float4& b) {          \
+    return {{a.v[0] op b.v[0], a.v[1] op b.v[1], a.v[2] op b.v[2], \
+             a.v[3] op b.v[3]}};                                  \
+  }
+MINMAP_FLOAT4_OPERATOR(+)
+MINMAP_FLOAT4_OPERATOR(-)
+MINMAP_FLOAT4_OPERATOR(*)
+MINMAP_FLOAT4_OPERATOR(/)
+#undef MINMAP_FLOAT4_OPERATOR
+
+#endif
+
+Float4 Reciprocal(const Float4& a) { return Float4::Broadcast(1) / a; }
+float Reciprocal(const float a) { return 1 / a; }
+
+}  // namespace colmap
@@ -9,6 +9,7 @@
 #include <optional>
 #include <random>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace colmap {
@@ -46,6 +47,12 @@ class LORANSAC : public RANSAC<Estimator, SupportMeasurer, Sampler> {
 
  private:
   using RANSAC<Estimator, SupportMeasurer, Sampler>::options_;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::sampler_max_num_trials_;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::sprt_;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::kPackedResiduals;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::InitializeEvaluation;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::EvaluateSampleModel;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeDynNumTrials;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -108,6 +115,8 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
   std::vector<typename LocalEstimator::M_t> local_models;
 
   sampler.Initialize(num_samples);
+  sampler_max_num_trials_ = std::numeric_limits<size_t>::max();
+  InitializeEvaluation(X, Y);
 
   size_t max_num_trials =
       std::min<size_t>(options_.max_num_trials, sampler.MaxNumSamples());
@@ -128,74 +137,100 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
 
     // Iterate through all estimated models
     for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
-
-      // Do local optimization if better than all previous subsets.
-      if (support_measurer.IsLeftBetter(support, best_support)) {
-        best_support = support;
-        best_model = sample_model;
-        best_model_is_local = false;
-
-        // Estimate locally optimized model from inliers.
-        if (support.num_inliers > Estimator::kMinNumSamples &&
-            support.num_inliers >= LocalEstimator::kMinNumSamples) {
-          // Recursive local optimization to expand inlier set.
-          const size_t kMaxNumLocalTrials = 10;
-          for (size_t local_num_trials = 0;
-               local_num_trials < kMaxNumLocalTrials;
-               ++local_num_trials) {
-            X_inlier.clear();
-            Y_inlier.clear();
-            X_inlier.reserve(num_samples);
-            Y_inlier.reserve(num_samples);
-            for (size_t i = 0; i < residuals.size(); ++i) {
-              if (residuals[i] <= max_residual) {
-                X_inlier.push_back(X[i]);
-                Y_inlier.push_back(Y[i]);
-              }
+      typename SupportMeasurer::Support support;
+      if (EvaluateSampleModel(
+              X, Y, sample_model, max_residual, &support, &residuals)) {
+        // Do local optimization if better than all previous subsets.
+        if (support_measurer.IsLeftBetter(support, best_support)) {
+          best_support = support;
+          best_model = sample_model;
+          best_model_is_local = false;
+
+          // Estimate locally optimized model from inliers.
+          if (support.num_inliers > Estimator::kMinNumSamples &&
+              support.num_inliers >= LocalEstimator::kMinNumSamples) {
+            // The packed evaluation does not compute the residuals, which
+            // determine the inliers for the local optimization.
+            if constexpr (kPackedResiduals) {
+              estimator.Residuals(X, Y, sample_model, &residuals);
             }
 
-            local_estimator.Estimate(X_inlier, Y_inlier, &local_models);
+            // Recursive local optimization to expand inlier set.
+            const size_t kMaxNumLocalTrials = 10;
+            for (size_t local_num_trials = 0;
+                 local_num_trials < kMaxNumLocalTrials;
+                 ++local_num_trials) {
+              X_inlier.clear();
+              Y_inlier.clear();
+              X_inlier.reserve(num_samples);
+              Y_inlier.reserve(num_samples);
+              for (size_t i = 0; i < residuals.size(); ++i) {
+                if (residuals[i] <= max_residual) {
+                  X_inlier.push_back(X[i]);
+                  Y_inlier.push_back(Y[i]);
+                }
+              }
+
+              local_estimator.Estimate(X_inlier, Y_inlier, &local_models);
 
-            const size_t prev_best_num_inliers = best_support.num_inliers;
+              const size_t prev_best_num_inliers = best_support.num_inliers;
 
-            for (const auto& local_model : local_models) {
-              local_estimator.Residuals(X, Y, local_model, &residuals);
-              THROW_CHECK_EQ(residuals.size(), num_samples);
+              for (const auto& local_model : local_models) {
+                local_estimator.Residuals(X, Y, local_model, &residuals);
+                THROW_CHECK_EQ(residuals.size(), num_samples);
 
-              const auto local_support =
-                  support_measurer.Evaluate(residuals, max_residual);
+                const auto local_support =
+                    support_measurer.Evaluate(residuals, max_residual);
 
-              // Check if locally optimized model is better.
-              if (support_measurer.IsLeftBetter(local_support, best_support)) {
-                best_support = local_support;
-                best_model = local_model;
-                best_model_is_local = true;
-                std::swap(residuals, best_local_residuals);
+                // Check if locally optimized model is better.
+                if (support_measurer.IsLeftBetter(local_support,
+                                                  best_support)) {
+                  best_support = local_support;
+                  best_model = local_model;
+                  best_model_is_local = true;
+                  std::swap(residuals, best_local_residuals);
+                }
               }
-            }
 
-            // Only continue recursive local optimization, if the inlier set
-            // size increased and we thus have a chance to further improve.
-            if (best_support.num_inliers <= prev_best_num_inliers) {
-              break;
+              // Only continue recursive local optimization, if the inlier set
+              // size increased and we thus have a chance to further improve.
+              if (best_support.num_inliers <= prev_best_num_inliers) {
+                break;
+              }
+
+              // Swap back the residuals, so we can extract the best inlier
+              // set in the next recursion of local optimization.
+              std::swap(residuals, best_local_residuals);
             }
+          }
 
-            // Swap back the residuals, so we can extract the best inlier
-            // set in the next recursion of local optimization.
-            std::swap(residuals, best_local_residuals);
+          if (options_.use_sprt) {
+            sprt_.UpdateEpsilon(static_cast<double>(best_support.num_inliers) /
+                                num_samples);
+          }
+
+          if constexpr (std::is_base_of_v<ProgressiveSampler, Sampler>) {
+            // The residuals of the best model were overwritten by the local
+            // optimization.
+            if (best_model_is_local) {
+              local_estimator.Residuals(X, Y, *best_model, &residuals);
+            } else {
+              estimator.Residuals(X, Y, *best_model, &residuals);
+            }
+            sampler_max_num_trials_ =
+                sampler.ComputeNumTrials(residuals,
+                                         max_residual,
+                                         options_.confidence,
+                                         options_.dyn_num_trials_multiplier);
           }
-        }
 
+          dyn_max_num_trials =
+              ComputeDynNumTrials(best_support.num_inliers, num_samples);
+        }
+      } else if (best_model.has_value()) {
+        // The rejection may have redesigned the SPRT.
         dyn_max_num_trials =
-            RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
-                best_support.num_inliers,
-                num_samples,
-                options_.confidence,
-                options_.dyn_num_trials_multiplier);
+            ComputeDynNumTrials(best_support.num_inliers, num_samples);
       }
 
       if (report.num_trials >= dyn_max_num_trials &&
@@ -237,6 +272,11 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
     report.inlier_mask[i] = residuals[i] <= max_residual;
   }
 
+  // Make the support consistent with the inlier mask in double precision.
+  if constexpr (kPackedResiduals) {
+    report.support = support_measurer.Evaluate(residuals, max_residual);
+  }
+
   return report;
 }
 
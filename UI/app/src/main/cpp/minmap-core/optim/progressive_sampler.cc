@@ -0,0 +1,127 @@
+#include "progressive_sampler.h"
+
+#include "../math/random.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace colmap {
+
+ProgressiveSampler::ProgressiveSampler(const size_t num_samples)
+    : num_samples_(num_samples),
+      total_num_samples_(0),
+      t_(0),
+      n_(0),
+      T_n_(0),
+      T_n_prime_(0) {}
+
+void ProgressiveSampler::Initialize(const size_t total_num_samples) {
+  THROW_CHECK_LE(num_samples_, total_num_samples);
+  total_num_samples_ = total_num_samples;
+
+  t_ = 0;
+  n_ = num_samples_;
+
+  // Expected number of samples from the first `num_samples_` data out of
+  // `kNumProgressiveTrials` samples from all data.
+  T_n_ = kNumProgressiveTrials;
+  for (size_t i = 0; i < num_samples_; ++i) {
+    T_n_ *= static_cast<double>(num_samples_ - i) / (total_num_samples_ - i);
+  }
+  T_n_prime_ = 1;
+}
+
+size_t ProgressiveSampler::MaxNumSamples() {
+  return std::numeric_limits<size_t>::max();
+}
+
+void ProgressiveSampler::Sample(std::vector<size_t>* sampled_idxs) {
+  t_ += 1;
+
+  // Grow the set of the highest quality data.
+  if (t_ >= T_n_prime_ && n_ < total_num_samples_) {
+    const double T_n_plus_1 = T_n_ * (n_ + 1) / (n_ + 1 - num_samples_);
+    T_n_prime_ += std::ceil(T_n_plus_1 - T_n_);
+    T_n_ = T_n_plus_1;
+    n_ += 1;
+  }
+
+  // Until the set grows again, the samples contain the data with the lowest
+  // quality in the set, such that every sample is drawn at most once. Later
+  // samples are drawn uniformly from the set.
+  const bool progressive = t_ < T_n_prime_;
+  const size_t num_random_samples =
+      progressive ? num_samples_ - 1 : num_samples_;
+  const size_t max_random_sample_idx = progressive ? n_ - 2 : n_ - 1;
+
+  sampled_idxs->clear();
+  while (sampled_idxs->size() < num_random_samples) {
+    const size_t sample_idx =
+        RandomUniformInteger<size_t>(0, max_random_sample_idx);
+    if (std::find(sampled_idxs->begin(), sampled_idxs->end(), sample_idx) ==
+        sampled_idxs->end()) {
+      sampled_idxs->push_back(sample_idx);
+    }
+  }
+
+  if (progressive) {
+    sampled_idxs->push_back(n_ - 1);
+  }
+}
+
+size_t ProgressiveSampler::ComputeNumTrials(
+    const std::vector<double>& residuals,
+    const double max_residual,
+    const double confidence,
+    const double num_trials_multiplier) const {
+  THROW_CHECK_EQ(residuals.size(), total_num_samples_);
+
+  const double prob_failure = 1 - confidence;
+  if (prob_failure <= 0) {
+    return std::numeric_limits<size_t>::max();
+  }
+
+  size_t num_trials = std::numeric_limits<size_t>::max();
+  size_t num_inliers = 0;
+  for (size_t n = 1; n <= total_num_samples_; ++n) {
+    if (residuals[n - 1] <= max_residual) {
+      num_inliers += 1;
+    }
+
+    // Besides the sample itself, a wrong model is supported by the outliers
+    // that are consistent with it by chance.
+    if (n <= num_samples_) {
+      continue;
+    }
+    const double num_random_support_mean =
+        kProbOutlierSupport * (n - num_samples_);
+    const double num_random_support_stddev =
+        std::sqrt(num_random_support_mean * (1 - kProbOutlierSupport));
+    if (num_inliers < num_samples_ + num_random_support_mean +
+                          kNonRandomQuantile * num_random_support_stddev) {
+      continue;
+    }
+
+    double prob_inlier = 1.0;
+    for (size_t i = 0; i < num_samples_; ++i) {
+      prob_inlier *=
+          static_cast<double>(num_inliers - i) / static_cast<double>(n - i);
+    }
+
+    const double prob_outlier = 1 - prob_inlier;
+    if (prob_outlier <= 0) {
+      return 1;
+    }
+
+    num_trials = std::min(
+        num_trials,
+        static_cast<size_t>(std::ceil(std::log(prob_failure) /
+                                      std::log(prob_outlier) *
+                                      num_trials_multiplier)));
+  }
+
+  return num_trials;
+}
+
+}  // namespace colmap
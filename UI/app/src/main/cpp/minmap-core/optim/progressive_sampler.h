@@ -0,0 +1,75 @@
+#pragma once
+
+#include "sampler.h"
+
+namespace colmap {
+
+// Random sampler for PROSAC (Progressive Sample Consensus), as described in:
+//
+//    "Matching with PROSAC - Progressive Sample Consensus".
+//        Ondrej Chum and Jiri Matas. CVPR 2005.
+//
+// The samples are progressively drawn from a growing set of the data with the
+// highest quality, such that good data yields a confident model after few
+// trials. After `kNumProgressiveTrials` trials, the sampler draws uniformly
+// at random from all data, as the `RandomSampler`. `ComputeNumTrials`
+// implements the stopping criterion of PROSAC, which stops as soon as the
+// best model is confident on any set of the highest quality data.
+//
+// Note that a separate sampler should be instantiated per thread and that the
+// data must be sorted by decreasing quality, i.e. the data with the highest
+// quality comes first.
+class ProgressiveSampler : public Sampler {
+ public:
+  // Number of trials, after which the sampler draws uniformly from all data.
+  // Chosen according to the recommendation in the paper.
+  static constexpr size_t kNumProgressiveTrials = 200000;
+
+  // Probability that an outlier is consistent with a wrong model, and the
+  // one-sided standard normal quantile for a probability of 5% that the
+  // inliers of a wrong model pass the non-randomness test.
+  static constexpr double kProbOutlierSupport = 0.05;
+  static constexpr double kNonRandomQuantile = 1.645;
+
+  explicit ProgressiveSampler(size_t num_samples);
+
+  void Initialize(size_t total_num_samples) override;
+
+  size_t MaxNumSamples() override;
+
+  void Sample(std::vector<size_t>* sampled_idxs) override;
+
+  // Determine the number of trials of the PROSAC stopping criterion for the
+  // residuals of the best model. This is the minimum number of trials over
+  // all sets of the highest quality data, whose number of inliers is
+  // unlikely for a wrong model (non-randomness), to sample at least one
+  // outlier-free sample from the set with the specified confidence
+  // (maximality). The non-randomness test uses the normal approximation of
+  // the binomial distribution of the support of a wrong model.
+  //
+  // @param residuals              Residuals of all data in sampling order.
+  // @param max_residual           Maximum residual of an inlier.
+  // @param confidence             Confidence that one sample is outlier-free.
+  // @param num_trials_multiplier  Multiplication factor to number of trials.
+  //
+  // @return                       The required number of iterations.
+  size_t ComputeNumTrials(const std::vector<double>& residuals,
+                          double max_residual,
+                          double confidence,
+                          double num_trials_multiplier) const;
+
+ private:
+  const size_t num_samples_;
+  size_t total_num_samples_;
+
+  // The number of generated samples, i.e. the number of calls to `Sample`.
+  size_t t_;
+  // The size of the set of the highest quality data to sample from.
+  size_t n_;
+  // The expected number of samples from the first `n_` data, T_n, and the
+  // trial, T'_n, at which the set grows to include the next data.
+  double T_n_;
+  double T_n_prime_;
+};
+
+}  // namespace colmap
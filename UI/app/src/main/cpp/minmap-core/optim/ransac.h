@@ -1,13 +1,19 @@
 #pragma once
 
+#include "progressive_sampler.h"
 #include "random_sampler.h"
+#include "../math/random.h"
+#include "../optim/sprt.h"
 #include "../optim/support_measurement.h"
 #include "../util/logging.h"
 
+#include <algorithm>
 #include <cfloat>
+#include <numeric>
 #include <optional>
 #include <random>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 namespace colmap {
@@ -33,6 +39,17 @@ struct RANSACOptions {
   int min_num_trials = 0;
   int max_num_trials = std::numeric_limits<int>::max();
 
+  // Whether to verify the sample models with Wald's sequential probability
+  // ratio test (SPRT), which stops the evaluation of a bad model after few
+  // data points. This mostly speeds up the estimation for low inlier ratios.
+  // The test occasionally rejects a good model, which the dynamic number of
+  // trials accounts for.
+  bool use_sprt = false;
+
+  // Time to estimate one model from a random sample in units of the time to
+  // compute the residual of one data point, used to design the SPRT.
+  double sprt_model_cost = 200;
+
   void Check() const {
     THROW_CHECK_GT(max_error, 0);
     THROW_CHECK_GE(min_inlier_ratio, 0);
@@ -40,30 +57,66 @@ struct RANSACOptions {
     THROW_CHECK_GE(confidence, 0);
     THROW_CHECK_LE(confidence, 1);
     THROW_CHECK_LE(min_num_trials, max_num_trials);
+    THROW_CHECK_GT(sprt_model_cost, 0);
   }
 };
 
+namespace internal {
+
+// Whether the estimator provides a packed single precision layout of its data
+// with a residual kernel (`Packed_t`, `Pack`, and `Residuals` for ranges of
+// the packed data), and the support measurer accumulates the support from
+// blocks of residuals. RANSAC then evaluates the sample models in blocks of
+// the packed data without storing their residuals.
+template <typename Estimator, typename SupportMeasurer, typename = void>
+struct HasPackedResiduals : std::false_type {};
+
+template <typename Estimator, typename SupportMeasurer>
+struct HasPackedResiduals<
+    Estimator,
+    SupportMeasurer,
+    std::void_t<typename Estimator::Packed_t,
+                decltype(&SupportMeasurer::Accumulate)>> : std::true_type {};
+
+// The packed data of the estimator, if it has any.
+template <typename Estimator, typename = void>
+struct PackedData {
+  using type = std::nullptr_t;
+};
+
+template <typename Estimator>
+struct PackedData<Estimator, std::void_t<typename Estimator::Packed_t>> {
+  using type = typename Estimator::Packed_t;
+};
+
+}  // namespace internal
+
+// The result of a robust estimation, which does not depend on the sampler, such
+// that estimations with different samplers have the same report type.
+template <typename Estimator, typename SupportMeasurer>
+struct RANSACReport {
+  // Whether the estimation was successful.
+  bool success = false;
+
+  // The number of RANSAC trials / iterations.
+  size_t num_trials = 0;
+
+  // The support of the estimated model.
+  typename SupportMeasurer::Support support;
+
+  // Boolean mask which is true if a sample is an inlier.
+  std::vector<char> inlier_mask;
+
+  // The estimated model.
+  typename Estimator::M_t model;
+};
+
 template <typename Estimator,
           typename SupportMeasurer = InlierSupportMeasurer,
           typename Sampler = RandomSampler>
 class RANSAC {
  public:
-  struct Report {
-    // Whether the estimation was successful.
-    bool success = false;
-
-    // The number of RANSAC trials / iterations.
-    size_t num_trials = 0;
-
-    // The support of the estimated model.
-    typename SupportMeasurer::Support support;
-
-    // Boolean mask which is true if a sample is an inlier.
-    std::vector<char> inlier_mask;
-
-    // The estimated model.
-    typename Estimator::M_t model;
-  };
+  using Report = RANSACReport<Estimator, SupportMeasurer>;
 
   explicit RANSAC(const RANSACOptions& options,
                   Estimator estimator = Estimator(),
@@ -78,12 +131,15 @@ class RANSAC {
   // @param num_samples The total number of samples.
   // @param confidence Confidence that one sample is outlier-free.
   // @param num_trials_multiplier Multiplication factor to number of trials.
+  // @param prob_reject_good_model Probability that the verification rejects
+  //                               the model of an outlier-free sample.
   //
   // @return The required number of iterations.
   static size_t ComputeNumTrials(size_t num_inliers,
                                  size_t num_samples,
                                  double confidence,
-                                 double num_trials_multiplier);
+                                 double num_trials_multiplier,
+                                 double prob_reject_good_model = 0);
 
   // Robustly estimate model with RANSAC (RANdom SAmple Consensus).
   //
@@ -99,7 +155,51 @@ class RANSAC {
   Sampler sampler;
 
  protected:
+  static constexpr bool kPackedResiduals =
+      internal::HasPackedResiduals<Estimator, SupportMeasurer>::value;
+
+  // Number of data points evaluated at once with SPRT or packed residuals.
+  // Large enough to amortize the call to the estimator and small enough to
+  // not waste many residuals after the rejection by the SPRT.
+  static constexpr size_t kBlockSize = 32;
+
+  // Initialize the SPRT, the order in which the data points are evaluated,
+  // and the packed data points, if enabled.
+  void InitializeEvaluation(const std::vector<typename Estimator::X_t>& X,
+                            const std::vector<typename Estimator::Y_t>& Y);
+
+  // Compute the support of a sample model. With SPRT, the residuals are
+  // computed in blocks in random order of the data points, and the evaluation
+  // stops as soon as the model is rejected. Returns false for a rejected model,
+  // in which case the support and residuals are incomplete. With packed
+  // residuals, the support is accumulated from blocks of residuals in single
+  // precision and the residuals are not computed.
+  bool EvaluateSampleModel(const std::vector<typename Estimator::X_t>& X,
+                           const std::vector<typename Estimator::Y_t>& Y,
+                           const typename Estimator::M_t& model,
+                           double max_residual,
+                           typename SupportMeasurer::Support* support,
+                           std::vector<double>* residuals);
+
+  // Dynamic number of trials for the current best support, which accounts
+  // for good models rejected by the SPRT and the stopping criterion of the
+  // sampler, if any.
+  size_t ComputeDynNumTrials(size_t num_inliers, size_t num_samples) const;
+
   RANSACOptions options_;
+
+  // Number of trials of the stopping criterion of the sampler for the current
+  // best model, e.g. for PROSAC.
+  size_t sampler_max_num_trials_;
+
+  SPRT sprt_;
+  // Order of the evaluated data points, which is random for the SPRT.
+  std::vector<size_t> sample_idxs_;
+  std::vector<typename Estimator::X_t> X_block_;
+  std::vector<typename Estimator::Y_t> Y_block_;
+  std::vector<double> block_residuals_;
+  // The data points in the order of `sample_idxs_` for packed residuals.
+  typename internal::PackedData<Estimator>::type packed_data_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -115,7 +215,8 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::RANSAC(
     : estimator(std::move(estimator)),
       support_measurer(std::move(support_measurer)),
       sampler(std::move(sampler)),
-      options_(options) {
+      options_(options),
+      sampler_max_num_trials_(std::numeric_limits<size_t>::max()) {
   options.Check();
 
   // Determine max_num_trials based on assumed `min_inlier_ratio`.
@@ -134,7 +235,8 @@ size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
     const size_t num_inliers,
     const size_t num_samples,
     const double confidence,
-    const double num_trials_multiplier) {
+    const double num_trials_multiplier,
+    const double prob_reject_good_model) {
   const double prob_failure = 1 - confidence;
   if (prob_failure <= 0) {
     return std::numeric_limits<size_t>::max();
@@ -148,6 +250,7 @@ size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
     prob_inlier *= static_cast<double>(num_inliers - i) /
                    static_cast<double>(num_samples - i);
   }
+  prob_inlier *= 1 - prob_reject_good_model;
 
   const double prob_outlier = 1 - prob_inlier;
   if (prob_outlier <= 0) {
@@ -194,6 +297,8 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
   std::vector<typename Estimator::M_t> sample_models;
 
   sampler.Initialize(num_samples);
+  sampler_max_num_trials_ = std::numeric_limits<size_t>::max();
+  InitializeEvaluation(X, Y);
 
   size_t max_num_trials =
       std::min<size_t>(options_.max_num_trials, sampler.MaxNumSamples());
@@ -214,21 +319,37 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
 
     // Iterate through all estimated models.
     for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
-
-      // Save as best subset if better than all previous subsets.
-      if (support_measurer.IsLeftBetter(support, best_support)) {
-        best_support = support;
-        best_model = sample_model;
-
+      typename SupportMeasurer::Support support;
+      if (EvaluateSampleModel(
+              X, Y, sample_model, max_residual, &support, &residuals)) {
+        // Save as best subset if better than all previous subsets.
+        if (support_measurer.IsLeftBetter(support, best_support)) {
+          best_support = support;
+          best_model = sample_model;
+
+          if (options_.use_sprt) {
+            sprt_.UpdateEpsilon(static_cast<double>(best_support.num_inliers) /
+                                num_samples);
+          }
+
+          if constexpr (std::is_base_of_v<ProgressiveSampler, Sampler>) {
+            if constexpr (kPackedResiduals) {
+              estimator.Residuals(X, Y, sample_model, &residuals);
+            }
+            sampler_max_num_trials_ =
+                sampler.ComputeNumTrials(residuals,
+                                         max_residual,
+                                         options_.confidence,
+                                         options_.dyn_num_trials_multiplier);
+          }
+
+          dyn_max_num_trials =
+              ComputeDynNumTrials(best_support.num_inliers, num_samples);
+        }
+      } else if (best_model.has_value()) {
+        // The rejection may have redesigned the SPRT.
         dyn_max_num_trials =
-            ComputeNumTrials(best_support.num_inliers,
-                             num_samples,
-                             options_.confidence,
-                             options_.dyn_num_trials_multiplier);
+            ComputeDynNumTrials(best_support.num_inliers, num_samples);
       }
 
       if (report.num_trials >= dyn_max_num_trials &&
@@ -265,7 +386,117 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
     report.inlier_mask[i] = residuals[i] <= max_residual;
   }
 
+  // Make the support consistent with the inlier mask in double precision.
+  if constexpr (kPackedResiduals) {
+    report.support = support_measurer.Evaluate(residuals, max_residual);
+  }
+
   return report;
 }
 
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::InitializeEvaluation(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  if (!options_.use_sprt && !kPackedResiduals) {
+    return;
+  }
+
+  const size_t num_samples = X.size();
+  sample_idxs_.resize(num_samples);
+  std::iota(sample_idxs_.begin(), sample_idxs_.end(), 0);
+
+  if (options_.use_sprt) {
+    SPRT::Options sprt_options;
+    sprt_options.model_cost = options_.sprt_model_cost;
+    sprt_ = SPRT(sprt_options);
+
+    // The test assumes that the inliers are not ordered, e.g. by image region.
+    Shuffle(static_cast<uint32_t>(num_samples), &sample_idxs_);
+  }
+
+  if constexpr (kPackedResiduals) {
+    estimator.Pack(X, Y, sample_idxs_, &packed_data_);
+  }
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+bool RANSAC<Estimator, SupportMeasurer, Sampler>::EvaluateSampleModel(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const typename Estimator::M_t& model,
+    const double max_residual,
+    typename SupportMeasurer::Support* support,
+    std::vector<double>* residuals) {
+  const size_t num_samples = X.size();
+  const bool use_sprt = options_.use_sprt && sprt_.IsActive();
+
+  if constexpr (kPackedResiduals) {
+    float block_residuals[kBlockSize];
+    *support = support_measurer.EmptySupport();
+    SPRT::Test test;
+    for (size_t begin = 0; begin < num_samples; begin += kBlockSize) {
+      const size_t end = std::min(begin + kBlockSize, num_samples);
+      estimator.Residuals(packed_data_, model, begin, end, block_residuals);
+
+      if (use_sprt && !sprt_.Evaluate(
+                          block_residuals, end - begin, max_residual, &test)) {
+        sprt_.Reject(test);
+        return false;
+      }
+
+      support_measurer.Accumulate(
+          block_residuals, end - begin, max_residual, support);
+    }
+
+    return true;
+  } else {
+    if (!use_sprt) {
+      estimator.Residuals(X, Y, model, residuals);
+      THROW_CHECK_EQ(residuals->size(), num_samples);
+      *support = support_measurer.Evaluate(*residuals, max_residual);
+      return true;
+    }
+
+    residuals->resize(num_samples);
+    SPRT::Test test;
+    for (size_t begin = 0; begin < num_samples; begin += kBlockSize) {
+      const size_t end = std::min(begin + kBlockSize, num_samples);
+      X_block_.clear();
+      Y_block_.clear();
+      for (size_t i = begin; i < end; ++i) {
+        X_block_.push_back(X[sample_idxs_[i]]);
+        Y_block_.push_back(Y[sample_idxs_[i]]);
+      }
+
+      estimator.Residuals(X_block_, Y_block_, model, &block_residuals_);
+      THROW_CHECK_EQ(block_residuals_.size(), end - begin);
+
+      if (!sprt_.Evaluate(block_residuals_, max_residual, &test)) {
+        sprt_.Reject(test);
+        return false;
+      }
+
+      for (size_t i = begin; i < end; ++i) {
+        (*residuals)[sample_idxs_[i]] = block_residuals_[i - begin];
+      }
+    }
+
+    *support = support_measurer.Evaluate(*residuals, max_residual);
+    return true;
+  }
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeDynNumTrials(
+    const size_t num_inliers, const size_t num_samples) const {
+  return std::min(
+      sampler_max_num_trials_,
+      ComputeNumTrials(num_inliers,
+                       num_samples,
+                       options_.confidence,
+                       options_.dyn_num_trials_multiplier,
+                       options_.use_sprt ? sprt_.ProbRejectGoodModel() : 0));
+}
+
 }  // namespace colmap
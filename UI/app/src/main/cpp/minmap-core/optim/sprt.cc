@@ -0,0 +1,137 @@
+#include "sprt.h"
+
+#include "../util/logging.h"
+
+#include <algorithm>
+
+namespace colmap {
+namespace {
+
+// Minimum number of data points of the rejected models before delta is
+// estimated from them.
+constexpr size_t kMinNumRejectedEvaluated = 100;
+
+// Minimum relative change of delta or epsilon to redesign the test.
+constexpr double kMinRelativeChange = 0.1;
+
+}  // namespace
+
+SPRT::SPRT() : SPRT(Options()) {}
+
+SPRT::SPRT(const Options& options)
+    : options_(options),
+      delta_(options.delta),
+      epsilon_(0),
+      num_rejected_evaluated_(0),
+      num_rejected_inliers_(0) {
+  THROW_CHECK_GT(options_.delta, 0);
+  THROW_CHECK_LT(options_.delta, 1);
+  THROW_CHECK_GT(options_.model_cost, 0);
+  UpdateDecisionThreshold();
+}
+
+bool SPRT::Evaluate(const std::vector<double>& residuals,
+                    const double max_residual,
+                    Test* test) const {
+  return EvaluateImpl(residuals.data(), residuals.size(), max_residual, test);
+}
+
+bool SPRT::Evaluate(const float* residuals,
+                    const size_t num_residuals,
+                    const double max_residual,
+                    Test* test) const {
+  return EvaluateImpl(residuals, num_residuals, max_residual, test);
+}
+
+template <typename T>
+bool SPRT::EvaluateImpl(const T* residuals,
+                        const size_t num_residuals,
+                        const double max_residual,
+                        Test* test) const {
+  if (!IsActive()) {
+    for (size_t i = 0; i < num_residuals; ++i) {
+      if (residuals[i] <= max_residual) {
+        ++test->num_inliers;
+      }
+    }
+    test->num_evaluated += num_residuals;
+    return true;
+  }
+
+  for (size_t i = 0; i < num_residuals; ++i) {
+    ++test->num_evaluated;
+    if (residuals[i] <= max_residual) {
+      ++test->num_inliers;
+      test->log_likelihood_ratio += log_inlier_ratio_;
+    } else {
+      test->log_likelihood_ratio += log_outlier_ratio_;
+      if (test->log_likelihood_ratio > log_decision_threshold_) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool SPRT::Reject(const Test& test) {
+  num_rejected_evaluated_ += test.num_evaluated;
+  num_rejected_inliers_ += test.num_inliers;
+  if (num_rejected_evaluated_ < kMinNumRejectedEvaluated) {
+    return false;
+  }
+
+  // The inlier ratio of a bad model must be positive for the likelihood
+  // ratio of inliers to be defined.
+  const double delta = std::max(
+      static_cast<double>(num_rejected_inliers_) / num_rejected_evaluated_,
+      1e-3);
+  if (std::abs(delta - delta_) <= kMinRelativeChange * delta_) {
+    return false;
+  }
+
+  delta_ = delta;
+  UpdateDecisionThreshold();
+  return true;
+}
+
+bool SPRT::UpdateEpsilon(const double epsilon) {
+  // The likelihood ratio of outliers must be defined.
+  const double clamped_epsilon = std::min(epsilon, 1 - 1e-6);
+  if (std::abs(clamped_epsilon - epsilon_) <= kMinRelativeChange * epsilon_) {
+    return false;
+  }
+
+  epsilon_ = clamped_epsilon;
+  UpdateDecisionThreshold();
+  return true;
+}
+
+void SPRT::UpdateDecisionThreshold() {
+  if (!IsActive()) {
+    return;
+  }
+
+  log_inlier_ratio_ = std::log(delta_ / epsilon_);
+  log_outlier_ratio_ = std::log((1 - delta_) / (1 - epsilon_));
+
+  // The optimal decision threshold A is the fixed point of
+  // A = model_cost * C + 1 + log(A), where C is the expected log likelihood
+  // ratio of a data point under a bad model.
+  const double C =
+      (1 - delta_) * log_outlier_ratio_ + delta_ * log_inlier_ratio_;
+  const double A0 = options_.model_cost * C + 1;
+  double A = A0;
+  for (int i = 0; i < 100; ++i) {
+    const double next_A = A0 + std::log(A);
+    if (std::abs(next_A - A) <= 1e-6 * A) {
+      A = next_A;
+      break;
+    }
+    A = next_A;
+  }
+
+  log_decision_threshold_ = std::log(A);
+}
+
+}  // namespace colmap
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace colmap {
+
+// Wald's sequential probability ratio test (SPRT) for the verification of
+// RANSAC models. Instead of computing the residuals of all data points, the
+// test decides after few data points whether a model is bad. The test is
+// designed for the inlier ratio epsilon of a good model and the probability
+// delta that a data point is consistent with a bad model. Epsilon follows the
+// best model so far and delta is estimated from the rejected models, such
+// that the test only becomes active once a model is better than a bad model.
+//
+// "Optimal Randomized RANSAC", Ondrej Chum, Jiri Matas, PAMI 2008.
+class SPRT {
+ public:
+  struct Options {
+    // Initial probability that a data point is consistent with a bad model.
+    double delta = 0.05;
+
+    // Time to estimate one model from a random sample in units of the time to
+    // compute the residual of one data point. Chum and Matas measured about
+    // 200 for the 7-point fundamental matrix estimator.
+    double model_cost = 200;
+  };
+
+  // The state of the test of one model.
+  struct Test {
+    double log_likelihood_ratio = 0;
+    size_t num_evaluated = 0;
+    size_t num_inliers = 0;
+  };
+
+  SPRT();
+  explicit SPRT(const Options& options);
+
+  // Whether the test can reject any model, i.e. whether a good model has a
+  // larger inlier ratio than a bad model.
+  inline bool IsActive() const;
+
+  // Probability that the test rejects a good model, which reduces the
+  // probability that a RANSAC trial finds a good model.
+  inline double ProbRejectGoodModel() const;
+
+  // Continue the test with the residuals of the next data points. Returns
+  // false as soon as the model is rejected, in which case the remaining
+  // residuals are not evaluated.
+  bool Evaluate(const std::vector<double>& residuals,
+                double max_residual,
+                Test* test) const;
+  bool Evaluate(const float* residuals,
+                size_t num_residuals,
+                double max_residual,
+                Test* test) const;
+
+  // Update delta from the test of a rejected model. Returns true if the test
+  // was redesigned.
+  bool Reject(const Test& test);
+
+  // Update epsilon to the inlier ratio of a new best model, which is the
+  // minimum inlier ratio of a good model. Returns true if the test was
+  // redesigned.
+  bool UpdateEpsilon(double epsilon);
+
+ private:
+  template <typename T>
+  bool EvaluateImpl(const T* residuals,
+                    size_t num_residuals,
+                    double max_residual,
+                    Test* test) const;
+
+  void UpdateDecisionThreshold();
+
+  Options options_;
+  double delta_;
+  double epsilon_;
+  double log_decision_threshold_;
+  double log_inlier_ratio_;
+  double log_outlier_ratio_;
+
+  size_t num_rejected_evaluated_;
+  size_t num_rejected_inliers_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool SPRT::IsActive() const { return epsilon_ > delta_; }
+
+double SPRT::ProbRejectGoodModel() const {
+  return IsActive() ? std::exp(-log_decision_threshold_) : 0;
+}
+
+}  // namespace colmap
@@ -22,6 +22,25 @@ InlierSupportMeasurer::Support InlierSupportMeasurer::Evaluate(
   return support;
 }
 
+InlierSupportMeasurer::Support InlierSupportMeasurer::EmptySupport() const {
+  Support support;
+  support.num_inliers = 0;
+  support.residual_sum = 0;
+  return support;
+}
+
+void InlierSupportMeasurer::Accumulate(const float* residuals,
+                                       const size_t num_residuals,
+                                       const double max_residual,
+                                       Support* support) const {
+  for (size_t i = 0; i < num_residuals; ++i) {
+    if (residuals[i] <= max_residual) {
+      support->num_inliers += 1;
+      support->residual_sum += residuals[i];
+    }
+  }
+}
+
 bool InlierSupportMeasurer::IsLeftBetter(const Support& left,
                                          const Support& right) {
   if (left.num_inliers > right.num_inliers) {
@@ -90,6 +109,28 @@ MEstimatorSupportMeasurer::Support MEstimatorSupportMeasurer::Evaluate(
   return support;
 }
 
+MEstimatorSupportMeasurer::Support MEstimatorSupportMeasurer::EmptySupport()
+    const {
+  Support support;
+  support.num_inliers = 0;
+  support.score = 0;
+  return support;
+}
+
+void MEstimatorSupportMeasurer::Accumulate(const float* residuals,
+                                           const size_t num_residuals,
+                                           const double max_residual,
+                                           Support* support) const {
+  for (size_t i = 0; i < num_residuals; ++i) {
+    if (residuals[i] <= max_residual) {
+      support->num_inliers += 1;
+      support->score += residuals[i];
+    } else {
+      support->score += max_residual;
+    }
+  }
+}
+
 bool MEstimatorSupportMeasurer::IsLeftBetter(const Support& left,
                                              const Support& right) {
   return left.score < right.score;
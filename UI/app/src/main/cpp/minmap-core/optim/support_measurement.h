@@ -21,6 +21,15 @@ struct InlierSupportMeasurer {
   // Compute the support of the residuals.
   Support Evaluate(const std::vector<double>& residuals, double max_residual);
 
+  // Compute the support incrementally from blocks of single precision
+  // residuals, starting from the support of no residuals, such that the
+  // residuals of a model need not be stored.
+  Support EmptySupport() const;
+  void Accumulate(const float* residuals,
+                  size_t num_residuals,
+                  double max_residual,
+                  Support* support) const;
+
   // Compare the two supports.
   bool IsLeftBetter(const Support& left, const Support& right);
 };
@@ -69,6 +78,15 @@ struct MEstimatorSupportMeasurer {
   // Compute the support of the residuals.
   Support Evaluate(const std::vector<double>& residuals, double max_residual);
 
+  // Compute the support incrementally from blocks of single precision
+  // residuals, starting from the support of no residuals, such that the
+  // residuals of a model need not be stored.
+  Support EmptySupport() const;
+  void Accumulate(const float* residuals,
+                  size_t num_residuals,
+                  double max_residual,
+                  Support* support) const;
+
   // Compare the two supports.
   bool IsLeftBetter(const Support& left, const Support& right);
 };
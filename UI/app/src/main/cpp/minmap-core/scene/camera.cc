@@ -83,6 +83,20 @@ bool Camera::IsUndistorted() const {
   return true;
 }
 
+void Camera::UpdateUndistortionGrid() {
+  if (!UndistortionGrid::IsUsefulFor(model_id) || width == 0 || height == 0 ||
+      !VerifyParams()) {
+    undistortion_grid.reset();
+    return;
+  }
+  if (undistortion_grid &&
+      undistortion_grid->IsValidFor(model_id, params, width, height)) {
+    return;
+  }
+  undistortion_grid =
+      std::make_shared<const UndistortionGrid>(model_id, params, width, height);
+}
+
 void Camera::Rescale(const double scale) {
   THROW_CHECK_GT(scale, 0.0);
   const double scale_x = std::round(scale * width) / static_cast<double>(width);
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "../sensor/models.h"
+#include "../sensor/undistortion_grid.h"
 #include "../util/logging.h"
 #include "../util/types.h"
 
+#include <memory>
 #include <vector>
 
 #include <PoseLib/alignment.h>
@@ -34,6 +36,11 @@ struct Camera {
   // e.g. manually provided or extracted from EXIF
   bool has_prior_focal_length = false;
 
+  // Lookup table that speeds up `CamFromImg` for models with iterative
+  // undistortion. It is shared between copies of the camera and ignored once
+  // the model or parameters change, until it is rebuilt.
+  std::shared_ptr<const UndistortionGrid> undistortion_grid;
+
   // Initialize parameters for given camera model and focal length, and set
   // the principal point to be the image center.
   static Camera CreateFromModelId(camera_t camera_id,
@@ -97,6 +104,11 @@ struct Camera {
                              double max_focal_length_ratio,
                              double max_extra_param) const;
 
+  // Build the undistortion grid for the current parameters, if the camera
+  // model benefits from it and the existing grid is missing or outdated.
+  // Must not be called concurrently with other uses of the camera.
+  void UpdateUndistortionGrid();
+
   // Project point in image plane to camera ray (not unit normalized).
   inline std::optional<Eigen::Vector2d> CamFromImg(
       const Eigen::Vector2d& image_point) const;
@@ -108,6 +120,16 @@ struct Camera {
   inline std::optional<Eigen::Vector2d> ImgFromCam(
       const Eigen::Vector3d& cam_point) const;
 
+  // Batched variants of CamFromImg and ImgFromCam, which dispatch on the
+  // camera model once for all points. Points that cannot be transformed are
+  // zero in the valid mask and their outputs are undefined.
+  inline void CamFromImgBatch(span<const Eigen::Vector2d> image_points,
+                              span<Eigen::Vector2d> cam_points,
+                              span<char> valid_mask) const;
+  inline void ImgFromCamBatch(span<const Eigen::Vector3d> cam_points,
+                              span<Eigen::Vector2d> image_points,
+                              span<char> valid_mask) const;
+
   // Rescale camera dimensions and accordingly the focal length and
   // and the principal point.
   void Rescale(double scale);
@@ -224,6 +246,10 @@ bool Camera::HasBogusParams(const double min_focal_length_ratio,
 
 std::optional<Eigen::Vector2d> Camera::CamFromImg(
     const Eigen::Vector2d& image_point) const {
+  if (undistortion_grid &&
+      undistortion_grid->IsValidFor(model_id, params, width, height)) {
+    return undistortion_grid->CamFromImg(image_point);
+  }
   return CameraModelCamFromImg(model_id, params, image_point);
 }
 
@@ -236,6 +262,25 @@ std::optional<Eigen::Vector2d> Camera::ImgFromCam(
   return CameraModelImgFromCam(model_id, params, cam_point);
 }
 
+void Camera::CamFromImgBatch(const span<const Eigen::Vector2d> image_points,
+                             span<Eigen::Vector2d> cam_points,
+                             span<char> valid_mask) const {
+  if (undistortion_grid &&
+      undistortion_grid->IsValidFor(model_id, params, width, height)) {
+    undistortion_grid->CamFromImgBatch(image_points, cam_points, valid_mask);
+    return;
+  }
+  CameraModelCamFromImgBatch(
+      model_id, params, image_points, cam_points, valid_mask);
+}
+
+void Camera::ImgFromCamBatch(const span<const Eigen::Vector3d> cam_points,
+                             span<Eigen::Vector2d> image_points,
+                             span<char> valid_mask) const {
+  CameraModelImgFromCamBatch(
+      model_id, params, cam_points, image_points, valid_mask);
+}
+
 bool Camera::operator==(const Camera& other) const {
   return camera_id == other.camera_id && model_id == other.model_id &&
          width == other.width && height == other.height &&
@@ -692,6 +692,11 @@ PosePrior Database::ReadPosePrior(const image_t image_id) const {
         sqlite3_column_int64(sql_stmt_read_pose_prior_, 2));
     prior.position_covariance =
         ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt_read_pose_prior_, rc, 3);
+    // Priors without gravity may have been written by other tools.
+    if (sqlite3_column_type(sql_stmt_read_pose_prior_, 4) != SQLITE_NULL) {
+      prior.gravity = ReadStaticMatrixBlob<Eigen::Vector3d>(
+          sql_stmt_read_pose_prior_, rc, 4);
+    }
   }
   return prior;
 }
@@ -1010,6 +1015,7 @@ void Database::WritePosePrior(const image_t image_id,
       static_cast<sqlite3_int64>(pose_prior.coordinate_system)));
   WriteStaticMatrixBlob(
       sql_stmt_write_pose_prior_, pose_prior.position_covariance, 4);
+  WriteStaticMatrixBlob(sql_stmt_write_pose_prior_, pose_prior.gravity, 5);
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_pose_prior_));
 }
 
@@ -1230,7 +1236,8 @@ void Database::UpdatePosePrior(image_t image_id,
       static_cast<sqlite3_int64>(pose_prior.coordinate_system)));
   WriteStaticMatrixBlob(
       sql_stmt_update_pose_prior_, pose_prior.position_covariance, 3);
-  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_update_pose_prior_, 4, image_id));
+  WriteStaticMatrixBlob(sql_stmt_update_pose_prior_, pose_prior.gravity, 4);
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_update_pose_prior_, 5, image_id));
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_update_pose_prior_));
 }
@@ -1591,7 +1598,7 @@ void Database::PrepareSQLStatements() {
                    &sql_stmt_update_image_);
   prepare_sql_stmt(
       "UPDATE pose_priors SET position=?, coordinate_system=?, "
-      "position_covariance=? WHERE image_id=?;",
+      "position_covariance=?, gravity=? WHERE image_id=?;",
       &sql_stmt_update_pose_prior_);
 
   //////////////////////////////////////////////////////////////////////////////
@@ -1667,7 +1674,7 @@ void Database::PrepareSQLStatements() {
   //////////////////////////////////////////////////////////////////////////////
   prepare_sql_stmt(
       "INSERT INTO pose_priors(image_id, position, coordinate_system, "
-      "position_covariance) VALUES(?, ?, ?, ?);",
+      "position_covariance, gravity) VALUES(?, ?, ?, ?, ?);",
       &sql_stmt_write_pose_prior_);
   prepare_sql_stmt(
       "INSERT INTO keypoints(image_id, rows, cols, data) VALUES(?, ?, ?, ?);",
@@ -1818,6 +1825,7 @@ void Database::CreatePosePriorTable() const {
       "    position                   BLOB,"
       "    coordinate_system          INTEGER               NOT NULL,"
       "    position_covariance        BLOB,"
+      "    gravity                    BLOB,"
       "    FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE "
       "CASCADE);";
 
@@ -1932,6 +1940,23 @@ void Database::UpdateSchema() const {
     SQLITE3_CALL(sqlite3_finalize(update_stmt));
   }
 
+  if (!ExistsColumn("pose_priors", "gravity")) {
+    // Create gravity column
+    SQLITE3_EXEC(database_,
+                 "ALTER TABLE pose_priors ADD COLUMN gravity BLOB "
+                 "DEFAULT NULL;",
+                 nullptr);
+
+    // Set gravity column to NaN vectors
+    const std::string update_sql = "UPDATE pose_priors SET gravity = ?;";
+    sqlite3_stmt* update_stmt;
+    SQLITE3_CALL(
+        sqlite3_prepare_v2(database_, update_sql.c_str(), -1, &update_stmt, 0));
+    WriteStaticMatrixBlob(update_stmt, PosePrior().gravity, 1);
+    SQLITE3_CALL(sqlite3_step(update_stmt));
+    SQLITE3_CALL(sqlite3_finalize(update_stmt));
+  }
+
   // Update user version number.
   std::unique_lock<std::mutex> lock(update_schema_mutex_);
   const std::string update_user_version_sql =
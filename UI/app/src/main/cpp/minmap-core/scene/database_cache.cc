@@ -1,11 +1,122 @@
 #include "database_cache.h"
 
+#include "../util/endian.h"
+#include "../util/file.h"
 #include "../util/string.h"
 #include "../util/timer.h"
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
 namespace colmap {
 namespace {
 
+// Magic number ("MMDBCACH") and format version of database cache snapshots.
+// Bump the version whenever the layout written by `WriteSnapshot` changes.
+constexpr uint64_t kSnapshotMagic = 0x4843414342444d4dULL;
+constexpr uint32_t kSnapshotVersion = 2;
+
+static_assert(sizeof(CorrespondenceGraph::Correspondence) ==
+                  sizeof(image_t) + sizeof(point2D_t),
+              "Correspondences must be tightly packed to be snapshotted");
+static_assert(sizeof(Eigen::Vector2d) == 2 * sizeof(double),
+              "2D points must be tightly packed to be snapshotted");
+
+// Sequential, bounds-checked reader over the raw bytes of a snapshot. Once a
+// read runs past the end of the data, the reader is marked as failed and all
+// subsequent reads are no-ops.
+class SnapshotReader {
+ public:
+  SnapshotReader(const char* data, const size_t size)
+      : data_(data), size_(size) {}
+
+  bool Ok() const { return ok_; }
+  bool AtEnd() const { return pos_ == size_; }
+
+  template <typename T>
+  T Read() {
+    T value{};
+    ReadArray(&value, 1);
+    return value;
+  }
+
+  template <typename T>
+  void ReadArray(T* values, const size_t num_values) {
+    if (!ok_ || num_values > (size_ - pos_) / sizeof(T)) {
+      ok_ = false;
+      return;
+    }
+    std::memcpy(values, data_ + pos_, num_values * sizeof(T));
+    pos_ += num_values * sizeof(T);
+  }
+
+  // Read an array prefixed by its length. The length is validated against the
+  // remaining bytes before allocating, so corrupt files cannot trigger huge
+  // allocations.
+  template <typename T>
+  void ReadVector(std::vector<T>* values) {
+    const uint64_t num_values = Read<uint64_t>();
+    if (!ok_ || num_values > (size_ - pos_) / sizeof(T)) {
+      ok_ = false;
+      return;
+    }
+    values->resize(num_values);
+    ReadArray(values->data(), num_values);
+  }
+
+  std::string ReadString() {
+    std::vector<char> chars;
+    ReadVector(&chars);
+    return std::string(chars.begin(), chars.end());
+  }
+
+ private:
+  const char* data_;
+  const size_t size_;
+  size_t pos_ = 0;
+  bool ok_ = true;
+};
+
+template <typename T>
+void WriteSnapshotVector(std::ostream* stream, const std::vector<T>& values) {
+  WriteBinaryLittleEndian<uint64_t>(stream, values.size());
+  stream->write(reinterpret_cast<const char*>(values.data()),
+                values.size() * sizeof(T));
+}
+
+void WriteSnapshotString(std::ostream* stream, const std::string& str) {
+  WriteBinaryLittleEndian<uint64_t>(stream, str.size());
+  stream->write(str.data(), str.size());
+}
+
+// 64-bit FNV-1a hash, used to fold the database state into a snapshot key.
+class SnapshotKeyHasher {
+ public:
+  void Add(const void* data, const size_t num_bytes) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < num_bytes; ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 0x100000001b3ULL;
+    }
+  }
+
+  template <typename T>
+  void Add(const T& value) {
+    Add(&value, sizeof(T));
+  }
+
+  void Add(const std::string& str) {
+    Add<uint64_t>(str.size());
+    Add(str.data(), str.size());
+  }
+
+  uint64_t Hash() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
 std::vector<Eigen::Vector2d> FeatureKeypointsToPointsVector(
     const FeatureKeypoints& keypoints) {
   std::vector<Eigen::Vector2d> points(keypoints.size());
@@ -250,6 +361,17 @@ void DatabaseCache::Load(const Database& database,
   LOG(MM_INFO) << StringPrintf(" in %.3fs (ignored %d)",
                             timer.ElapsedSeconds(),
                             num_ignored_image_pairs);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compute camera rays
+  //////////////////////////////////////////////////////////////////////////////
+
+  timer.Restart();
+  LOG(MM_INFO) << "Computing camera rays...";
+
+  ComputeCamRays();
+
+  LOG(MM_INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
 }
 
 std::shared_ptr<DatabaseCache> DatabaseCache::Create(
@@ -262,6 +384,362 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
   return cache;
 }
 
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateWithSnapshot(
+    const std::string& database_path,
+    const std::string& snapshot_path,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<std::string>& image_names) {
+  auto cache = std::make_shared<DatabaseCache>();
+
+  Timer timer;
+  timer.Start();
+  if (cache->ReadSnapshot(snapshot_path,
+                          SnapshotKey(database_path,
+                                      min_num_matches,
+                                      ignore_watermarks,
+                                      image_names))) {
+    LOG(MM_INFO) << StringPrintf("Restored database cache from %s in %.3fs",
+                                 snapshot_path.c_str(),
+                                 timer.ElapsedSeconds());
+    return cache;
+  }
+
+  {
+    Database database(database_path);
+    cache->Load(database, min_num_matches, ignore_watermarks, image_names);
+  }
+
+  // Opening the database touches its files, so the key is only computed once
+  // the connection is closed again.
+  try {
+    cache->WriteSnapshot(snapshot_path,
+                         SnapshotKey(database_path,
+                                     min_num_matches,
+                                     ignore_watermarks,
+                                     image_names));
+  } catch (const std::exception& error) {
+    LOG(MM_WARNING) << "Failed to write database cache snapshot: "
+                    << error.what();
+  }
+
+  return cache;
+}
+
+uint64_t DatabaseCache::SnapshotKey(
+    const std::string& database_path,
+    const size_t min_num_matches,
+    const bool ignore_watermarks,
+    const std::unordered_set<std::string>& image_names) {
+  SnapshotKeyHasher hasher;
+  hasher.Add(kSnapshotVersion);
+
+  // SQLite keeps recent transactions in the write-ahead log, so both files
+  // determine the state of the database.
+  for (const std::string& path : {database_path, database_path + "-wal"}) {
+    std::error_code error;
+    const auto file_size = std::filesystem::file_size(path, error);
+    hasher.Add<uint64_t>(error ? 0 : file_size);
+    const auto write_time = std::filesystem::last_write_time(path, error);
+    hasher.Add<int64_t>(error ? 0 : write_time.time_since_epoch().count());
+  }
+
+  hasher.Add<uint64_t>(min_num_matches);
+  hasher.Add<uint8_t>(ignore_watermarks);
+
+  std::vector<std::string> sorted_image_names(image_names.begin(),
+                                              image_names.end());
+  std::sort(sorted_image_names.begin(), sorted_image_names.end());
+  hasher.Add<uint64_t>(sorted_image_names.size());
+  for (const std::string& image_name : sorted_image_names) {
+    hasher.Add(image_name);
+  }
+
+  return hasher.Hash();
+}
+
+void DatabaseCache::WriteSnapshot(const std::string& path,
+                                  const uint64_t key) const {
+  // The arrays are dumped in native layout, which is only the on-disk little
+  // endian layout on little endian machines.
+  if (!IsLittleEndian()) {
+    LOG(MM_WARNING) << "Database cache snapshots require little endian";
+    return;
+  }
+
+  Timer timer;
+  timer.Start();
+
+  // Write to a temporary file first, so that an interrupted write never leaves
+  // a truncated snapshot behind under the final path.
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
+    std::ostream* stream = &file;
+
+    WriteBinaryLittleEndian<uint64_t>(stream, kSnapshotMagic);
+    WriteBinaryLittleEndian<uint32_t>(stream, kSnapshotVersion);
+    WriteBinaryLittleEndian<uint64_t>(stream, key);
+
+    WriteBinaryLittleEndian<uint64_t>(stream, rigs_.size());
+    for (const auto& [rig_id, rig] : rigs_) {
+      WriteBinaryLittleEndian<rig_t>(stream, rig_id);
+      WriteBinaryLittleEndian<uint32_t>(stream, rig.NumSensors());
+      if (rig.NumSensors() == 0) {
+        continue;
+      }
+      WriteBinaryLittleEndian<int>(stream,
+                                   static_cast<int>(rig.RefSensorId().type));
+      WriteBinaryLittleEndian<uint32_t>(stream, rig.RefSensorId().id);
+      for (const auto& [sensor_id, sensor_from_rig] : rig.NonRefSensors()) {
+        WriteBinaryLittleEndian<int>(stream, static_cast<int>(sensor_id.type));
+        WriteBinaryLittleEndian<uint32_t>(stream, sensor_id.id);
+        WriteBinaryLittleEndian<uint8_t>(stream, sensor_from_rig.has_value());
+        if (sensor_from_rig.has_value()) {
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->rotation.w());
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->rotation.x());
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->rotation.y());
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->rotation.z());
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->translation.x());
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->translation.y());
+          WriteBinaryLittleEndian<double>(stream,
+                                          sensor_from_rig->translation.z());
+        }
+      }
+    }
+
+    WriteBinaryLittleEndian<uint64_t>(stream, cameras_.size());
+    for (const auto& [camera_id, camera] : cameras_) {
+      WriteBinaryLittleEndian<camera_t>(stream, camera_id);
+      WriteBinaryLittleEndian<int>(stream, static_cast<int>(camera.model_id));
+      WriteBinaryLittleEndian<uint64_t>(stream, camera.width);
+      WriteBinaryLittleEndian<uint64_t>(stream, camera.height);
+      WriteBinaryLittleEndian<uint8_t>(stream, camera.has_prior_focal_length);
+      WriteSnapshotVector(stream, camera.params);
+    }
+
+    WriteBinaryLittleEndian<uint64_t>(stream, frames_.size());
+    for (const auto& [frame_id, frame] : frames_) {
+      WriteBinaryLittleEndian<frame_t>(stream, frame_id);
+      WriteBinaryLittleEndian<rig_t>(stream, frame.RigId());
+      WriteBinaryLittleEndian<uint32_t>(stream, frame.NumDataIds());
+      for (const data_t& data_id : frame.DataIds()) {
+        WriteBinaryLittleEndian<int>(stream,
+                                     static_cast<int>(data_id.sensor_id.type));
+        WriteBinaryLittleEndian<uint32_t>(stream, data_id.sensor_id.id);
+        WriteBinaryLittleEndian<uint64_t>(stream, data_id.id);
+      }
+    }
+
+    std::vector<Eigen::Vector2d> points2D;
+    WriteBinaryLittleEndian<uint64_t>(stream, images_.size());
+    for (const auto& [image_id, image] : images_) {
+      WriteBinaryLittleEndian<image_t>(stream, image_id);
+      WriteBinaryLittleEndian<camera_t>(stream, image.CameraId());
+      WriteBinaryLittleEndian<frame_t>(stream, image.FrameId());
+      WriteSnapshotString(stream, image.Name());
+      points2D.resize(image.NumPoints2D());
+      for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+           ++point2D_idx) {
+        points2D[point2D_idx] = image.Point2D(point2D_idx).xy;
+      }
+      WriteSnapshotVector(stream, points2D);
+    }
+
+    WriteBinaryLittleEndian<uint64_t>(stream, pose_priors_.size());
+    for (const auto& [image_id, pose_prior] : pose_priors_) {
+      WriteBinaryLittleEndian<image_t>(stream, image_id);
+      stream->write(reinterpret_cast<const char*>(pose_prior.position.data()),
+                    3 * sizeof(double));
+      stream->write(
+          reinterpret_cast<const char*>(pose_prior.position_covariance.data()),
+          9 * sizeof(double));
+      stream->write(reinterpret_cast<const char*>(pose_prior.gravity.data()),
+                    3 * sizeof(double));
+      WriteBinaryLittleEndian<int>(
+          stream, static_cast<int>(pose_prior.coordinate_system));
+    }
+
+    const class CorrespondenceGraph& graph = *correspondence_graph_;
+    THROW_CHECK(graph.finalized_);
+    WriteBinaryLittleEndian<uint64_t>(stream, graph.images_.size());
+    for (const auto& [image_id, graph_image] : graph.images_) {
+      WriteBinaryLittleEndian<image_t>(stream, image_id);
+      WriteBinaryLittleEndian<point2D_t>(stream, graph_image.num_observations);
+      WriteBinaryLittleEndian<point2D_t>(stream,
+                                         graph_image.num_correspondences);
+      WriteSnapshotVector(stream, graph_image.flat_corr_begs);
+      WriteSnapshotVector(stream, graph_image.flat_corrs);
+    }
+    WriteBinaryLittleEndian<uint64_t>(stream, graph.image_pairs_.size());
+    for (const auto& [pair_id, image_pair] : graph.image_pairs_) {
+      WriteBinaryLittleEndian<image_pair_t>(stream, pair_id);
+      WriteBinaryLittleEndian<point2D_t>(stream,
+                                         image_pair.num_correspondences);
+    }
+
+    // Trailing magic number to detect truncated files.
+    WriteBinaryLittleEndian<uint64_t>(stream, kSnapshotMagic);
+
+    file.close();
+    THROW_CHECK(!file.fail()) << "Failed to write " << tmp_path;
+  }
+
+  std::filesystem::rename(tmp_path, path);
+
+  LOG(MM_INFO) << StringPrintf(
+      "Wrote database cache snapshot in %.3fs", timer.ElapsedSeconds());
+}
+
+bool DatabaseCache::ReadSnapshot(const std::string& path, const uint64_t key) {
+  if (!IsLittleEndian()) {
+    return false;
+  }
+
+  const MappedFile file(path);
+  if (!file.IsOpen()) {
+    return false;
+  }
+
+  SnapshotReader reader(file.Data(), file.Size());
+  if (reader.Read<uint64_t>() != kSnapshotMagic ||
+      reader.Read<uint32_t>() != kSnapshotVersion) {
+    LOG(MM_WARNING) << "Ignoring incompatible database cache snapshot "
+                    << path;
+    return false;
+  }
+  if (reader.Read<uint64_t>() != key) {
+    LOG(MM_INFO) << "Database changed, ignoring stale cache snapshot";
+    return false;
+  }
+
+  // Restore into a fresh cache, so that a corrupt file leaves this cache
+  // untouched.
+  DatabaseCache cache;
+
+  const uint64_t num_rigs = reader.Read<uint64_t>();
+  for (uint64_t i = 0; i < num_rigs && reader.Ok(); ++i) {
+    class Rig rig;
+    rig.SetRigId(reader.Read<rig_t>());
+    const uint32_t num_sensors = reader.Read<uint32_t>();
+    if (num_sensors > 0) {
+      sensor_t ref_sensor_id;
+      ref_sensor_id.type = static_cast<SensorType>(reader.Read<int>());
+      ref_sensor_id.id = reader.Read<uint32_t>();
+      rig.AddRefSensor(ref_sensor_id);
+    }
+    for (uint32_t j = 1; j < num_sensors && reader.Ok(); ++j) {
+      sensor_t sensor_id;
+      sensor_id.type = static_cast<SensorType>(reader.Read<int>());
+      sensor_id.id = reader.Read<uint32_t>();
+      std::optional<Rigid3d> sensor_from_rig;
+      if (reader.Read<uint8_t>()) {
+        sensor_from_rig = Rigid3d();
+        sensor_from_rig->rotation.w() = reader.Read<double>();
+        sensor_from_rig->rotation.x() = reader.Read<double>();
+        sensor_from_rig->rotation.y() = reader.Read<double>();
+        sensor_from_rig->rotation.z() = reader.Read<double>();
+        sensor_from_rig->translation.x() = reader.Read<double>();
+        sensor_from_rig->translation.y() = reader.Read<double>();
+        sensor_from_rig->translation.z() = reader.Read<double>();
+      }
+      rig.AddSensor(sensor_id, sensor_from_rig);
+    }
+    cache.rigs_.emplace(rig.RigId(), std::move(rig));
+  }
+
+  const uint64_t num_cameras = reader.Read<uint64_t>();
+  for (uint64_t i = 0; i < num_cameras && reader.Ok(); ++i) {
+    struct Camera camera;
+    camera.camera_id = reader.Read<camera_t>();
+    camera.model_id = static_cast<CameraModelId>(reader.Read<int>());
+    camera.width = reader.Read<uint64_t>();
+    camera.height = reader.Read<uint64_t>();
+    camera.has_prior_focal_length = reader.Read<uint8_t>();
+    reader.ReadVector(&camera.params);
+    cache.cameras_.emplace(camera.camera_id, std::move(camera));
+  }
+
+  const uint64_t num_frames = reader.Read<uint64_t>();
+  for (uint64_t i = 0; i < num_frames && reader.Ok(); ++i) {
+    class Frame frame;
+    frame.SetFrameId(reader.Read<frame_t>());
+    frame.SetRigId(reader.Read<rig_t>());
+    const uint32_t num_data_ids = reader.Read<uint32_t>();
+    for (uint32_t j = 0; j < num_data_ids && reader.Ok(); ++j) {
+      data_t data_id;
+      data_id.sensor_id.type = static_cast<SensorType>(reader.Read<int>());
+      data_id.sensor_id.id = reader.Read<uint32_t>();
+      data_id.id = reader.Read<uint64_t>();
+      frame.AddDataId(data_id);
+    }
+    cache.frames_.emplace(frame.FrameId(), std::move(frame));
+  }
+
+  std::vector<Eigen::Vector2d> points2D;
+  const uint64_t num_images = reader.Read<uint64_t>();
+  cache.images_.reserve(num_images);
+  for (uint64_t i = 0; i < num_images && reader.Ok(); ++i) {
+    class Image image;
+    image.SetImageId(reader.Read<image_t>());
+    image.SetCameraId(reader.Read<camera_t>());
+    image.SetFrameId(reader.Read<frame_t>());
+    image.SetName(reader.ReadString());
+    reader.ReadVector(&points2D);
+    image.SetPoints2D(points2D);
+    cache.images_.emplace(image.ImageId(), std::move(image));
+  }
+
+  const uint64_t num_pose_priors = reader.Read<uint64_t>();
+  for (uint64_t i = 0; i < num_pose_priors && reader.Ok(); ++i) {
+    const image_t image_id = reader.Read<image_t>();
+    struct PosePrior pose_prior;
+    reader.ReadArray(pose_prior.position.data(), 3);
+    reader.ReadArray(pose_prior.position_covariance.data(), 9);
+    reader.ReadArray(pose_prior.gravity.data(), 3);
+    pose_prior.coordinate_system =
+        static_cast<PosePrior::CoordinateSystem>(reader.Read<int>());
+    cache.pose_priors_.emplace(image_id, std::move(pose_prior));
+  }
+
+  class CorrespondenceGraph& graph = *cache.correspondence_graph_;
+  const uint64_t num_graph_images = reader.Read<uint64_t>();
+  graph.images_.reserve(num_graph_images);
+  for (uint64_t i = 0; i < num_graph_images && reader.Ok(); ++i) {
+    const image_t image_id = reader.Read<image_t>();
+    auto& graph_image = graph.images_[image_id];
+    graph_image.num_observations = reader.Read<point2D_t>();
+    graph_image.num_correspondences = reader.Read<point2D_t>();
+    reader.ReadVector(&graph_image.flat_corr_begs);
+    reader.ReadVector(&graph_image.flat_corrs);
+  }
+  const uint64_t num_image_pairs = reader.Read<uint64_t>();
+  graph.image_pairs_.reserve(num_image_pairs);
+  for (uint64_t i = 0; i < num_image_pairs && reader.Ok(); ++i) {
+    const image_pair_t pair_id = reader.Read<image_pair_t>();
+    graph.image_pairs_[pair_id].num_correspondences = reader.Read<point2D_t>();
+  }
+  graph.finalized_ = true;
+
+  if (reader.Read<uint64_t>() != kSnapshotMagic || !reader.Ok() ||
+      !reader.AtEnd()) {
+    LOG(MM_WARNING) << "Ignoring corrupt database cache snapshot " << path;
+    return false;
+  }
+
+  *this = std::move(cache);
+  // The camera rays are derived data and are not part of the snapshot.
+  ComputeCamRays();
+  return true;
+}
+
 void DatabaseCache::AddRig(class Rig rig) {
   const rig_t rig_id = rig.RigId();
   THROW_CHECK(!ExistsRig(rig_id));
@@ -271,6 +749,7 @@ void DatabaseCache::AddRig(class Rig rig) {
 void DatabaseCache::AddCamera(struct Camera camera) {
   const camera_t camera_id = camera.camera_id;
   THROW_CHECK(!ExistsCamera(camera_id));
+  camera.UpdateUndistortionGrid();
   cameras_.emplace(camera_id, std::move(camera));
 }
 
@@ -284,6 +763,9 @@ void DatabaseCache::AddImage(class Image image) {
   const image_t image_id = image.ImageId();
   THROW_CHECK(!ExistsImage(image_id));
   correspondence_graph_->AddImage(image_id, image.NumPoints2D());
+  if (ExistsCamera(image.CameraId())) {
+    ComputeCamRays(image);
+  }
   images_.emplace(image_id, std::move(image));
 }
 
@@ -294,6 +776,41 @@ void DatabaseCache::AddPosePrior(image_t image_id,
   pose_priors_.emplace(image_id, std::move(pose_prior));
 }
 
+void DatabaseCache::ComputeCamRays() {
+  for (auto& [_, camera] : cameras_) {
+    camera.UpdateUndistortionGrid();
+  }
+  cam_rays_.clear();
+  cam_rays_.reserve(images_.size());
+  for (const auto& [_, image] : images_) {
+    ComputeCamRays(image);
+  }
+}
+
+void DatabaseCache::ComputeCamRays(const class Image& image) {
+  const struct Camera& camera = Camera(image.CameraId());
+  const size_t num_points2D = image.NumPoints2D();
+  std::vector<Eigen::Vector2d> img_points(num_points2D);
+  for (point2D_t point2D_idx = 0; point2D_idx < num_points2D; ++point2D_idx) {
+    img_points[point2D_idx] = image.Point2D(point2D_idx).xy;
+  }
+  std::vector<Eigen::Vector2d> cam_points(num_points2D);
+  std::vector<char> valid_mask(num_points2D);
+  camera.CamFromImgBatch(
+      span<const Eigen::Vector2d>(img_points.data(), num_points2D),
+      span<Eigen::Vector2d>(cam_points.data(), num_points2D),
+      span<char>(valid_mask.data(), num_points2D));
+  std::vector<Eigen::Vector3d>& cam_rays = cam_rays_[image.ImageId()];
+  cam_rays.resize(num_points2D);
+  for (size_t i = 0; i < num_points2D; ++i) {
+    if (valid_mask[i]) {
+      cam_rays[i] = cam_points[i].homogeneous().normalized();
+    } else {
+      cam_rays[i].setZero();
+    }
+  }
+}
+
 const class Image* DatabaseCache::FindImageWithName(
     const std::string& name) const {
   for (const auto& image : images_) {
@@ -319,8 +836,15 @@ bool DatabaseCache::SetupPosePriors() {
 
   // Get sorted image ids for GPS to cartesian conversion
   std::set<image_t> image_ids_with_prior;
-  for (const auto& [image_id, _] : pose_priors_) {
-    image_ids_with_prior.insert(image_id);
+  for (const auto& [image_id, pose_prior] : pose_priors_) {
+    // Priors may only have a gravity direction.
+    if (pose_prior.IsValid()) {
+      image_ids_with_prior.insert(image_id);
+    }
+  }
+  if (image_ids_with_prior.empty()) {
+    LOG(MM_ERROR) << "No prior positions in database...";
+    return false;
   }
 
   // Get GPS priors
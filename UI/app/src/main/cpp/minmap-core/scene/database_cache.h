@@ -47,6 +47,35 @@ class DatabaseCache {
       bool ignore_watermarks,
       const std::unordered_set<std::string>& image_names);
 
+  // Same as `Create`, but first tries to restore the cache from the binary
+  // snapshot at `snapshot_path`. If the snapshot is missing or stale, the
+  // cache is loaded from the database and a new snapshot is written.
+  static std::shared_ptr<DatabaseCache> CreateWithSnapshot(
+      const std::string& database_path,
+      const std::string& snapshot_path,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names);
+
+  // Compute the key that identifies a snapshot of the given database. The key
+  // changes whenever the database files are modified or the load options
+  // differ, so that stale snapshots are never restored.
+  static uint64_t SnapshotKey(
+      const std::string& database_path,
+      size_t min_num_matches,
+      bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names);
+
+  // Write the loaded and finalized cache to a versioned binary snapshot. The
+  // arrays are stored in native little endian layout, such that reading the
+  // snapshot is a memory-mapped copy in the order of the file size.
+  void WriteSnapshot(const std::string& path, uint64_t key) const;
+
+  // Restore the cache from a snapshot written by `WriteSnapshot`. Returns false
+  // and leaves the cache unchanged if the file does not exist, was written by
+  // an incompatible version, or does not match the given key.
+  bool ReadSnapshot(const std::string& path, uint64_t key);
+
   // Get number of objects.
   inline size_t NumRigs() const;
   inline size_t NumCameras() const;
@@ -88,6 +117,12 @@ class DatabaseCache {
   inline bool ExistsImage(image_t image_id) const;
   inline bool ExistsPosePrior(image_t image_id) const;
 
+  // Normalized camera rays of the keypoints of an image, computed once when
+  // the image is loaded. The rays are only valid for the camera parameters
+  // of this cache and not for intrinsics refined in a reconstruction.
+  inline bool ExistsCamRays(image_t image_id) const;
+  inline const std::vector<Eigen::Vector3d>& CamRays(image_t image_id) const;
+
   // Get reference to const correspondence graph.
   inline std::shared_ptr<const class CorrespondenceGraph> CorrespondenceGraph()
       const;
@@ -99,6 +134,11 @@ class DatabaseCache {
   bool SetupPosePriors();
 
  private:
+  // Build the undistortion grids of all cameras and compute the camera rays
+  // of all images, or only of the given image.
+  void ComputeCamRays();
+  void ComputeCamRays(const class Image& image);
+
   std::shared_ptr<class CorrespondenceGraph> correspondence_graph_;
 
   std::unordered_map<rig_t, class Rig> rigs_;
@@ -106,6 +146,7 @@ class DatabaseCache {
   std::unordered_map<frame_t, class Frame> frames_;
   std::unordered_map<image_t, class Image> images_;
   std::unordered_map<image_t, struct PosePrior> pose_priors_;
+  std::unordered_map<image_t, std::vector<Eigen::Vector3d>> cam_rays_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -202,6 +243,15 @@ bool DatabaseCache::ExistsPosePrior(const image_t image_id) const {
   return pose_priors_.find(image_id) != pose_priors_.end();
 }
 
+bool DatabaseCache::ExistsCamRays(const image_t image_id) const {
+  return cam_rays_.find(image_id) != cam_rays_.end();
+}
+
+const std::vector<Eigen::Vector3d>& DatabaseCache::CamRays(
+    const image_t image_id) const {
+  return cam_rays_.at(image_id);
+}
+
 std::shared_ptr<const class CorrespondenceGraph>
 DatabaseCache::CorrespondenceGraph() const {
   return correspondence_graph_;
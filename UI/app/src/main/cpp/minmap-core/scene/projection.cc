@@ -31,6 +31,41 @@ double CalculateSquaredReprojectionError(
   return (*proj_point2D - point2D).squaredNorm();
 }
 
+size_t SquaredReprojectionErrorBatch::Add(const Eigen::Vector2d& point2D,
+                                          const Eigen::Vector3d& point3D,
+                                          const Rigid3d& cam_from_world,
+                                          const Camera& camera) {
+  CameraObservations& observations = camera_observations_[&camera];
+  observations.idxs.push_back(num_observations_);
+  observations.points2D.push_back(point2D);
+  observations.points3D_in_cam.push_back(cam_from_world * point3D);
+  return num_observations_++;
+}
+
+std::vector<double> SquaredReprojectionErrorBatch::Compute() const {
+  std::vector<double> squared_errors(num_observations_,
+                                     std::numeric_limits<double>::max());
+  std::vector<Eigen::Vector2d> proj_points2D;
+  std::vector<char> valid_mask;
+  for (const auto& [camera, observations] : camera_observations_) {
+    const size_t num_camera_observations = observations.idxs.size();
+    proj_points2D.resize(num_camera_observations);
+    valid_mask.resize(num_camera_observations);
+    camera->ImgFromCamBatch(
+        span<const Eigen::Vector3d>(observations.points3D_in_cam.data(),
+                                    num_camera_observations),
+        span<Eigen::Vector2d>(proj_points2D.data(), num_camera_observations),
+        span<char>(valid_mask.data(), num_camera_observations));
+    for (size_t i = 0; i < num_camera_observations; ++i) {
+      if (valid_mask[i]) {
+        squared_errors[observations.idxs[i]] =
+            (proj_points2D[i] - observations.points2D[i]).squaredNorm();
+      }
+    }
+  }
+  return squared_errors;
+}
+
 double CalculateAngularReprojectionError(const Eigen::Vector2d& point2D,
                                          const Eigen::Vector3d& point3D,
                                          const Rigid3d& cam_from_world,
@@ -4,6 +4,7 @@
 #include "../scene/camera.h"
 
 #include <limits>
+#include <unordered_map>
 #include <vector>
 
 #include <PoseLib/alignment.h>
@@ -27,6 +28,34 @@ double CalculateSquaredReprojectionError(
     const Eigen::Matrix3x4d& cam_from_world,
     const Camera& camera);
 
+// Calculate the squared reprojection errors of many observations.
+//
+// The observations are collected per camera and projected in one batch per
+// camera, such that the camera model is dispatched once per camera instead
+// of once per observation. As for `CalculateSquaredReprojectionError`, the
+// error of a 3D point that cannot be projected into the image is DBL_MAX.
+class SquaredReprojectionErrorBatch {
+ public:
+  // Add an observation and return the index of its error.
+  size_t Add(const Eigen::Vector2d& point2D,
+             const Eigen::Vector3d& point3D,
+             const Rigid3d& cam_from_world,
+             const Camera& camera);
+
+  // The errors of all observations in the order of adding them.
+  std::vector<double> Compute() const;
+
+ private:
+  struct CameraObservations {
+    std::vector<size_t> idxs;
+    std::vector<Eigen::Vector2d> points2D;
+    std::vector<Eigen::Vector3d> points3D_in_cam;
+  };
+
+  std::unordered_map<const Camera*, CameraObservations> camera_observations_;
+  size_t num_observations_ = 0;
+};
+
 // Calculate the angular reprojection error.
 //
 // The angular error is the angle between the observed viewing ray and the
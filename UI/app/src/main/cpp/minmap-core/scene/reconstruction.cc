@@ -292,10 +292,11 @@ point3D_t Reconstruction::AddPoint3D(const Eigen::Vector3d& xyz,
     THROW_CHECK_LE(image.NumPoints3D(), image.NumPoints2D());
   }
 
-  struct Point3D& point3D = points3D_[point3D_id];
+  struct Point3D point3D;
   point3D.xyz = xyz;
   point3D.track = std::move(track);
   point3D.color = color;
+  points3D_.emplace(point3D_id, std::move(point3D));
 
   return point3D_id;
 }
@@ -334,8 +335,8 @@ point3D_t Reconstruction::MergePoints3D(const point3D_t point3D_id1,
   DeletePoint3D(point3D_id1);
   DeletePoint3D(point3D_id2);
 
-  const point3D_t merged_point3D_id =
-      AddPoint3D(merged_xyz, merged_track, merged_rgb.cast<uint8_t>());
+  const point3D_t merged_point3D_id = AddPoint3D(
+      merged_xyz, std::move(merged_track), merged_rgb.cast<uint8_t>());
 
   return merged_point3D_id;
 }
@@ -677,18 +678,29 @@ double Reconstruction::ComputeMeanReprojectionError() const {
 }
 
 void Reconstruction::UpdatePoint3DErrors() {
+  SquaredReprojectionErrorBatch squared_reproj_error_batch;
+  for (const auto& point3D : points3D_) {
+    for (const auto& track_el : point3D.second.track.Elements()) {
+      const auto& image = Image(track_el.image_id);
+      const auto& point2D = image.Point2D(track_el.point2D_idx);
+      squared_reproj_error_batch.Add(point2D.xy,
+                                     point3D.second.xyz,
+                                     image.CamFromWorld(),
+                                     *image.CameraPtr());
+    }
+  }
+
+  // The errors are in the order of the points and their track elements.
+  const std::vector<double> squared_reproj_errors =
+      squared_reproj_error_batch.Compute();
+  size_t error_idx = 0;
   for (auto& point3D : points3D_) {
+    point3D.second.error = 0;
     if (point3D.second.track.Length() == 0) {
-      point3D.second.error = 0;
       continue;
     }
-    point3D.second.error = 0;
-    for (const auto& track_el : point3D.second.track.Elements()) {
-      const auto& image = Image(track_el.image_id);
-      const auto& point2D = image.Point2D(track_el.point2D_idx);
-      const auto& camera = *image.CameraPtr();
-      point3D.second.error += std::sqrt(CalculateSquaredReprojectionError(
-          point2D.xy, point3D.second.xyz, image.CamFromWorld(), camera));
+    for (size_t i = 0; i < point3D.second.track.Length(); ++i) {
+      point3D.second.error += std::sqrt(squared_reproj_errors[error_idx++]);
     }
     point3D.second.error /= point3D.second.track.Length();
   }
@@ -8,6 +8,7 @@
 #include "../scene/point3d.h"
 #include "../scene/track.h"
 #include "../sensor/rig.h"
+#include "../util/slot_map.h"
 #include "../util/types.h"
 
 #include <memory>
@@ -64,7 +65,7 @@ class Reconstruction {
   inline const std::unordered_map<frame_t, class Frame>& Frames() const;
   inline const std::vector<frame_t>& RegFrameIds() const;
   inline const std::unordered_map<image_t, class Image>& Images() const;
-  inline const std::unordered_map<point3D_t, struct Point3D>& Points3D() const;
+  inline const SlotMap<point3D_t, struct Point3D>& Points3D() const;
 
   // Number of images in all registered frames.
   size_t NumRegImages() const;
@@ -247,7 +248,7 @@ class Reconstruction {
   std::unordered_map<camera_t, struct Camera> cameras_;
   std::unordered_map<frame_t, class Frame> frames_;
   std::unordered_map<image_t, class Image> images_;
-  std::unordered_map<point3D_t, struct Point3D> points3D_;
+  SlotMap<point3D_t, struct Point3D> points3D_;
 
   // Unique set of frame_ids where `Frame(frame_id).HasPose() == true`.
   // Note that we intentionally use a vector instead of a set here leading
@@ -389,7 +390,7 @@ const std::vector<frame_t>& Reconstruction::RegFrameIds() const {
   return reg_frame_ids_;
 }
 
-const std::unordered_map<point3D_t, Point3D>& Reconstruction::Points3D() const {
+const SlotMap<point3D_t, Point3D>& Reconstruction::Points3D() const {
   return points3D_;
 }
 
@@ -28,6 +28,21 @@ std::vector<ID_TYPE> ExtractSortedIds(
   return ids;
 }
 
+template <typename ID_TYPE, typename DATA_TYPE>
+std::vector<ID_TYPE> ExtractSortedIds(
+    const SlotMap<ID_TYPE, DATA_TYPE>& data,
+    const std::function<bool(const DATA_TYPE&)>& filter = nullptr) {
+  std::vector<ID_TYPE> ids;
+  ids.reserve(data.size());
+  for (const auto& [id, d] : data) {
+    if (filter == nullptr || filter(d)) {
+      ids.push_back(id);
+    }
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
 void CreateOneRigPerCamera(Reconstruction& reconstruction);
 
 void CreateFrameForImage(const Image& image,
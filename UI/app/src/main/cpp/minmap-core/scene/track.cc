@@ -1,7 +1,93 @@
 #include "../scene/track.h"
 
+#include <limits>
+
 namespace colmap {
 
+TrackElements::TrackElements()
+    : data_(inline_elements_), size_(0), capacity_(kNumInlineElements) {}
+
+TrackElements::TrackElements(const TrackElements& other) : TrackElements() {
+  insert(end(), other.begin(), other.end());
+}
+
+TrackElements::TrackElements(TrackElements&& other) noexcept
+    : TrackElements() {
+  *this = std::move(other);
+}
+
+TrackElements& TrackElements::operator=(const TrackElements& other) {
+  if (this != &other) {
+    clear();
+    insert(end(), other.begin(), other.end());
+  }
+  return *this;
+}
+
+TrackElements& TrackElements::operator=(TrackElements&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  if (other.IsInline()) {
+    // Keep the heap storage of this track, if any, to be reused.
+    clear();
+    std::copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+  } else {
+    if (!IsInline()) {
+      delete[] data_;
+    }
+    data_ = other.data_;
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    other.data_ = other.inline_elements_;
+    other.capacity_ = kNumInlineElements;
+  }
+  other.size_ = 0;
+  return *this;
+}
+
+TrackElements::~TrackElements() {
+  if (!IsInline()) {
+    delete[] data_;
+  }
+}
+
+void TrackElements::reserve(const size_t num_elements) {
+  if (num_elements > capacity_) {
+    THROW_CHECK_LE(num_elements, std::numeric_limits<uint32_t>::max());
+    Reallocate(static_cast<uint32_t>(num_elements));
+  }
+}
+
+void TrackElements::shrink_to_fit() {
+  if (!IsInline() && size_ < capacity_) {
+    Reallocate(size_);
+  }
+}
+
+bool TrackElements::operator==(const TrackElements& other) const {
+  return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+}
+
+void TrackElements::Reallocate(const uint32_t capacity) {
+  TrackElement* data;
+  if (capacity <= kNumInlineElements) {
+    data = inline_elements_;
+    capacity_ = kNumInlineElements;
+  } else {
+    data = new TrackElement[capacity];
+    capacity_ = capacity;
+  }
+  if (data != data_) {
+    std::copy(begin(), end(), data);
+    if (!IsInline()) {
+      delete[] data_;
+    }
+    data_ = data;
+  }
+}
+
 Track::Track() {}
 
 TrackElement::TrackElement()
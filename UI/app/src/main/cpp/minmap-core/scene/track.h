@@ -3,6 +3,10 @@
 #include "../util/logging.h"
 #include "../util/types.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 
 namespace colmap {
@@ -20,6 +24,77 @@ struct TrackElement {
   inline bool operator!=(const TrackElement& other) const;
 };
 
+// Storage of the elements of a track with a subset of the std::vector
+// interface. Up to kNumInlineElements elements are stored inline, such that
+// the majority of tracks does not need a separate heap allocation, and only
+// longer tracks spill to the heap. Unlike std::vector, moving the storage of
+// a short track copies its elements and invalidates iterators.
+class TrackElements {
+ public:
+  static constexpr uint32_t kNumInlineElements = 4;
+
+  using value_type = TrackElement;
+  using iterator = TrackElement*;
+  using const_iterator = const TrackElement*;
+
+  TrackElements();
+  template <typename InputIt>
+  TrackElements(InputIt first, InputIt last);
+  TrackElements(const TrackElements& other);
+  TrackElements(TrackElements&& other) noexcept;
+  TrackElements& operator=(const TrackElements& other);
+  TrackElements& operator=(TrackElements&& other) noexcept;
+  ~TrackElements();
+
+  inline size_t size() const;
+  inline bool empty() const;
+  inline size_t capacity() const;
+
+  inline TrackElement* data();
+  inline const TrackElement* data() const;
+
+  inline iterator begin();
+  inline iterator end();
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+
+  inline TrackElement& operator[](size_t idx);
+  inline const TrackElement& operator[](size_t idx) const;
+  // Throws std::out_of_range if the index is invalid.
+  inline TrackElement& at(size_t idx);
+  inline const TrackElement& at(size_t idx) const;
+  inline TrackElement& front();
+  inline const TrackElement& front() const;
+  inline TrackElement& back();
+  inline const TrackElement& back() const;
+
+  inline void push_back(const TrackElement& element);
+  inline void emplace_back(image_t image_id, point2D_t point2D_idx);
+  // The inserted range must not alias the storage.
+  template <typename InputIt>
+  void insert(const_iterator pos, InputIt first, InputIt last);
+  inline iterator erase(const_iterator pos);
+  inline iterator erase(const_iterator first, const_iterator last);
+  inline void pop_back();
+
+  void reserve(size_t num_elements);
+  inline void clear();
+  // Moves the elements back inline or into a heap block of exact size.
+  void shrink_to_fit();
+
+  bool operator==(const TrackElements& other) const;
+  inline bool operator!=(const TrackElements& other) const;
+
+ private:
+  inline bool IsInline() const;
+  void Reallocate(uint32_t capacity);
+
+  TrackElement* data_;
+  uint32_t size_;
+  uint32_t capacity_;
+  TrackElement inline_elements_[kNumInlineElements];
+};
+
 class Track {
  public:
   Track();
@@ -28,9 +103,10 @@ class Track {
   inline size_t Length() const;
 
   // Access all elements.
-  inline const std::vector<TrackElement>& Elements() const;
-  inline std::vector<TrackElement>& Elements();
-  inline void SetElements(std::vector<TrackElement> elements);
+  inline const TrackElements& Elements() const;
+  inline TrackElements& Elements();
+  inline void SetElements(const std::vector<TrackElement>& elements);
+  inline void SetElements(TrackElements elements);
 
   // Access specific elements.
   inline const TrackElement& Element(size_t idx) const;
@@ -41,6 +117,7 @@ class Track {
   inline void AddElement(const TrackElement& element);
   inline void AddElement(image_t image_id, point2D_t point2D_idx);
   inline void AddElements(const std::vector<TrackElement>& elements);
+  inline void AddElements(const TrackElements& elements);
 
   // Delete existing element.
   inline void DeleteElement(size_t idx);
@@ -50,14 +127,14 @@ class Track {
   // specified number of elements.
   inline void Reserve(size_t num_elements);
 
-  // Shrink the capacity of track vector to fit its size to save memory.
+  // Shrink the capacity of the track storage to fit its size to save memory.
   inline void Compress();
 
   inline bool operator==(const Track& other) const;
   inline bool operator!=(const Track& other) const;
 
  private:
-  std::vector<TrackElement> elements_;
+  TrackElements elements_;
 };
 
 std::ostream& operator<<(std::ostream& stream, const TrackElement& track_el);
@@ -75,13 +152,128 @@ bool TrackElement::operator!=(const TrackElement& other) const {
   return !(*this == other);
 }
 
+template <typename InputIt>
+TrackElements::TrackElements(InputIt first, InputIt last) : TrackElements() {
+  insert(end(), first, last);
+}
+
+size_t TrackElements::size() const { return size_; }
+
+bool TrackElements::empty() const { return size_ == 0; }
+
+size_t TrackElements::capacity() const { return capacity_; }
+
+TrackElement* TrackElements::data() { return data_; }
+
+const TrackElement* TrackElements::data() const { return data_; }
+
+TrackElements::iterator TrackElements::begin() { return data_; }
+
+TrackElements::iterator TrackElements::end() { return data_ + size_; }
+
+TrackElements::const_iterator TrackElements::begin() const { return data_; }
+
+TrackElements::const_iterator TrackElements::end() const {
+  return data_ + size_;
+}
+
+TrackElement& TrackElements::operator[](const size_t idx) {
+  return data_[idx];
+}
+
+const TrackElement& TrackElements::operator[](const size_t idx) const {
+  return data_[idx];
+}
+
+TrackElement& TrackElements::at(const size_t idx) {
+  if (idx >= size_) {
+    throw std::out_of_range("TrackElements::at");
+  }
+  return data_[idx];
+}
+
+const TrackElement& TrackElements::at(const size_t idx) const {
+  if (idx >= size_) {
+    throw std::out_of_range("TrackElements::at");
+  }
+  return data_[idx];
+}
+
+TrackElement& TrackElements::front() { return data_[0]; }
+
+const TrackElement& TrackElements::front() const { return data_[0]; }
+
+TrackElement& TrackElements::back() { return data_[size_ - 1]; }
+
+const TrackElement& TrackElements::back() const { return data_[size_ - 1]; }
+
+void TrackElements::push_back(const TrackElement& element) {
+  if (size_ == capacity_) {
+    // The element may alias the current storage.
+    const TrackElement copy = element;
+    reserve(2 * static_cast<size_t>(capacity_));
+    data_[size_++] = copy;
+  } else {
+    data_[size_++] = element;
+  }
+}
+
+void TrackElements::emplace_back(const image_t image_id,
+                                 const point2D_t point2D_idx) {
+  push_back(TrackElement(image_id, point2D_idx));
+}
+
+template <typename InputIt>
+void TrackElements::insert(const_iterator pos, InputIt first, InputIt last) {
+  const size_t pos_idx = pos - data_;
+  THROW_CHECK_LE(pos_idx, size_);
+  const size_t num_elements = std::distance(first, last);
+  if (num_elements == 0) {
+    return;
+  }
+  if (size_ + num_elements > capacity_) {
+    reserve(std::max(size_ + num_elements, 2 * static_cast<size_t>(capacity_)));
+  }
+  std::move_backward(
+      data_ + pos_idx, data_ + size_, data_ + size_ + num_elements);
+  std::copy(first, last, data_ + pos_idx);
+  size_ += num_elements;
+}
+
+TrackElements::iterator TrackElements::erase(const_iterator pos) {
+  return erase(pos, pos + 1);
+}
+
+TrackElements::iterator TrackElements::erase(const_iterator first,
+                                             const_iterator last) {
+  iterator mutable_first = data_ + (first - data_);
+  iterator mutable_last = data_ + (last - data_);
+  std::move(mutable_last, end(), mutable_first);
+  size_ -= mutable_last - mutable_first;
+  return mutable_first;
+}
+
+void TrackElements::pop_back() { --size_; }
+
+void TrackElements::clear() { size_ = 0; }
+
+bool TrackElements::operator!=(const TrackElements& other) const {
+  return !(*this == other);
+}
+
+bool TrackElements::IsInline() const { return data_ == inline_elements_; }
+
 size_t Track::Length() const { return elements_.size(); }
 
-const std::vector<TrackElement>& Track::Elements() const { return elements_; }
+const TrackElements& Track::Elements() const { return elements_; }
+
+TrackElements& Track::Elements() { return elements_; }
 
-std::vector<TrackElement>& Track::Elements() { return elements_; }
+void Track::SetElements(const std::vector<TrackElement>& elements) {
+  elements_ = TrackElements(elements.begin(), elements.end());
+}
 
-void Track::SetElements(std::vector<TrackElement> elements) {
+void Track::SetElements(TrackElements elements) {
   elements_ = std::move(elements);
 }
 
@@ -108,6 +300,10 @@ void Track::AddElements(const std::vector<TrackElement>& elements) {
   elements_.insert(elements_.end(), elements.begin(), elements.end());
 }
 
+void Track::AddElements(const TrackElements& elements) {
+  elements_.insert(elements_.end(), elements.begin(), elements.end());
+}
+
 void Track::DeleteElement(const size_t idx) {
   THROW_CHECK_LT(idx, elements_.size());
   elements_.erase(elements_.begin() + idx);
@@ -0,0 +1,195 @@
+// Benchmark of the track storage on a synthetic reconstruction with a large
+// number of 3D points. The tracks are built observation by observation as in
+// the incremental triangulation, then a fraction of the points is merged and
+// a fraction of the observations is deleted, as in the track merging and
+// filtering of the incremental mapper. Reports the number of heap allocations
+// per phase and the peak resident set size of the process. Build with
+// MINMAP_BUILD_BENCHMARKS=ON and run, e.g., through adb on the target device:
+//
+//    minmap_track_benchmark [num_points] [num_images]
+//
+
+#include "reconstruction.h"
+
+#include "../util/string.h"
+#include "../util/timer.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+
+namespace {
+
+std::atomic<size_t> num_allocations(0);
+
+}  // namespace
+
+void* operator new(const size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace colmap {
+namespace {
+
+// Peak resident set size of the process in MB.
+double PeakRSS() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+class Phase {
+ public:
+  explicit Phase(const std::string& name)
+      : name_(name), num_allocations_(num_allocations.load()) {
+    timer_.Start();
+  }
+
+  void Print(const Reconstruction& reconstruction) const {
+    std::cout << StringPrintf(
+                     "%-6s time=%.3fs allocations=%d num_points=%d "
+                     "num_observations=%d peak_rss=%.1fMB",
+                     name_.c_str(),
+                     timer_.ElapsedSeconds(),
+                     static_cast<int>(num_allocations.load() -
+                                      num_allocations_),
+                     static_cast<int>(reconstruction.NumPoints3D()),
+                     static_cast<int>(
+                         reconstruction.ComputeNumObservations()),
+                     PeakRSS())
+              << std::endl;
+  }
+
+ private:
+  const std::string name_;
+  const size_t num_allocations_;
+  Timer timer_;
+};
+
+}  // namespace
+}  // namespace colmap
+
+int main(int argc, char** argv) {
+  using namespace colmap;
+
+  const int num_points = argc > 1 ? std::stoi(argv[1]) : 500000;
+  const int num_images = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> image_distribution(0, num_images - 1);
+  // Most tracks are short and few are long, with a mean length of about 4.
+  std::geometric_distribution<int> track_length_distribution(0.35);
+
+  std::vector<std::vector<TrackElement>> tracks(num_points);
+  std::vector<point2D_t> num_points2D(num_images, 0);
+  for (auto& track : tracks) {
+    const int track_length =
+        std::min(num_images, 2 + track_length_distribution(rng));
+    while (static_cast<int>(track.size()) < track_length) {
+      const int image_idx = image_distribution(rng);
+      if (std::none_of(track.begin(),
+                       track.end(),
+                       [image_idx](const TrackElement& track_el) {
+                         return track_el.image_id ==
+                                static_cast<image_t>(image_idx + 1);
+                       })) {
+        track.emplace_back(image_idx + 1, num_points2D[image_idx]++);
+      }
+    }
+  }
+
+  Reconstruction reconstruction;
+
+  Camera camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 1000, 1000, 1000);
+  reconstruction.AddCamera(camera);
+
+  Rig rig;
+  rig.SetRigId(1);
+  rig.AddRefSensor(camera.SensorId());
+  reconstruction.AddRig(rig);
+
+  for (int i = 0; i < num_images; ++i) {
+    const image_t image_id = i + 1;
+
+    Image image;
+    image.SetImageId(image_id);
+    image.SetCameraId(camera.camera_id);
+    image.SetName(StringPrintf("image%06d", i));
+    image.SetPoints2D(
+        std::vector<Eigen::Vector2d>(num_points2D[i], Eigen::Vector2d::Zero()));
+
+    Frame frame;
+    frame.SetFrameId(image_id);
+    frame.SetRigId(rig.RigId());
+    frame.AddDataId(image.DataId());
+    frame.SetRigFromWorld(Rigid3d());
+    reconstruction.AddFrame(frame);
+
+    image.SetFrameId(image_id);
+    reconstruction.AddImage(image);
+    reconstruction.RegisterFrame(image_id);
+  }
+
+  std::cout << StringPrintf("num_points=%d num_images=%d sizeof(Track)=%d",
+                            num_points,
+                            num_images,
+                            static_cast<int>(sizeof(Track)))
+            << std::endl;
+
+  {
+    Phase phase("build");
+    for (const auto& track : tracks) {
+      const point3D_t point3D_id =
+          reconstruction.AddPoint3D(Eigen::Vector3d::Zero(), Track());
+      for (const auto& track_el : track) {
+        reconstruction.AddObservation(point3D_id, track_el);
+      }
+    }
+    phase.Print(reconstruction);
+  }
+
+  {
+    Phase phase("merge");
+    std::vector<point3D_t> point3D_ids;
+    point3D_ids.reserve(reconstruction.NumPoints3D());
+    for (const auto& point3D : reconstruction.Points3D()) {
+      point3D_ids.push_back(point3D.first);
+    }
+    std::shuffle(point3D_ids.begin(), point3D_ids.end(), rng);
+    for (size_t i = 0; i + 1 < point3D_ids.size() / 5; i += 2) {
+      reconstruction.MergePoints3D(point3D_ids[i], point3D_ids[i + 1]);
+    }
+    phase.Print(reconstruction);
+  }
+
+  {
+    Phase phase("filter");
+    std::vector<TrackElement> track_els;
+    for (const auto& point3D : reconstruction.Points3D()) {
+      if (point3D.first % 4 == 0) {
+        track_els.push_back(point3D.second.track.Element(0));
+      }
+    }
+    for (const auto& track_el : track_els) {
+      reconstruction.DeleteObservation(track_el.image_id,
+                                       track_el.point2D_idx);
+    }
+    phase.Print(reconstruction);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -225,6 +225,16 @@ struct BaseCameraModel {
   static inline bool IterativeUndistortion(const double* params,
                                            double* u,
                                            double* v);
+
+  static inline void ImgFromCamBatch(const double* params,
+                                     span<const Eigen::Vector3d> cam_points,
+                                     span<Eigen::Vector2d> img_points,
+                                     span<char> valid_mask);
+
+  static inline void CamFromImgBatch(const double* params,
+                                     span<const Eigen::Vector2d> img_points,
+                                     span<Eigen::Vector2d> cam_points,
+                                     span<char> valid_mask);
 };
 
 // Base model for Fisheye camera models
@@ -563,6 +573,38 @@ inline std::optional<Eigen::Vector2d> CameraModelCamFromImg(
     const std::vector<double>& params,
     const Eigen::Vector2d& xy);
 
+// Transform a batch of camera to image coordinates. In contrast to calling
+// `CameraModelImgFromCam` per point, the camera model is dispatched once and
+// the points are transformed in a single loop over the inlined model.
+//
+// @param model_id     Unique identifier of camera model.
+// @param params       Array of camera parameters.
+// @param cam_points   Coordinates in camera system as (u, v, w).
+// @param img_points   Output image coordinates in pixels.
+// @param valid_mask   Output whether each point could be transformed. The
+//                     image coordinates of invalid points are undefined.
+inline void CameraModelImgFromCamBatch(CameraModelId model_id,
+                                       const std::vector<double>& params,
+                                       span<const Eigen::Vector3d> cam_points,
+                                       span<Eigen::Vector2d> img_points,
+                                       span<char> valid_mask);
+
+// Transform a batch of image to camera coordinates, see
+// `CameraModelImgFromCamBatch`.
+//
+// @param model_id     Unique identifier of camera model.
+// @param params       Array of camera parameters.
+// @param img_points   Image coordinates in pixels.
+// @param cam_points   Output camera coordinates as (u, v), i.e. the rays
+//                     (u, v, 1) in camera frame.
+// @param valid_mask   Output whether each point could be transformed. The
+//                     camera coordinates of invalid points are undefined.
+inline void CameraModelCamFromImgBatch(CameraModelId model_id,
+                                       const std::vector<double>& params,
+                                       span<const Eigen::Vector2d> img_points,
+                                       span<Eigen::Vector2d> cam_points,
+                                       span<char> valid_mask);
+
 // Convert pixel threshold in image plane to camera space by dividing
 // the threshold through the mean focal length.
 //
@@ -720,6 +762,41 @@ bool BaseCameraModel<CameraModel>::IterativeUndistortion(const double* params,
   return false;
 }
 
+template <typename CameraModel>
+void BaseCameraModel<CameraModel>::ImgFromCamBatch(
+    const double* params,
+    const span<const Eigen::Vector3d> cam_points,
+    span<Eigen::Vector2d> img_points,
+    span<char> valid_mask) {
+  for (size_t i = 0; i < cam_points.size(); ++i) {
+    const Eigen::Vector3d& cam_point = cam_points[i];
+    Eigen::Vector2d& img_point = img_points[i];
+    valid_mask[i] = CameraModel::ImgFromCam(params,
+                                            cam_point.x(),
+                                            cam_point.y(),
+                                            cam_point.z(),
+                                            &img_point.x(),
+                                            &img_point.y());
+  }
+}
+
+template <typename CameraModel>
+void BaseCameraModel<CameraModel>::CamFromImgBatch(
+    const double* params,
+    const span<const Eigen::Vector2d> img_points,
+    span<Eigen::Vector2d> cam_points,
+    span<char> valid_mask) {
+  for (size_t i = 0; i < img_points.size(); ++i) {
+    const Eigen::Vector2d& img_point = img_points[i];
+    Eigen::Vector2d& cam_point = cam_points[i];
+    valid_mask[i] = CameraModel::CamFromImg(params,
+                                            img_point.x(),
+                                            img_point.y(),
+                                            &cam_point.x(),
+                                            &cam_point.y());
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // SimplePinholeCameraModel
 
@@ -1893,6 +1970,46 @@ std::optional<Eigen::Vector2d> CameraModelCamFromImg(
   return std::nullopt;
 }
 
+void CameraModelImgFromCamBatch(const CameraModelId model_id,
+                                const std::vector<double>& params,
+                                const span<const Eigen::Vector3d> cam_points,
+                                span<Eigen::Vector2d> img_points,
+                                span<char> valid_mask) {
+  THROW_CHECK_EQ(cam_points.size(), img_points.size());
+  THROW_CHECK_EQ(cam_points.size(), valid_mask.size());
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                      \
+  case CameraModel::model_id:                               \
+    CameraModel::ImgFromCamBatch(                           \
+        params.data(), cam_points, img_points, valid_mask); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+void CameraModelCamFromImgBatch(const CameraModelId model_id,
+                                const std::vector<double>& params,
+                                const span<const Eigen::Vector2d> img_points,
+                                span<Eigen::Vector2d> cam_points,
+                                span<char> valid_mask) {
+  THROW_CHECK_EQ(img_points.size(), cam_points.size());
+  THROW_CHECK_EQ(img_points.size(), valid_mask.size());
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                      \
+  case CameraModel::model_id:                               \
+    CameraModel::CamFromImgBatch(                           \
+        params.data(), img_points, cam_points, valid_mask); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
 double CameraModelCamFromImgThreshold(const CameraModelId model_id,
                                       const std::vector<double>& params,
                                       const double threshold) {
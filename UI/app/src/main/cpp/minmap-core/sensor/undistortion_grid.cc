@@ -0,0 +1,161 @@
+#include "undistortion_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace colmap {
+namespace {
+
+template <typename CameraModel>
+void InitializeParamsJet(const std::vector<double>& params,
+                         ceres::Jet<double, 2>* params_jet) {
+  for (size_t i = 0; i < CameraModel::num_params; ++i) {
+    params_jet[i] = ceres::Jet<double, 2>(params[i]);
+  }
+}
+
+}  // namespace
+
+bool UndistortionGrid::IsUsefulFor(const CameraModelId model_id) {
+  // The fisheye models undistort the radius with few cheap iterations, which
+  // are about as fast as the interpolation and the Newton step.
+  switch (model_id) {
+    case SimpleRadialCameraModel::model_id:
+    case RadialCameraModel::model_id:
+    case OpenCVCameraModel::model_id:
+    case FullOpenCVCameraModel::model_id:
+      return true;
+    default:
+      return false;
+  }
+}
+
+UndistortionGrid::UndistortionGrid(const CameraModelId model_id,
+                                   const std::vector<double>& params,
+                                   const size_t width,
+                                   const size_t height)
+    : model_id_(model_id), params_(params), width_(width), height_(height) {
+  THROW_CHECK_GT(width, 0);
+  THROW_CHECK_GT(height, 0);
+
+  spacing_ = std::max(width, height) / static_cast<double>(kNumCells);
+  num_cols_ = static_cast<int>(std::ceil(width / spacing_)) + 1;
+  num_rows_ = static_cast<int>(std::ceil(height / spacing_)) + 1;
+
+  nodes_.resize(num_cols_ * num_rows_);
+  for (int row = 0; row < num_rows_; ++row) {
+    for (int col = 0; col < num_cols_; ++col) {
+      const std::optional<Eigen::Vector2d> cam_point = CameraModelCamFromImg(
+          model_id, params, Eigen::Vector2d(col * spacing_, row * spacing_));
+      nodes_[row * num_cols_ + col] =
+          cam_point ? *cam_point
+                    : Eigen::Vector2d::Constant(
+                          std::numeric_limits<double>::quiet_NaN());
+    }
+  }
+}
+
+std::optional<Eigen::Vector2d> UndistortionGrid::CamFromImg(
+    const Eigen::Vector2d& xy) const {
+  Eigen::Vector2d uv;
+  switch (model_id_) {
+#define CAMERA_MODEL_CASE(CameraModel)                       \
+  case CameraModel::model_id: {                              \
+    ParamsJet<CameraModel> params_jet;                       \
+    InitializeParamsJet<CameraModel>(params_, params_jet);   \
+    if (CamFromImg<CameraModel>(                             \
+            params_jet, xy.x(), xy.y(), &uv.x(), &uv.y())) { \
+      return uv;                                             \
+    }                                                        \
+    break;                                                   \
+  }
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+  return std::nullopt;
+}
+
+void UndistortionGrid::CamFromImgBatch(
+    const span<const Eigen::Vector2d> img_points,
+    span<Eigen::Vector2d> cam_points,
+    span<char> valid_mask) const {
+  THROW_CHECK_EQ(img_points.size(), cam_points.size());
+  THROW_CHECK_EQ(img_points.size(), valid_mask.size());
+  switch (model_id_) {
+#define CAMERA_MODEL_CASE(CameraModel)                                \
+  case CameraModel::model_id:                                         \
+    CamFromImgBatch<CameraModel>(img_points, cam_points, valid_mask); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+template <typename CameraModel>
+bool UndistortionGrid::CamFromImg(const ParamsJet<CameraModel>& params_jet,
+                                  const double x,
+                                  const double y,
+                                  double* u,
+                                  double* v) const {
+  const double grid_x = x / spacing_;
+  const double grid_y = y / spacing_;
+  if (grid_x >= 0 && grid_y >= 0 && grid_x <= num_cols_ - 1 &&
+      grid_y <= num_rows_ - 1) {
+    const int col = std::min(static_cast<int>(grid_x), num_cols_ - 2);
+    const int row = std::min(static_cast<int>(grid_y), num_rows_ - 2);
+    const double tx = grid_x - col;
+    const double ty = grid_y - row;
+    const Eigen::Vector2d* node = &nodes_[row * num_cols_ + col];
+    Eigen::Vector2d uv =
+        (1 - ty) * ((1 - tx) * node[0] + tx * node[1]) +
+        ty * ((1 - tx) * node[num_cols_] + tx * node[num_cols_ + 1]);
+
+    // Newton step on the projection of the camera model.
+    typedef ceres::Jet<double, 2> JetT;
+    JetT x_jet;
+    JetT y_jet;
+    if (uv.allFinite() && CameraModel::ImgFromCam(params_jet,
+                                                  JetT(uv(0), 0),
+                                                  JetT(uv(1), 1),
+                                                  JetT(1),
+                                                  &x_jet,
+                                                  &y_jet)) {
+      Eigen::Matrix2d J;
+      J << x_jet.v[0], x_jet.v[1], y_jet.v[0], y_jet.v[1];
+      const Eigen::Vector2d step = J.partialPivLu().solve(
+          Eigen::Vector2d(x_jet.a - x, y_jet.a - y));
+      if (step.squaredNorm() <= kMaxSquaredStep) {
+        *u = uv(0) - step(0);
+        *v = uv(1) - step(1);
+        return true;
+      }
+    }
+  }
+
+  return CameraModel::CamFromImg(params_.data(), x, y, u, v);
+}
+
+template <typename CameraModel>
+void UndistortionGrid::CamFromImgBatch(
+    const span<const Eigen::Vector2d> img_points,
+    span<Eigen::Vector2d> cam_points,
+    span<char> valid_mask) const {
+  ParamsJet<CameraModel> params_jet;
+  InitializeParamsJet<CameraModel>(params_, params_jet);
+  for (size_t i = 0; i < img_points.size(); ++i) {
+    const Eigen::Vector2d& img_point = img_points[i];
+    Eigen::Vector2d& cam_point = cam_points[i];
+    valid_mask[i] = CamFromImg<CameraModel>(params_jet,
+                                            img_point.x(),
+                                            img_point.y(),
+                                            &cam_point.x(),
+                                            &cam_point.y());
+  }
+}
+
+}  // namespace colmap
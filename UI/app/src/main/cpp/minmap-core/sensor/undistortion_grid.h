@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../sensor/models.h"
+#include "../util/types.h"
+
+#include <optional>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+// Lookup table of the image to camera transformation of a camera model.
+//
+// Camera models with distortion lift image points to the camera frame by an
+// iterative undistortion, which is repeated for the same keypoints by many
+// estimators. The grid stores the undistorted camera coordinates at the nodes
+// of a regular grid over the image. A lookup interpolates the nodes bilinearly
+// and refines the result with a single Newton step on the projection of the
+// camera model. Points outside of the image, or whose Newton step is too large
+// to have converged, fall back to the iterative undistortion, such that the
+// results match `CameraModelCamFromImg` far below the keypoint precision.
+//
+// The grid is immutable and only valid for the camera parameters that it was
+// built for, such that it can be shared between threads and camera copies.
+class UndistortionGrid {
+ public:
+  // Number of grid cells along the larger image dimension.
+  static constexpr int kNumCells = 64;
+
+  // Maximum squared norm of the Newton step in normalized camera coordinates.
+  // Newton's method converges quadratically, such that the error after a step
+  // of at most 1e-4 is in the order of 1e-8, i.e. 1e-5 pixels for a focal
+  // length of 1000 pixels.
+  static constexpr double kMaxSquaredStep = 1e-8;
+
+  // Whether the camera model lifts image points by iterative undistortion,
+  // i.e. whether a grid speeds up `CamFromImg`.
+  static bool IsUsefulFor(CameraModelId model_id);
+
+  UndistortionGrid(CameraModelId model_id,
+                   const std::vector<double>& params,
+                   size_t width,
+                   size_t height);
+
+  // Whether the grid was built for the given camera model and parameters.
+  inline bool IsValidFor(CameraModelId model_id,
+                         const std::vector<double>& params,
+                         size_t width,
+                         size_t height) const;
+
+  // Same as `CameraModelCamFromImg` and `CameraModelCamFromImgBatch` with the
+  // camera model and parameters of the grid.
+  std::optional<Eigen::Vector2d> CamFromImg(const Eigen::Vector2d& xy) const;
+  void CamFromImgBatch(span<const Eigen::Vector2d> img_points,
+                       span<Eigen::Vector2d> cam_points,
+                       span<char> valid_mask) const;
+
+ private:
+  // Jets of the camera parameters for the Newton step.
+  template <typename CameraModel>
+  using ParamsJet = ceres::Jet<double, 2>[CameraModel::num_params];
+
+  template <typename CameraModel>
+  bool CamFromImg(const ParamsJet<CameraModel>& params_jet,
+                  double x,
+                  double y,
+                  double* u,
+                  double* v) const;
+
+  template <typename CameraModel>
+  void CamFromImgBatch(span<const Eigen::Vector2d> img_points,
+                       span<Eigen::Vector2d> cam_points,
+                       span<char> valid_mask) const;
+
+  CameraModelId model_id_;
+  std::vector<double> params_;
+  size_t width_;
+  size_t height_;
+
+  // Distance between grid nodes in pixels.
+  double spacing_;
+  int num_cols_;
+  int num_rows_;
+  // Camera coordinates of the nodes in row-major order. Nodes, for which the
+  // undistortion failed, are NaN.
+  std::vector<Eigen::Vector2d> nodes_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool UndistortionGrid::IsValidFor(const CameraModelId model_id,
+                                  const std::vector<double>& params,
+                                  const size_t width,
+                                  const size_t height) const {
+  return model_id_ == model_id && width_ == width && height_ == height &&
+         params_ == params;
+}
+
+}  // namespace colmap
@@ -3,17 +3,118 @@
 #include "incremental_mapper_impl.h"
 #include "../estimators/generalized_pose.h"
 #include "../estimators/pose.h"
+#include "../estimators/similarity_transform.h"
 #include "../estimators/two_view_geometry.h"
+#include "../geometry/pose.h"
 #include "../geometry/triangulation.h"
 #include "../scene/projection.h"
 #include "../sensor/bitmap.h"
 #include "../util/misc.h"
+#include "../util/task_scheduler.h"
+#include "../util/timer.h"
 #include <PoseLib/alignment.h>
 
 #include <array>
+#include <chrono>
 #include <fstream>
+#include <limits>
+#include <numeric>
 
 namespace colmap {
+namespace {
+
+// Direction of gravity in the world frame as the normalized mean of the
+// gravity priors of the registered images. Returns false if none of the
+// registered images has a gravity prior.
+bool EstimateGravityInWorld(const DatabaseCache& database_cache,
+                            const Reconstruction& reconstruction,
+                            Eigen::Vector3d* gravity_in_world) {
+  Eigen::Vector3d gravity_sum = Eigen::Vector3d::Zero();
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    if (!database_cache.ExistsPosePrior(image_id)) {
+      continue;
+    }
+    const struct PosePrior& pose_prior = database_cache.PosePrior(image_id);
+    if (!pose_prior.IsGravityValid()) {
+      continue;
+    }
+    gravity_sum +=
+        reconstruction.Image(image_id).CamFromWorld().rotation.inverse() *
+        pose_prior.gravity;
+  }
+  if (gravity_sum.norm() < std::numeric_limits<double>::epsilon()) {
+    return false;
+  }
+  *gravity_in_world = gravity_sum.normalized();
+  return true;
+}
+
+// Create the adjuster of all registered frames of the reconstruction.
+std::unique_ptr<BundleAdjuster> CreateGlobalBundleAdjuster(
+    const IncrementalMapper::Options& options,
+    const BundleAdjustmentOptions& ba_options,
+    const DatabaseCache& database_cache,
+    const std::unordered_set<frame_t>& existing_frame_ids,
+    Reconstruction& reconstruction) {
+  BundleAdjustmentOptions custom_ba_options = ba_options;
+  // Use stricter convergence criteria for first registered images.
+  const size_t kMinNumRegFramesForFastBA = 10;
+  if (reconstruction.NumRegFrames() < kMinNumRegFramesForFastBA) {
+    custom_ba_options.solver_options.function_tolerance /= 10;
+    custom_ba_options.solver_options.gradient_tolerance /= 10;
+    custom_ba_options.solver_options.parameter_tolerance /= 10;
+    custom_ba_options.solver_options.max_num_iterations *= 2;
+    custom_ba_options.solver_options.max_linear_solver_iterations = 200;
+  }
+
+  // Configure bundle adjustment.
+  BundleAdjustmentConfig ba_config;
+  for (const frame_t frame_id : reconstruction.RegFrameIds()) {
+    const Frame& frame = reconstruction.Frame(frame_id);
+    for (const data_t& data_id : frame.ImageIds()) {
+      ba_config.AddImage(data_id.id);
+    }
+  }
+
+  THROW_CHECK_GE(ba_config.NumImages(), 2) << "At least two images must be "
+                                              "registered for global "
+                                              "bundle-adjustment";
+
+  // Fix the existing images, if option specified.
+  if (options.fix_existing_frames) {
+    for (const frame_t frame_id : reconstruction.RegFrameIds()) {
+      if (existing_frame_ids.count(frame_id)) {
+        ba_config.SetConstantRigFromWorldPose(frame_id);
+      }
+    }
+  }
+
+  // Only use prior pose if at least 3 images have been registered.
+  const bool use_prior_position =
+      options.use_prior_position && ba_config.NumImages() > 2;
+
+  if (!use_prior_position) {
+    // Fixing the gauge with two cameras leads to a more stable optimization
+    // with fewer steps as compared to fixing three points.
+    // TODO(jsch): Investigate whether it is safe to not fix the gauge at all,
+    // as initial experiments show that it is even faster.
+    ba_config.FixGauge(BundleAdjustmentGauge::TWO_CAMS_FROM_WORLD);
+    return CreateDefaultBundleAdjuster(
+        std::move(custom_ba_options), ba_config, reconstruction);
+  } else {
+    PosePriorBundleAdjustmentOptions prior_options;
+    prior_options.use_robust_loss_on_prior_position =
+        options.use_robust_loss_on_prior_position;
+    prior_options.prior_position_loss_scale = options.prior_position_loss_scale;
+    return CreatePosePriorBundleAdjuster(std::move(custom_ba_options),
+                                         prior_options,
+                                         ba_config,
+                                         database_cache.PosePriors(),
+                                         reconstruction);
+  }
+}
+
+}  // namespace
 
 bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GT(init_min_num_inliers, 0);
@@ -34,10 +135,17 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GE(filter_max_reproj_error, 0.0);
   CHECK_OPTION_GE(filter_min_tri_angle, 0.0);
   CHECK_OPTION_GE(max_reg_trials, 1);
+  CHECK_OPTION_GT(reg_num_parallel_images, 0);
   return true;
 }
 
 // Needed
+void IncrementalMapper::NextImageRanks::Clear() {
+  min_num_visible_points = -1;
+  ranked_image_ids.clear();
+  image_ranks.clear();
+}
+
 IncrementalMapper::IncrementalMapper(
     std::shared_ptr<const DatabaseCache> database_cache)
     : database_cache_(std::move(database_cache)),
@@ -68,6 +176,9 @@ void IncrementalMapper::BeginReconstruction(
 
   filtered_frames_.clear();
   reg_stats_.num_reg_trials.clear();
+  next_image_ranks_.Clear();
+  local_ba_context_.Clear();
+  DiscardBackgroundGlobalRefinement();
 }
 
 // Needed
@@ -80,6 +191,9 @@ void IncrementalMapper::EndReconstruction(const bool discard) {
     }
   }
 
+  next_image_ranks_.Clear();
+  local_ba_context_.Clear();
+  DiscardBackgroundGlobalRefinement();
   triangulator_.reset();
   obs_manager_.reset();
   reconstruction_->TearDown();
@@ -103,8 +217,11 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
 }
 
 std::vector<image_t> IncrementalMapper::FindNextImages(const Options& options) {
-  return IncrementalMapperImpl::FindNextImages(
-      options, *obs_manager_, filtered_frames_, reg_stats_.num_reg_trials);
+  return IncrementalMapperImpl::FindNextImages(options,
+                                               *obs_manager_,
+                                               filtered_frames_,
+                                               reg_stats_.num_reg_trials,
+                                               next_image_ranks_);
 }
 
 void IncrementalMapper::RegisterInitialImagePair(
@@ -186,10 +303,112 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
       VLOG(2) << "Registering image using generalized pose estimation";
       return RegisterNextGeneralFrame(options, *image.FramePtr());
     }
+
+    // If any of the other cameras in the same rig has bogus parameters, reset
+    // them to the original values from the database, so we have a chance of
+    // recovering from previous failed estimations. The camera of the image
+    // itself is reset in the pose estimation.
+    for (const data_t& data_id : image.FramePtr()->ImageIds()) {
+      Image& frame_image = reconstruction_->Image(data_id.id);
+      if (frame_image.CameraId() != image.CameraId() &&
+          frame_image.CameraPtr()->HasBogusParams(
+              options.min_focal_length_ratio,
+              options.max_focal_length_ratio,
+              options.max_extra_param)) {
+        VLOG(2) << "Resetting camera " << frame_image.CameraId()
+                << "'s bogus parameters";
+        frame_image.CameraPtr()->params =
+            database_cache_->Camera(frame_image.CameraId()).params;
+      }
+    }
   }
 
   reg_stats_.num_reg_trials[image_id] += 1;
 
+  NextImagePose pose;
+  if (!EstimateNextImagePose(options, image_id, camera, pose)) {
+    return false;
+  }
+
+  RegisterNextImagePose(image_id, pose);
+
+  return true;
+}
+
+image_t IncrementalMapper::RegisterBestNextImage(
+    const Options& options, const std::vector<image_t>& image_ids) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+  THROW_CHECK_GT(reconstruction_->NumRegFrames(), 0);
+  THROW_CHECK(options.Check());
+
+  std::vector<image_t> central_image_ids;
+  std::vector<image_t> rig_image_ids;
+  for (const image_t image_id : image_ids) {
+    const Image& image = reconstruction_->Image(image_id);
+    if (image.FramePtr()->RigPtr()->NumSensors() > 1) {
+      rig_image_ids.push_back(image_id);
+    } else {
+      central_image_ids.push_back(image_id);
+    }
+  }
+
+  // Estimate the poses with copies of the cameras, since images may share
+  // their camera, and only the camera of the registered image is updated.
+  const size_t num_images = central_image_ids.size();
+  std::vector<Camera> cameras;
+  cameras.reserve(num_images);
+  for (const image_t image_id : central_image_ids) {
+    cameras.push_back(*reconstruction_->Image(image_id).CameraPtr());
+  }
+  std::vector<NextImagePose> poses(num_images);
+  std::vector<char> success(num_images, false);
+  ParallelFor(0, num_images, [&](const int64_t i) {
+    success[i] = EstimateNextImagePose(
+        options, central_image_ids[i], cameras[i], poses[i]);
+  });
+
+  // Select the image with the most inliers and, for a deterministic result
+  // independent of the scheduling, the first one in case of ties.
+  size_t best_idx = num_images;
+  for (size_t i = 0; i < num_images; ++i) {
+    if (success[i] && (best_idx == num_images ||
+                       poses[i].num_inliers > poses[best_idx].num_inliers)) {
+      best_idx = i;
+    }
+  }
+
+  // Images whose pose could be estimated but that were not registered are
+  // not counted as failed trials.
+  for (size_t i = 0; i < num_images; ++i) {
+    if (!success[i] || i == best_idx) {
+      reg_stats_.num_reg_trials[central_image_ids[i]] += 1;
+    }
+  }
+
+  if (best_idx < num_images) {
+    const image_t image_id = central_image_ids[best_idx];
+    reconstruction_->Image(image_id).CameraPtr()->params =
+        cameras[best_idx].params;
+    RegisterNextImagePose(image_id, poses[best_idx]);
+    return image_id;
+  }
+
+  for (const image_t image_id : rig_image_ids) {
+    if (RegisterNextImage(options, image_id)) {
+      return image_id;
+    }
+  }
+
+  return kInvalidImageId;
+}
+
+bool IncrementalMapper::EstimateNextImagePose(const Options& options,
+                                              const image_t image_id,
+                                              Camera& camera,
+                                              NextImagePose& pose) const {
+  const Image& image = reconstruction_->Image(image_id);
+
   // Check if enough 2D-3D correspondences.
   if (obs_manager_->NumVisiblePoints3D(image_id) <
       static_cast<size_t>(options.abs_pose_min_num_inliers)) {
@@ -203,9 +422,9 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   // Search for 2D-3D correspondences
   //////////////////////////////////////////////////////////////////////////////
 
-  std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
   std::vector<Eigen::Vector2d> tri_points2D;
   std::vector<Eigen::Vector3d> tri_points3D;
+  std::vector<double> tri_point3D_errors;
 
   const std::shared_ptr<const CorrespondenceGraph> correspondence_graph =
       database_cache_->CorrespondenceGraph();
@@ -246,10 +465,11 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
       const Point3D& point3D =
           reconstruction_->Point3D(corr_point2D.point3D_id);
 
-      tri_corrs.emplace_back(point2D_idx, corr_point2D.point3D_id);
+      pose.tri_corrs.emplace_back(point2D_idx, corr_point2D.point3D_id);
       corr_point3D_ids.insert(corr_point2D.point3D_id);
       tri_points2D.push_back(point2D.xy);
       tri_points3D.push_back(point3D.xyz);
+      tri_point3D_errors.push_back(point3D.error);
     }
   }
 
@@ -264,6 +484,37 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
     return false;
   }
 
+  // Order the correspondences by decreasing quality for progressive sampling,
+  // where the 3D points without known error come last.
+  if (options.abs_pose_progressive_sampling) {
+    std::vector<size_t> order(tri_points2D.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(), [&tri_point3D_errors](size_t i, size_t j) {
+          const double error_i = tri_point3D_errors[i] < 0
+                                     ? std::numeric_limits<double>::max()
+                                     : tri_point3D_errors[i];
+          const double error_j = tri_point3D_errors[j] < 0
+                                     ? std::numeric_limits<double>::max()
+                                     : tri_point3D_errors[j];
+          return error_i < error_j;
+        });
+    std::vector<std::pair<point2D_t, point3D_t>> ordered_tri_corrs;
+    std::vector<Eigen::Vector2d> ordered_tri_points2D;
+    std::vector<Eigen::Vector3d> ordered_tri_points3D;
+    ordered_tri_corrs.reserve(order.size());
+    ordered_tri_points2D.reserve(order.size());
+    ordered_tri_points3D.reserve(order.size());
+    for (const size_t idx : order) {
+      ordered_tri_corrs.push_back(pose.tri_corrs[idx]);
+      ordered_tri_points2D.push_back(tri_points2D[idx]);
+      ordered_tri_points3D.push_back(tri_points3D[idx]);
+    }
+    pose.tri_corrs = std::move(ordered_tri_corrs);
+    tri_points2D = std::move(ordered_tri_points2D);
+    tri_points3D = std::move(ordered_tri_points3D);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // 2D-3D estimation
   //////////////////////////////////////////////////////////////////////////////
@@ -276,9 +527,22 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   abs_pose_options.ransac_options.max_error = options.abs_pose_max_error;
   abs_pose_options.ransac_options.min_inlier_ratio =
       options.abs_pose_min_inlier_ratio;
+  abs_pose_options.progressive_sampling = options.abs_pose_progressive_sampling;
+  if (options.abs_pose_use_gravity &&
+      database_cache_->ExistsPosePrior(image_id) &&
+      database_cache_->PosePrior(image_id).IsGravityValid() &&
+      EstimateGravityInWorld(*database_cache_,
+                             *reconstruction_,
+                             &abs_pose_options.gravity_in_world)) {
+    abs_pose_options.gravity_in_cam =
+        database_cache_->PosePrior(image_id).gravity;
+  }
 
   AbsolutePoseRefinementOptions abs_pose_refinement_options;
-  if (reg_stats_.num_reg_images_per_camera[image.CameraId()] > 0) {
+  const auto num_reg_images_it =
+      reg_stats_.num_reg_images_per_camera.find(image.CameraId());
+  if (num_reg_images_it != reg_stats_.num_reg_images_per_camera.end() &&
+      num_reg_images_it->second > 0) {
     // Camera already refined from another image with the same camera.
     if (camera.HasBogusParams(options.min_focal_length_ratio,
                               options.max_focal_length_ratio,
@@ -310,40 +574,32 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
     abs_pose_refinement_options.refine_extra_params = false;
   }
 
-  // If any of the cameras in the same rig has bogus cameras, reset them to the
-  // original values from the database, so we have a chance of recovering from
-  // previous failed estimations. Notice that this function will be called for
-  // non-trivial frames, when there is no good estimate for the focal length or
-  // one of the rig's cameras has bogus parameters.
-  for (const data_t& data_id : image.FramePtr()->ImageIds()) {
-    Image& frame_image = reconstruction_->Image(data_id.id);
-    if (frame_image.CameraPtr()->HasBogusParams(options.min_focal_length_ratio,
-                                                options.max_focal_length_ratio,
-                                                options.max_extra_param)) {
-      VLOG(2) << "Resetting camera " << frame_image.CameraId()
-              << "'s bogus parameters";
-      frame_image.CameraPtr()->params =
-          database_cache_->Camera(frame_image.CameraId()).params;
-    }
+  // If the camera has bogus parameters, reset them to the original values
+  // from the database, so we have a chance of recovering from previous failed
+  // estimations.
+  if (camera.HasBogusParams(options.min_focal_length_ratio,
+                            options.max_focal_length_ratio,
+                            options.max_extra_param)) {
+    VLOG(2) << "Resetting camera " << image.CameraId()
+            << "'s bogus parameters";
+    camera.params = database_cache_->Camera(image.CameraId()).params;
   }
 
-  size_t num_inliers;
-  std::vector<char> inlier_mask;
-  Rigid3d cam_from_world;
   if (!EstimateAbsolutePose(abs_pose_options,
                             tri_points2D,
                             tri_points3D,
-                            &cam_from_world,
+                            &pose.cam_from_world,
                             &camera,
-                            &num_inliers,
-                            &inlier_mask)) {
+                            &pose.num_inliers,
+                            &pose.inlier_mask)) {
     VLOG(2) << "Absolute pose estimation failed";
     return false;
   }
 
-  if (num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+  if (pose.num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
     VLOG(2) << "Absolute pose estimation failed due to insufficient inliers ("
-            << num_inliers << " < " << options.abs_pose_min_num_inliers << ")";
+            << pose.num_inliers << " < " << options.abs_pose_min_num_inliers
+            << ")";
     return false;
   }
 
@@ -352,30 +608,36 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   //////////////////////////////////////////////////////////////////////////////
 
   if (!RefineAbsolutePose(abs_pose_refinement_options,
-                          inlier_mask,
+                          pose.inlier_mask,
                           tri_points2D,
                           tri_points3D,
-                          &cam_from_world,
+                          &pose.cam_from_world,
                           &camera)) {
     VLOG(2) << "Absolute pose refinement failed";
     return false;
   }
 
+  return true;
+}
+
+void IncrementalMapper::RegisterNextImagePose(const image_t image_id,
+                                              const NextImagePose& pose) {
   //////////////////////////////////////////////////////////////////////////////
   // Continue tracks
   //////////////////////////////////////////////////////////////////////////////
 
-  VLOG(2) << "Continuing tracks for " << num_inliers
+  VLOG(2) << "Continuing tracks for " << pose.num_inliers
           << " inlier 2D-3D correspondences";
 
-  image.FramePtr()->SetCamFromWorld(image.CameraId(), cam_from_world);
+  Image& image = reconstruction_->Image(image_id);
+  image.FramePtr()->SetCamFromWorld(image.CameraId(), pose.cam_from_world);
 
   reconstruction_->RegisterFrame(image.FrameId());
   RegisterFrameEvent(image.FrameId());
 
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
-      const auto [point2D_idx, point3D_id] = tri_corrs[i];
+  for (size_t i = 0; i < pose.inlier_mask.size(); ++i) {
+    if (pose.inlier_mask[i]) {
+      const auto [point2D_idx, point3D_id] = pose.tri_corrs[i];
       const Point2D& point2D = image.Point2D(point2D_idx);
       if (!point2D.HasPoint3D()) {
         const TrackElement track_el(image_id, point2D_idx);
@@ -384,8 +646,6 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
       }
     }
   }
-
-  return true;
 }
 
 bool IncrementalMapper::RegisterNextGeneralFrame(const Options& options,
@@ -703,13 +963,24 @@ IncrementalMapper::AdjustLocalBundle(
 
     // Adjust the local bundle.
     image_ids = ba_config.Images();
+    Timer timer;
+    timer.Start();
     std::unique_ptr<BundleAdjuster> bundle_adjuster =
-        CreateDefaultBundleAdjuster(
+        local_ba_context_.CreateBundleAdjuster(
             ba_options, std::move(ba_config), *reconstruction_);
+    report.problem_construction_time = timer.ElapsedSeconds();
+    timer.Restart();
     const ceres::Solver::Summary summary = bundle_adjuster->Solve();
+    report.solve_time = timer.ElapsedSeconds();
 
     report.num_adjusted_observations = summary.num_residuals / 2;
 
+    // Rebuild the undistortion grids of the refined intrinsics, before the
+    // keypoints of these cameras are lifted again by the triangulator.
+    for (const auto& [camera_id, _] : num_images_per_camera) {
+      reconstruction_->Camera(camera_id).UpdateUndistortionGrid();
+    }
+
     // Merge refined tracks with other existing points.
     report.num_merged_observations =
         triangulator_->MergeTracks(tri_options, variable_point3D_ids);
@@ -743,69 +1014,23 @@ bool IncrementalMapper::AdjustGlobalBundle(
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
 
-  BundleAdjustmentOptions custom_ba_options = ba_options;
-  // Use stricter convergence criteria for first registered images.
-  const size_t kMinNumRegFramesForFastBA = 10;
-  if (reconstruction_->NumRegFrames() < kMinNumRegFramesForFastBA) {
-    custom_ba_options.solver_options.function_tolerance /= 10;
-    custom_ba_options.solver_options.gradient_tolerance /= 10;
-    custom_ba_options.solver_options.parameter_tolerance /= 10;
-    custom_ba_options.solver_options.max_num_iterations *= 2;
-    custom_ba_options.solver_options.max_linear_solver_iterations = 200;
-  }
-
   // Avoid degeneracies in bundle adjustment.
   obs_manager_->FilterObservationsWithNegativeDepth();
 
-  // Configure bundle adjustment.
-  BundleAdjustmentConfig ba_config;
-  for (const frame_t frame_id : reconstruction_->RegFrameIds()) {
-    const Frame& frame = reconstruction_->Frame(frame_id);
-    for (const data_t& data_id : frame.ImageIds()) {
-      ba_config.AddImage(data_id.id);
-    }
-  }
-
-  THROW_CHECK_GE(ba_config.NumImages(), 2) << "At least two images must be "
-                                              "registered for global "
-                                              "bundle-adjustment";
-
-  // Fix the existing images, if option specified.
-  if (options.fix_existing_frames) {
-    for (const frame_t frame_id : reconstruction_->RegFrameIds()) {
-      if (existing_frame_ids_.count(frame_id)) {
-        ba_config.SetConstantRigFromWorldPose(frame_id);
-      }
-    }
-  }
-
-  // Only use prior pose if at least 3 images have been registered.
-  const bool use_prior_position =
-      options.use_prior_position && ba_config.NumImages() > 2;
-
-  std::unique_ptr<BundleAdjuster> bundle_adjuster;
-  if (!use_prior_position) {
-    // Fixing the gauge with two cameras leads to a more stable optimization
-    // with fewer steps as compared to fixing three points.
-    // TODO(jsch): Investigate whether it is safe to not fix the gauge at all,
-    // as initial experiments show that it is even faster.
-    ba_config.FixGauge(BundleAdjustmentGauge::TWO_CAMS_FROM_WORLD);
-    bundle_adjuster = CreateDefaultBundleAdjuster(
-        std::move(custom_ba_options), ba_config, *reconstruction_);
-  } else {
-    PosePriorBundleAdjustmentOptions prior_options;
-    prior_options.use_robust_loss_on_prior_position =
-        options.use_robust_loss_on_prior_position;
-    prior_options.prior_position_loss_scale = options.prior_position_loss_scale;
-    bundle_adjuster =
-        CreatePosePriorBundleAdjuster(std::move(custom_ba_options),
-                                      prior_options,
-                                      ba_config,
-                                      database_cache_->PosePriors(),
-                                      *reconstruction_);
+  std::unique_ptr<BundleAdjuster> bundle_adjuster =
+      CreateGlobalBundleAdjuster(options,
+                                 ba_options,
+                                 *database_cache_,
+                                 existing_frame_ids_,
+                                 *reconstruction_);
+  const bool success =
+      bundle_adjuster->Solve().termination_type != ceres::FAILURE;
+
+  for (const auto& [camera_id, _] : reconstruction_->Cameras()) {
+    reconstruction_->Camera(camera_id).UpdateUndistortionGrid();
   }
 
-  return bundle_adjuster->Solve().termination_type != ceres::FAILURE;
+  return success;
 }
 
 void IncrementalMapper::IterativeLocalRefinement(
@@ -826,6 +1051,10 @@ void IncrementalMapper::IterativeLocalRefinement(
     VLOG(1) << "=> Completed observations: "
             << report.num_completed_observations;
     VLOG(1) << "=> Filtered observations: " << report.num_filtered_observations;
+    VLOG(1) << StringPrintf(
+        "=> Problem construction: %.3fs, solve: %.3fs",
+        report.problem_construction_time,
+        report.solve_time);
     const double changed =
         report.num_adjusted_observations == 0
             ? 0
@@ -877,6 +1106,145 @@ void IncrementalMapper::IterativeGlobalRefinement(
   ClearModifiedPoints3D();
 }
 
+void IncrementalMapper::BeginBackgroundGlobalRefinement(
+    const Options& options,
+    const BundleAdjustmentOptions& ba_options,
+    const IncrementalTriangulator::Options& tri_options) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+  THROW_CHECK(!HasBackgroundGlobalRefinement());
+
+  CompleteAndMergeTracks(tri_options);
+  const size_t num_retriangulated_observations = Retriangulate(tri_options);
+  VLOG(1) << "=> Retriangulated observations: "
+          << num_retriangulated_observations;
+
+  // Avoid degeneracies in bundle adjustment.
+  obs_manager_->FilterObservationsWithNegativeDepth();
+
+  // The snapshot is a deep copy, so the bundle adjustment never touches the
+  // reconstruction that is extended in the meantime.
+  background_ba_snapshot_ =
+      std::make_shared<class Reconstruction>(*reconstruction_);
+  if (background_ba_thread_ == nullptr) {
+    background_ba_thread_ = std::make_unique<ThreadPool>(1);
+  }
+  background_ba_success_ = background_ba_thread_->AddTask(
+      [options,
+       ba_options,
+       database_cache = database_cache_,
+       existing_frame_ids = existing_frame_ids_,
+       snapshot = background_ba_snapshot_]() {
+        return CreateGlobalBundleAdjuster(options,
+                                          ba_options,
+                                          *database_cache,
+                                          existing_frame_ids,
+                                          *snapshot)
+                   ->Solve()
+                   .termination_type != ceres::FAILURE;
+      });
+}
+
+bool IncrementalMapper::HasBackgroundGlobalRefinement() const {
+  return background_ba_success_.valid();
+}
+
+bool IncrementalMapper::IsBackgroundGlobalRefinementDone() const {
+  return background_ba_success_.valid() &&
+         background_ba_success_.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+}
+
+bool IncrementalMapper::EndBackgroundGlobalRefinement(
+    const Options& options,
+    const IncrementalTriangulator::Options& tri_options,
+    const bool normalize_reconstruction) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK(HasBackgroundGlobalRefinement());
+
+  const bool success = background_ba_success_.get();
+  const std::shared_ptr<class Reconstruction> snapshot =
+      std::move(background_ba_snapshot_);
+  if (!success) {
+    LOG(MM_WARNING) << "Background global bundle adjustment failed";
+    return false;
+  }
+
+  // Align the frames that are registered in both reconstructions, such that
+  // the frames and points added in the meantime can be moved along.
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> tgt;
+  for (const frame_t frame_id : reconstruction_->RegFrameIds()) {
+    if (!snapshot->ExistsFrame(frame_id)) {
+      continue;
+    }
+    const Frame& refined_frame = snapshot->Frame(frame_id);
+    if (!refined_frame.HasPose()) {
+      continue;
+    }
+    src.push_back(
+        Inverse(reconstruction_->Frame(frame_id).RigFromWorld()).translation);
+    tgt.push_back(Inverse(refined_frame.RigFromWorld()).translation);
+  }
+  Sim3d refined_from_current;
+  if (src.size() < 3 || !EstimateSim3d(src, tgt, refined_from_current)) {
+    refined_from_current = Sim3d();
+  }
+
+  for (auto& [rig_id, rig] : snapshot->Rigs()) {
+    class Rig& current_rig = reconstruction_->Rig(rig_id);
+    for (const auto& [sensor_id, sensor_from_rig] : rig.NonRefSensors()) {
+      if (sensor_from_rig.has_value() && current_rig.HasSensor(sensor_id)) {
+        current_rig.SetSensorFromRig(sensor_id, sensor_from_rig);
+      }
+    }
+  }
+
+  for (const auto& [camera_id, camera] : snapshot->Cameras()) {
+    struct Camera& current_camera = reconstruction_->Camera(camera_id);
+    current_camera.params = camera.params;
+    current_camera.UpdateUndistortionGrid();
+  }
+
+  for (const frame_t frame_id : reconstruction_->RegFrameIds()) {
+    Frame& frame = reconstruction_->Frame(frame_id);
+    if (snapshot->ExistsFrame(frame_id) &&
+        snapshot->Frame(frame_id).HasPose()) {
+      frame.SetRigFromWorld(snapshot->Frame(frame_id).RigFromWorld());
+    } else {
+      frame.SetRigFromWorld(
+          TransformCameraWorld(refined_from_current, frame.RigFromWorld()));
+    }
+  }
+
+  for (const point3D_t point3D_id : reconstruction_->Point3DIds()) {
+    Point3D& point3D = reconstruction_->Point3D(point3D_id);
+    if (snapshot->ExistsPoint3D(point3D_id)) {
+      point3D.xyz = snapshot->Point3D(point3D_id).xyz;
+    } else {
+      point3D.xyz = refined_from_current * point3D.xyz;
+    }
+  }
+
+  if (normalize_reconstruction && !options.use_prior_position) {
+    // Normalize scene for numerical stability and
+    // to avoid large scale changes in the viewer.
+    reconstruction_->Normalize();
+  }
+  CompleteAndMergeTracks(tri_options);
+  FilterPoints(options);
+  ClearModifiedPoints3D();
+  return true;
+}
+
+void IncrementalMapper::DiscardBackgroundGlobalRefinement() {
+  if (HasBackgroundGlobalRefinement()) {
+    background_ba_success_.wait();
+    background_ba_success_ = {};
+    background_ba_snapshot_.reset();
+  }
+}
+
 size_t IncrementalMapper::FilterFrames(const Options& options) {
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
@@ -974,7 +1342,7 @@ void IncrementalMapper::ClearModifiedPoints3D() {
 std::vector<image_t> IncrementalMapper::FindLocalBundle(
     const Options& options, const image_t image_id) const {
   return IncrementalMapperImpl::FindLocalBundle(
-      options, image_id, *reconstruction_);
+      options, image_id, *obs_manager_);
 }
 
 void IncrementalMapper::RegisterFrameEvent(const frame_t frame_id) {
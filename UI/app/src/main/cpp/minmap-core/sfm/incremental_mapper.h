@@ -3,9 +3,15 @@
 #include "incremental_triangulator.h"
 #include "observation_manager.h"
 #include "../estimators/bundle_adjustment.h"
+#include "../estimators/local_bundle_adjustment.h"
 #include "../scene/database.h"
 #include "../scene/database_cache.h"
 #include "../scene/reconstruction.h"
+#include "../util/threading.h"
+
+#include <functional>
+#include <future>
+#include <set>
 
 namespace colmap {
 
@@ -65,6 +71,15 @@ class IncrementalMapper {
     // Whether to estimate the extra parameters in absolute pose estimation.
     bool abs_pose_refine_extra_params = true;
 
+    // Whether to sample the 2D-3D correspondences in absolute pose estimation
+    // progressively by increasing reprojection error of the 3D points.
+    bool abs_pose_progressive_sampling = false;
+
+    // Whether to hypothesize the pose in absolute pose estimation with the
+    // upright 2-point solver, if the image has a gravity prior. The gravity
+    // in the world frame is then taken from the registered images.
+    bool abs_pose_use_gravity = true;
+
     // Number of images to optimize in local bundle adjustment.
     int local_ba_num_images = 6;
 
@@ -86,6 +101,11 @@ class IncrementalMapper {
     // Maximum number of trials to register an image.
     int max_reg_trials = 3;
 
+    // Number of next images whose poses are estimated in parallel, of which
+    // the image with the most inliers is registered. If 1, the next images are
+    // tried one after the other.
+    int reg_num_parallel_images = 1;
+
     // If reconstruction is provided as input, fix the existing image poses.
     bool fix_existing_frames = false;
 
@@ -119,6 +139,26 @@ class IncrementalMapper {
     size_t num_completed_observations = 0;
     size_t num_filtered_observations = 0;
     size_t num_adjusted_observations = 0;
+    // Time to set up the bundle adjustment problem and to solve it.
+    double problem_construction_time = 0;
+    double solve_time = 0;
+  };
+
+  // Ranks of the not yet registered images with sufficient visible points.
+  // Only the ranks of images with changed visibility in the observation
+  // manager are updated, instead of ranking all images for every next image.
+  struct NextImageRanks {
+    // The options the ranks were computed for. The ranks are recomputed for
+    // all images if the options change.
+    Options::ImageSelectionMethod image_selection_method =
+        Options::ImageSelectionMethod::MIN_UNCERTAINTY;
+    int min_num_visible_points = -1;
+
+    // Images in descending order of their rank and the rank per image.
+    std::set<std::pair<float, image_t>, std::greater<>> ranked_image_ids;
+    std::unordered_map<image_t, float> image_ranks;
+
+    void Clear();
   };
 
   // Create incremental mapper. The database cache must live for the entire
@@ -139,7 +179,10 @@ class IncrementalMapper {
 
   // Find initial image pair to seed the incremental reconstruction. The image
   // pairs should be passed to `RegisterInitialImagePair`. This function
-  // automatically ignores image pairs that failed to register previously.
+  // automatically ignores image pairs that failed to register previously. The
+  // two-view geometries of up to `num_threads` candidate pairs are estimated
+  // in parallel, but the selected pair is the same as if the candidates were
+  // tried one after the other.
   bool FindInitialImagePair(const Options& options,
                             image_t& image_id1,
                             image_t& image_id2,
@@ -147,7 +190,9 @@ class IncrementalMapper {
 
   // Find best next image to register in the incremental reconstruction. The
   // images should be passed to `RegisterNextImage`. This function automatically
-  // ignores images that failed to registered for `max_reg_trials`.
+  // ignores images that failed to registered for `max_reg_trials`. The ranks
+  // of the images are maintained between calls and only updated for images
+  // whose visible points changed.
   std::vector<image_t> FindNextImages(const Options& options);
 
   // Attempt to seed the reconstruction from an image pair.
@@ -160,6 +205,15 @@ class IncrementalMapper {
   // a previous call to `RegisterInitialImagePair` was successful.
   bool RegisterNextImage(const Options& options, image_t image_id);
 
+  // Attempt to register one of the given images to the existing model. The
+  // poses of the images are estimated in parallel without changing the
+  // reconstruction, and the image with the most inliers is registered. Images
+  // of rigs with multiple sensors are only tried afterwards, one after the
+  // other, if none of the other images could be registered. Returns the
+  // registered image or kInvalidImageId.
+  image_t RegisterBestNextImage(const Options& options,
+                                const std::vector<image_t>& image_ids);
+
   // Triangulate observations of image.
   size_t TriangulateImage(const IncrementalTriangulator::Options& tri_options,
                           image_t image_id);
@@ -220,6 +274,36 @@ class IncrementalMapper {
       const IncrementalTriangulator::Options& tri_options,
       bool normalize_reconstruction = true);
 
+  // Start a global bundle adjustment of a snapshot of the reconstruction in a
+  // background thread, such that the next images can be registered and
+  // locally refined in the meantime. As in `IterativeGlobalRefinement`, the
+  // tracks are completed, merged, and retriangulated before the snapshot is
+  // taken. Only one global bundle adjustment can run in the background.
+  void BeginBackgroundGlobalRefinement(
+      const Options& options,
+      const BundleAdjustmentOptions& ba_options,
+      const IncrementalTriangulator::Options& tri_options);
+
+  // Whether a background global bundle adjustment was started and not yet
+  // merged, and whether it is done, such that merging it does not block.
+  bool HasBackgroundGlobalRefinement() const;
+  bool IsBackgroundGlobalRefinementDone() const;
+
+  // Wait for the background global bundle adjustment and merge its result
+  // into the reconstruction. The refined poses, intrinsics, and points of the
+  // snapshot replace the values in the reconstruction, including the changes
+  // of the local bundle adjustments in the meantime. Frames registered and
+  // points created after the snapshot was taken are moved by the similarity
+  // transform that aligns the other frames to their refined poses. Frames and
+  // points that were removed in the meantime stay removed. Afterwards, the
+  // tracks are completed, merged, and filtered as in
+  // `IterativeGlobalRefinement`. Returns false, without changing the
+  // reconstruction, if the bundle adjustment failed.
+  bool EndBackgroundGlobalRefinement(
+      const Options& options,
+      const IncrementalTriangulator::Options& tri_options,
+      bool normalize_reconstruction = true);
+
   // Filter frames and point observations.
   size_t FilterFrames(const Options& options);
   size_t FilterPoints(const Options& options);
@@ -292,6 +376,26 @@ class IncrementalMapper {
     std::unordered_map<image_t, size_t> num_reg_trials;
   };
 
+  // The estimated pose of an image to register and its 2D-3D correspondences.
+  struct NextImagePose {
+    Rigid3d cam_from_world;
+    std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+    std::vector<char> inlier_mask;
+    size_t num_inliers = 0;
+  };
+
+  // Estimate the pose of an image to register without changing the
+  // reconstruction. The intrinsics are estimated in the given camera, which is
+  // either the camera of the image or a copy of it.
+  bool EstimateNextImagePose(const Options& options,
+                             image_t image_id,
+                             Camera& camera,
+                             NextImagePose& pose) const;
+
+  // Register the image with the estimated pose and continue the tracks of its
+  // inlier correspondences.
+  void RegisterNextImagePose(image_t image_id, const NextImagePose& pose);
+
   // Registers a frame using generalized absolute pose estimation.
   bool RegisterNextGeneralFrame(const Options& options, Frame& frame);
 
@@ -300,6 +404,9 @@ class IncrementalMapper {
   void RegisterFrameEvent(frame_t frame_id);
   void DeRegisterFrameEvent(frame_t frame_id);
 
+  // Wait for the background global bundle adjustment and drop its result.
+  void DiscardBackgroundGlobalRefinement();
+
   // Class that holds all necessary data from database in memory.
   const std::shared_ptr<const DatabaseCache> database_cache_;
 
@@ -312,9 +419,22 @@ class IncrementalMapper {
   // Class that is responsible for incremental triangulation.
   std::shared_ptr<IncrementalTriangulator> triangulator_;
 
+  // The problem of the last local bundle adjustment, which is updated for the
+  // next local bundle adjustment.
+  LocalBundleAdjustmentContext local_ba_context_;
+
+  // The snapshot of the background global bundle adjustment and whether the
+  // adjustment succeeded. The thread is only created on first use.
+  std::shared_ptr<class Reconstruction> background_ba_snapshot_;
+  std::future<bool> background_ba_success_;
+  std::unique_ptr<ThreadPool> background_ba_thread_;
+
   // Statistics
   RegistrationStatistics reg_stats_;
 
+  // Ranks of the next images in the current reconstruction.
+  NextImageRanks next_image_ranks_;
+
   // Frames that have been filtered in current reconstruction.
   std::unordered_set<frame_t> filtered_frames_;
 
@@ -6,6 +6,8 @@
 #include "../geometry/triangulation.h"
 #include "../scene/projection.h"
 #include "../util/misc.h"
+#include "../util/task_scheduler.h"
+#include "../util/threading.h"
 
 #include <array>
 #include <fstream>
@@ -13,21 +15,6 @@
 namespace colmap {
 namespace {
 
-void SortAndAppendNextImages(std::vector<std::pair<image_t, float>> image_ranks,
-                             std::vector<image_t>* sorted_images_ids) {
-  std::sort(image_ranks.begin(),
-            image_ranks.end(),
-            [](const std::pair<image_t, float>& image1,
-               const std::pair<image_t, float>& image2) {
-              return image1.second > image2.second;
-            });
-
-  sorted_images_ids->reserve(sorted_images_ids->size() + image_ranks.size());
-  for (const auto& image : image_ranks) {
-    sorted_images_ids->push_back(image.first);
-  }
-}
-
 float RankNextImageMaxVisiblePointsNum(
     const image_t image_id, const class ObservationManager& obs_manager) {
   return static_cast<float>(obs_manager.NumVisiblePoints3D(image_id));
@@ -235,31 +222,67 @@ bool IncrementalMapperImpl::FindInitialImagePair(
         num_registrations);
   }
 
-  // Try to find good initial pair.
-  for (size_t i1 = 0; i1 < image_ids1.size(); ++i1) {
-    image_id1 = image_ids1[i1];
-
-    const std::vector<image_t> image_ids2 =
-        IncrementalMapperImpl::FindSecondInitialImage(
-            options,
-            image_id1,
-            *database_cache.CorrespondenceGraph(),
-            reconstruction,
-            num_registrations);
-
-    for (size_t i2 = 0; i2 < image_ids2.size(); ++i2) {
-      image_id2 = image_ids2[i2];
-
-      const image_pair_t pair_id =
-          Database::ImagePairToPairId(image_id1, image_id2);
-
-      // Try every pair only once.
-      if (!init_image_pairs.emplace(pair_id).second) {
-        continue;
+  // Try to find good initial pair. The candidate pairs are evaluated in
+  // parallel batches in the order in which they would be tried one after the
+  // other, and the first suitable pair in this order is selected, such that
+  // the result does not depend on the number of threads.
+  const size_t batch_size =
+      static_cast<size_t>(GetEffectiveNumThreads(options.num_threads));
+  for (size_t i1_begin = 0; i1_begin < image_ids1.size();
+       i1_begin += batch_size) {
+    const size_t i1_end = std::min(i1_begin + batch_size, image_ids1.size());
+
+    std::vector<std::vector<image_t>> image_ids2(i1_end - i1_begin);
+    ParallelFor(i1_begin, i1_end, [&](const int64_t i1) {
+      image_ids2[i1 - i1_begin] = IncrementalMapperImpl::FindSecondInitialImage(
+          options,
+          image_ids1[i1],
+          *database_cache.CorrespondenceGraph(),
+          reconstruction,
+          num_registrations);
+    });
+
+    // Try every pair only once.
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    for (size_t i1 = i1_begin; i1 < i1_end; ++i1) {
+      for (const image_t candidate_image_id2 : image_ids2[i1 - i1_begin]) {
+        if (init_image_pairs
+                .emplace(Database::ImagePairToPairId(image_ids1[i1],
+                                                     candidate_image_id2))
+                .second) {
+          image_pairs.emplace_back(image_ids1[i1], candidate_image_id2);
+        }
       }
+    }
 
-      if (IncrementalMapperImpl::EstimateInitialTwoViewGeometry(
-              options, database_cache, image_id1, image_id2, cam2_from_cam1)) {
+    for (size_t pair_begin = 0; pair_begin < image_pairs.size();
+         pair_begin += batch_size) {
+      const size_t pair_end =
+          std::min(pair_begin + batch_size, image_pairs.size());
+      std::vector<Rigid3d> cams2_from_cams1(pair_end - pair_begin);
+      std::vector<char> success(pair_end - pair_begin, false);
+      ParallelFor(pair_begin, pair_end, [&](const int64_t pair_idx) {
+        success[pair_idx - pair_begin] =
+            IncrementalMapperImpl::EstimateInitialTwoViewGeometry(
+                options,
+                database_cache,
+                image_pairs[pair_idx].first,
+                image_pairs[pair_idx].second,
+                cams2_from_cams1[pair_idx - pair_begin]);
+      });
+
+      for (size_t pair_idx = pair_begin; pair_idx < pair_end; ++pair_idx) {
+        if (!success[pair_idx - pair_begin]) {
+          continue;
+        }
+        // The pairs after the selected one have not been tried yet.
+        for (size_t i = pair_idx + 1; i < image_pairs.size(); ++i) {
+          init_image_pairs.erase(Database::ImagePairToPairId(
+              image_pairs[i].first, image_pairs[i].second));
+        }
+        image_id1 = image_pairs[pair_idx].first;
+        image_id2 = image_pairs[pair_idx].second;
+        cam2_from_cam1 = cams2_from_cams1[pair_idx - pair_begin];
         return true;
       }
     }
@@ -274,9 +297,10 @@ bool IncrementalMapperImpl::FindInitialImagePair(
 
 std::vector<image_t> IncrementalMapperImpl::FindNextImages(
     const IncrementalMapper::Options& options,
-    const ObservationManager& obs_manager,
+    ObservationManager& obs_manager,
     const std::unordered_set<image_t>& filtered_images,
-    std::unordered_map<image_t, size_t>& num_reg_trials) {
+    std::unordered_map<image_t, size_t>& num_reg_trials,
+    IncrementalMapper::NextImageRanks& next_image_ranks) {
   THROW_CHECK(options.Check());
   const Reconstruction& reconstruction = obs_manager.Reconstruction();
 
@@ -296,13 +320,35 @@ std::vector<image_t> IncrementalMapperImpl::FindNextImages(
       break;
   }
 
-  std::vector<std::pair<image_t, float>> image_ranks;
-  std::vector<std::pair<image_t, float>> other_image_ranks;
+  // Only re-rank the images whose visible points changed since the last call,
+  // unless the ranking criteria changed.
+  std::vector<image_t> changed_image_ids =
+      obs_manager.PopImagesWithChangedVisibility();
+  if (next_image_ranks.image_selection_method !=
+          options.image_selection_method ||
+      next_image_ranks.min_num_visible_points !=
+          options.abs_pose_min_num_inliers) {
+    next_image_ranks.Clear();
+    next_image_ranks.image_selection_method = options.image_selection_method;
+    next_image_ranks.min_num_visible_points = options.abs_pose_min_num_inliers;
+    changed_image_ids.clear();
+    changed_image_ids.reserve(reconstruction.NumImages());
+    for (const auto& image : reconstruction.Images()) {
+      changed_image_ids.push_back(image.first);
+    }
+  }
+
+  auto& ranked_image_ids = next_image_ranks.ranked_image_ids;
+  auto& image_ranks = next_image_ranks.image_ranks;
+
+  for (const image_t image_id : changed_image_ids) {
+    if (const auto it = image_ranks.find(image_id); it != image_ranks.end()) {
+      ranked_image_ids.erase({it->second, image_id});
+      image_ranks.erase(it);
+    }
 
-  // Append images that have not failed to register before.
-  for (const auto& [image_id, image] : reconstruction.Images()) {
     // Skip images that are already registered.
-    if (image.HasPose()) {
+    if (reconstruction.Image(image_id).HasPose()) {
       continue;
     }
 
@@ -312,6 +358,26 @@ std::vector<image_t> IncrementalMapperImpl::FindNextImages(
       continue;
     }
 
+    const float rank = rank_image_func(image_id, obs_manager);
+    ranked_image_ids.emplace(rank, image_id);
+    image_ranks.emplace(image_id, rank);
+  }
+
+  std::vector<image_t> next_image_ids;
+  std::vector<image_t> other_next_image_ids;
+
+  for (auto it = ranked_image_ids.begin(); it != ranked_image_ids.end();) {
+    const image_t image_id = it->second;
+
+    // Drop images that were registered since they were ranked. They are
+    // ranked again when they are de-registered.
+    if (reconstruction.Image(image_id).HasPose()) {
+      image_ranks.erase(image_id);
+      it = ranked_image_ids.erase(it);
+      continue;
+    }
+    ++it;
+
     // Only try registration for a certain maximum number of times.
     const size_t image_num_reg_trials = num_reg_trials[image_id];
     if (image_num_reg_trials >= static_cast<size_t>(options.max_reg_trials)) {
@@ -320,49 +386,36 @@ std::vector<image_t> IncrementalMapperImpl::FindNextImages(
 
     // If image has been filtered or failed to register, place it in the
     // second bucket and prefer images that have not been tried before.
-    const float rank = rank_image_func(image_id, obs_manager);
     if (filtered_images.count(image_id) == 0 && image_num_reg_trials == 0) {
-      image_ranks.emplace_back(image_id, rank);
+      next_image_ids.push_back(image_id);
     } else {
-      other_image_ranks.emplace_back(image_id, rank);
+      other_next_image_ids.push_back(image_id);
     }
   }
 
-  std::vector<image_t> ranked_images_ids;
-  SortAndAppendNextImages(std::move(image_ranks), &ranked_images_ids);
-  SortAndAppendNextImages(std::move(other_image_ranks), &ranked_images_ids);
+  next_image_ids.insert(next_image_ids.end(),
+                        other_next_image_ids.begin(),
+                        other_next_image_ids.end());
 
-  return ranked_images_ids;
+  return next_image_ids;
 }
 
 std::vector<image_t> IncrementalMapperImpl::FindLocalBundle(
     const IncrementalMapper::Options& options,
     image_t image_id,
-    const Reconstruction& reconstruction) {
+    const ObservationManager& obs_manager) {
   THROW_CHECK(options.Check());
 
+  const Reconstruction& reconstruction = obs_manager.Reconstruction();
   const Image& image = reconstruction.Image(image_id);
   THROW_CHECK(image.HasPose());
 
-  // Extract all images that have at least one 3D point with the query image
-  // in common, and simultaneously count the number of common 3D points.
-
-  std::unordered_map<image_t, size_t> shared_observations;
+  // All images that have at least one 3D point with the query image in
+  // common and the number of common observations are maintained by the
+  // covisibility graph of the observation manager.
 
-  std::unordered_set<point3D_t> point3D_ids;
-  point3D_ids.reserve(image.NumPoints3D());
-
-  for (const Point2D& point2D : image.Points2D()) {
-    if (point2D.HasPoint3D()) {
-      point3D_ids.insert(point2D.point3D_id);
-      const Point3D& point3D = reconstruction.Point3D(point2D.point3D_id);
-      for (const TrackElement& track_el : point3D.track.Elements()) {
-        if (track_el.image_id != image_id) {
-          shared_observations[track_el.image_id] += 1;
-        }
-      }
-    }
-  }
+  const std::unordered_map<image_t, size_t>& shared_observations =
+      obs_manager.CovisibleImages(image_id);
 
   // Sort overlapping images according to number of shared observations.
 
@@ -418,6 +471,14 @@ std::vector<image_t> IncrementalMapperImpl::FindLocalBundle(
       std::make_pair(min_tri_angle_rad / 6.0, 0.1 * image.NumPoints3D()),
   }};
 
+  std::unordered_set<point3D_t> point3D_ids;
+  point3D_ids.reserve(image.NumPoints3D());
+  for (const Point2D& point2D : image.Points2D()) {
+    if (point2D.HasPoint3D()) {
+      point3D_ids.insert(point2D.point3D_id);
+    }
+  }
+
   const Eigen::Vector3d proj_center = image.ProjectionCenter();
   std::vector<Eigen::Vector3d> shared_points3D;
   shared_points3D.reserve(image.NumPoints3D());
@@ -652,11 +713,29 @@ bool IncrementalMapperImpl::EstimateInitialTwoViewGeometry(
   TwoViewGeometryOptions two_view_geometry_options;
   two_view_geometry_options.ransac_options.min_num_trials = 30;
   two_view_geometry_options.ransac_options.max_error = options.init_max_error;
-  TwoViewGeometry two_view_geometry = EstimateCalibratedTwoViewGeometry(
-      camera1, points1, camera2, points2, matches, two_view_geometry_options);
-
-  if (!EstimateTwoViewGeometryPose(
-          camera1, points1, camera2, points2, &two_view_geometry)) {
+  // The camera rays were computed with the same cameras of the cache.
+  const std::vector<Eigen::Vector3d>& cam_rays1 =
+      database_cache.CamRays(image_id1);
+  const std::vector<Eigen::Vector3d>& cam_rays2 =
+      database_cache.CamRays(image_id2);
+
+  TwoViewGeometry two_view_geometry =
+      EstimateCalibratedTwoViewGeometry(camera1,
+                                        points1,
+                                        cam_rays1,
+                                        camera2,
+                                        points2,
+                                        cam_rays2,
+                                        matches,
+                                        two_view_geometry_options);
+
+  if (!EstimateTwoViewGeometryPose(camera1,
+                                   points1,
+                                   cam_rays1,
+                                   camera2,
+                                   points2,
+                                   cam_rays2,
+                                   &two_view_geometry)) {
     return false;
   }
 
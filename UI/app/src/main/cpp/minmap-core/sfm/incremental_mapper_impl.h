@@ -48,15 +48,16 @@ class IncrementalMapperImpl {
   // Implement IncrementalMapper::FindNextImages
   static std::vector<image_t> FindNextImages(
       const IncrementalMapper::Options& options,
-      const ObservationManager& obs_manager,
+      ObservationManager& obs_manager,
       const std::unordered_set<image_t>& filtered_images,
-      std::unordered_map<image_t, size_t>& num_reg_trials);
+      std::unordered_map<image_t, size_t>& num_reg_trials,
+      IncrementalMapper::NextImageRanks& next_image_ranks);
 
   // Implement IncrementalMapper::FindLocalBundle
   static std::vector<image_t> FindLocalBundle(
       const IncrementalMapper::Options& options,
       image_t image_id,
-      const Reconstruction& reconstruction);
+      const ObservationManager& obs_manager);
 
   // Implement IncrementalMapper::EstimateInitialTwoViewGeometry
   static bool EstimateInitialTwoViewGeometry(
@@ -3,6 +3,10 @@
 #include "../estimators/triangulation.h"
 #include "../scene/projection.h"
 #include "../util/misc.h"
+#include "../util/task_scheduler.h"
+#include "../util/threading.h"
+
+#include <set>
 
 namespace colmap {
 namespace {
@@ -36,6 +40,15 @@ bool TriangulateTrack(
       options_, points, cams_from_world, cameras, &inlier_mask, &xyz);
 }
 
+// Number of consecutive observations or correspondences that are estimated
+// by one task of the parallel triangulation.
+constexpr int64_t kParallelGrainSize = 16;
+
+bool UseParallelTriangulation(
+    const IncrementalTriangulator::Options& options) {
+  return GetEffectiveNumThreads(options.num_threads) > 1;
+}
+
 }  // namespace
 
 bool IncrementalTriangulator::Options::Check() const {
@@ -72,7 +85,7 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
 
   size_t num_tris = 0;
 
-  ClearCaches();
+  ClearCaches(options);
 
   const Image& image = reconstruction_.Image(image_id);
   if (!image.HasPose()) {
@@ -91,35 +104,50 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
   ref_corr_data.image = &image;
   ref_corr_data.camera = image.CameraPtr();
 
+  if (UseParallelTriangulation(options)) {
+    // Estimate the triangulations of all observations against the unchanged
+    // reconstruction and add them in the order of the observations.
+    std::vector<std::vector<PendingTriangulation>> point2D_tris(
+        image.NumPoints2D());
+    ParallelFor(
+        0,
+        image.NumPoints2D(),
+        [&](const int64_t point2D_idx) {
+          CorrData point2D_ref_corr_data = ref_corr_data;
+          point2D_ref_corr_data.point2D_idx = point2D_idx;
+          point2D_ref_corr_data.point2D = &image.Point2D(point2D_idx);
+          std::vector<CorrespondenceGraph::Correspondence> found_corrs;
+          std::vector<CorrData> corrs_data;
+          EstimateObservation(options,
+                              point2D_ref_corr_data,
+                              &found_corrs,
+                              &corrs_data,
+                              &point2D_tris[point2D_idx]);
+        },
+        kParallelGrainSize);
+    for (const auto& tris : point2D_tris) {
+      for (const PendingTriangulation& tri : tris) {
+        num_tris += AddTriangulation(tri);
+      }
+    }
+    return num_tris;
+  }
+
   // Container for correspondences from reference observation to other images.
   std::vector<CorrData> corrs_data;
+  std::vector<PendingTriangulation> tris;
 
   // Try to triangulate all image observations.
   for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
        ++point2D_idx) {
-    const size_t num_triangulated =
-        Find(options,
-             image_id,
-             point2D_idx,
-             static_cast<size_t>(options.max_transitivity),
-             &corrs_data);
-    if (corrs_data.empty()) {
-      continue;
-    }
-
-    const Point2D& point2D = image.Point2D(point2D_idx);
     ref_corr_data.point2D_idx = point2D_idx;
-    ref_corr_data.point2D = &point2D;
+    ref_corr_data.point2D = &image.Point2D(point2D_idx);
 
-    if (num_triangulated == 0) {
-      corrs_data.push_back(ref_corr_data);
-      num_tris += Create(options, corrs_data);
-    } else {
-      // Continue correspondences to existing 3D points.
-      num_tris += Continue(options, ref_corr_data, corrs_data);
-      // Create points from correspondences that are not continued.
-      corrs_data.push_back(ref_corr_data);
-      num_tris += Create(options, corrs_data);
+    tris.clear();
+    EstimateObservation(
+        options, ref_corr_data, &found_corrs_, &corrs_data, &tris);
+    for (const PendingTriangulation& tri : tris) {
+      num_tris += AddTriangulation(tri);
     }
   }
 
@@ -132,7 +160,7 @@ size_t IncrementalTriangulator::CompleteImage(const Options& options,
 
   size_t num_tris = 0;
 
-  ClearCaches();
+  ClearCaches(options);
 
   const Image& image = reconstruction_.Image(image_id);
   if (!image.HasPose()) {
@@ -181,6 +209,7 @@ size_t IncrementalTriangulator::CompleteImage(const Options& options,
              image_id,
              point2D_idx,
              static_cast<size_t>(options.max_transitivity),
+             &found_corrs_,
              &corrs_data);
     if (num_triangulated || corrs_data.empty()) {
       continue;
@@ -221,7 +250,7 @@ size_t IncrementalTriangulator::CompleteTracks(
 
   size_t num_completed = 0;
 
-  ClearCaches();
+  ClearCaches(options);
 
   for (const point3D_t point3D_id : point3D_ids) {
     num_completed += Complete(options, point3D_id);
@@ -235,7 +264,26 @@ size_t IncrementalTriangulator::CompleteAllTracks(const Options& options) {
 
   size_t num_completed = 0;
 
-  ClearCaches();
+  ClearCaches(options);
+
+  if (UseParallelTriangulation(options)) {
+    const std::unordered_set<point3D_t> point3D_id_set =
+        reconstruction_.Point3DIds();
+    const std::vector<point3D_t> point3D_ids(point3D_id_set.begin(),
+                                             point3D_id_set.end());
+    std::vector<PendingTriangulation> tris(point3D_ids.size());
+    ParallelFor(
+        0,
+        point3D_ids.size(),
+        [&](const int64_t i) {
+          EstimateComplete(options, point3D_ids[i], &tris[i]);
+        },
+        kParallelGrainSize);
+    for (const PendingTriangulation& tri : tris) {
+      num_completed += AddTriangulation(tri);
+    }
+    return num_completed;
+  }
 
   for (const point3D_t point3D_id : reconstruction_.Point3DIds()) {
     num_completed += Complete(options, point3D_id);
@@ -250,7 +298,7 @@ size_t IncrementalTriangulator::MergeTracks(
 
   size_t num_merged = 0;
 
-  ClearCaches();
+  ClearCaches(options);
 
   for (const point3D_t point3D_id : point3D_ids) {
     num_merged += Merge(options, point3D_id);
@@ -264,7 +312,7 @@ size_t IncrementalTriangulator::MergeAllTracks(const Options& options) {
 
   size_t num_merged = 0;
 
-  ClearCaches();
+  ClearCaches(options);
 
   for (const point3D_t point3D_id : reconstruction_.Point3DIds()) {
     num_merged += Merge(options, point3D_id);
@@ -278,11 +326,18 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
 
   size_t num_tris = 0;
 
-  ClearCaches();
+  ClearCaches(options);
 
   Options re_options = options;
   re_options.continue_max_angle_error = options.re_max_angle_error;
 
+  const bool parallel = UseParallelTriangulation(options);
+
+  // Correspondences that are retriangulated in parallel.
+  std::vector<std::pair<CorrData, CorrData>> re_corrs_data;
+
+  std::vector<PendingTriangulation> tris;
+
   for (const auto& image_pair : obs_manager_->ImagePairs()) {
     // Only perform retriangulation for under-reconstructed image pairs.
     const double tri_ratio =
@@ -357,20 +412,40 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
       corr_data2.camera = &camera2;
       corr_data2.point2D = &point2D2;
 
-      if (point2D1.HasPoint3D() && !point2D2.HasPoint3D()) {
-        const std::vector<CorrData> corrs_data1 = {corr_data1};
-        num_tris += Continue(re_options, corr_data2, corrs_data1);
-      } else if (!point2D1.HasPoint3D() && point2D2.HasPoint3D()) {
-        const std::vector<CorrData> corrs_data2 = {corr_data2};
-        num_tris += Continue(re_options, corr_data1, corrs_data2);
-      } else if (!point2D1.HasPoint3D() && !point2D2.HasPoint3D()) {
-        const std::vector<CorrData> corrs_data = {corr_data1, corr_data2};
-        // Do not use larger triangulation threshold as this causes
-        // significant drift when creating points (options vs. re_options).
-        num_tris += Create(options, corrs_data);
+      if (parallel) {
+        re_corrs_data.emplace_back(corr_data1, corr_data2);
+        continue;
+      }
+
+      tris.clear();
+      EstimateRetriangulation(
+          options, re_options, corr_data1, corr_data2, &tris);
+      for (const PendingTriangulation& tri : tris) {
+        num_tris += AddTriangulation(tri);
+      }
+    }
+  }
+
+  if (parallel) {
+    // Estimate the retriangulations of all under-reconstructed image pairs
+    // against the unchanged reconstruction and add them in order.
+    std::vector<std::vector<PendingTriangulation>> corr_tris(
+        re_corrs_data.size());
+    ParallelFor(
+        0,
+        re_corrs_data.size(),
+        [&](const int64_t i) {
+          EstimateRetriangulation(options,
+                                  re_options,
+                                  re_corrs_data[i].first,
+                                  re_corrs_data[i].second,
+                                  &corr_tris[i]);
+        },
+        kParallelGrainSize);
+    for (const auto& tris : corr_tris) {
+      for (const PendingTriangulation& tri : tris) {
+        num_tris += AddTriangulation(tri);
       }
-      // Else both points have a 3D point, but we do not want to
-      // merge points in retriangulation.
     }
   }
 
@@ -399,26 +474,37 @@ void IncrementalTriangulator::ClearModifiedPoints3D() {
   modified_point3D_ids_.clear();
 }
 
-void IncrementalTriangulator::ClearCaches() {
+void IncrementalTriangulator::ClearCaches(const Options& options) {
+  // Cache the bogus camera parameters up front, such that the cache is only
+  // read during the (parallel) triangulation.
   camera_has_bogus_params_.clear();
+  for (const auto& [camera_id, camera] : reconstruction_.Cameras()) {
+    camera_has_bogus_params_.emplace(
+        camera_id,
+        camera.HasBogusParams(options.min_focal_length_ratio,
+                              options.max_focal_length_ratio,
+                              options.max_extra_param));
+  }
   merge_trials_.clear();
   found_corrs_.clear();
 }
 
-size_t IncrementalTriangulator::Find(const Options& options,
-                                     const image_t image_id,
-                                     const point2D_t point2D_idx,
-                                     const size_t transitivity,
-                                     std::vector<CorrData>* corrs_data) {
+size_t IncrementalTriangulator::Find(
+    const Options& options,
+    const image_t image_id,
+    const point2D_t point2D_idx,
+    const size_t transitivity,
+    std::vector<CorrespondenceGraph::Correspondence>* found_corrs,
+    std::vector<CorrData>* corrs_data) const {
   correspondence_graph_->ExtractTransitiveCorrespondences(
-      image_id, point2D_idx, transitivity, &found_corrs_);
+      image_id, point2D_idx, transitivity, found_corrs);
 
   corrs_data->clear();
-  corrs_data->reserve(found_corrs_.size());
+  corrs_data->reserve(found_corrs->size());
 
   size_t num_triangulated = 0;
 
-  for (const auto& corr : found_corrs_) {
+  for (const auto& corr : *found_corrs) {
     const Image& corr_image = reconstruction_.Image(corr.image_id);
     if (!corr_image.HasPose()) {
       continue;
@@ -446,8 +532,69 @@ size_t IncrementalTriangulator::Find(const Options& options,
   return num_triangulated;
 }
 
-size_t IncrementalTriangulator::Create(
-    const Options& options, const std::vector<CorrData>& corrs_data) {
+void IncrementalTriangulator::EstimateObservation(
+    const Options& options,
+    const CorrData& ref_corr_data,
+    std::vector<CorrespondenceGraph::Correspondence>* found_corrs,
+    std::vector<CorrData>* corrs_data,
+    std::vector<PendingTriangulation>* tris) const {
+  const size_t num_triangulated =
+      Find(options,
+           ref_corr_data.image_id,
+           ref_corr_data.point2D_idx,
+           static_cast<size_t>(options.max_transitivity),
+           found_corrs,
+           corrs_data);
+  if (corrs_data->empty()) {
+    return;
+  }
+
+  if (num_triangulated > 0) {
+    // Continue correspondences to existing 3D points.
+    PendingTriangulation tri;
+    if (EstimateContinue(options, ref_corr_data, *corrs_data, &tri)) {
+      tris->push_back(std::move(tri));
+      // Create points from correspondences that are not continued.
+      EstimateCreate(options, *corrs_data, tris);
+      return;
+    }
+  }
+
+  corrs_data->push_back(ref_corr_data);
+  EstimateCreate(options, *corrs_data, tris);
+}
+
+void IncrementalTriangulator::EstimateRetriangulation(
+    const Options& options,
+    const Options& re_options,
+    const CorrData& corr_data1,
+    const CorrData& corr_data2,
+    std::vector<PendingTriangulation>* tris) const {
+  const bool has_point3D1 = corr_data1.point2D->HasPoint3D();
+  const bool has_point3D2 = corr_data2.point2D->HasPoint3D();
+  if (has_point3D1 && !has_point3D2) {
+    PendingTriangulation tri;
+    if (EstimateContinue(re_options, corr_data2, {corr_data1}, &tri)) {
+      tris->push_back(std::move(tri));
+    }
+  } else if (!has_point3D1 && has_point3D2) {
+    PendingTriangulation tri;
+    if (EstimateContinue(re_options, corr_data1, {corr_data2}, &tri)) {
+      tris->push_back(std::move(tri));
+    }
+  } else if (!has_point3D1 && !has_point3D2) {
+    // Do not use larger triangulation threshold as this causes
+    // significant drift when creating points (options vs. re_options).
+    EstimateCreate(options, {corr_data1, corr_data2}, tris);
+  }
+  // Else both points have a 3D point, but we do not want to
+  // merge points in retriangulation.
+}
+
+void IncrementalTriangulator::EstimateCreate(
+    const Options& options,
+    const std::vector<CorrData>& corrs_data,
+    std::vector<PendingTriangulation>* tris) const {
   // Extract correspondences without an existing triangulated observation.
   std::vector<CorrData> create_corrs_data;
   create_corrs_data.reserve(corrs_data.size());
@@ -457,17 +604,6 @@ size_t IncrementalTriangulator::Create(
     }
   }
 
-  if (create_corrs_data.size() < 2) {
-    // Need at least two observations for triangulation.
-    return 0;
-  } else if (options.ignore_two_view_tracks && create_corrs_data.size() == 2) {
-    const CorrData& corr_data1 = create_corrs_data[0];
-    if (correspondence_graph_->IsTwoViewObservation(corr_data1.image_id,
-                                                    corr_data1.point2D_idx)) {
-      return 0;
-    }
-  }
-
   // Setup estimation options.
   EstimateTriangulationOptions tri_options;
   tri_options.min_tri_angle = DegToRad(options.min_angle);
@@ -476,43 +612,60 @@ size_t IncrementalTriangulator::Create(
   tri_options.ransac_options.max_error =
       DegToRad(options.create_max_angle_error);
 
-  // Estimate triangulation.
-  Eigen::Vector3d xyz;
-  std::vector<char> inlier_mask;
-  if (!TriangulateTrack(tri_options, create_corrs_data, inlier_mask, xyz)) {
-    return 0;
-  }
+  // Create points from the outliers of the previous point, as long as there
+  // are enough of them.
+  const size_t kMinRecursiveTrackLength = 3;
+  std::vector<CorrData> outlier_corrs_data;
+  while (true) {
+    if (create_corrs_data.size() < 2) {
+      // Need at least two observations for triangulation.
+      return;
+    } else if (options.ignore_two_view_tracks &&
+               create_corrs_data.size() == 2) {
+      const CorrData& corr_data1 = create_corrs_data[0];
+      if (correspondence_graph_->IsTwoViewObservation(
+              corr_data1.image_id, corr_data1.point2D_idx)) {
+        return;
+      }
+    }
 
-  // Add inliers to estimated track.
-  Track track;
-  track.Reserve(create_corrs_data.size());
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
+    // Estimate triangulation.
+    Eigen::Vector3d xyz;
+    std::vector<char> inlier_mask;
+    if (!TriangulateTrack(tri_options, create_corrs_data, inlier_mask, xyz)) {
+      return;
+    }
+
+    // Add inliers to estimated track.
+    PendingTriangulation& tri = tris->emplace_back();
+    tri.xyz = xyz;
+    tri.track_els.reserve(create_corrs_data.size());
+    outlier_corrs_data.clear();
+    for (size_t i = 0; i < inlier_mask.size(); ++i) {
       const CorrData& corr_data = create_corrs_data[i];
-      track.AddElement(corr_data.image_id, corr_data.point2D_idx);
+      if (inlier_mask[i]) {
+        tri.track_els.emplace_back(corr_data.image_id, corr_data.point2D_idx);
+      } else {
+        outlier_corrs_data.push_back(corr_data);
+      }
     }
-  }
 
-  // Add estimated point to reconstruction.
-  const size_t track_length = track.Length();
-  const point3D_t point3D_id = obs_manager_->AddPoint3D(xyz, track);
-  modified_point3D_ids_.insert(point3D_id);
+    if (outlier_corrs_data.size() < kMinRecursiveTrackLength) {
+      return;
+    }
 
-  const size_t kMinRecursiveTrackLength = 3;
-  if (create_corrs_data.size() - track_length >= kMinRecursiveTrackLength) {
-    return track_length + Create(options, create_corrs_data);
+    std::swap(create_corrs_data, outlier_corrs_data);
   }
-
-  return track_length;
 }
 
-size_t IncrementalTriangulator::Continue(
+bool IncrementalTriangulator::EstimateContinue(
     const Options& options,
     const CorrData& ref_corr_data,
-    const std::vector<CorrData>& corrs_data) {
+    const std::vector<CorrData>& corrs_data,
+    PendingTriangulation* tri) const {
   // No need to continue, if the reference observation is triangulated.
   if (ref_corr_data.point2D->HasPoint3D()) {
-    return 0;
+    return false;
   }
 
   double best_angle_error = std::numeric_limits<double>::max();
@@ -541,15 +694,53 @@ size_t IncrementalTriangulator::Continue(
   const double max_angle_error = DegToRad(options.continue_max_angle_error);
   if (best_angle_error <= max_angle_error &&
       best_idx != std::numeric_limits<size_t>::max()) {
-    const CorrData& corr_data = corrs_data[best_idx];
-    const TrackElement track_el(ref_corr_data.image_id,
-                                ref_corr_data.point2D_idx);
-    obs_manager_->AddObservation(corr_data.point2D->point3D_id, track_el);
-    modified_point3D_ids_.insert(corr_data.point2D->point3D_id);
-    return 1;
+    tri->point3D_id = corrs_data[best_idx].point2D->point3D_id;
+    tri->track_els.assign(
+        1, TrackElement(ref_corr_data.image_id, ref_corr_data.point2D_idx));
+    return true;
   }
 
-  return 0;
+  return false;
+}
+
+size_t IncrementalTriangulator::AddTriangulation(
+    const PendingTriangulation& tri) {
+  // Observations may have been triangulated since the triangulation was
+  // estimated, e.g., by a preceding triangulation of the parallel phase.
+  const auto is_triangulated = [this](const TrackElement& track_el) {
+    return reconstruction_.Image(track_el.image_id)
+        .Point2D(track_el.point2D_idx)
+        .HasPoint3D();
+  };
+
+  if (tri.point3D_id == kInvalidPoint3DId) {
+    Track track;
+    track.Reserve(tri.track_els.size());
+    for (const TrackElement& track_el : tri.track_els) {
+      if (!is_triangulated(track_el)) {
+        track.AddElement(track_el);
+      }
+    }
+    if (track.Length() < 2) {
+      return 0;
+    }
+    const size_t track_length = track.Length();
+    const point3D_t point3D_id = obs_manager_->AddPoint3D(tri.xyz, track);
+    modified_point3D_ids_.insert(point3D_id);
+    return track_length;
+  }
+
+  size_t num_added = 0;
+  for (const TrackElement& track_el : tri.track_els) {
+    if (!is_triangulated(track_el)) {
+      obs_manager_->AddObservation(tri.point3D_id, track_el);
+      num_added += 1;
+    }
+  }
+  if (num_added > 0) {
+    modified_point3D_ids_.insert(tri.point3D_id);
+  }
+  return num_added;
 }
 
 size_t IncrementalTriangulator::Merge(const Options& options,
@@ -644,10 +835,19 @@ size_t IncrementalTriangulator::Merge(const Options& options,
 
 size_t IncrementalTriangulator::Complete(const Options& options,
                                          const point3D_t point3D_id) {
-  size_t num_completed = 0;
+  PendingTriangulation tri;
+  EstimateComplete(options, point3D_id, &tri);
+  return AddTriangulation(tri);
+}
+
+void IncrementalTriangulator::EstimateComplete(
+    const Options& options,
+    const point3D_t point3D_id,
+    PendingTriangulation* tri) const {
+  tri->point3D_id = point3D_id;
 
   if (!reconstruction_.ExistsPoint3D(point3D_id)) {
-    return num_completed;
+    return;
   }
 
   const double max_squared_reproj_error =
@@ -655,7 +855,11 @@ size_t IncrementalTriangulator::Complete(const Options& options,
 
   const Point3D& point3D = reconstruction_.Point3D(point3D_id);
 
-  std::vector<TrackElement> curr_queue = point3D.track.Elements();
+  // Observations that are already added to the completed track.
+  std::set<std::pair<image_t, point2D_t>> completed_point2Ds;
+
+  std::vector<TrackElement> curr_queue(point3D.track.Elements().begin(),
+                                       point3D.track.Elements().end());
   std::vector<TrackElement> next_queue;
 
   const int max_transitivity = options.complete_max_transitivity;
@@ -673,7 +877,9 @@ size_t IncrementalTriangulator::Complete(const Options& options,
         }
 
         const Point2D& point2D = image.Point2D(corr->point2D_idx);
-        if (point2D.HasPoint3D()) {
+        if (point2D.HasPoint3D() ||
+            completed_point2Ds.count({corr->image_id, corr->point2D_idx}) >
+                0) {
           continue;
         }
 
@@ -689,16 +895,13 @@ size_t IncrementalTriangulator::Complete(const Options& options,
         }
 
         // Success, add observation to point track.
-        obs_manager_->AddObservation(
-            point3D_id, TrackElement(corr->image_id, corr->point2D_idx));
-        modified_point3D_ids_.insert(point3D_id);
+        tri->track_els.emplace_back(corr->image_id, corr->point2D_idx);
+        completed_point2Ds.emplace(corr->image_id, corr->point2D_idx);
 
         // Recursively complete track for this new correspondence.
         if (transitivity < max_transitivity) {
           next_queue.emplace_back(corr->image_id, corr->point2D_idx);
         }
-
-        num_completed += 1;
       }
     }
 
@@ -708,20 +911,15 @@ size_t IncrementalTriangulator::Complete(const Options& options,
 
     std::swap(curr_queue, next_queue);
   }
-
-  return num_completed;
 }
 
 bool IncrementalTriangulator::HasCameraBogusParams(const Options& options,
-                                                   const Camera& camera) {
+                                                   const Camera& camera) const {
   const auto it = camera_has_bogus_params_.find(camera.camera_id);
   if (it == camera_has_bogus_params_.end()) {
-    const bool has_bogus_params =
-        camera.HasBogusParams(options.min_focal_length_ratio,
-                              options.max_focal_length_ratio,
-                              options.max_extra_param);
-    camera_has_bogus_params_.emplace(camera.camera_id, has_bogus_params);
-    return has_bogus_params;
+    return camera.HasBogusParams(options.min_focal_length_ratio,
+                                 options.max_focal_length_ratio,
+                                 options.max_extra_param);
   } else {
     return it->second;
   }
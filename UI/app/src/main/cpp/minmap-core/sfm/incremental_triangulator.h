@@ -54,6 +54,15 @@ class IncrementalTriangulator {
     double max_focal_length_ratio = 10.0;
     double max_extra_param = 1.0;
 
+    // Number of threads to triangulate the observations of an image,
+    // retriangulate image pairs, and complete all tracks. With more than one
+    // thread, the triangulations are first estimated in parallel against the
+    // unchanged reconstruction and then added one after the other, skipping
+    // observations that were triangulated in the meantime. Unlike in the
+    // serial triangulation, a triangulation therefore does not see the new
+    // points of the preceding observations.
+    int num_threads = 1;
+
     bool Check() const;
   };
 
@@ -131,24 +140,64 @@ class IncrementalTriangulator {
   friend std::ostream& operator<<(std::ostream& stream,
                                   const IncrementalTriangulator& triangulator);
 
-  // Clear cache of bogus camera parameters and merge trials.
-  void ClearCaches();
+  // Triangulation that is estimated against the current reconstruction and
+  // added to it later. Continues the given 3D point or, if the 3D point is
+  // invalid, creates a new 3D point at xyz.
+  struct PendingTriangulation {
+    point3D_t point3D_id = kInvalidPoint3DId;
+    Eigen::Vector3d xyz = Eigen::Vector3d::Zero();
+    std::vector<TrackElement> track_els;
+  };
+
+  // Clear cache of merge trials and cache bogus camera parameters of all
+  // cameras in the reconstruction.
+  void ClearCaches(const Options& options);
 
   // Find (transitive) correspondences to other images.
   size_t Find(const Options& options,
               image_t image_id,
               point2D_t point2D_idx,
               size_t transitivity,
-              std::vector<CorrData>* corrs_data);
-
-  // Try to create a new 3D point from the given correspondences.
-  size_t Create(const Options& options,
-                const std::vector<CorrData>& corrs_data);
+              std::vector<CorrespondenceGraph::Correspondence>* found_corrs,
+              std::vector<CorrData>* corrs_data) const;
+
+  // Estimate the triangulations of an observation of an image, i.e., the
+  // continuation of a corresponding 3D point and new 3D points from the
+  // correspondences that are not yet triangulated.
+  void EstimateObservation(
+      const Options& options,
+      const CorrData& ref_corr_data,
+      std::vector<CorrespondenceGraph::Correspondence>* found_corrs,
+      std::vector<CorrData>* corrs_data,
+      std::vector<PendingTriangulation>* tris) const;
+
+  // Estimate the retriangulation of a correspondence between two images.
+  void EstimateRetriangulation(const Options& options,
+                               const Options& re_options,
+                               const CorrData& corr_data1,
+                               const CorrData& corr_data2,
+                               std::vector<PendingTriangulation>* tris) const;
+
+  // Try to create new 3D points from the given correspondences.
+  void EstimateCreate(const Options& options,
+                      const std::vector<CorrData>& corrs_data,
+                      std::vector<PendingTriangulation>* tris) const;
 
   // Try to continue the 3D point with the given correspondences.
-  size_t Continue(const Options& options,
-                  const CorrData& ref_corr_data,
-                  const std::vector<CorrData>& corrs_data);
+  bool EstimateContinue(const Options& options,
+                        const CorrData& ref_corr_data,
+                        const std::vector<CorrData>& corrs_data,
+                        PendingTriangulation* tri) const;
+
+  // Try to transitively complete the track of a 3D point.
+  void EstimateComplete(const Options& options,
+                        point3D_t point3D_id,
+                        PendingTriangulation* tri) const;
+
+  // Add the observations of the triangulation that are not yet triangulated.
+  // New 3D points are only added with at least two observations. Returns the
+  // number of added observations.
+  size_t AddTriangulation(const PendingTriangulation& tri);
 
   // Try to merge 3D point with any of its corresponding 3D points.
   size_t Merge(const Options& options, point3D_t point3D_id);
@@ -156,8 +205,8 @@ class IncrementalTriangulator {
   // Try to transitively complete the track of a 3D point.
   size_t Complete(const Options& options, point3D_t point3D_id);
 
-  // Check if camera has bogus parameters and cache the result.
-  bool HasCameraBogusParams(const Options& options, const Camera& camera);
+  // Check if camera has bogus parameters using the cached result.
+  bool HasCameraBogusParams(const Options& options, const Camera& camera) const;
 
   // Database cache for the reconstruction. Used to retrieve correspondence
   // information for triangulation.
@@ -70,6 +70,10 @@ ObservationManager::ObservationManager(
       }
     }
   }
+
+  for (const auto& point3D : reconstruction_.Points3D()) {
+    UpdateCovisibility(point3D.second.track, 1);
+  }
 }
 
 void ObservationManager::IncrementCorrespondenceHasPoint3D(
@@ -84,6 +88,7 @@ void ObservationManager::IncrementCorrespondenceHasPoint3D(
   }
 
   stats.point3D_visibility_pyramid.SetPoint(point2D.xy(0), point2D.xy(1));
+  SetImageVisibilityChanged(image_id, stats);
 
   assert(stats.num_visible_points3D <= stats.num_observations);
 }
@@ -100,10 +105,70 @@ void ObservationManager::DecrementCorrespondenceHasPoint3D(
   }
 
   stats.point3D_visibility_pyramid.ResetPoint(point2D.xy(0), point2D.xy(1));
+  SetImageVisibilityChanged(image_id, stats);
 
   assert(stats.num_visible_points3D <= stats.num_observations);
 }
 
+std::vector<image_t> ObservationManager::PopImagesWithChangedVisibility() {
+  for (const image_t image_id : changed_visibility_image_ids_) {
+    image_stats_.at(image_id).has_changed_visibility = false;
+  }
+  std::vector<image_t> image_ids;
+  image_ids.swap(changed_visibility_image_ids_);
+  return image_ids;
+}
+
+void ObservationManager::SetImageVisibilityChanged(const image_t image_id,
+                                                   ImageStat& stats) {
+  if (!stats.has_changed_visibility) {
+    stats.has_changed_visibility = true;
+    changed_visibility_image_ids_.push_back(image_id);
+  }
+}
+
+void ObservationManager::UpdateCovisibility(const image_t image_id1,
+                                            const image_t image_id2,
+                                            const int delta) {
+  for (const auto& [image_id, covisible_image_id] :
+       {std::make_pair(image_id1, image_id2),
+        std::make_pair(image_id2, image_id1)}) {
+    auto& covisible_images = image_stats_.at(image_id).covisible_images;
+    auto it = covisible_images.emplace(covisible_image_id, 0).first;
+    if (delta < 0) {
+      THROW_CHECK_GE(it->second, static_cast<size_t>(-delta));
+      it->second -= static_cast<size_t>(-delta);
+    } else {
+      it->second += static_cast<size_t>(delta);
+    }
+    if (it->second == 0) {
+      covisible_images.erase(it);
+    }
+  }
+}
+
+void ObservationManager::UpdateCovisibility(const TrackElement& track_el,
+                                            const Track& track,
+                                            const int delta) {
+  for (const auto& other_track_el : track.Elements()) {
+    if (other_track_el.image_id != track_el.image_id) {
+      UpdateCovisibility(track_el.image_id, other_track_el.image_id, delta);
+    }
+  }
+}
+
+void ObservationManager::UpdateCovisibility(const Track& track,
+                                            const int delta) {
+  const TrackElements& track_els = track.Elements();
+  for (size_t i = 0; i < track_els.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (track_els[i].image_id != track_els[j].image_id) {
+        UpdateCovisibility(track_els[i].image_id, track_els[j].image_id, delta);
+      }
+    }
+  }
+}
+
 void ObservationManager::SetObservationAsTriangulated(
     const image_t image_id,
     const point2D_t point2D_idx,
@@ -172,6 +237,7 @@ point3D_t ObservationManager::AddPoint3D(const Eigen::Vector3d& xyz,
                                          const Track& track,
                                          const Eigen::Vector3ub& color) {
   const point3D_t point3D_id = reconstruction_.AddPoint3D(xyz, track, color);
+  UpdateCovisibility(track, 1);
 
   const bool kIsContinuedPoint3D = false;
   for (const auto& track_el : track.Elements()) {
@@ -184,6 +250,7 @@ point3D_t ObservationManager::AddPoint3D(const Eigen::Vector3d& xyz,
 
 void ObservationManager::AddObservation(const point3D_t point3D_id,
                                         const TrackElement& track_el) {
+  UpdateCovisibility(track_el, reconstruction_.Point3D(point3D_id).track, 1);
   reconstruction_.AddObservation(point3D_id, track_el);
   const bool kIsContinuedPoint3D = true;
   SetObservationAsTriangulated(
@@ -199,6 +266,7 @@ void ObservationManager::DeletePoint3D(const point3D_t point3D_id) {
     ResetTriObservations(
         track_el.image_id, track_el.point2D_idx, kIsDeletedPoint3D);
   }
+  UpdateCovisibility(track, -1);
 
   reconstruction_.DeletePoint3D(point3D_id);
 }
@@ -218,6 +286,7 @@ void ObservationManager::DeleteObservation(const image_t image_id,
 
   const bool kIsDeletedPoint3D = false;
   ResetTriObservations(image_id, point2D_idx, kIsDeletedPoint3D);
+  UpdateCovisibility(TrackElement(image_id, point2D_idx), point3D.track, -1);
   reconstruction_.DeleteObservation(image_id, point2D_idx);
 }
 
@@ -234,6 +303,10 @@ point3D_t ObservationManager::MergePoints3D(const point3D_t point3D_id1,
     ResetTriObservations(
         track_el.image_id, track_el.point2D_idx, kIsDeletedPoint3D);
   }
+  // The merged track only adds the pairs of observations across both tracks.
+  for (const auto& track_el : track1.Elements()) {
+    UpdateCovisibility(track_el, track2, 1);
+  }
 
   point3D_t merged_point3D_id =
       reconstruction_.MergePoints3D(point3D_id1, point3D_id2);
@@ -383,12 +456,19 @@ size_t ObservationManager::FilterPoints3DWithLargeReprojectionError(
   // Number of filtered observations.
   size_t num_filtered_observations = 0;
 
+  // Compute the errors of all observations upfront, such that they can be
+  // projected in batches per camera. Filtering a point only modifies the
+  // point itself and thus does not change the errors of the other points.
+  SquaredReprojectionErrorBatch squared_reproj_error_batch;
+  std::vector<std::pair<point3D_t, size_t>> point3D_error_idxs;
+  point3D_error_idxs.reserve(point3D_ids.size());
+  size_t num_errors = 0;
   for (const auto point3D_id : point3D_ids) {
     if (!reconstruction_.ExistsPoint3D(point3D_id)) {
       continue;
     }
 
-    struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
+    const struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
 
     if (point3D.track.Length() < 2) {
       num_filtered_observations += point3D.track.Length();
@@ -396,18 +476,30 @@ size_t ObservationManager::FilterPoints3DWithLargeReprojectionError(
       continue;
     }
 
+    point3D_error_idxs.emplace_back(point3D_id, num_errors);
+    for (const auto& track_el : point3D.track.Elements()) {
+      const Image& image = reconstruction_.Image(track_el.image_id);
+      const Point2D& point2D = image.Point2D(track_el.point2D_idx);
+      squared_reproj_error_batch.Add(
+          point2D.xy, point3D.xyz, image.CamFromWorld(), *image.CameraPtr());
+    }
+    num_errors += point3D.track.Length();
+  }
+
+  const std::vector<double> squared_reproj_errors =
+      squared_reproj_error_batch.Compute();
+
+  for (const auto& [point3D_id, error_idx] : point3D_error_idxs) {
+    struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
+
     double reproj_error_sum = 0.0;
 
     std::vector<TrackElement> track_els_to_delete;
 
-    for (const auto& track_el : point3D.track.Elements()) {
-      const Image& image = reconstruction_.Image(track_el.image_id);
-      const struct Camera& camera = *image.CameraPtr();
-      const Point2D& point2D = image.Point2D(track_el.point2D_idx);
-      const double squared_reproj_error = CalculateSquaredReprojectionError(
-          point2D.xy, point3D.xyz, image.CamFromWorld(), camera);
+    for (size_t i = 0; i < point3D.track.Length(); ++i) {
+      const double squared_reproj_error = squared_reproj_errors[error_idx + i];
       if (squared_reproj_error > max_squared_reproj_error) {
-        track_els_to_delete.push_back(track_el);
+        track_els_to_delete.push_back(point3D.track.Element(i));
       } else {
         reproj_error_sum += std::sqrt(squared_reproj_error);
       }
@@ -440,6 +532,9 @@ void ObservationManager::DeRegisterFrame(const frame_t frame_id) {
     }
   }
   reconstruction_.DeRegisterFrame(frame_id);
+  for (const data_t& data_id : frame.ImageIds()) {
+    SetImageVisibilityChanged(data_id.id, image_stats_.at(data_id.id));
+  }
 }
 
 std::vector<frame_t> ObservationManager::FilterFrames(
@@ -106,6 +106,13 @@ class ObservationManager {
   // uniform distribution of observations results in more robust registration.
   inline size_t Point3DVisibilityScore(image_t image_id) const;
 
+  // Get the images that share 3D points with the image, i.e. the neighbors of
+  // the image in the covisibility graph. The weight of an edge is the number
+  // of pairs of observations of the shared 3D points in both images. The
+  // graph is updated whenever observations are added, merged, or deleted.
+  inline const std::unordered_map<image_t, size_t>& CovisibleImages(
+      image_t image_id) const;
+
   // The number of levels in the 3D point multi-resolution visibility pyramid.
   static const int kNumPoint3DVisibilityPyramidLevels;
 
@@ -121,6 +128,11 @@ class ObservationManager {
   void DecrementCorrespondenceHasPoint3D(image_t image_id,
                                          point2D_t point2D_idx);
 
+  // Get the images whose visible 3D points changed or that were
+  // de-registered since the last call, i.e. the images whose rank as next
+  // image in incremental reconstruction may have changed.
+  std::vector<image_t> PopImagesWithChangedVisibility();
+
  private:
   friend std::ostream& operator<<(std::ostream& stream,
                                   const ObservationManager& obs_manager);
@@ -132,6 +144,21 @@ class ObservationManager {
                             point2D_t point2D_idx,
                             bool is_deleted_point3D);
 
+  struct ImageStat;
+  void SetImageVisibilityChanged(image_t image_id, ImageStat& stats);
+
+  // Add delta to the weight of the edge between two images in the
+  // covisibility graph.
+  void UpdateCovisibility(image_t image_id1, image_t image_id2, int delta);
+  // Add delta to the covisibility between the images of the observation and
+  // of the other observations in the track.
+  void UpdateCovisibility(const TrackElement& track_el,
+                          const Track& track,
+                          int delta);
+  // Add delta to the covisibility between the images of all pairs of
+  // observations in the track.
+  void UpdateCovisibility(const Track& track, int delta);
+
   struct ImageStat {
     // The number of image points that have at least one correspondence to
     // another image.
@@ -151,12 +178,19 @@ class ObservationManager {
     // Data structure to compute the distribution of triangulated
     // correspondences in the image.
     VisibilityPyramid point3D_visibility_pyramid;
+
+    // Whether the image is in `changed_visibility_image_ids_`.
+    bool has_changed_visibility = false;
+
+    // The edges of the image in the covisibility graph.
+    std::unordered_map<image_t, size_t> covisible_images;
   };
 
   class Reconstruction& reconstruction_;
   const std::shared_ptr<const CorrespondenceGraph> correspondence_graph_;
   std::unordered_map<image_pair_t, ImagePairStat> image_pair_stats_;
   std::unordered_map<image_t, ImageStat> image_stats_;
+  std::vector<image_t> changed_visibility_image_ids_;
 };
 
 std::ostream& operator<<(std::ostream& stream,
@@ -192,4 +226,9 @@ size_t ObservationManager::Point3DVisibilityScore(
   return image_stats_.at(image_id).point3D_visibility_pyramid.Score();
 }
 
+const std::unordered_map<image_t, size_t>& ObservationManager::CovisibleImages(
+    const image_t image_id) const {
+  return image_stats_.at(image_id).covisible_images;
+}
+
 }  // namespace colmap
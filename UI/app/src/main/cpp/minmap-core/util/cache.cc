@@ -0,0 +1,65 @@
+#include "cache.h"
+
+namespace colmap {
+
+CacheMemoryBudget::CacheMemoryBudget(const size_t max_num_bytes)
+    : max_num_bytes_(max_num_bytes) {}
+
+size_t CacheMemoryBudget::NumBytes() const { return num_bytes_.load(); }
+
+size_t CacheMemoryBudget::MaxNumBytes() const { return max_num_bytes_.load(); }
+
+void CacheMemoryBudget::SetMaxNumBytes(const size_t max_num_bytes) {
+  max_num_bytes_.store(max_num_bytes);
+  Shrink();
+}
+
+void CacheMemoryBudget::Shrink() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (num_bytes_.load() > max_num_bytes_.load()) {
+    // Evicting from the largest cache keeps the share of each cache roughly
+    // proportional to the size of its elements.
+    AttachedCache* largest_cache = nullptr;
+    size_t largest_num_bytes = 0;
+    for (AttachedCache& cache : caches_) {
+      const size_t num_bytes = cache.num_bytes_fn();
+      if (num_bytes > largest_num_bytes) {
+        largest_cache = &cache;
+        largest_num_bytes = num_bytes;
+      }
+    }
+    if (largest_cache == nullptr || !largest_cache->pop_fn()) {
+      break;
+    }
+  }
+}
+
+void CacheMemoryBudget::Attach(const void* cache,
+                               NumBytesFn num_bytes_fn,
+                               PopFn pop_fn) {
+  THROW_CHECK_NOTNULL(cache);
+  THROW_CHECK_NOTNULL(num_bytes_fn);
+  THROW_CHECK_NOTNULL(pop_fn);
+  std::lock_guard<std::mutex> lock(mutex_);
+  caches_.push_back({cache, std::move(num_bytes_fn), std::move(pop_fn)});
+}
+
+void CacheMemoryBudget::Detach(const void* cache) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  caches_.erase(std::remove_if(caches_.begin(),
+                               caches_.end(),
+                               [cache](const AttachedCache& attached_cache) {
+                                 return attached_cache.cache == cache;
+                               }),
+                caches_.end());
+}
+
+void CacheMemoryBudget::Charge(const size_t num_bytes) {
+  num_bytes_ += num_bytes;
+}
+
+void CacheMemoryBudget::Release(const size_t num_bytes) {
+  THROW_CHECK_GE(num_bytes_.fetch_sub(num_bytes), num_bytes);
+}
+
+}  // namespace colmap
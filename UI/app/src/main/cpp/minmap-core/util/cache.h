@@ -1,15 +1,20 @@
 #pragma once
 
 #include "logging.h"
+#include "types.h"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <future>
 #include <iostream>
 #include <limits>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace colmap {
 
@@ -102,6 +107,168 @@ class ThreadSafeLRUCache {
   LRUCache<key_t, Entry> cache_;
 };
 
+// Memory budget in bytes that is shared by one or more caches. The attached
+// caches charge the size of their loaded elements to the budget. Whenever the
+// total exceeds the limit, elements are evicted from the cache that currently
+// holds the most bytes until the limit is met again. The limit can be changed
+// at any time, e.g., to release memory when the system runs low on memory.
+class CacheMemoryBudget {
+ public:
+  using NumBytesFn = std::function<size_t()>;
+  using PopFn = std::function<bool()>;
+
+  explicit CacheMemoryBudget(size_t max_num_bytes);
+
+  NON_COPYABLE(CacheMemoryBudget)
+  NON_MOVABLE(CacheMemoryBudget)
+
+  // The size in bytes of the elements in all attached caches.
+  size_t NumBytes() const;
+  size_t MaxNumBytes() const;
+
+  // Change the limit and evict elements until the new limit is met.
+  void SetMaxNumBytes(size_t max_num_bytes);
+
+  // Evict elements until the limit is met.
+  void Shrink();
+
+  // Attach a cache by the function returning its size in bytes and the
+  // function evicting one of its elements, which returns false if the cache
+  // is empty. The functions are only called while the cache is attached.
+  void Attach(const void* cache, NumBytesFn num_bytes_fn, PopFn pop_fn);
+  void Detach(const void* cache);
+
+  // Account for elements loaded into or removed from an attached cache. This
+  // never evicts, so that it can be called while holding the cache's locks.
+  void Charge(size_t num_bytes);
+  void Release(size_t num_bytes);
+
+ private:
+  struct AttachedCache {
+    const void* cache;
+    NumBytesFn num_bytes_fn;
+    PopFn pop_fn;
+  };
+
+  std::atomic<size_t> num_bytes_{0};
+  std::atomic<size_t> max_num_bytes_;
+
+  // Guards the attached caches and serializes eviction.
+  std::mutex mutex_;
+  std::vector<AttachedCache> caches_;
+};
+
+// Thread-safe cache with approximate Least Recently Used eviction, designed
+// for lookups from many threads. Elements are distributed over independent
+// shards by the hash of their key. Each shard evicts with the CLOCK policy, so
+// a hit only sets a reference bit under a shared lock and concurrent hits never
+// serialize. As in `ThreadSafeLRUCache`, concurrent requests for the same
+// missing element wait for a single load. Each shard holds at most
+// ceil(max_num_elems / num_shards) elements.
+template <typename key_t, typename value_t>
+class ShardedLRUCache {
+ public:
+  using LoadFn = std::function<std::shared_ptr<value_t>(const key_t&)>;
+  using NumBytesFn = std::function<size_t(const value_t&)>;
+
+  static const size_t kDefaultNumShards = 16;
+
+  ShardedLRUCache(size_t max_num_elems,
+                  LoadFn load_fn,
+                  size_t num_shards = kDefaultNumShards);
+
+  // Cache that is not limited by the number of elements but by the given
+  // memory budget, which may be shared with other caches. The size of an
+  // element is computed once after it was loaded.
+  ShardedLRUCache(std::shared_ptr<CacheMemoryBudget> memory_budget,
+                  LoadFn load_fn,
+                  NumBytesFn num_bytes_fn,
+                  size_t num_shards = kDefaultNumShards);
+
+  ~ShardedLRUCache();
+
+  // The number of elements in the cache.
+  size_t NumElems() const;
+  size_t MaxNumElems() const;
+
+  // The size in bytes of the loaded elements. Only tracked for caches with a
+  // memory budget, zero otherwise.
+  size_t NumBytes() const;
+
+  // The number of independently locked shards.
+  size_t NumShards() const;
+
+  // Check whether the element with the given key exists.
+  bool Exists(const key_t& key) const;
+
+  // Get the value of an element either from the cache or compute the new value.
+  std::shared_ptr<value_t> Get(const key_t& key);
+
+  // Manually evict an element from the cache.
+  // Returns true if the element was evicted.
+  bool Evict(const key_t& key);
+
+  // Pop an approximately least recently used element from the cache. The
+  // shards are visited in round-robin order.
+  void Pop();
+
+  // Clear all elements from cache.
+  void Clear();
+
+ private:
+  struct Entry {
+    Entry() : future(promise.get_future()) {}
+    std::promise<std::shared_ptr<value_t>> promise;
+    std::shared_future<std::shared_ptr<value_t>> future;
+    // Set on every hit and cleared when the clock hand passes the entry.
+    std::atomic<bool> referenced{false};
+  };
+
+  struct Slot {
+    std::shared_ptr<Entry> entry;
+    // Position of the key in the clock of the shard.
+    size_t clock_idx;
+    // Size charged to the memory budget, zero while loading.
+    size_t num_bytes = 0;
+  };
+
+  using SlotMap = std::unordered_map<key_t, Slot>;
+
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    SlotMap slots;
+    // Keys arranged on the clock, the hand points to the next eviction
+    // candidate.
+    std::vector<key_t> clock;
+    size_t hand = 0;
+  };
+
+  Shard& ShardForKey(const key_t& key);
+  const Shard& ShardForKey(const key_t& key) const;
+
+  // Pop an element from the next non-empty shard. Returns false if the cache
+  // is empty.
+  bool PopAnyShard();
+
+  // The following functions require an exclusive lock on the shard.
+  void EraseLocked(Shard& shard, typename SlotMap::iterator it);
+  void PopLocked(Shard& shard);
+
+  const size_t max_num_elems_;
+  const size_t max_num_elems_per_shard_;
+
+  // Function to compute new values if not in the cache.
+  const LoadFn load_fn_;
+
+  // Only set for caches with a memory budget.
+  const NumBytesFn num_bytes_fn_;
+  const std::shared_ptr<CacheMemoryBudget> memory_budget_;
+  std::atomic<size_t> num_bytes_{0};
+
+  std::vector<Shard> shards_;
+  std::atomic<size_t> next_pop_shard_idx_{0};
+};
+
 // Least Recently Used cache implementation that is constrained by a maximum
 // memory limitation of its elements. Whenever the memory limit is exceeded, the
 // least recently used (by Get) is deleted. Each element must implement a
@@ -308,6 +475,260 @@ void ThreadSafeLRUCache<key_t, value_t>::Clear() {
   return cache_.Clear();
 }
 
+template <typename key_t, typename value_t>
+ShardedLRUCache<key_t, value_t>::ShardedLRUCache(const size_t max_num_elems,
+                                                 LoadFn load_fn,
+                                                 const size_t num_shards)
+    : max_num_elems_(max_num_elems),
+      max_num_elems_per_shard_(
+          (max_num_elems + std::min(num_shards, max_num_elems) - 1) /
+          std::max<size_t>(std::min(num_shards, max_num_elems), 1)),
+      load_fn_(std::move(load_fn)),
+      shards_(std::min(num_shards, max_num_elems)) {
+  THROW_CHECK_NOTNULL(load_fn_);
+  THROW_CHECK_GT(max_num_elems, 0);
+  THROW_CHECK_GT(num_shards, 0);
+}
+
+template <typename key_t, typename value_t>
+ShardedLRUCache<key_t, value_t>::ShardedLRUCache(
+    std::shared_ptr<CacheMemoryBudget> memory_budget,
+    LoadFn load_fn,
+    NumBytesFn num_bytes_fn,
+    const size_t num_shards)
+    : max_num_elems_(std::numeric_limits<size_t>::max()),
+      max_num_elems_per_shard_(std::numeric_limits<size_t>::max()),
+      load_fn_(std::move(load_fn)),
+      num_bytes_fn_(std::move(num_bytes_fn)),
+      memory_budget_(std::move(memory_budget)),
+      shards_(num_shards) {
+  THROW_CHECK_NOTNULL(load_fn_);
+  THROW_CHECK_NOTNULL(num_bytes_fn_);
+  THROW_CHECK_NOTNULL(memory_budget_);
+  THROW_CHECK_GT(num_shards, 0);
+  memory_budget_->Attach(
+      this,
+      [this]() { return NumBytes(); },
+      [this]() { return PopAnyShard(); });
+}
+
+template <typename key_t, typename value_t>
+ShardedLRUCache<key_t, value_t>::~ShardedLRUCache() {
+  if (memory_budget_) {
+    // Detach first, so that the budget no longer evicts from this cache.
+    memory_budget_->Detach(this);
+    Clear();
+  }
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumElems() const {
+  size_t num_elems = 0;
+  for (const Shard& shard : shards_) {
+    std::shared_lock lock(shard.mutex);
+    num_elems += shard.slots.size();
+  }
+  return num_elems;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::MaxNumElems() const {
+  return max_num_elems_;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumBytes() const {
+  return num_bytes_.load();
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumShards() const {
+  return shards_.size();
+}
+
+template <typename key_t, typename value_t>
+bool ShardedLRUCache<key_t, value_t>::Exists(const key_t& key) const {
+  const Shard& shard = ShardForKey(key);
+  std::shared_lock lock(shard.mutex);
+  return shard.slots.find(key) != shard.slots.end();
+}
+
+template <typename key_t, typename value_t>
+std::shared_ptr<value_t> ShardedLRUCache<key_t, value_t>::Get(
+    const key_t& key) {
+  Shard& shard = ShardForKey(key);
+
+  std::shared_ptr<Entry> entry;
+  std::shared_future<std::shared_ptr<value_t>> shared_future;
+
+  // Fast path for hits, which only need the shared lock.
+  {
+    std::shared_lock lock(shard.mutex);
+    const auto it = shard.slots.find(key);
+    if (it != shard.slots.end()) {
+      entry = it->second.entry;
+      entry->referenced.store(true, std::memory_order_relaxed);
+      shared_future = entry->future;
+    }
+  }
+
+  if (entry == nullptr) {
+    bool should_load = false;
+
+    {
+      std::unique_lock lock(shard.mutex);
+      // Another thread may have inserted the element in the meantime.
+      const auto it = shard.slots.find(key);
+      if (it == shard.slots.end()) {
+        while (shard.slots.size() >= max_num_elems_per_shard_) {
+          PopLocked(shard);
+        }
+        entry = std::make_shared<Entry>();
+        shard.slots.emplace(key, Slot{entry, shard.clock.size()});
+        shard.clock.push_back(key);
+        should_load = true;
+      } else {
+        entry = it->second.entry;
+        entry->referenced.store(true, std::memory_order_relaxed);
+      }
+      shared_future = entry->future;
+    }
+
+    if (should_load) {
+      try {
+        std::shared_ptr<value_t> value = THROW_CHECK_NOTNULL(load_fn_(key));
+        if (memory_budget_) {
+          const size_t num_bytes = num_bytes_fn_(*value);
+          std::unique_lock lock(shard.mutex);
+          // Nothing to charge if the entry was evicted while loading.
+          const auto it = shard.slots.find(key);
+          if (it != shard.slots.end() && it->second.entry == entry) {
+            it->second.num_bytes = num_bytes;
+            // Protect the new element from being evicted right away.
+            entry->referenced.store(true, std::memory_order_relaxed);
+            num_bytes_ += num_bytes;
+            memory_budget_->Charge(num_bytes);
+          }
+        }
+        entry->promise.set_value(std::move(value));
+      } catch (...) {
+        // Evict the cache entry after load failed and set the exception.
+        {
+          std::unique_lock lock(shard.mutex);
+          const auto it = shard.slots.find(key);
+          if (it != shard.slots.end() && it->second.entry == entry) {
+            EraseLocked(shard, it);
+          }
+        }
+        entry->promise.set_exception(std::current_exception());
+      }
+
+      if (memory_budget_) {
+        memory_budget_->Shrink();
+      }
+    }
+  }
+
+  return shared_future.get();
+}
+
+template <typename key_t, typename value_t>
+bool ShardedLRUCache<key_t, value_t>::Evict(const key_t& key) {
+  Shard& shard = ShardForKey(key);
+  std::unique_lock lock(shard.mutex);
+  const auto it = shard.slots.find(key);
+  if (it == shard.slots.end()) {
+    return false;
+  }
+  EraseLocked(shard, it);
+  return true;
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::Pop() {
+  PopAnyShard();
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::Clear() {
+  for (Shard& shard : shards_) {
+    std::unique_lock lock(shard.mutex);
+    size_t num_bytes = 0;
+    for (const auto& slot : shard.slots) {
+      num_bytes += slot.second.num_bytes;
+    }
+    if (num_bytes > 0) {
+      num_bytes_ -= num_bytes;
+      memory_budget_->Release(num_bytes);
+    }
+    shard.slots.clear();
+    shard.clock.clear();
+    shard.hand = 0;
+  }
+}
+
+template <typename key_t, typename value_t>
+bool ShardedLRUCache<key_t, value_t>::PopAnyShard() {
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    Shard& shard =
+        shards_[next_pop_shard_idx_.fetch_add(1) % shards_.size()];
+    std::unique_lock lock(shard.mutex);
+    if (!shard.slots.empty()) {
+      PopLocked(shard);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::Shard&
+ShardedLRUCache<key_t, value_t>::ShardForKey(const key_t& key) {
+  return shards_[std::hash<key_t>{}(key) % shards_.size()];
+}
+
+template <typename key_t, typename value_t>
+const typename ShardedLRUCache<key_t, value_t>::Shard&
+ShardedLRUCache<key_t, value_t>::ShardForKey(const key_t& key) const {
+  return shards_[std::hash<key_t>{}(key) % shards_.size()];
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::EraseLocked(
+    Shard& shard, typename SlotMap::iterator it) {
+  // Fill the hole in the clock with the last key to keep it dense.
+  const size_t clock_idx = it->second.clock_idx;
+  if (clock_idx + 1 != shard.clock.size()) {
+    shard.clock[clock_idx] = std::move(shard.clock.back());
+    shard.slots.at(shard.clock[clock_idx]).clock_idx = clock_idx;
+  }
+  shard.clock.pop_back();
+  if (it->second.num_bytes > 0) {
+    num_bytes_ -= it->second.num_bytes;
+    memory_budget_->Release(it->second.num_bytes);
+  }
+  shard.slots.erase(it);
+  if (shard.hand >= shard.clock.size()) {
+    shard.hand = 0;
+  }
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::PopLocked(Shard& shard) {
+  // Advance the hand and give referenced entries a second chance. This
+  // terminates after at most one full revolution of the clock.
+  while (!shard.clock.empty()) {
+    const auto it = shard.slots.find(shard.clock[shard.hand]);
+    if (it->second.entry->referenced.exchange(false,
+                                              std::memory_order_relaxed)) {
+      shard.hand = (shard.hand + 1) % shard.clock.size();
+    } else {
+      EraseLocked(shard, it);
+      return;
+    }
+  }
+}
+
 template <typename key_t, typename value_t>
 MemoryConstrainedLRUCache<key_t, value_t>::MemoryConstrainedLRUCache(
     const size_t max_num_bytes, LoadFn load_fn)
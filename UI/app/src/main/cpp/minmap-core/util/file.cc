@@ -18,6 +18,14 @@
 #endif
 #endif
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MINMAP_HAS_MMAP
+#endif
+
 #ifndef _MSC_VER
 extern "C" {
 extern char** environ;
@@ -307,6 +315,49 @@ void WriteBinaryBlob(const std::string& path, const span<const char>& data) {
   file.write(data.begin(), data.size());
 }
 
+MappedFile::MappedFile(const std::string& path) {
+#ifdef MINMAP_HAS_MMAP
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    void* addr = mmap(nullptr,
+                      static_cast<size_t>(file_stat.st_size),
+                      PROT_READ,
+                      MAP_PRIVATE,
+                      fd,
+                      0);
+    if (addr != MAP_FAILED) {
+      data_ = static_cast<const char*>(addr);
+      size_ = static_cast<size_t>(file_stat.st_size);
+      mapped_ = true;
+    }
+  }
+  close(fd);
+  if (mapped_) {
+    return;
+  }
+#endif
+  if (!ExistsFile(path)) {
+    return;
+  }
+  ReadBinaryBlob(path, &buffer_);
+  if (!buffer_.empty()) {
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+  }
+}
+
+MappedFile::~MappedFile() {
+#ifdef MINMAP_HAS_MMAP
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
+
 std::vector<std::string> ReadTextFileLines(const std::string& path) {
   std::ifstream file(path);
   THROW_CHECK_FILE_OPEN(file, path);
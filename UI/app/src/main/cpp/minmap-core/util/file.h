@@ -100,6 +100,28 @@ void ReadBinaryBlob(const std::string& path, std::vector<char>* data);
 // Write contiguous binary blob to file.
 void WriteBinaryBlob(const std::string& path, const span<const char>& data);
 
+// Read-only view of a whole file. The file is memory-mapped where supported,
+// otherwise its contents are read into memory. An empty or missing file
+// results in a closed mapping.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  NON_COPYABLE(MappedFile)
+  NON_MOVABLE(MappedFile)
+
+  inline bool IsOpen() const { return data_ != nullptr; }
+  inline const char* Data() const { return data_; }
+  inline size_t Size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  std::vector<char> buffer_;
+};
+
 // Read each line of a text file into a separate element. Empty lines are
 // ignored and leading/trailing whitespace is removed.
 std::vector<std::string> ReadTextFileLines(const std::string& path);
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace colmap {
+
+// Map from integer identifiers to values, which stores the values densely in
+// a single vector. A lookup indexes the slot of the identifier instead of
+// probing a hash table, and iterating all values walks contiguous memory.
+// Erasing a value moves the last value into its position, such that erasing
+// is O(1) and the values stay dense.
+//
+// The slots grow with the largest identifier, i.e. the identifiers should be
+// allocated incrementally. Since identifiers are never reused, the slot of an
+// erased identifier stays empty and a stale identifier is never mistaken for
+// a new value. The iteration order is the insertion order modulo erasures.
+//
+// Unlike std::unordered_map, inserting and erasing values invalidates
+// references and iterators to other values.
+template <typename Key, typename T>
+class SlotMap {
+ public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  inline size_t size() const;
+  inline bool empty() const;
+
+  inline iterator begin();
+  inline iterator end();
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+
+  inline void reserve(size_t num_values);
+  inline void clear();
+
+  inline size_t count(Key key) const;
+  inline iterator find(Key key);
+  inline const_iterator find(Key key) const;
+
+  // Throws std::out_of_range if the identifier does not exist.
+  inline T& at(Key key);
+  inline const T& at(Key key) const;
+
+  // Insert the value, if the identifier does not exist yet.
+  inline std::pair<iterator, bool> emplace(Key key, T value);
+
+  // Returns the number of erased values.
+  inline size_t erase(Key key);
+
+ private:
+  using slot_t = uint32_t;
+  static constexpr slot_t kInvalidSlot = std::numeric_limits<slot_t>::max();
+
+  inline slot_t Slot(Key key) const;
+
+  std::vector<value_type> values_;
+  std::vector<slot_t> slots_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename Key, typename T>
+size_t SlotMap<Key, T>::size() const {
+  return values_.size();
+}
+
+template <typename Key, typename T>
+bool SlotMap<Key, T>::empty() const {
+  return values_.empty();
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::iterator SlotMap<Key, T>::begin() {
+  return values_.begin();
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::iterator SlotMap<Key, T>::end() {
+  return values_.end();
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::const_iterator SlotMap<Key, T>::begin() const {
+  return values_.begin();
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::const_iterator SlotMap<Key, T>::end() const {
+  return values_.end();
+}
+
+template <typename Key, typename T>
+void SlotMap<Key, T>::reserve(const size_t num_values) {
+  values_.reserve(num_values);
+}
+
+template <typename Key, typename T>
+void SlotMap<Key, T>::clear() {
+  values_.clear();
+  slots_.clear();
+}
+
+template <typename Key, typename T>
+size_t SlotMap<Key, T>::count(const Key key) const {
+  return Slot(key) == kInvalidSlot ? 0 : 1;
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::iterator SlotMap<Key, T>::find(const Key key) {
+  const slot_t slot = Slot(key);
+  return slot == kInvalidSlot ? values_.end() : values_.begin() + slot;
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::const_iterator SlotMap<Key, T>::find(
+    const Key key) const {
+  const slot_t slot = Slot(key);
+  return slot == kInvalidSlot ? values_.end() : values_.begin() + slot;
+}
+
+template <typename Key, typename T>
+T& SlotMap<Key, T>::at(const Key key) {
+  const slot_t slot = Slot(key);
+  if (slot == kInvalidSlot) {
+    throw std::out_of_range("SlotMap::at");
+  }
+  return values_[slot].second;
+}
+
+template <typename Key, typename T>
+const T& SlotMap<Key, T>::at(const Key key) const {
+  const slot_t slot = Slot(key);
+  if (slot == kInvalidSlot) {
+    throw std::out_of_range("SlotMap::at");
+  }
+  return values_[slot].second;
+}
+
+template <typename Key, typename T>
+std::pair<typename SlotMap<Key, T>::iterator, bool> SlotMap<Key, T>::emplace(
+    const Key key, T value) {
+  const slot_t slot = Slot(key);
+  if (slot != kInvalidSlot) {
+    return {values_.begin() + slot, false};
+  }
+  if (values_.size() >= kInvalidSlot) {
+    throw std::length_error("SlotMap::emplace");
+  }
+  const size_t key_idx = static_cast<size_t>(key);
+  if (key_idx >= slots_.size()) {
+    slots_.resize(std::max(key_idx + 1, 2 * slots_.size()), kInvalidSlot);
+  }
+  slots_[key_idx] = static_cast<slot_t>(values_.size());
+  values_.emplace_back(key, std::move(value));
+  return {values_.end() - 1, true};
+}
+
+template <typename Key, typename T>
+size_t SlotMap<Key, T>::erase(const Key key) {
+  const slot_t slot = Slot(key);
+  if (slot == kInvalidSlot) {
+    return 0;
+  }
+  if (slot + 1 != values_.size()) {
+    values_[slot] = std::move(values_.back());
+    slots_[static_cast<size_t>(values_[slot].first)] = slot;
+  }
+  values_.pop_back();
+  slots_[static_cast<size_t>(key)] = kInvalidSlot;
+  return 1;
+}
+
+template <typename Key, typename T>
+typename SlotMap<Key, T>::slot_t SlotMap<Key, T>::Slot(const Key key) const {
+  const size_t key_idx = static_cast<size_t>(key);
+  return key_idx < slots_.size() ? slots_[key_idx] : kInvalidSlot;
+}
+
+}  // namespace colmap
@@ -0,0 +1,416 @@
+#include "task_scheduler.h"
+
+#include "string.h"
+#include "threading.h"
+
+#include <fstream>
+#include <numeric>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace colmap {
+namespace {
+
+thread_local const TaskScheduler* tls_scheduler = nullptr;
+thread_local int tls_worker_idx = -1;
+
+std::mutex instance_mutex;
+TaskSchedulerOptions instance_options;
+bool instance_created = false;
+
+// Maximum frequency of every CPU or empty if it is unknown for any CPU.
+std::vector<long> ReadMaxCpuFrequencies() {
+  std::vector<long> frequencies;
+#if defined(__linux__)
+  const unsigned int num_cpus = std::thread::hardware_concurrency();
+  for (unsigned int cpu = 0; cpu < num_cpus; ++cpu) {
+    std::ifstream file(StringPrintf(
+        "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", cpu));
+    long frequency = 0;
+    if (!(file >> frequency) || frequency <= 0) {
+      return {};
+    }
+    frequencies.push_back(frequency);
+  }
+#endif
+  return frequencies;
+}
+
+void PinCurrentThread(const std::vector<int>& cpus) {
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    LOG(MM_WARNING) << "Failed to pin task scheduler worker to cores";
+  }
+#endif
+}
+
+}  // namespace
+
+bool TaskSchedulerOptions::Check() const {
+  CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_GE(num_threads, -1);
+  return true;
+}
+
+TaskScheduler::TaskScheduler(const TaskSchedulerOptions& options) {
+  THROW_CHECK(options.Check());
+
+  const int num_workers = GetEffectiveNumThreads(options.num_threads) - 1;
+
+  // Cores with the lowest maximum frequency are efficiency cores and all
+  // others performance cores, which also covers devices with a third tier of
+  // prime cores. Workers are assigned to the fastest cores first.
+  const std::vector<long> frequencies = ReadMaxCpuFrequencies();
+  std::vector<int> cpus(frequencies.size());
+  std::iota(cpus.begin(), cpus.end(), 0);
+  std::stable_sort(cpus.begin(), cpus.end(), [&](const int a, const int b) {
+    return frequencies[a] > frequencies[b];
+  });
+  long min_frequency = 0;
+  if (!frequencies.empty()) {
+    min_frequency = frequencies[cpus.back()];
+    has_heterogeneous_cores_ = frequencies[cpus.front()] != min_frequency;
+  }
+
+  std::vector<int> performance_cpus;
+  std::vector<int> efficiency_cpus;
+  for (const int cpu : cpus) {
+    if (frequencies[cpu] > min_frequency) {
+      performance_cpus.push_back(cpu);
+    } else {
+      efficiency_cpus.push_back(cpu);
+    }
+  }
+
+  workers_.reserve(std::max(num_workers, 0));
+  for (int worker_idx = 0; worker_idx < num_workers; ++worker_idx) {
+    auto worker = std::make_unique<Worker>();
+    if (has_heterogeneous_cores_) {
+      const int cpu = cpus[worker_idx % cpus.size()];
+      if (frequencies[cpu] > min_frequency) {
+        worker->core_type = TaskHints::CoreType::PERFORMANCE;
+        worker->cpus = performance_cpus;
+      } else {
+        worker->core_type = TaskHints::CoreType::EFFICIENCY;
+        worker->cpus = efficiency_cpus;
+      }
+      if (!options.pin_workers) {
+        worker->cpus.clear();
+      }
+    }
+    workers_.push_back(std::move(worker));
+  }
+
+  for (int worker_idx = 0; worker_idx < num_workers; ++worker_idx) {
+    workers_[worker_idx]->thread =
+        std::thread(&TaskScheduler::WorkerFunc, this, worker_idx);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+    sleep_condition_.notify_all();
+  }
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+TaskScheduler& TaskScheduler::Instance() {
+  // Intentionally leaked, such that task groups can still be waited for
+  // during the destruction of other static objects.
+  static TaskScheduler* scheduler = []() {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    instance_created = true;
+    return new TaskScheduler(instance_options);
+  }();
+  return *scheduler;
+}
+
+void TaskScheduler::SetInstanceOptions(const TaskSchedulerOptions& options) {
+  THROW_CHECK(options.Check());
+  std::lock_guard<std::mutex> lock(instance_mutex);
+  THROW_CHECK(!instance_created)
+      << "The task scheduler options must be set before its first use";
+  instance_options = options;
+}
+
+size_t TaskScheduler::NumWorkers() const { return workers_.size(); }
+
+bool TaskScheduler::HasHeterogeneousCores() const {
+  return has_heterogeneous_cores_;
+}
+
+int TaskScheduler::CurrentWorkerIndex() const {
+  return tls_scheduler == this ? tls_worker_idx : -1;
+}
+
+void TaskScheduler::Submit(std::function<void()> task,
+                           const TaskHints& hints) {
+  THROW_CHECK(task);
+
+  Task pending_task;
+  pending_task.func = std::move(task);
+  pending_task.hints = hints;
+
+  // Ignore core types that no worker runs on.
+  if (pending_task.hints.core_type != TaskHints::CoreType::ANY) {
+    const bool has_worker =
+        std::any_of(workers_.begin(),
+                    workers_.end(),
+                    [&](const std::unique_ptr<Worker>& worker) {
+                      return worker->core_type == hints.core_type;
+                    });
+    if (!has_worker) {
+      pending_task.hints.core_type = TaskHints::CoreType::ANY;
+    }
+  }
+
+  // Workers keep their own tasks for locality, other threads distribute
+  // their tasks round-robin.
+  TaskDeque* deque = &external_deque_;
+  const int worker_idx = CurrentWorkerIndex();
+  if (worker_idx >= 0 && CanRun(worker_idx, pending_task)) {
+    deque = &workers_[worker_idx]->deque;
+  } else {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      const size_t next_worker_idx = next_worker_idx_++ % workers_.size();
+      if (CanRun(static_cast<int>(next_worker_idx), pending_task)) {
+        deque = &workers_[next_worker_idx]->deque;
+        break;
+      }
+    }
+  }
+
+  const int core_type = static_cast<int>(pending_task.hints.core_type);
+  const int priority = static_cast<int>(pending_task.hints.priority);
+  {
+    std::lock_guard<std::mutex> lock(deque->mutex);
+    deque->tasks[priority].push_back(std::move(pending_task));
+    num_pending_tasks_[core_type]++;
+  }
+
+  if (num_sleeping_workers_ > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    // A single woken worker might not be allowed to run the task.
+    if (core_type == static_cast<int>(TaskHints::CoreType::ANY)) {
+      sleep_condition_.notify_one();
+    } else {
+      sleep_condition_.notify_all();
+    }
+  }
+}
+
+bool TaskScheduler::RunPendingTask() {
+  Task task;
+  if (!FindTask(CurrentWorkerIndex(), &task)) {
+    return false;
+  }
+  RunTask(task);
+  return true;
+}
+
+void TaskScheduler::WorkerFunc(const int worker_idx) {
+  tls_scheduler = this;
+  tls_worker_idx = worker_idx;
+
+  if (!workers_[worker_idx]->cpus.empty()) {
+    PinCurrentThread(workers_[worker_idx]->cpus);
+  }
+
+  Task task;
+  while (true) {
+    if (FindTask(worker_idx, &task)) {
+      RunTask(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    num_sleeping_workers_++;
+    sleep_condition_.wait(
+        lock, [&]() { return stop_ || HasRunnableTask(worker_idx); });
+    num_sleeping_workers_--;
+    if (stop_) {
+      break;
+    }
+  }
+}
+
+bool TaskScheduler::CanRun(const int worker_idx, const Task& task) const {
+  return worker_idx < 0 ||
+         task.hints.core_type == TaskHints::CoreType::ANY ||
+         task.hints.core_type == workers_[worker_idx]->core_type;
+}
+
+bool TaskScheduler::HasRunnableTask(const int worker_idx) const {
+  if (num_pending_tasks_[static_cast<int>(TaskHints::CoreType::ANY)] > 0) {
+    return true;
+  }
+  if (worker_idx < 0) {
+    return num_pending_tasks_[static_cast<int>(
+               TaskHints::CoreType::PERFORMANCE)] > 0 ||
+           num_pending_tasks_[static_cast<int>(
+               TaskHints::CoreType::EFFICIENCY)] > 0;
+  }
+  const TaskHints::CoreType core_type = workers_[worker_idx]->core_type;
+  return core_type != TaskHints::CoreType::ANY &&
+         num_pending_tasks_[static_cast<int>(core_type)] > 0;
+}
+
+bool TaskScheduler::PopTask(const int worker_idx,
+                            TaskDeque& deque,
+                            const int priority,
+                            const bool back,
+                            Task* task) {
+  std::lock_guard<std::mutex> lock(deque.mutex);
+  std::deque<Task>& tasks = deque.tasks[priority];
+  if (tasks.empty()) {
+    return false;
+  }
+
+  auto it = tasks.end();
+  if (back) {
+    for (auto rit = tasks.rbegin(); rit != tasks.rend(); ++rit) {
+      if (CanRun(worker_idx, *rit)) {
+        it = std::prev(rit.base());
+        break;
+      }
+    }
+  } else {
+    it = std::find_if(tasks.begin(), tasks.end(), [&](const Task& task) {
+      return CanRun(worker_idx, task);
+    });
+  }
+  if (it == tasks.end()) {
+    return false;
+  }
+
+  *task = std::move(*it);
+  tasks.erase(it);
+  num_pending_tasks_[static_cast<int>(task->hints.core_type)]--;
+  return true;
+}
+
+bool TaskScheduler::FindTask(const int worker_idx, Task* task) {
+  if (!HasRunnableTask(worker_idx)) {
+    return false;
+  }
+
+  const int num_workers = static_cast<int>(workers_.size());
+  for (int priority = kNumPriorities - 1; priority >= 0; --priority) {
+    if (worker_idx >= 0 &&
+        PopTask(worker_idx,
+                workers_[worker_idx]->deque,
+                priority,
+                /*back=*/true,
+                task)) {
+      return true;
+    }
+    if (PopTask(worker_idx, external_deque_, priority, /*back=*/false, task)) {
+      return true;
+    }
+    // Steal the oldest task of the other workers, which is likely the
+    // largest piece of remaining work.
+    const int first_victim_idx = std::max(worker_idx, 0);
+    for (int i = 0; i < num_workers; ++i) {
+      const int victim_idx = (first_victim_idx + i) % num_workers;
+      if (victim_idx != worker_idx &&
+          PopTask(worker_idx,
+                  workers_[victim_idx]->deque,
+                  priority,
+                  /*back=*/false,
+                  task)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+void TaskScheduler::RunTask(Task& task) {
+  try {
+    task.func();
+  } catch (const std::exception& e) {
+    LOG(MM_ERROR) << "Uncaught exception in task: " << e.what();
+  }
+  task.func = nullptr;
+}
+
+TaskGroup::TaskGroup(const TaskHints& hints, TaskScheduler& scheduler)
+    : scheduler_(scheduler), hints_(hints) {}
+
+TaskGroup::~TaskGroup() {
+  try {
+    Wait();
+  } catch (const std::exception& e) {
+    LOG(MM_ERROR) << "Unhandled exception in task group: " << e.what();
+  }
+}
+
+void TaskGroup::Run(std::function<void()> func) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_pending_++;
+  }
+  scheduler_.Submit(
+      [this, func = std::move(func)]() {
+        std::exception_ptr exception;
+        try {
+          func();
+        } catch (...) {
+          exception = std::current_exception();
+        }
+        // The group may be destroyed as soon as the mutex is released.
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (exception && !exception_) {
+          exception_ = exception;
+        }
+        num_pending_--;
+        finished_condition_.notify_all();
+      },
+      hints_);
+}
+
+size_t TaskGroup::NumPending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_pending_;
+}
+
+void TaskGroup::Wait(const size_t max_num_pending) {
+  const auto is_done = [&]() { return num_pending_ <= max_num_pending; };
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (is_done()) {
+        break;
+      }
+    }
+    // Help instead of blocking. The remaining tasks of the group may run on
+    // other threads or not be runnable by this thread.
+    if (!scheduler_.RunPendingTask()) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      finished_condition_.wait_for(lock, std::chrono::milliseconds(1), is_done);
+    }
+  }
+
+  std::exception_ptr exception;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(exception, exception_);
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+}  // namespace colmap
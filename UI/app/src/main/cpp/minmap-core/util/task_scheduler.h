@@ -0,0 +1,283 @@
+#pragma once
+
+#include "logging.h"
+#include "types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace colmap {
+
+// Scheduling hints of a task. The priority orders the pending tasks of the
+// scheduler but does not change the priority of the worker threads. The core
+// type restricts the workers that may run the task on devices with
+// heterogeneous cores, e.g., ARM big.LITTLE, and is ignored on devices with
+// homogeneous cores and for threads that run tasks while waiting.
+struct TaskHints {
+  enum class Priority { LOW = 0, NORMAL = 1, HIGH = 2 };
+  enum class CoreType { ANY = 0, PERFORMANCE = 1, EFFICIENCY = 2 };
+
+  Priority priority = Priority::NORMAL;
+  CoreType core_type = CoreType::ANY;
+};
+
+struct TaskSchedulerOptions {
+  // The number of threads running tasks. Threads waiting for a task group
+  // run pending tasks themselves, so the scheduler starts num_threads - 1
+  // worker threads.
+  int num_threads = -1;
+
+  // Whether to pin the workers to the cores of their type on devices with
+  // heterogeneous cores.
+  bool pin_workers = true;
+
+  bool Check() const;
+};
+
+// Work-stealing task scheduler shared by all controllers. Every worker owns
+// a deque of pending tasks per priority. Workers run their own tasks in LIFO
+// order and steal the oldest tasks of other workers when idle, such that the
+// controllers no longer need dedicated threads per pipeline stage and idle
+// cores pick up the work of any stage. Tasks are usually not submitted
+// directly but through a TaskGroup or ParallelFor.
+class TaskScheduler {
+ public:
+  explicit TaskScheduler(
+      const TaskSchedulerOptions& options = TaskSchedulerOptions());
+  ~TaskScheduler();
+
+  NON_COPYABLE(TaskScheduler)
+  NON_MOVABLE(TaskScheduler)
+
+  // The process-wide scheduler, which is created on first use.
+  static TaskScheduler& Instance();
+
+  // Set the options of the process-wide scheduler. Must be called before the
+  // first call to Instance().
+  static void SetInstanceOptions(const TaskSchedulerOptions& options);
+
+  size_t NumWorkers() const;
+
+  // Whether the cores of the device have different maximum frequencies, in
+  // which case the core type hints of tasks are honored.
+  bool HasHeterogeneousCores() const;
+
+  // The index of the calling worker thread or -1 if the calling thread is
+  // not a worker of this scheduler.
+  int CurrentWorkerIndex() const;
+
+  void Submit(std::function<void()> task, const TaskHints& hints = TaskHints());
+
+  // Run one pending task in the calling thread. Returns false if there is no
+  // pending task the calling thread may run.
+  bool RunPendingTask();
+
+ private:
+  static constexpr int kNumPriorities = 3;
+  static constexpr int kNumCoreTypes = 3;
+
+  struct Task {
+    std::function<void()> func;
+    TaskHints hints;
+  };
+
+  struct TaskDeque {
+    std::mutex mutex;
+    std::deque<Task> tasks[kNumPriorities];
+  };
+
+  struct Worker {
+    TaskHints::CoreType core_type = TaskHints::CoreType::ANY;
+    std::vector<int> cpus;
+    TaskDeque deque;
+    std::thread thread;
+  };
+
+  void WorkerFunc(int worker_idx);
+
+  // Whether the given worker (or any thread for -1) may run the task.
+  bool CanRun(int worker_idx, const Task& task) const;
+  bool HasRunnableTask(int worker_idx) const;
+
+  bool PopTask(int worker_idx,
+               TaskDeque& deque,
+               int priority,
+               bool back,
+               Task* task);
+  bool FindTask(int worker_idx, Task* task);
+  void RunTask(Task& task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  bool has_heterogeneous_cores_ = false;
+
+  // Tasks submitted by threads other than the workers if there is no worker
+  // that may run them, i.e., they are only run by waiting threads.
+  TaskDeque external_deque_;
+
+  std::atomic<size_t> next_worker_idx_{0};
+  std::atomic<size_t> num_pending_tasks_[kNumCoreTypes] = {};
+
+  std::atomic<bool> stop_{false};
+  std::atomic<int> num_sleeping_workers_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_condition_;
+};
+
+// Group of tasks that are waited for together:
+//
+//    TaskGroup group;
+//    for (int i = 0; i < 10; ++i) {
+//      group.Run([i]() { /* Do some work */ });
+//    }
+//    group.Wait();
+//
+// The waiting thread runs pending tasks of the scheduler, so groups can be
+// nested inside tasks and work without any worker thread. The first
+// exception thrown by a task is rethrown by Wait.
+class TaskGroup {
+ public:
+  explicit TaskGroup(const TaskHints& hints = TaskHints(),
+                     TaskScheduler& scheduler = TaskScheduler::Instance());
+  ~TaskGroup();
+
+  NON_COPYABLE(TaskGroup)
+  NON_MOVABLE(TaskGroup)
+
+  void Run(std::function<void()> func);
+
+  size_t NumPending() const;
+
+  // Wait until at most the given number of tasks of the group is pending.
+  // Bounding the number of pending tasks limits the memory held by tasks
+  // that are submitted faster than they run.
+  void Wait(size_t max_num_pending = 0);
+
+ private:
+  TaskScheduler& scheduler_;
+  const TaskHints hints_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable finished_condition_;
+  size_t num_pending_ = 0;
+  std::exception_ptr exception_;
+};
+
+// Call func(i) for all i in [begin, end) on the calling thread and the
+// workers of the scheduler. Consecutive indices are claimed in chunks of
+// grain_size, so that cheap iterations do not drown in scheduling overhead.
+template <typename Func>
+void ParallelFor(int64_t begin,
+                 int64_t end,
+                 const Func& func,
+                 int64_t grain_size = 1,
+                 const TaskHints& hints = TaskHints(),
+                 TaskScheduler& scheduler = TaskScheduler::Instance());
+
+// Pool of objects that are expensive to create and must not be shared
+// between concurrent tasks, e.g., feature extractors or matchers. At most
+// one object per concurrently running task is created.
+template <typename T>
+class TaskResourcePool {
+ public:
+  using CreateFn = std::function<std::unique_ptr<T>()>;
+
+  explicit TaskResourcePool(CreateFn create_fn);
+
+  // Take an idle object or create a new one. Returns null if the creation
+  // failed.
+  std::unique_ptr<T> Acquire();
+  void Release(std::unique_ptr<T> object);
+
+ private:
+  const CreateFn create_fn_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<T>> idle_objects_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename Func>
+void ParallelFor(const int64_t begin,
+                 const int64_t end,
+                 const Func& func,
+                 const int64_t grain_size,
+                 const TaskHints& hints,
+                 TaskScheduler& scheduler) {
+  if (begin >= end) {
+    return;
+  }
+
+  THROW_CHECK_GT(grain_size, 0);
+  const int64_t num_chunks = (end - begin + grain_size - 1) / grain_size;
+  const int64_t num_tasks = std::min<int64_t>(
+      num_chunks, static_cast<int64_t>(scheduler.NumWorkers()) + 1);
+  if (num_tasks <= 1) {
+    for (int64_t i = begin; i < end; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<int64_t> next_chunk(0);
+  const auto run_chunks = [&]() {
+    while (true) {
+      const int64_t chunk = next_chunk.fetch_add(1);
+      if (chunk >= num_chunks) {
+        break;
+      }
+      const int64_t chunk_begin = begin + chunk * grain_size;
+      const int64_t chunk_end = std::min(end, chunk_begin + grain_size);
+      for (int64_t i = chunk_begin; i < chunk_end; ++i) {
+        func(i);
+      }
+    }
+  };
+
+  TaskGroup group(hints, scheduler);
+  for (int64_t i = 1; i < num_tasks; ++i) {
+    group.Run(run_chunks);
+  }
+  run_chunks();
+  group.Wait();
+}
+
+template <typename T>
+TaskResourcePool<T>::TaskResourcePool(CreateFn create_fn)
+    : create_fn_(std::move(create_fn)) {
+  THROW_CHECK_NOTNULL(create_fn_);
+}
+
+template <typename T>
+std::unique_ptr<T> TaskResourcePool<T>::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_objects_.empty()) {
+      std::unique_ptr<T> object = std::move(idle_objects_.back());
+      idle_objects_.pop_back();
+      return object;
+    }
+  }
+  return create_fn_();
+}
+
+template <typename T>
+void TaskResourcePool<T>::Release(std::unique_ptr<T> object) {
+  if (object == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_objects_.push_back(std::move(object));
+}
+
+}  // namespace colmap
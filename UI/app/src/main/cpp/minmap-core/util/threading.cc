@@ -234,10 +234,9 @@ int ThreadPool::GetThreadIndex() {
   return thread_id_to_index_.at(GetThreadId());
 }
 
-int GetEffectiveNumThreads(const int num_threads) {
-#if MINMAP_SINGLE_THREADED
-    return 1;
-#else
+namespace {
+
+int GetNumHardwareThreads(const int num_threads) {
     int num_effective_threads = num_threads;
     if (num_threads <= 0) {
         num_effective_threads = std::thread::hardware_concurrency();
@@ -250,7 +249,23 @@ int GetEffectiveNumThreads(const int num_threads) {
     }
 
     return static_cast<int>(std::ceil((double)num_effective_threads * 0.5));
+}
+
+}  // namespace
+
+int GetEffectiveNumThreads(const int num_threads) {
+#if MINMAP_SINGLE_THREADED
+    return 1;
+#else
+    return GetNumHardwareThreads(num_threads);
 #endif
 }
 
+int GetEffectiveNumSolverThreads(const int num_threads) {
+    if (num_threads > 0) {
+        return num_threads;
+    }
+    return GetNumHardwareThreads(num_threads);
+}
+
 }  // namespace colmap
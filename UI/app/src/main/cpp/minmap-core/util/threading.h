@@ -2,10 +2,16 @@
 
 #include "timer.h"
 
+#include <atomic>
 #include <climits>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <future>
+#include <limits>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <thread>
 #include <type_traits>
@@ -232,6 +238,13 @@ class ThreadPool {
 //    producer_thread.join();
 //    consumer_thread.join();
 //
+// The jobs are stored in a bounded ring buffer with a sequence number per slot,
+// so that producers and consumers only contend on a compare-and-swap of their
+// own position and never take a lock while the queue is neither full nor
+// empty. Waiting calls first spin for a short time and then park on a
+// condition variable. An unbounded queue spills jobs to a locked overflow
+// queue when its ring buffer is full, in which case jobs may be popped out of
+// order.
 template <typename T>
 class JobQueue {
  public:
@@ -252,6 +265,9 @@ class JobQueue {
     bool valid_;
   };
 
+  // Capacity of the ring buffer of unbounded queues.
+  static const size_t kUnboundedRingSize = 256;
+
   JobQueue();
   explicit JobQueue(size_t max_num_jobs);
   ~JobQueue();
@@ -275,9 +291,56 @@ class JobQueue {
   void Clear();
 
  private:
-  size_t max_num_jobs_;
-  bool stop_;
-  std::queue<T> jobs_;
+  // Avoid false sharing between the producer and consumer positions.
+  static const size_t kCacheLineSize = 64;
+
+  // Busy-wait iterations and then yields before a waiting call parks.
+  static const int kNumSpins = 256;
+  static const int kNumYields = 4;
+
+  struct Slot {
+    // Equals the position of the next push into this slot if the slot is
+    // free, or the position of the last push plus one if it is occupied.
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // Non-blocking push/pop on the ring buffer. Return false if it is full or
+  // empty, respectively.
+  bool TryPushRing(T& data);
+  bool TryPopRing(T& data);
+  bool TryPop(T& data);
+
+  size_t NumRingJobs() const;
+  bool IsEmpty() const;
+
+  // Spin and then park on the condition until the predicate is true.
+  template <typename Predicate>
+  void Await(std::condition_variable& condition,
+             std::atomic<int>& num_waiters,
+             Predicate predicate);
+  // Wake up one or all threads parked on the condition, if there are any.
+  void Notify(std::condition_variable& condition,
+              const std::atomic<int>& num_waiters,
+              bool notify_all);
+
+  const size_t max_num_jobs_;
+  const size_t ring_size_;
+  const int num_spins_;
+  std::unique_ptr<Slot[]> ring_;
+
+  alignas(kCacheLineSize) std::atomic<size_t> push_pos_{0};
+  alignas(kCacheLineSize) std::atomic<size_t> pop_pos_{0};
+  alignas(kCacheLineSize) std::atomic<bool> stop_{false};
+
+  // Jobs that did not fit into the ring buffer of an unbounded queue.
+  std::atomic<size_t> num_overflow_jobs_{0};
+  std::mutex overflow_mutex_;
+  std::queue<T> overflow_jobs_;
+
+  std::atomic<int> num_push_waiters_{0};
+  std::atomic<int> num_pop_waiters_{0};
+  std::atomic<int> num_empty_waiters_{0};
   std::mutex mutex_;
   std::condition_variable push_condition_;
   std::condition_variable pop_condition_;
@@ -288,6 +351,11 @@ class JobQueue {
 // otherwise return the input value of num_threads.
 int GetEffectiveNumThreads(int num_threads);
 
+// Same as GetEffectiveNumThreads but for the threads of the Ceres solver,
+// which are not limited by MINMAP_SINGLE_THREADED, because they only hold
+// small per-thread evaluation buffers instead of images and features.
+int GetEffectiveNumSolverThreads(int num_threads);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -317,12 +385,35 @@ auto ThreadPool::AddTask(func_t&& f, args_t&&... args)
   return result;
 }
 
+namespace internal {
+
+// Hint to the processor that the caller is busy-waiting.
+inline void SpinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+}  // namespace internal
+
 template <typename T>
 JobQueue<T>::JobQueue() : JobQueue(std::numeric_limits<size_t>::max()) {}
 
 template <typename T>
 JobQueue<T>::JobQueue(const size_t max_num_jobs)
-    : max_num_jobs_(max_num_jobs), stop_(false) {}
+    : max_num_jobs_(max_num_jobs),
+      ring_size_(max_num_jobs == std::numeric_limits<size_t>::max()
+                     ? kUnboundedRingSize
+                     : std::max<size_t>(max_num_jobs, 1)),
+      // Spinning only pays off if another core can make progress meanwhile.
+      num_spins_(std::thread::hardware_concurrency() > 1 ? kNumSpins : 0),
+      ring_(new Slot[ring_size_]) {
+  for (size_t i = 0; i < ring_size_; ++i) {
+    ring_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
 
 template <typename T>
 JobQueue<T>::~JobQueue() {
@@ -331,57 +422,65 @@ JobQueue<T>::~JobQueue() {
 
 template <typename T>
 size_t JobQueue<T>::Size() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  return jobs_.size();
+  return NumRingJobs() + num_overflow_jobs_.load(std::memory_order_acquire);
 }
 
 template <typename T>
 bool JobQueue<T>::Push(T data) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  while (jobs_.size() >= max_num_jobs_ && !stop_) {
-    pop_condition_.wait(lock);
-  }
-  if (stop_) {
-    return false;
-  } else {
-    jobs_.push(std::move(data));
-    push_condition_.notify_one();
-    return true;
+  while (true) {
+    if (stop_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    if (TryPushRing(data)) {
+      break;
+    }
+    if (max_num_jobs_ == std::numeric_limits<size_t>::max()) {
+      std::unique_lock<std::mutex> lock(overflow_mutex_);
+      overflow_jobs_.push(std::move(data));
+      num_overflow_jobs_.fetch_add(1, std::memory_order_release);
+      break;
+    }
+    Await(pop_condition_, num_push_waiters_, [this]() {
+      return stop_.load(std::memory_order_acquire) ||
+             NumRingJobs() < ring_size_;
+    });
   }
+  Notify(push_condition_, num_pop_waiters_, /*notify_all=*/false);
+  return true;
 }
 
 template <typename T>
 typename JobQueue<T>::Job JobQueue<T>::Pop() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  while (jobs_.empty() && !stop_) {
-    push_condition_.wait(lock);
-  }
-  if (stop_) {
-    return Job();
-  } else {
-    Job job(std::move(jobs_.front()));
-    jobs_.pop();
-    pop_condition_.notify_one();
-    if (jobs_.empty()) {
-      empty_condition_.notify_all();
+  T data;
+  while (true) {
+    if (stop_.load(std::memory_order_acquire)) {
+      return Job();
     }
-    return job;
+    if (TryPop(data)) {
+      break;
+    }
+    Await(push_condition_, num_pop_waiters_, [this]() {
+      return stop_.load(std::memory_order_acquire) || !IsEmpty();
+    });
+  }
+  Notify(pop_condition_, num_push_waiters_, /*notify_all=*/false);
+  if (IsEmpty()) {
+    Notify(empty_condition_, num_empty_waiters_, /*notify_all=*/true);
   }
+  return Job(std::move(data));
 }
 
 template <typename T>
 void JobQueue<T>::Wait() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  while (!jobs_.empty()) {
-    empty_condition_.wait(lock);
-  }
+  Await(empty_condition_, num_empty_waiters_, [this]() { return IsEmpty(); });
 }
 
 template <typename T>
 void JobQueue<T>::Stop() {
+  stop_.store(true, std::memory_order_release);
+  // Unconditionally wake up all parked threads, as Stop is rare.
   {
     std::unique_lock<std::mutex> lock(mutex_);
-    stop_ = true;
   }
   push_condition_.notify_all();
   pop_condition_.notify_all();
@@ -389,9 +488,132 @@ void JobQueue<T>::Stop() {
 
 template <typename T>
 void JobQueue<T>::Clear() {
+  T data;
+  while (TryPop(data)) {
+  }
+  Notify(pop_condition_, num_push_waiters_, /*notify_all=*/true);
+  Notify(empty_condition_, num_empty_waiters_, /*notify_all=*/true);
+}
+
+template <typename T>
+bool JobQueue<T>::TryPushRing(T& data) {
+  size_t pos = push_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot& slot = ring_[pos % ring_size_];
+    const intptr_t diff =
+        static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire)) -
+        static_cast<intptr_t>(pos);
+    if (diff == 0) {
+      if (push_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        slot.data = std::move(data);
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // The slot was not yet released by the consumer of the previous round.
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+bool JobQueue<T>::TryPopRing(T& data) {
+  size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot& slot = ring_[pos % ring_size_];
+    const intptr_t diff =
+        static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire)) -
+        static_cast<intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (pop_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        data = std::move(slot.data);
+        slot.sequence.store(pos + ring_size_, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // The slot was not yet filled by the producer.
+      return false;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+bool JobQueue<T>::TryPop(T& data) {
+  if (TryPopRing(data)) {
+    return true;
+  }
+  if (num_overflow_jobs_.load(std::memory_order_acquire) > 0) {
+    std::unique_lock<std::mutex> lock(overflow_mutex_);
+    if (!overflow_jobs_.empty()) {
+      data = std::move(overflow_jobs_.front());
+      overflow_jobs_.pop();
+      num_overflow_jobs_.fetch_sub(1, std::memory_order_release);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+size_t JobQueue<T>::NumRingJobs() const {
+  // Load the pop position first, since the push position never falls behind.
+  const size_t pop_pos = pop_pos_.load(std::memory_order_acquire);
+  const size_t push_pos = push_pos_.load(std::memory_order_acquire);
+  return push_pos - pop_pos;
+}
+
+template <typename T>
+bool JobQueue<T>::IsEmpty() const {
+  return NumRingJobs() == 0 &&
+         num_overflow_jobs_.load(std::memory_order_acquire) == 0;
+}
+
+template <typename T>
+template <typename Predicate>
+void JobQueue<T>::Await(std::condition_variable& condition,
+                        std::atomic<int>& num_waiters,
+                        Predicate predicate) {
+  for (int i = 0; i < num_spins_; ++i) {
+    if (predicate()) {
+      return;
+    }
+    internal::SpinPause();
+  }
+  for (int i = 0; i < kNumYields; ++i) {
+    if (predicate()) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
   std::unique_lock<std::mutex> lock(mutex_);
-  std::queue<T> empty_jobs;
-  std::swap(jobs_, empty_jobs);
+  // The waiter must be registered before the predicate is checked, so that a
+  // concurrent Notify either sees the waiter or the predicate sees its change.
+  num_waiters.fetch_add(1, std::memory_order_seq_cst);
+  condition.wait(lock, predicate);
+  num_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+void JobQueue<T>::Notify(std::condition_variable& condition,
+                         const std::atomic<int>& num_waiters,
+                         const bool notify_all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_waiters.load(std::memory_order_relaxed) > 0) {
+    // Synchronize with waiters between checking the predicate and parking.
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (notify_all) {
+      condition.notify_all();
+    } else {
+      condition.notify_one();
+    }
+  }
 }
 
 }  // namespace colmap
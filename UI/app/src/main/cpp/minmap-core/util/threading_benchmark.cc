@@ -0,0 +1,165 @@
+// Micro-benchmark of the JobQueue throughput against the previous queue
+// implementation with a single mutex and three condition variables, for
+// 1 to 8 producers and consumers. Build with MINMAP_BUILD_BENCHMARKS=ON and
+// run, e.g., through adb on the target device:
+//
+//    minmap_threading_benchmark [num_jobs] [max_num_jobs]
+//
+
+#include "string.h"
+#include "threading.h"
+#include "timer.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace colmap {
+namespace {
+
+// Reference queue implementation as of before the lock-free ring buffer.
+template <typename T>
+class MutexJobQueue {
+ public:
+  using Job = typename JobQueue<T>::Job;
+
+  explicit MutexJobQueue(const size_t max_num_jobs)
+      : max_num_jobs_(max_num_jobs), stop_(false) {}
+
+  bool Push(T data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (jobs_.size() >= max_num_jobs_ && !stop_) {
+      pop_condition_.wait(lock);
+    }
+    if (stop_) {
+      return false;
+    }
+    jobs_.push(std::move(data));
+    push_condition_.notify_one();
+    return true;
+  }
+
+  Job Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (jobs_.empty() && !stop_) {
+      push_condition_.wait(lock);
+    }
+    if (stop_) {
+      return Job();
+    }
+    Job job(std::move(jobs_.front()));
+    jobs_.pop();
+    pop_condition_.notify_one();
+    if (jobs_.empty()) {
+      empty_condition_.notify_all();
+    }
+    return job;
+  }
+
+  void Stop() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    push_condition_.notify_all();
+    pop_condition_.notify_all();
+  }
+
+ private:
+  const size_t max_num_jobs_;
+  bool stop_;
+  std::queue<T> jobs_;
+  std::mutex mutex_;
+  std::condition_variable push_condition_;
+  std::condition_variable pop_condition_;
+  std::condition_variable empty_condition_;
+};
+
+// Returns the throughput in jobs per second.
+template <typename Queue>
+double MeasureThroughput(const int num_producers,
+                         const int num_consumers,
+                         const size_t num_jobs,
+                         const size_t max_num_jobs) {
+  Queue queue(max_num_jobs);
+  std::atomic<size_t> num_popped_jobs(0);
+  std::atomic<size_t> checksum(0);
+
+  Timer timer;
+  timer.Start();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_producers; ++i) {
+    threads.emplace_back([&, i]() {
+      for (size_t j = i; j < num_jobs; j += num_producers) {
+        queue.Push(j);
+      }
+    });
+  }
+  for (int i = 0; i < num_consumers; ++i) {
+    threads.emplace_back([&]() {
+      size_t local_checksum = 0;
+      while (true) {
+        const auto job = queue.Pop();
+        if (!job.IsValid()) {
+          break;
+        }
+        local_checksum += job.Data();
+        if (num_popped_jobs.fetch_add(1) + 1 == num_jobs) {
+          queue.Stop();
+        }
+      }
+      checksum += local_checksum;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  const double elapsed_seconds = timer.ElapsedSeconds();
+  if (checksum != num_jobs * (num_jobs - 1) / 2) {
+    std::cerr << "ERROR: Lost or duplicated jobs" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  return num_jobs / elapsed_seconds;
+}
+
+}  // namespace
+}  // namespace colmap
+
+int main(int argc, char** argv) {
+  using namespace colmap;
+
+  const size_t num_jobs = argc > 1 ? std::stoull(argv[1]) : 1000000;
+  const size_t max_num_jobs = argc > 2 ? std::stoull(argv[2]) : 64;
+
+  std::cout << StringPrintf(
+                   "num_jobs=%zu max_num_jobs=%zu hardware_concurrency=%u",
+                   num_jobs,
+                   max_num_jobs,
+                   std::thread::hardware_concurrency())
+            << std::endl;
+  std::cout << "producers consumers  mutex [Mjobs/s]  ring [Mjobs/s]  speedup"
+            << std::endl;
+
+  for (const int num_producers : {1, 2, 4, 8}) {
+    for (const int num_consumers : {1, 2, 4, 8}) {
+      const double mutex_throughput =
+          MeasureThroughput<MutexJobQueue<size_t>>(
+              num_producers, num_consumers, num_jobs, max_num_jobs);
+      const double ring_throughput = MeasureThroughput<JobQueue<size_t>>(
+          num_producers, num_consumers, num_jobs, max_num_jobs);
+      std::cout << StringPrintf("%9d %9d %17.2f %15.2f %8.2f",
+                                num_producers,
+                                num_consumers,
+                                mutex_throughput * 1e-6,
+                                ring_throughput * 1e-6,
+                                ring_throughput / mutex_throughput)
+                << std::endl;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
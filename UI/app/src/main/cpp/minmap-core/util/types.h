@@ -31,6 +31,14 @@ typedef unsigned __int64 uint64_t;
 #include <PoseLib/alignment.h>
 #include <Eigen/Core>
 
+// The fixed-size Eigen types, e.g., Eigen::Vector4d, are over-aligned when
+// Eigen is vectorized. Their heap allocations in new, std::make_shared, and the
+// STL containers rely on the aligned new of C++17 instead of
+// Eigen::aligned_allocator and EIGEN_MAKE_ALIGNED_OPERATOR_NEW.
+#if !defined(__cpp_aligned_new)
+#error "The aligned new of C++17 is required for the fixed-size Eigen types."
+#endif
+
 namespace Eigen {
 
 using Matrix3x4f = Matrix<float, 3, 4>;
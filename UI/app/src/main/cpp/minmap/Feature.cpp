@@ -154,7 +154,9 @@ int RunFeatureExtractor(
     return EXIT_SUCCESS;
 }
 
-int RunExhaustiveMatcher(const std::filesystem::path& database_path) {
+int RunExhaustiveMatcher(
+    const std::filesystem::path& database_path,
+    std::shared_ptr<colmap::CacheMemoryBudget> cache_memory_budget) {
     colmap::OptionManager options(false);
     *options.database_path = database_path.string();
     options.AddDatabaseOptions();
@@ -169,7 +171,8 @@ int RunExhaustiveMatcher(const std::filesystem::path& database_path) {
         *options.exhaustive_matching,
         *options.sift_matching,
         *options.two_view_geometry,
-        *options.database_path
+        *options.database_path,
+        std::move(cache_memory_budget)
     );
 
     matcher->Start();
@@ -4,6 +4,7 @@
 #include "minmap_defs.hpp"
 
 #include <filesystem>
+#include <memory>
 
 #include <controllers/feature_matching.h>
 #include <controllers/image_reader.h>
@@ -41,7 +42,9 @@ int RunFeatureExtractor(
     int camera_mode = -1,
     const std::string& descriptor_normalization = "l1_root",
     const std::string& image_list_path = "");
-int RunExhaustiveMatcher(const std::filesystem::path& database_path);
+int RunExhaustiveMatcher(
+    const std::filesystem::path& database_path,
+    std::shared_ptr<colmap::CacheMemoryBudget> cache_memory_budget = nullptr);
 
 MM_NS_E
 
@@ -11,8 +11,19 @@
 
 MM_NS_B
 
+namespace {
+
+// Trim levels of android.content.ComponentCallbacks2.
+constexpr int kTrimMemoryRunningModerate = 5;
+constexpr int kTrimMemoryRunningLow = 10;
+constexpr int kTrimMemoryRunningCritical = 15;
+
+}  // namespace
+
 ReconstructionEngine::ReconstructionEngine(std::string& datasetPath, std::string& databasePath)
-    : datasetPath(datasetPath), databasePath(databasePath)
+    : datasetPath(datasetPath), databasePath(databasePath),
+      featureCacheBudget(std::make_shared<colmap::CacheMemoryBudget>(
+              colmap::FeatureMatcherCache::kDefaultMaxNumBytes))
 {
 
 }
@@ -38,7 +49,7 @@ std::int8_t ReconstructionEngine::extractFeatures(
 }
 
 std::int8_t ReconstructionEngine::matchFeatures() {
-    if (RunExhaustiveMatcher(this->databasePath) == EXIT_FAILURE) {
+    if (RunExhaustiveMatcher(this->databasePath, this->featureCacheBudget) == EXIT_FAILURE) {
         LOG(MM_ERROR) << "Feature matching failed";
         return EXIT_FAILURE;
     }
@@ -89,4 +100,29 @@ std::int8_t ReconstructionEngine::mapModel(
     return EXIT_SUCCESS;
 }
 
+void ReconstructionEngine::setFeatureCacheBudget(std::size_t max_num_bytes) {
+    LOG(MM_INFO) << "Setting feature cache budget to " << max_num_bytes
+                 << " bytes (currently used: "
+                 << this->featureCacheBudget->NumBytes() << ")";
+    this->featureCacheBudget->SetMaxNumBytes(max_num_bytes);
+}
+
+void ReconstructionEngine::trimMemory(int level) {
+    std::size_t max_num_bytes = colmap::FeatureMatcherCache::kDefaultMaxNumBytes;
+    if (level >= kTrimMemoryRunningCritical) {
+        max_num_bytes /= 8;
+    }
+    else if (level >= kTrimMemoryRunningLow) {
+        max_num_bytes /= 4;
+    }
+    else if (level >= kTrimMemoryRunningModerate) {
+        max_num_bytes /= 2;
+    }
+
+    // Only ever shrink here, the budget is restored explicitly.
+    if (max_num_bytes < this->featureCacheBudget->MaxNumBytes()) {
+        setFeatureCacheBudget(max_num_bytes);
+    }
+}
+
 MM_NS_E
\ No newline at end of file
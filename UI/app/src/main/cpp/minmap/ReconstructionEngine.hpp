@@ -10,6 +10,8 @@
 #include "SfM.hpp"
 #include "minmap_defs.hpp"
 
+#include <memory>
+
 MM_NS_B
 
 class ReconstructionEngine {
@@ -32,9 +34,17 @@ public:
             const std::string& output_type,
             bool skip_distortion = false);
 
+    // Memory budget of the features cached during matching. Lowering it
+    // evicts cached features immediately, also while matching is running.
+    void setFeatureCacheBudget(std::size_t max_num_bytes);
+    // Shrinks the feature cache according to an Android trim memory level,
+    // see ComponentCallbacks2.
+    void trimMemory(int level);
+
 private:
     std::string datasetPath;
     std::string databasePath;
+    std::shared_ptr<colmap::CacheMemoryBudget> featureCacheBudget;
 };
 
 MM_NS_E
@@ -65,6 +65,10 @@ int RunMapper(
 
     options.mapper->fix_existing_frames = fix_existing_frames;
 
+    // Keep a snapshot of the loaded database next to the database, so that
+    // repeated mapper runs on an unchanged database skip the loading phase.
+    options.mapper->database_cache_path = database_path.string() + ".cache";
+
     // Android-specific optimizations for mobile devices
     // Reduce computational load during pose estimation to prevent alignment issues
     options.mapper->min_focal_length_ratio = 0.1;
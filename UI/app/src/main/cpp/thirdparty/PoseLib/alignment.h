@@ -42,7 +42,11 @@
 #else
 #define CPP_VERSION __cplusplus
 #endif
-#if !EIGEN_VERSION_AT_LEAST(3, 4, 0) || CPP_VERSION < 201703L
+// With C++17, the aligned new also aligns the elements of the STL containers,
+// independent of the Eigen version. The specializations below would then only
+// give std::vector different allocators in the translation units with and
+// without this header, which violates the one definition rule.
+#if CPP_VERSION < 201703L
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -24,6 +24,8 @@ class NativeReconstructionEngine {
         outputPath: String,
         outputType: String,
         skipDistortion: Boolean = false): Int;
+    private external fun nativeSetFeatureCacheBudget(maxNumBytes: Long);
+    private external fun nativeTrimMemory(level: Int);
 
     private var isInitialized = false;
 
@@ -84,6 +86,18 @@ class NativeReconstructionEngine {
         )
     }
 
+    /** Limits the memory of the features cached while matching. */
+    fun setFeatureCacheBudget(maxNumBytes: Long) {
+        ensureInitialized()
+        nativeSetFeatureCacheBudget(maxNumBytes)
+    }
+
+    /** Forwards [android.content.ComponentCallbacks2.onTrimMemory] levels. */
+    fun trimMemory(level: Int) {
+        if (isInitialized) {
+            nativeTrimMemory(level)
+        }
+    }
 
     private fun ensureInitialized() {
         check(isInitialized) { "Engine not initialized. Call create() first." }
@@ -1,5 +1,7 @@
 package com.example.ipmedth_nfi.pages.scan
 
+import android.content.ComponentCallbacks2
+import android.content.res.Configuration
 import android.util.Log
 import androidx.camera.core.CameraSelector
 import androidx.camera.core.ImageCapture
@@ -79,7 +81,24 @@ fun ScanCameraContent(
             databasePath = databasePath.absolutePath
         )
 
+        // Release cached features when the system runs low on memory
+        val memoryCallbacks = object : ComponentCallbacks2 {
+            override fun onTrimMemory(level: Int) {
+                reconstructionEngine.trimMemory(level)
+            }
+
+            override fun onConfigurationChanged(newConfig: Configuration) {}
+
+            @Deprecated("Deprecated in Java")
+            override fun onLowMemory() {
+                reconstructionEngine.trimMemory(
+                    ComponentCallbacks2.TRIM_MEMORY_COMPLETE)
+            }
+        }
+        context.applicationContext.registerComponentCallbacks(memoryCallbacks)
+
         onDispose {
+            context.applicationContext.unregisterComponentCallbacks(memoryCallbacks)
             reconstructionEngine.destroy()
         }
     }